@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// QBENCH.H
+//
+// Minimal microbenchmark harness for Quadrion Engine kernels
+//
+// A benchmark is a function that runs its kernel 'iterations' times over some user data. The
+// harness warms it up, then times several repetitions and reports the fastest and the median
+// in ns per op along with the throughput. Every result is also kept for the JSON report
+// (qbench --json <file>) so runs can be compared across releases.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __QBENCH_H_
+#define __QBENCH_H_
+
+
+typedef void (*QBENCH_FUNC)(void* data, const unsigned int& iterations);
+
+
+struct QBenchResult
+{
+	const char*		group;
+	const char*		name;
+	const char*		variant;
+	double			nsPerOp;			// fastest repetition
+	double			nsPerOpMedian;		// median repetition
+	double			opsPerSec;			// throughput of the fastest repetition
+	unsigned int	repetitions;
+	unsigned int	iterations;
+	unsigned int	opsPerIteration;
+};
+
+
+// Times func. opsPerIteration is how many logical operations one iteration performs (eg. the //
+// batch size) so that results of batched and single-call kernels are directly comparable.    //
+QBenchResult QBENCH_RUN(const char* group, const char* name, const char* variant, QBENCH_FUNC func, void* data, const unsigned int& iterations, const unsigned int& opsPerIteration);
+
+void QBENCH_PRINT_HEADER();
+void QBENCH_PRINT(const QBenchResult& res);
+
+// Keeps the optimizer from discarding kernel results //
+void QBENCH_SINK(const float* p, const unsigned int& n);
+
+
+// Benchmark groups //
+void QBENCH_MATH();
+void QBENCH_CULL();
+void QBENCH_MESH();
+void QBENCH_GEOM();
+void QBENCH_IMAGE();
+
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include "qbench.h"
+#include "qmath.h"
+#include "qcamera.h"
+
+
+
+#define CULL_COUNT		100000
+
+
+struct cullBenchData
+{
+	CCamera			camera;
+	CAABBList		boxes;
+	CSphereList		spheres;
+	vec3f*			mins;
+	vec3f*			maxs;
+	unsigned int*	mask;
+	unsigned int*	indices;
+	unsigned int	nVisible;
+};
+
+
+static float randRange(const float& lo, const float& hi)
+{
+	return lo + (hi - lo) * ((float)rand() / (float)RAND_MAX);
+}
+
+
+// Per volume loops through the existing CCamera tests, the baseline for the batched paths //
+static void benchAABBLoop(void* p, const unsigned int& iterations)
+{
+	cullBenchData* d = (cullBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		unsigned int nVisible = 0;
+		for(unsigned int i = 0; i < CULL_COUNT; ++i)
+		{
+			if(d->camera.IsAABBInFrustum(d->mins[i], d->maxs[i]) != QMATH_OUTSIDE)
+				d->indices[nVisible++] = i;
+		}
+		d->nVisible = nVisible;
+	}
+}
+
+static void benchSphereLoop(void* p, const unsigned int& iterations)
+{
+	cullBenchData* d = (cullBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		unsigned int nVisible = 0;
+		for(unsigned int i = 0; i < CULL_COUNT; ++i)
+		{
+			vec3f c(d->spheres.m_centerX[i], d->spheres.m_centerY[i], d->spheres.m_centerZ[i]);
+			if(d->camera.IsSphereInFrustum(c, d->spheres.m_radius[i]) != QMATH_OUTSIDE)
+				d->indices[nVisible++] = i;
+		}
+		d->nVisible = nVisible;
+	}
+}
+
+static void benchAABBBatch(void* p, const unsigned int& iterations)
+{
+	cullBenchData* d = (cullBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		d->nVisible = d->camera.CullAABBs(d->boxes, d->mask, d->indices);
+}
+
+static void benchSphereBatch(void* p, const unsigned int& iterations)
+{
+	cullBenchData* d = (cullBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		d->nVisible = d->camera.CullSpheres(d->spheres, d->mask, d->indices);
+}
+
+static void benchAABBMaskOnly(void* p, const unsigned int& iterations)
+{
+	cullBenchData* d = (cullBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		d->nVisible = d->camera.CullAABBs(d->boxes, d->mask);
+}
+
+
+void QBENCH_CULL()
+{
+	cullBenchData* d = new cullBenchData;
+	d->mins = new vec3f[CULL_COUNT];
+	d->maxs = new vec3f[CULL_COUNT];
+	d->mask = new unsigned int[(CULL_COUNT + 31) / 32];
+	d->indices = new unsigned int[CULL_COUNT];
+	d->nVisible = 0;
+
+	// Camera at the origin looking down +z, boxes scattered all around it so that //
+	// roughly a sixth of them survive                                             //
+	mat4 view, proj, viewProj;
+	QMATH_MATRIX_LOADVIEW_DX(view, vec3f(0.0F, 0.0F, 0.0F), vec3f(0.0F, 0.0F, 1.0F), vec3f(0.0F, 1.0F, 0.0F));
+	QMATH_MATRIX_LOADPERSPECTIVE_DX(proj, QMATH_DEG2RAD(60.0F), 1.333F, 1.0F, 1000.0F);
+	QMATH_MATRIX_MULTIPLY(proj, view, viewProj);
+
+	vec4f planes[6];
+	QMATH_GET_FRUSTUM_PLANES(viewProj, planes);
+	for(int i = 0; i < 6; ++i)
+	{
+		vec3f n(planes[i].x, planes[i].y, planes[i].z);
+		float iMag = 1.0F / n.getLength();
+		planes[i].set(planes[i].x * iMag, planes[i].y * iMag, planes[i].z * iMag, planes[i].w * iMag);
+	}
+	d->camera.SetClipPlanes(planes);
+
+	srand(4321);
+	d->boxes.Reserve(CULL_COUNT);
+	d->spheres.Reserve(CULL_COUNT);
+	for(unsigned int i = 0; i < CULL_COUNT; ++i)
+	{
+		vec3f c(randRange(-800.0F, 800.0F), randRange(-800.0F, 800.0F), randRange(-800.0F, 800.0F));
+		vec3f e(randRange(0.5F, 8.0F), randRange(0.5F, 8.0F), randRange(0.5F, 8.0F));
+		d->mins[i] = c - e;
+		d->maxs[i] = c + e;
+		d->boxes.Add(d->mins[i], d->maxs[i]);
+		d->spheres.Add(c, e.getLength());
+	}
+
+	QBENCH_PRINT(QBENCH_RUN("cull", "aabb_loop", "scalar", benchAABBLoop, d, 10, CULL_COUNT));
+	QBENCH_PRINT(QBENCH_RUN("cull", "sphere_loop", "scalar", benchSphereLoop, d, 10, CULL_COUNT));
+
+	static const char* levelNames[] = { "scalar", "sse", "avx" };
+	QMATH_SIMD_LEVEL support = QMATH_GET_SIMD_SUPPORT();
+	QMATH_SIMD_LEVEL prev = QMATH_GET_SIMD_LEVEL();
+
+	for(int lvl = QMATH_SIMD_SCALAR; lvl <= support; ++lvl)
+	{
+		QMATH_SET_SIMD_LEVEL((QMATH_SIMD_LEVEL)lvl);
+		const char* v = levelNames[lvl];
+
+		QBENCH_PRINT(QBENCH_RUN("cull", "aabb_batch", v, benchAABBBatch, d, 10, CULL_COUNT));
+		QBENCH_PRINT(QBENCH_RUN("cull", "aabb_batch_mask", v, benchAABBMaskOnly, d, 10, CULL_COUNT));
+		QBENCH_PRINT(QBENCH_RUN("cull", "sphere_batch", v, benchSphereBatch, d, 10, CULL_COUNT));
+	}
+
+	QMATH_SET_SIMD_LEVEL(prev);
+
+	delete[] d->mins;
+	delete[] d->maxs;
+	delete[] d->mask;
+	delete[] d->indices;
+	delete d;
+}
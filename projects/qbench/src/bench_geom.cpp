@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <string.h>
+#include "qbench.h"
+#include "qmath.h"
+#include "qgeom.h"
+
+
+
+#define GEOM_COUNT		100000
+
+
+struct geomBenchData
+{
+	CCone			cone;
+	vec3f*			centers;
+	float*			radii;
+	CRay*			rays;
+	point3f*		hits;
+	unsigned int	nHits;
+};
+
+
+static float randRange(const float& lo, const float& hi)
+{
+	return lo + (hi - lo) * ((float)rand() / (float)RAND_MAX);
+}
+
+
+static void benchSphereInCone(void* p, const unsigned int& iterations)
+{
+	geomBenchData* d = (geomBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		unsigned int nHits = 0;
+		for(unsigned int i = 0; i < GEOM_COUNT; ++i)
+		{
+			if(d->cone.IsSphereInCone(d->centers[i], d->radii[i]) != QMATH_OUTSIDE)
+				++nHits;
+		}
+		d->nHits = nHits;
+	}
+}
+
+// Each ray is intersected with its neighbour //
+static void benchRayIntersection(void* p, const unsigned int& iterations)
+{
+	geomBenchData* d = (geomBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		unsigned int nHits = 0;
+		for(unsigned int i = 0; i < GEOM_COUNT - 1; ++i)
+		{
+			if(d->rays[i].GetRayIntersection(d->rays[i + 1], d->hits[nHits]))
+				++nHits;
+		}
+		d->nHits = nHits;
+	}
+	QBENCH_SINK(&d->hits[0].x, 3);
+}
+
+
+void QBENCH_GEOM()
+{
+	geomBenchData* d = new geomBenchData;
+	d->centers = new vec3f[GEOM_COUNT];
+	d->radii = new float[GEOM_COUNT];
+	d->rays = new CRay[GEOM_COUNT];
+	d->hits = new point3f[GEOM_COUNT];
+	d->nHits = 0;
+
+	// 30 degree spot light at the origin looking down +z //
+	d->cone.SetVertex(vec3f(0.0F, 0.0F, 0.0F));
+	d->cone.SetDirection(vec3f(0.0F, 0.0F, 1.0F));
+	d->cone.SetTheta(QMATH_DEG2RAD(30.0F));
+
+	srand(2468);
+	for(unsigned int i = 0; i < GEOM_COUNT; ++i)
+	{
+		d->centers[i].set(randRange(-200.0F, 200.0F), randRange(-200.0F, 200.0F), randRange(-200.0F, 200.0F));
+		d->radii[i] = randRange(0.5F, 16.0F);
+
+		vec3f v(randRange(-100.0F, 100.0F), randRange(-100.0F, 100.0F), randRange(-100.0F, 100.0F));
+		vec3f dir(randRange(-1.0F, 1.0F), randRange(-1.0F, 1.0F), randRange(-1.0F, 1.0F));
+		d->rays[i].SetVertex(v);
+		d->rays[i].SetDirection(dir);
+	}
+
+	QBENCH_PRINT(QBENCH_RUN("geom", "sphere_in_cone", "scalar", benchSphereInCone, d, 20, GEOM_COUNT));
+	QBENCH_PRINT(QBENCH_RUN("geom", "ray_intersection", "scalar", benchRayIntersection, d, 20, GEOM_COUNT - 1));
+
+	delete[] d->centers;
+	delete[] d->radii;
+	delete[] d->rays;
+	delete[] d->hits;
+	delete d;
+}
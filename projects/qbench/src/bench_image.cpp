@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qbench.h"
+#include "qimage.h"
+#include "qmath.h"
+#include "qparallel.h"
+#include "jpegdecoder.h"
+
+
+
+#define MIP_DIM			1024
+#define MIP_ODD_W		1000
+#define MIP_ODD_H		700
+#define BLOCK_DIM		512
+#define CUBE_DIM		256
+#define NORMAL_DIM		1024
+#define CONVERT_DIM		2048
+#define IDCT_BLOCKS		4096
+#define JPEG_SAMPLES	3
+#define JPEG_RESTARTS	2
+#define JPEG_THREADS	4
+
+
+struct imageBenchData
+{
+	unsigned char*		pixels;			// level 0 followed by room for the chain
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		nChannels;
+	QIMAGE_CHANNEL_TYPE	type;
+	unsigned int		srgbMask;
+};
+
+
+static void benchMipChain(void* p, const unsigned int& iterations)
+{
+	imageBenchData* d = (imageBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QIMAGE_GENERATE_MIP_CHAIN(d->pixels, d->width, d->height, 1, 1, 127, d->nChannels, d->type, d->srgbMask);
+}
+
+
+struct blockBenchData
+{
+	unsigned char*		pixels;
+	unsigned char*		blocks;
+	unsigned char*		decoded;
+	unsigned int		dim;
+	unsigned int		nChannels;
+	QIMAGE_BLOCK_FORMAT	format;
+};
+
+
+static void benchCompress(void* p, const unsigned int& iterations)
+{
+	blockBenchData* d = (blockBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QIMAGE_COMPRESS(d->pixels, d->blocks, d->dim, d->dim, 1, d->nChannels, d->format);
+}
+
+static void benchDecompress(void* p, const unsigned int& iterations)
+{
+	blockBenchData* d = (blockBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QIMAGE_DECOMPRESS(d->blocks, d->decoded, d->dim, d->dim, 1, d->format);
+}
+
+
+// Chain of a compressed cubemap, each level holds its 6 faces one after the other //
+static unsigned int cubeBlockBytes(const unsigned int& dim, const QIMAGE_BLOCK_FORMAT& format)
+{
+	unsigned int blockSize = (format == QIMAGE_BLOCK_BC1 || format == QIMAGE_BLOCK_BC4) ? 8 : 16;
+	return ((dim + 3) >> 2) * ((dim + 3) >> 2) * blockSize * 6;
+}
+
+// Decodes the whole chain like CQuadrionTextureFile::ConvertToGreyscaleCompressed, a level at a //
+// time with all 6 faces through one buffer sized for level 0                                    //
+static void benchDecompressCube(void* p, const unsigned int& iterations)
+{
+	blockBenchData* d = (blockBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		const unsigned char* src = d->blocks;
+		for(unsigned int dim = d->dim; dim; dim >>= 1)
+		{
+			QIMAGE_DECOMPRESS(src, d->decoded, dim, dim, 6, d->format);
+			src += cubeBlockBytes(dim, d->format);
+		}
+	}
+}
+
+
+struct normalBenchData
+{
+	unsigned char*		heights;
+	unsigned char*		normals;
+	unsigned int		dim;
+	unsigned int		nChannels;
+};
+
+
+static void benchHeightToNormal(void* p, const unsigned int& iterations)
+{
+	normalBenchData* d = (normalBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QIMAGE_HEIGHT_TO_NORMAL(d->heights, d->normals, d->dim, d->dim, 1, d->nChannels, 0.125f);
+}
+
+
+struct convertBenchData
+{
+	unsigned char*		src;
+	unsigned char*		dst;
+	QIMAGE_PIXEL_LAYOUT	srcLayout;
+	QIMAGE_PIXEL_LAYOUT	dstLayout;
+};
+
+
+static void benchConvert(void* p, const unsigned int& iterations)
+{
+	convertBenchData* d = (convertBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QIMAGE_CONVERT(d->src, d->dst, CONVERT_DIM, CONVERT_DIM, d->srcLayout, d->dstLayout, true);
+}
+
+
+struct idctBenchData
+{
+	BLOCK_TYPE*			coefs;			// quantized, natural order
+	QUANT_TYPE*			quant;
+	QUANT_TYPE**		blockQuant;
+	BLOCK_TYPE*			dequant;		// dequantized copy for idct()
+	unsigned char*		samples;
+	Pidct_func			kernel;
+};
+
+
+// Same work as jpeg_decoder::transform_row, idct() dequantizes on a copy of the block //
+static void benchIdct(void* p, const unsigned int& iterations)
+{
+	idctBenchData* d = (idctBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		if(d->kernel)
+		{
+			d->kernel(d->coefs, d->blockQuant, IDCT_BLOCKS, d->samples);
+			continue;
+		}
+
+		BLOCK_TYPE block[64];
+		for(unsigned int i = 0; i < IDCT_BLOCKS; ++i)
+		{
+			memcpy(block, &d->dequant[i * 64], sizeof(block));
+			idct(block, &d->samples[i * 64]);
+		}
+	}
+}
+
+
+// Sample files, qbench is run from its project directory //
+static const char* s_jpegSamples[JPEG_SAMPLES] = { "data/colour_420.jpg", "data/colour_odd_q50.jpg", "data/grey_odd.jpg" };
+// Restart intervals of 7 MCUs (not a whole row) and of exactly one row //
+static const char* s_jpegRestartSamples[JPEG_RESTARTS] = { "data/colour_rst.jpg", "data/grey_rst.jpg" };
+
+
+struct jpegBenchData
+{
+	unsigned char*		files[JPEG_SAMPLES];	// whole file, NULL if it could not be read
+	unsigned int		sizes[JPEG_SAMPLES];
+	unsigned char*		images[JPEG_SAMPLES];	// RGBA rows, or grey for single component files
+	int					widths[JPEG_SAMPLES];
+	int					heights[JPEG_SAMPLES];
+	int					bpps[JPEG_SAMPLES];
+};
+
+
+// Reads a whole sample file, NULL if it could not be read //
+static unsigned char* readJpegFile(const char* fileName, unsigned int& size)
+{
+	FILE* f = fopen(fileName, "rb");
+	if(!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	size = (unsigned int)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	unsigned char* file = (unsigned char*)malloc(size);
+	if(file && fread(file, 1, size, f) != size)
+	{
+		free(file);
+		file = NULL;
+	}
+
+	fclose(f);
+	return file;
+}
+
+// Decodes a whole file at the current SIMD level into dst, which is NULL to only read the header. //
+// useThreads lets decode_image split files with restart markers across threads                   //
+static bool decodeJpeg(const unsigned char* file, const unsigned int& size, unsigned char* dst, int& w, int& h, int& bpp, const bool useThreads = false)
+{
+	jpeg_decoder_mem_stream stream(file, size);
+	jpeg_decoder decoder(&stream, false);
+	if(decoder.get_error_code() != 0 || decoder.begin() != JPGD_OKAY)
+		return false;
+
+	w = decoder.get_width();
+	h = decoder.get_height();
+	bpp = (decoder.get_num_components() == 1) ? 1 : 4;
+
+	return !dst || decoder.decode_image(dst, w * bpp, bpp, useThreads) == JPGD_OKAY;
+}
+
+static void benchJpegDecode(void* p, const unsigned int& iterations)
+{
+	jpegBenchData* d = (jpegBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		for(unsigned int i = 0; i < JPEG_SAMPLES; ++i)
+		{
+			int w, h, bpp;
+			if(d->files[i])
+				decodeJpeg(d->files[i], d->sizes[i], d->images[i], w, h, bpp);
+		}
+	}
+}
+
+
+static void runMipCase(const char* name, const char* variant, const unsigned int& w, const unsigned int& h, const unsigned int& nChannels, 
+					   const QIMAGE_CHANNEL_TYPE& type, const unsigned int& srgbMask)
+{
+	static const unsigned int channelSizes[] = { 1, 2, 2, 4 };
+	unsigned int levelSize = w * h * nChannels * channelSizes[type];
+
+	imageBenchData d;
+	d.pixels = (unsigned char*)QMATH_ALIGNED_MALLOC(levelSize * 2);
+	d.width = w;
+	d.height = h;
+	d.nChannels = nChannels;
+	d.type = type;
+	d.srgbMask = srgbMask;
+
+	srand(1357);
+	if(type == QIMAGE_CHANNEL_FLOAT)
+	{
+		for(unsigned int i = 0; i < w * h * nChannels; ++i)
+			((float*)d.pixels)[i] = (float)rand() / (float)RAND_MAX;
+	}
+	else if(type == QIMAGE_CHANNEL_HALF)
+	{
+		for(unsigned int i = 0; i < w * h * nChannels; ++i)
+			((unsigned short*)d.pixels)[i] = QIMAGE_FLOAT_TO_HALF((float)rand() / (float)RAND_MAX);
+	}
+	else
+	{
+		for(unsigned int i = 0; i < levelSize; ++i)
+			d.pixels[i] = (unsigned char)rand();
+	}
+
+	QBENCH_PRINT(QBENCH_RUN("image", name, variant, benchMipChain, &d, 4, w * h));
+	QMATH_ALIGNED_FREE(d.pixels);
+}
+
+
+// Random texels would make every block worst case, use smooth gradients with some noise on top. //
+// The blocks are then decoded again, which times the decoder on realistic data                 //
+static void runBlockCase(const char* name, const char* decodeName, const char* variant, const unsigned int& nChannels, const QIMAGE_BLOCK_FORMAT& format)
+{
+	blockBenchData d;
+	d.dim = BLOCK_DIM;
+	d.nChannels = nChannels;
+	d.format = format;
+	d.pixels = (unsigned char*)QMATH_ALIGNED_MALLOC(BLOCK_DIM * BLOCK_DIM * nChannels);
+	d.blocks = (unsigned char*)QMATH_ALIGNED_MALLOC(BLOCK_DIM * BLOCK_DIM);
+	d.decoded = (unsigned char*)QMATH_ALIGNED_MALLOC(BLOCK_DIM * BLOCK_DIM * 4);
+
+	srand(2468);
+	for(unsigned int y = 0; y < BLOCK_DIM; ++y)
+	{
+		for(unsigned int x = 0; x < BLOCK_DIM; ++x)
+		{
+			unsigned char* t = &d.pixels[(y * BLOCK_DIM + x) * nChannels];
+			for(unsigned int c = 0; c < nChannels; ++c)
+			{
+				unsigned int ramp = (c & 1) ? (x + y * 3) : (x * 2 + y);
+				t[c] = (unsigned char)((ramp + (rand() & 15)) & 0xFF);
+			}
+		}
+	}
+
+	QBENCH_PRINT(QBENCH_RUN("image", name, variant, benchCompress, &d, 1, BLOCK_DIM * BLOCK_DIM));
+	QBENCH_PRINT(QBENCH_RUN("image", decodeName, variant, benchDecompress, &d, 4, BLOCK_DIM * BLOCK_DIM));
+	QMATH_ALIGNED_FREE(d.pixels);
+	QMATH_ALIGNED_FREE(d.blocks);
+	QMATH_ALIGNED_FREE(d.decoded);
+}
+
+
+// Every face of every level must decode the same as when it is decoded on its own //
+static void runCubeCase(const char* name, const char* variant, const QIMAGE_BLOCK_FORMAT& format)
+{
+	unsigned int nChannels = QIMAGE_GET_BLOCK_CHANNELS(format);
+	unsigned int chainBytes = 0;
+	for(unsigned int dim = CUBE_DIM; dim; dim >>= 1)
+		chainBytes += cubeBlockBytes(dim, format);
+
+	blockBenchData d;
+	d.dim = CUBE_DIM;
+	d.nChannels = nChannels;
+	d.format = format;
+	d.pixels = (unsigned char*)QMATH_ALIGNED_MALLOC(CUBE_DIM * CUBE_DIM * 6 * nChannels);
+	d.blocks = (unsigned char*)QMATH_ALIGNED_MALLOC(chainBytes);
+	d.decoded = (unsigned char*)QMATH_ALIGNED_MALLOC(CUBE_DIM * CUBE_DIM * 6 * nChannels);
+
+	srand(3579);
+	unsigned char* blocks = d.blocks;
+	for(unsigned int dim = CUBE_DIM; dim; dim >>= 1)
+	{
+		for(unsigned int i = 0; i < dim * dim * 6 * nChannels; ++i)
+		{
+			unsigned int t = i / nChannels;
+			unsigned int face = t / (dim * dim);
+			d.pixels[i] = (unsigned char)((face * 40 + (t % dim) * 2 + ((t / dim) % dim) + (rand() & 15)) & 0xFF);
+		}
+
+		QIMAGE_COMPRESS(d.pixels, blocks, dim, dim, 6, nChannels, format);
+		blocks += cubeBlockBytes(dim, format);
+	}
+
+	QBENCH_PRINT(QBENCH_RUN("image", name, variant, benchDecompressCube, &d, 4, CUBE_DIM * CUBE_DIM * 6));
+
+	unsigned int nDiff = 0;
+	unsigned int nFaces = 0;
+	unsigned char* face = (unsigned char*)QMATH_ALIGNED_MALLOC(CUBE_DIM * CUBE_DIM * nChannels);
+	blocks = d.blocks;
+	for(unsigned int dim = CUBE_DIM; dim; dim >>= 1)
+	{
+		QIMAGE_DECOMPRESS(blocks, d.decoded, dim, dim, 6, format);
+		for(unsigned int f = 0; f < 6; ++f, ++nFaces)
+		{
+			unsigned int faceTexels = dim * dim * nChannels;
+			QIMAGE_DECOMPRESS(blocks + f * cubeBlockBytes(dim, format) / 6, face, dim, dim, 1, format);
+			if(memcmp(face, d.decoded + f * faceTexels, faceTexels) != 0)
+				++nDiff;
+		}
+
+		blocks += cubeBlockBytes(dim, format);
+	}
+
+	if(nDiff)
+		printf("  %s (%s): %u of %u faces differ from a single face decode\n", name, variant, nDiff, nFaces);
+
+	QMATH_ALIGNED_FREE(face);
+	QMATH_ALIGNED_FREE(d.pixels);
+	QMATH_ALIGNED_FREE(d.blocks);
+	QMATH_ALIGNED_FREE(d.decoded);
+}
+
+
+static void runNormalCase(const char* name, const char* variant, const unsigned int& nChannels)
+{
+	normalBenchData d;
+	d.dim = NORMAL_DIM;
+	d.nChannels = nChannels;
+	d.heights = (unsigned char*)QMATH_ALIGNED_MALLOC(NORMAL_DIM * NORMAL_DIM * nChannels);
+	d.normals = (unsigned char*)QMATH_ALIGNED_MALLOC(NORMAL_DIM * NORMAL_DIM * 4);
+
+	srand(8642);
+	for(unsigned int i = 0; i < NORMAL_DIM * NORMAL_DIM * nChannels; ++i)
+		d.heights[i] = (unsigned char)rand();
+
+	QBENCH_PRINT(QBENCH_RUN("image", name, variant, benchHeightToNormal, &d, 2, NORMAL_DIM * NORMAL_DIM));
+	QMATH_ALIGNED_FREE(d.heights);
+	QMATH_ALIGNED_FREE(d.normals);
+}
+
+
+// Loader style conversions, flipped like a bottom up TGA //
+static void runConvertCase(const char* name, const char* variant, const QIMAGE_PIXEL_LAYOUT& srcLayout, const QIMAGE_PIXEL_LAYOUT& dstLayout)
+{
+	convertBenchData d;
+	d.srcLayout = srcLayout;
+	d.dstLayout = dstLayout;
+	d.src = (unsigned char*)QMATH_ALIGNED_MALLOC(CONVERT_DIM * CONVERT_DIM * QIMAGE_GET_LAYOUT_BYTES(srcLayout));
+	d.dst = (unsigned char*)QMATH_ALIGNED_MALLOC(CONVERT_DIM * CONVERT_DIM * QIMAGE_GET_LAYOUT_BYTES(dstLayout));
+
+	srand(1357);
+	for(unsigned int i = 0; i < CONVERT_DIM * CONVERT_DIM * QIMAGE_GET_LAYOUT_BYTES(srcLayout); ++i)
+		d.src[i] = (unsigned char)rand();
+
+	QBENCH_PRINT(QBENCH_RUN("image", name, variant, benchConvert, &d, 4, CONVERT_DIM * CONVERT_DIM));
+	QMATH_ALIGNED_FREE(d.src);
+	QMATH_ALIGNED_FREE(d.dst);
+}
+
+
+// Coefficients look like a quality 75 photo, mostly low frequencies. The SIMD kernels must match idct() //
+// bit for bit, any difference is reported                                                              //
+static void runIdctCase(const char* name, const char* variant)
+{
+	idctBenchData d;
+	d.coefs = (BLOCK_TYPE*)QMATH_ALIGNED_MALLOC(IDCT_BLOCKS * 64 * sizeof(BLOCK_TYPE));
+	d.dequant = (BLOCK_TYPE*)QMATH_ALIGNED_MALLOC(IDCT_BLOCKS * 64 * sizeof(BLOCK_TYPE));
+	d.quant = (QUANT_TYPE*)QMATH_ALIGNED_MALLOC(64 * sizeof(QUANT_TYPE));
+	d.blockQuant = (QUANT_TYPE**)malloc(IDCT_BLOCKS * sizeof(QUANT_TYPE*));
+	d.samples = (unsigned char*)QMATH_ALIGNED_MALLOC(IDCT_BLOCKS * 64);
+	d.kernel = idct_select();
+
+	srand(9753);
+	for(unsigned int i = 0; i < 64; ++i)
+		d.quant[i] = (QUANT_TYPE)(4 + ((i & 7) + (i >> 3)) * 3);
+
+	for(unsigned int b = 0; b < IDCT_BLOCKS; ++b)
+	{
+		d.blockQuant[b] = d.quant;
+		for(unsigned int i = 0; i < 64; ++i)
+		{
+			unsigned int freq = (i & 7) + (i >> 3);
+			int c = (i == 0) ? (rand() % 256) - 128 : ((rand() % (freq + 2) == 0) ? (rand() % 64) - 32 : 0);
+			d.coefs[b * 64 + i] = (BLOCK_TYPE)c;
+			d.dequant[b * 64 + i] = (BLOCK_TYPE)(c * d.quant[i]);
+		}
+	}
+
+	QBENCH_PRINT(QBENCH_RUN("image", name, variant, benchIdct, &d, 16, IDCT_BLOCKS));
+
+	if(d.kernel)
+	{
+		unsigned int nDiff = 0;
+		for(unsigned int b = 0; b < IDCT_BLOCKS; ++b)
+		{
+			unsigned char ref[64];
+			BLOCK_TYPE block[64];
+			memcpy(block, &d.dequant[b * 64], sizeof(block));
+			idct(block, ref);
+			if(memcmp(ref, &d.samples[b * 64], 64) != 0)
+				++nDiff;
+		}
+
+		if(nDiff)
+			printf("  %s (%s): %u of %u blocks differ from idct()\n", name, variant, nDiff, IDCT_BLOCKS);
+	}
+
+	QMATH_ALIGNED_FREE(d.coefs);
+	QMATH_ALIGNED_FREE(d.dequant);
+	QMATH_ALIGNED_FREE(d.quant);
+	QMATH_ALIGNED_FREE(d.samples);
+	free(d.blockQuant);
+}
+
+
+// Whole files through jpeg_decoder, the SSE2 and AVX2 IDCTs and colour conversion must give the //
+// same pixels as the scalar decode                                                              //
+static void runJpegCase(const char* name, const char* variant)
+{
+	jpegBenchData d;
+	unsigned int nPixels = 0;
+	for(unsigned int i = 0; i < JPEG_SAMPLES; ++i)
+	{
+		d.images[i] = NULL;
+		d.files[i] = readJpegFile(s_jpegSamples[i], d.sizes[i]);
+		if(!d.files[i])
+		{
+			printf("  %s (%s): could not open %s\n", name, variant, s_jpegSamples[i]);
+			continue;
+		}
+
+		if(!decodeJpeg(d.files[i], d.sizes[i], NULL, d.widths[i], d.heights[i], d.bpps[i]))
+		{
+			printf("  %s (%s): could not decode %s\n", name, variant, s_jpegSamples[i]);
+			free(d.files[i]);
+			d.files[i] = NULL;
+			continue;
+		}
+
+		d.images[i] = (unsigned char*)malloc(d.widths[i] * d.heights[i] * d.bpps[i]);
+		nPixels += d.widths[i] * d.heights[i];
+	}
+
+	if(nPixels)
+		QBENCH_PRINT(QBENCH_RUN("image", name, variant, benchJpegDecode, &d, 4, nPixels));
+
+	QMATH_SIMD_LEVEL level = QMATH_GET_SIMD_LEVEL();
+	for(unsigned int i = 0; i < JPEG_SAMPLES && level != QMATH_SIMD_SCALAR; ++i)
+	{
+		if(!d.files[i])
+			continue;
+
+		int w, h, bpp;
+		unsigned int imageSize = d.widths[i] * d.heights[i] * d.bpps[i];
+		unsigned char* ref = (unsigned char*)malloc(imageSize);
+
+		QMATH_SET_SIMD_LEVEL(QMATH_SIMD_SCALAR);
+		bool refOk = decodeJpeg(d.files[i], d.sizes[i], ref, w, h, bpp);
+		QMATH_SET_SIMD_LEVEL(level);
+
+		bool ok = decodeJpeg(d.files[i], d.sizes[i], d.images[i], w, h, bpp);
+		if(!refOk || !ok)
+			printf("  %s (%s): %s failed to decode\n", name, variant, s_jpegSamples[i]);
+		else
+		{
+			unsigned int nDiff = 0;
+			for(unsigned int b = 0; b < imageSize; ++b)
+				nDiff += (ref[b] != d.images[i][b]);
+
+			if(nDiff)
+				printf("  %s (%s): %u of %u bytes of %s differ from the scalar decode\n", name, variant, nDiff, imageSize, s_jpegSamples[i]);
+		}
+
+		free(ref);
+	}
+
+	for(unsigned int i = 0; i < JPEG_SAMPLES; ++i)
+	{
+		free(d.files[i]);
+		free(d.images[i]);
+	}
+
+	// Restart marker files go through the threaded split of decode_image and through jpeg_decode_batch, //
+	// both must match the serial decode. The thread count is forced so single core machines run them   //
+	unsigned int prevThreads = QPARALLEL_GET_MAX_THREADS();
+	QPARALLEL_SET_MAX_THREADS(JPEG_THREADS);
+
+	jpeg_batch_job_t jobs[JPEG_RESTARTS];
+	unsigned char* serial[JPEG_RESTARTS];
+	unsigned int imageSizes[JPEG_RESTARTS];
+	const char* jobFiles[JPEG_RESTARTS];
+	int nJobs = 0;
+	for(unsigned int i = 0; i < JPEG_RESTARTS; ++i)
+	{
+		int w, h, bpp;
+		unsigned int size;
+		unsigned char* file = readJpegFile(s_jpegRestartSamples[i], size);
+		if(!file || !decodeJpeg(file, size, NULL, w, h, bpp))
+		{
+			printf("  %s (%s): could not decode %s\n", name, variant, s_jpegRestartSamples[i]);
+			free(file);
+			continue;
+		}
+
+		unsigned int imageSize = w * h * bpp;
+		unsigned char* ref = (unsigned char*)malloc(imageSize);
+		unsigned char* threaded = (unsigned char*)malloc(imageSize);
+		if(!decodeJpeg(file, size, ref, w, h, bpp, false) || !decodeJpeg(file, size, threaded, w, h, bpp, true))
+			printf("  %s (%s): %s failed to decode\n", name, variant, s_jpegRestartSamples[i]);
+		else if(memcmp(ref, threaded, imageSize) != 0)
+			printf("  %s (%s): threaded decode of %s differs from the serial decode\n", name, variant, s_jpegRestartSamples[i]);
+
+		free(threaded);
+
+		jpeg_batch_job_t& job = jobs[nJobs];
+		job.Pdata = file;
+		job.data_size = size;
+		job.scale_shift = 0;
+		job.Pdst = malloc(imageSize);
+		job.dst_pitch = w * bpp;
+		job.dst_bpp = bpp;
+		job.status = JPGD_FAILED;
+		serial[nJobs] = ref;
+		imageSizes[nJobs] = imageSize;
+		jobFiles[nJobs] = s_jpegRestartSamples[i];
+		++nJobs;
+	}
+
+	// Once with a thread per file, which decodes whole files in parallel, and once with more threads //
+	// than files, which splits each file at its restart markers                                      //
+	for(unsigned int pass = 0; pass < 2 && nJobs; ++pass)
+	{
+		QPARALLEL_SET_MAX_THREADS(pass ? JPEG_THREADS : nJobs);
+		jpeg_decode_batch(jobs, nJobs);
+
+		for(int i = 0; i < nJobs; ++i)
+		{
+			if(jobs[i].status != JPGD_OKAY)
+				printf("  %s (%s): batch decode of %s failed\n", name, variant, jobFiles[i]);
+			else if(memcmp(serial[i], jobs[i].Pdst, imageSizes[i]) != 0)
+				printf("  %s (%s): batch decode of %s differs from the serial decode\n", name, variant, jobFiles[i]);
+		}
+	}
+
+	for(int i = 0; i < nJobs; ++i)
+	{
+		free((void*)jobs[i].Pdata);
+		free(jobs[i].Pdst);
+		free(serial[i]);
+	}
+
+	QPARALLEL_SET_MAX_THREADS(prevThreads);
+}
+
+
+void QBENCH_IMAGE()
+{
+	static const char* levelNames[] = { "scalar", "sse", "avx" };
+	QMATH_SIMD_LEVEL support = QMATH_GET_SIMD_SUPPORT();
+	QMATH_SIMD_LEVEL prev = QMATH_GET_SIMD_LEVEL();
+
+	for(int lvl = QMATH_SIMD_SCALAR; lvl <= support; ++lvl)
+	{
+		QMATH_SET_SIMD_LEVEL((QMATH_SIMD_LEVEL)lvl);
+		const char* v = levelNames[lvl];
+
+		runMipCase("mips_rgba8", v, MIP_DIM, MIP_DIM, 4, QIMAGE_CHANNEL_UNORM8, 0);
+		runMipCase("mips_rgba8_srgb", v, MIP_DIM, MIP_DIM, 4, QIMAGE_CHANNEL_UNORM8, 0x7);
+		runMipCase("mips_rgb8", v, MIP_DIM, MIP_DIM, 3, QIMAGE_CHANNEL_UNORM8, 0);
+		runMipCase("mips_i8", v, MIP_DIM, MIP_DIM, 1, QIMAGE_CHANNEL_UNORM8, 0);
+		runMipCase("mips_rgba8_npot", v, MIP_ODD_W, MIP_ODD_H, 4, QIMAGE_CHANNEL_UNORM8, 0);
+		runMipCase("mips_rgba16", v, MIP_DIM, MIP_DIM, 4, QIMAGE_CHANNEL_UNORM16, 0);
+		runMipCase("mips_rgba16f", v, MIP_DIM, MIP_DIM, 4, QIMAGE_CHANNEL_HALF, 0);
+		runMipCase("mips_rgba32f", v, MIP_DIM, MIP_DIM, 4, QIMAGE_CHANNEL_FLOAT, 0);
+
+		runBlockCase("compress_bc1", "decompress_bc1", v, 3, QIMAGE_BLOCK_BC1);
+		runBlockCase("compress_bc3", "decompress_bc3", v, 4, QIMAGE_BLOCK_BC3);
+		runBlockCase("compress_bc5", "decompress_bc5", v, 2, QIMAGE_BLOCK_BC5);
+		runCubeCase("decompress_bc1_cube", v, QIMAGE_BLOCK_BC1);
+		runCubeCase("decompress_bc4_cube", v, QIMAGE_BLOCK_BC4);
+
+		runNormalCase("height_to_normal_i8", v, 1);
+		runNormalCase("height_to_normal_rgb8", v, 3);
+
+		runConvertCase("convert_bgr8_rgb8", v, QIMAGE_LAYOUT_BGR8, QIMAGE_LAYOUT_RGB8);
+		runConvertCase("convert_bgra8_rgba8", v, QIMAGE_LAYOUT_BGRA8, QIMAGE_LAYOUT_RGBA8);
+		runConvertCase("convert_rgb8_rgba8", v, QIMAGE_LAYOUT_RGB8, QIMAGE_LAYOUT_RGBA8);
+		runConvertCase("convert_r5g6b5_rgba8", v, QIMAGE_LAYOUT_R5G6B5, QIMAGE_LAYOUT_RGBA8);
+		runConvertCase("convert_a1r5g5b5_rgba8", v, QIMAGE_LAYOUT_A1R5G5B5, QIMAGE_LAYOUT_RGBA8);
+		runConvertCase("convert_i8_rgba8", v, QIMAGE_LAYOUT_I8, QIMAGE_LAYOUT_RGBA8);
+
+		runIdctCase("jpeg_idct", v);
+		runJpegCase("jpeg_decode", v);
+	}
+
+	QMATH_SET_SIMD_LEVEL(prev);
+}
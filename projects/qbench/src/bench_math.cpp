@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+#include "qbench.h"
+#include "qmath.h"
+
+
+
+#define BATCH_SIZE		4096
+
+
+struct mathBenchData
+{
+	float*		mats;
+	float*		out;
+	vec4f*		vecs;
+	vec4f*		vecsOut;
+	vec3f*		points;
+	vec3f*		pointsOut;
+	quat*		quatsA;
+	quat*		quatsB;
+	quat*		quatsOut;
+	float*		weights;
+	QMATH_ALIGN(16) mat4 viewProj;
+};
+
+
+static float randf()
+{
+	return ((float)(rand() % 2001) - 1000.0F) / 100.0F;
+}
+
+
+static void benchMultiply(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+			QMATH_MATRIX_MULTIPLY(d->viewProj, *(mat4*)&d->mats[i * 16], *(mat4*)&d->out[i * 16]);
+	}
+	QBENCH_SINK(d->out, 16);
+}
+
+static void benchMultiplyBatch(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_MATRIX_MULTIPLY_BATCH(d->viewProj, d->mats, d->out, BATCH_SIZE);
+	QBENCH_SINK(d->out, 16);
+}
+
+static void benchMulVec(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+			QMATH_MATRIX_MULVEC(d->viewProj, d->vecs[i], d->vecsOut[i]);
+	}
+	QBENCH_SINK(&d->vecsOut[0].x, 4);
+}
+
+static void benchMulVecBatch(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_MATRIX_MULVEC_BATCH(d->viewProj, d->vecs, d->vecsOut, BATCH_SIZE);
+	QBENCH_SINK(&d->vecsOut[0].x, 4);
+}
+
+static void benchTransformPoints(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_MATRIX_TRANSFORM_POINTS(d->viewProj, d->points, d->pointsOut, BATCH_SIZE);
+	QBENCH_SINK(&d->pointsOut[0].x, 3);
+}
+
+static void benchTranspose(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+			QMATH_MATRIX_TRANSPOSE(*(mat4*)&d->mats[i * 16]);
+	}
+	QBENCH_SINK(d->mats, 16);
+}
+
+static void benchInverse(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+			QMATH_MATRIX_INVERSE(*(mat4*)&d->mats[i * 16], *(mat4*)&d->out[i * 16]);
+	}
+	QBENCH_SINK(d->out, 16);
+}
+
+static void benchInverseTransposeBatch(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_MATRIX_INVERSETRANSPOSE_BATCH(d->mats, d->out, BATCH_SIZE);
+	QBENCH_SINK(d->out, 16);
+}
+
+static void benchNormalize(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+		{
+			d->pointsOut[i] = d->points[i];
+			QMATH_VEC3F_NORMALIZE(d->pointsOut[i]);
+		}
+	}
+	QBENCH_SINK(&d->pointsOut[0].x, 3);
+}
+
+static void benchSlerp(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+	{
+		for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+			QMATH_QUATERNION_SLERP(d->quatsA[i], d->quatsB[i], d->weights[i], d->quatsOut[i]);
+	}
+	QBENCH_SINK(&d->quatsOut[0].x, 4);
+}
+
+static void benchSlerpBatch(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_QUATERNION_SLERP_BATCH(d->quatsA, d->quatsB, d->weights, d->quatsOut, BATCH_SIZE);
+	QBENCH_SINK(&d->quatsOut[0].x, 4);
+}
+
+static void benchNlerpBatch(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_QUATERNION_NLERP_BATCH(d->quatsA, d->quatsB, d->weights, d->quatsOut, BATCH_SIZE);
+	QBENCH_SINK(&d->quatsOut[0].x, 4);
+}
+
+static void benchQuatMatrixBatch(void* p, const unsigned int& iterations)
+{
+	mathBenchData* d = (mathBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_QUATERNION_MAKEMATRIX_BATCH(d->quatsA, d->points, d->out, BATCH_SIZE);
+	QBENCH_SINK(d->out, 16);
+}
+
+
+void QBENCH_MATH()
+{
+	mathBenchData d;
+	d.mats = (float*)QMATH_ALIGNED_MALLOC(sizeof(float) * 16 * BATCH_SIZE);
+	d.out = (float*)QMATH_ALIGNED_MALLOC(sizeof(float) * 16 * BATCH_SIZE);
+	d.vecs = (vec4f*)QMATH_ALIGNED_MALLOC(sizeof(vec4f) * BATCH_SIZE);
+	d.vecsOut = (vec4f*)QMATH_ALIGNED_MALLOC(sizeof(vec4f) * BATCH_SIZE);
+	d.points = new vec3f[BATCH_SIZE];
+	d.pointsOut = new vec3f[BATCH_SIZE];
+	d.quatsA = new quat[BATCH_SIZE];
+	d.quatsB = new quat[BATCH_SIZE];
+	d.quatsOut = new quat[BATCH_SIZE];
+	d.weights = new float[BATCH_SIZE];
+
+	srand(1234);
+	for(unsigned int i = 0; i < 16 * BATCH_SIZE; ++i)
+		d.mats[i] = randf();
+	for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+	{
+		d.vecs[i].set(randf(), randf(), randf(), 1.0F);
+		d.points[i].set(randf(), randf(), randf());
+		d.quatsA[i].set(randf(), randf(), randf(), randf());
+		d.quatsB[i].set(randf(), randf(), randf(), randf());
+		d.quatsA[i].normalize();
+		d.quatsB[i].normalize();
+		d.weights[i] = (float)(rand() % 1001) / 1000.0F;
+	}
+	QMATH_MATRIX_LOADPERSPECTIVE_DX(d.viewProj, QMATH_DEG2RAD(60.0F), 1.333F, 1.0F, 1000.0F);
+
+	static const char* levelNames[] = { "scalar", "sse", "avx" };
+	QMATH_SIMD_LEVEL support = QMATH_GET_SIMD_SUPPORT();
+	QMATH_SIMD_LEVEL prev = QMATH_GET_SIMD_LEVEL();
+
+	for(int lvl = QMATH_SIMD_SCALAR; lvl <= support; ++lvl)
+	{
+		QMATH_SET_SIMD_LEVEL((QMATH_SIMD_LEVEL)lvl);
+		const char* v = levelNames[lvl];
+
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_multiply", v, benchMultiply, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_multiply_batch", v, benchMultiplyBatch, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_mulvec", v, benchMulVec, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_mulvec_batch", v, benchMulVecBatch, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_transform_points", v, benchTransformPoints, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_transpose", v, benchTranspose, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_inverse", v, benchInverse, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "mat4_inversetranspose_batch", v, benchInverseTransposeBatch, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "vec3_normalize", v, benchNormalize, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "quat_slerp", v, benchSlerp, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "quat_slerp_batch", v, benchSlerpBatch, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "quat_nlerp_batch", v, benchNlerpBatch, &d, 200, BATCH_SIZE));
+		QBENCH_PRINT(QBENCH_RUN("math", "quat_makematrix_batch", v, benchQuatMatrixBatch, &d, 200, BATCH_SIZE));
+	}
+
+	QMATH_SET_SIMD_LEVEL(prev);
+
+	QMATH_ALIGNED_FREE(d.mats);
+	QMATH_ALIGNED_FREE(d.out);
+	QMATH_ALIGNED_FREE(d.vecs);
+	QMATH_ALIGNED_FREE(d.vecsOut);
+	delete[] d.points;
+	delete[] d.pointsOut;
+	delete[] d.quatsA;
+	delete[] d.quatsB;
+	delete[] d.quatsOut;
+	delete[] d.weights;
+}
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+#include "qbench.h"
+#include "qmath.h"
+
+
+
+// A wavy grid, GRID_DIM * GRID_DIM quads split into 2 triangles each (~130k triangles) //
+#define GRID_DIM		256
+
+
+struct meshBenchData
+{
+	vec3f*			verts;
+	vec2f*			texcoords;
+	vec3f*			norms;
+	vec3f*			tangents;
+	vec3f*			bitangents;
+	unsigned int*	polys;
+	unsigned int	nVerts;
+	unsigned int	nPolys;
+};
+
+
+static void benchVertexNormals(void* p, const unsigned int& iterations)
+{
+	meshBenchData* d = (meshBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_CREATE_VERTEX_NORMALS(d->verts, d->nVerts, d->polys, d->nPolys, &d->norms[0].x);
+	QBENCH_SINK(&d->norms[0].x, 3);
+}
+
+static void benchTangentSpace(void* p, const unsigned int& iterations)
+{
+	meshBenchData* d = (meshBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_CREATE_TANGENT_SPACE(d->verts, d->nVerts, d->polys, d->nPolys, d->texcoords, d->norms, d->tangents);
+	QBENCH_SINK(&d->tangents[0].x, 3);
+}
+
+static void benchTangentFrames(void* p, const unsigned int& iterations)
+{
+	meshBenchData* d = (meshBenchData*)p;
+	for(unsigned int it = 0; it < iterations; ++it)
+		QMATH_CREATE_TANGENT_FRAMES(d->verts, d->nVerts, d->polys, d->nPolys, d->texcoords, d->norms, d->tangents, d->bitangents);
+	QBENCH_SINK(&d->bitangents[0].x, 3);
+}
+
+
+void QBENCH_MESH()
+{
+	const unsigned int dim = GRID_DIM + 1;
+
+	meshBenchData d;
+	d.nVerts = dim * dim;
+	d.nPolys = GRID_DIM * GRID_DIM * 2;
+	d.verts = new vec3f[d.nVerts];
+	d.texcoords = new vec2f[d.nVerts];
+	d.norms = new vec3f[d.nVerts];
+	d.tangents = new vec3f[d.nVerts];
+	d.bitangents = new vec3f[d.nVerts];
+	d.polys = new unsigned int[d.nPolys * 3];
+
+	for(unsigned int y = 0; y < dim; ++y)
+	{
+		for(unsigned int x = 0; x < dim; ++x)
+		{
+			unsigned int i = y * dim + x;
+			d.verts[i].set((float)x, sinf((float)x * 0.3F) * cosf((float)y * 0.2F) * 4.0F, (float)y);
+			d.texcoords[i].set((float)x / (float)GRID_DIM, (float)y / (float)GRID_DIM);
+		}
+	}
+
+	unsigned int* idx = d.polys;
+	for(unsigned int y = 0; y < GRID_DIM; ++y)
+	{
+		for(unsigned int x = 0; x < GRID_DIM; ++x)
+		{
+			unsigned int i = y * dim + x;
+			idx[0] = i;		idx[1] = i + dim;	idx[2] = i + 1;
+			idx[3] = i + 1;	idx[4] = i + dim;	idx[5] = i + dim + 1;
+			idx += 6;
+		}
+	}
+
+	// the tangent benchmarks need valid normals //
+	QMATH_CREATE_VERTEX_NORMALS(d.verts, d.nVerts, d.polys, d.nPolys, &d.norms[0].x);
+
+	QBENCH_PRINT(QBENCH_RUN("mesh", "vertex_normals", "-", benchVertexNormals, &d, 10, d.nPolys));
+	QBENCH_PRINT(QBENCH_RUN("mesh", "tangent_space", "-", benchTangentSpace, &d, 10, d.nPolys));
+	QBENCH_PRINT(QBENCH_RUN("mesh", "tangent_frames", "-", benchTangentFrames, &d, 10, d.nPolys));
+
+	delete[] d.verts;
+	delete[] d.texcoords;
+	delete[] d.norms;
+	delete[] d.tangents;
+	delete[] d.bitangents;
+	delete[] d.polys;
+}
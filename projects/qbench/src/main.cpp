@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qbench.h"
+#include "qcpu.h"
+#include "qmath.h"
+#include "qtimer.h"
+
+
+
+#define QBENCH_MAX_RESULTS		256
+#define QBENCH_MAX_REPS			64
+
+
+static volatile float s_sink = 0.0F;
+
+static unsigned int s_nReps = 7;
+static const char* s_groupFilter = NULL;
+static bool s_quiet = false;
+
+static QBenchResult s_results[QBENCH_MAX_RESULTS];
+static unsigned int s_nResults = 0;
+
+
+void QBENCH_SINK(const float* p, const unsigned int& n)
+{
+	float acc = 0.0F;
+	for(unsigned int i = 0; i < n; ++i)
+		acc += p[i];
+	s_sink = s_sink + acc;
+}
+
+
+static int compareDouble(const void* l, const void* r)
+{
+	double a = *(const double*)l, b = *(const double*)r;
+	return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+QBenchResult QBENCH_RUN(const char* group, const char* name, const char* variant, QBENCH_FUNC func, void* data, const unsigned int& iterations, const unsigned int& opsPerIteration)
+{
+	CTimer timer;
+	double us[QBENCH_MAX_REPS];
+
+	// warm caches and branch predictors //
+	func(data, iterations / 4 + 1);
+
+	for(unsigned int i = 0; i < s_nReps; ++i)
+	{
+		timer.Start();
+		func(data, iterations);
+		timer.Stop();
+		us[i] = timer.GetElapsedMicroSec();
+	}
+	qsort(us, s_nReps, sizeof(double), compareDouble);
+
+	double ops = (double)iterations * (double)opsPerIteration;
+
+	QBenchResult res;
+	res.group = group;
+	res.name = name;
+	res.variant = variant;
+	res.nsPerOp = (us[0] * 1000.0) / ops;
+	res.nsPerOpMedian = (us[s_nReps / 2] * 1000.0) / ops;
+	res.opsPerSec = (us[0] > 0.0) ? ops / (us[0] * 0.000001) : 0.0;
+	res.repetitions = s_nReps;
+	res.iterations = iterations;
+	res.opsPerIteration = opsPerIteration;
+
+	if(s_nResults < QBENCH_MAX_RESULTS)
+		s_results[s_nResults++] = res;
+	return res;
+}
+
+void QBENCH_PRINT_HEADER()
+{
+	if(s_quiet)
+		return;
+	printf("%-10s %-28s %-8s %12s %12s %12s\n", "group", "benchmark", "variant", "ns/op", "median", "Mops/s");
+	printf("-----------------------------------------------------------------------------------------\n");
+}
+
+void QBENCH_PRINT(const QBenchResult& res)
+{
+	if(s_quiet)
+		return;
+	printf("%-10s %-28s %-8s %12.3f %12.3f %12.2f\n", res.group, res.name, res.variant, res.nsPerOp, res.nsPerOpMedian, res.opsPerSec * 0.000001);
+}
+
+
+static bool writeJSON(const char* path)
+{
+	FILE* f = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+	if(!f)
+		return false;
+
+	static const char* levelNames[] = { "scalar", "sse", "avx" };
+	fprintf(f, "{\n");
+	fprintf(f, "  \"cpu_features\": %u,\n", QCPU_GET_FEATURES());
+	fprintf(f, "  \"cores\": %u,\n", QCPU_GET_CORE_COUNT());
+	fprintf(f, "  \"simd_support\": \"%s\",\n", levelNames[QMATH_GET_SIMD_SUPPORT()]);
+	fprintf(f, "  \"repetitions\": %u,\n", s_nReps);
+	fprintf(f, "  \"results\": [\n");
+	for(unsigned int i = 0; i < s_nResults; ++i)
+	{
+		const QBenchResult& r = s_results[i];
+		fprintf(f, "    { \"group\": \"%s\", \"name\": \"%s\", \"variant\": \"%s\", \"ns_per_op\": %.4f, \"ns_per_op_median\": %.4f, "
+				   "\"ops_per_sec\": %.1f, \"iterations\": %u, \"ops_per_iteration\": %u }%s\n",
+				r.group, r.name, r.variant, r.nsPerOp, r.nsPerOpMedian, r.opsPerSec, r.iterations, r.opsPerIteration, (i + 1 < s_nResults) ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+
+	if(f != stdout)
+		fclose(f);
+	return true;
+}
+
+static bool runGroup(const char* group)
+{
+	return !s_groupFilter || strcmp(s_groupFilter, group) == 0;
+}
+
+static void printUsage()
+{
+	printf("usage: qbench [--json <file|->] [--reps <n>] [--group <math|cull|mesh|geom|image>]\n");
+}
+
+
+
+int main(int argc, char** argv)
+{
+	const char* jsonPath = NULL;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+		else if(strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+			s_nReps = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--group") == 0 && i + 1 < argc)
+			s_groupFilter = argv[++i];
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	s_nReps = (s_nReps < 1) ? 1 : ((s_nReps > QBENCH_MAX_REPS) ? QBENCH_MAX_REPS : s_nReps);
+
+	// With the report going to stdout the table is left out so the output stays valid JSON //
+	s_quiet = jsonPath && strcmp(jsonPath, "-") == 0;
+	if(!s_quiet)
+	{
+		printf("Quadrion kernel benchmarks\n");
+		printf("cpu features: 0x%08x  cores: %u\n\n", QCPU_GET_FEATURES(), QCPU_GET_CORE_COUNT());
+	}
+
+	QBENCH_PRINT_HEADER();
+	if(runGroup("math"))	QBENCH_MATH();
+	if(runGroup("cull"))	QBENCH_CULL();
+	if(runGroup("mesh"))	QBENCH_MESH();
+	if(runGroup("geom"))	QBENCH_GEOM();
+	if(runGroup("image"))	QBENCH_IMAGE();
+
+	if(jsonPath && !writeJSON(jsonPath))
+	{
+		fprintf(stderr, "qbench: could not write %s\n", jsonPath);
+		return 1;
+	}
+
+	return 0;
+}
@@ -16,6 +16,7 @@
 #include "qerrorlog.h"
 #include "qswf.h"
 #include "qfont.h"
+#include "qtextureatlas.h"
 #include <sstream>
 
 
@@ -53,6 +54,9 @@ struct skybox
 
 skybox* g_pSkybox;
 
+// The font and other UI images share a page //
+static CQuadrionTextureAtlas* g_pUIAtlas = NULL;
+
 /////////////////////////////
 
 //// completely temporary solution ///
@@ -348,10 +352,15 @@ static void PlayInit()
 	frameTimer = new CTimer();
 	frameTimer->Start();
 
+	g_pUIAtlas = new CQuadrionTextureAtlas(1024, 2);
+
 	font = new CFont();
-	if(!font->LoadFont("arial.tga", "Media/Textures/", false))
+	if(!font->LoadFont("arial.tga", "Media/Textures/", false, 16, g_pUIAtlas))
 		QUIT_ERROR("Could not load font!", "Font Loading Error!");
 
+	if(!g_pUIAtlas->Build(QTEXTURE_FILTER_NEAREST | QTEXTURE_CLAMP))
+		QUIT_ERROR("Could not build the UI atlas!", "Font Loading Error!");
+
 	g_pSkybox = new skybox;
 	GenerateSkybox(g_pSkybox);
 }
@@ -635,6 +644,7 @@ static void PlayDestroy()
 	QMem_SafeDelete( g_pCamera );
 	QMem_SafeDelete( g_pModelManager );
 	QMem_SafeDelete( g_pSWF );
+	QMem_SafeDelete( g_pUIAtlas );
 }
 
 #endif
@@ -149,6 +149,13 @@ void CApplicationWindow::LoadFromINI( cINI* ini, WNDPROC wndProc )
 	init.fsaa = ini->queryInt("fsaa");
 	init.csaa = ini->queryInt( "csaa" );
 	g_pRender->Initialize(handle, init);
+	
+	// Texture memory budgets in megabytes, a missing or 0 entry leaves the class unbounded //
+	CQuadrionTextureResidency* residency = g_pRender->GetTextureResidency();
+	residency->SetBudget(QTEXTURE_RESIDENCY_COLOR, (unsigned long long)ini->queryInt("texture_budget_color") << 20);
+	residency->SetBudget(QTEXTURE_RESIDENCY_NORMALMAP, (unsigned long long)ini->queryInt("texture_budget_normalmap") << 20);
+	residency->SetBudget(QTEXTURE_RESIDENCY_ENVIRONMENT, (unsigned long long)ini->queryInt("texture_budget_environment") << 20);
+	residency->SetBudget(QTEXTURE_RESIDENCY_UI, (unsigned long long)ini->queryInt("texture_budget_ui") << 20);
 
 	ShowWindow(handle, SW_SHOW);
 	SetForegroundWindow(handle);
@@ -302,10 +302,10 @@ VOID CHDRPipeline::MeasureLuminance()
 		curTexWidth = (float)lumCurP1->GetWidth();
 		curTexHeight = (float)lumCurP1->GetHeight();
 		
-		QMATH_GET_SAMPLE4X4_OFFSETS(curTexWidth, curTexHeight, sampleOffsets);
+		const cKernelTable* resample = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_SAMPLE4X4, curTexWidth, curTexHeight);
 		
 		hEffect->UploadParameters("g_useFloatLuminance", QEFFECT_VARIABLE_BOOL, 1, &useFloatLuminance);
-		hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, sampleOffsets);
+		hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, resample->offsets);
 
 		lumCur->BindRenderTarget(0);
 		lumCur->Clear();
@@ -321,10 +321,10 @@ VOID CHDRPipeline::MeasureLuminance()
 	// last pass to render final luminance to a 1 pixel I32F or I16F texture //
 	curTexWidth = (float)lum1->GetWidth();
 	curTexHeight = (float)lum1->GetHeight();
-	QMATH_GET_SAMPLE4X4_OFFSETS(curTexWidth, curTexHeight, sampleOffsets);
+	const cKernelTable* finalSample = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_SAMPLE4X4, curTexWidth, curTexHeight);
 
 	hEffect->BeginEffect("finalLuminanceTechnique");
-	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, sampleOffsets);
+	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, finalSample->offsets);
 	hEffect->UploadParameters("g_useFloatLuminance", QEFFECT_VARIABLE_BOOL, 1, &useFloatLuminance);
 
     lum0->BindRenderTarget(0);
@@ -415,9 +415,6 @@ VOID CHDRPipeline::ApplyBloom()
 	intermediateBloom = g_pRender->GetRenderTarget(m_intermediateBloom);
 	bright = g_pRender->GetRenderTarget(m_brightPass);
 
-	vec2f sampOffsets[16];
-	vec4f sampWeights[16];
-	
 	FLOAT intermediateBloomWidth = intermediateBloom->GetWidth();
 	FLOAT intermediateBloomHeight = intermediateBloom->GetHeight();
 
@@ -433,12 +430,12 @@ VOID CHDRPipeline::ApplyBloom()
 
 	FLOAT brightSurfWidth = bright->GetWidth();
 	FLOAT brightSurfHeight = bright->GetHeight();
-	QMATH_GET_GAUSSIAN5X5_OFFSETS(brightSurfWidth, brightSurfHeight, sampOffsets, sampWeights, 1.0F);
+	const cKernelTable* gauss = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_GAUSSIAN5X5, brightSurfWidth, brightSurfHeight);
 
 	CQuadrionEffect* hEffect = g_pRender->GetEffect(m_effect);
 	hEffect->BeginEffect("gaussBlurTechnique");
-	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, sampOffsets);
-	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, sampWeights);
+	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, gauss->offsets);
+	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, gauss->weights);
 	hEffect->UploadParameters("g_dispWidth", QEFFECT_VARIABLE_FLOAT, 1, &intermediateBloomWidth);
 	hEffect->UploadParameters("g_dispHeight", QEFFECT_VARIABLE_FLOAT, 1, &intermediateBloomHeight);
 	hEffect->UploadParameters( "g_bEncodeLogLuv", QEFFECT_VARIABLE_BOOL, 1, &m_bUsingLogLuv );
@@ -466,10 +463,10 @@ VOID CHDRPipeline::ApplyBloom()
 	InflateRect( &src, -1, -1 );
 	
 	QMATH_GET_TEXTURE_COORDINATES(srcDims, &src, destDims, &dest, &coords);
-	QMATH_GET_SAMPLE2X2_OFFSETS(brightSurfWidth, brightSurfHeight, sampOffsets);
+	const cKernelTable* downScale = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_SAMPLE2X2, brightSurfWidth, brightSurfHeight);
 
 	hEffect->BeginEffect("downScale2x2Technique");
-	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, sampOffsets);
+	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, downScale->offsets);
 	hEffect->UploadParameters( "g_bEncodeLogLuv", QEFFECT_VARIABLE_BOOL, 1, &m_bUsingLogLuv );
 
 	bloom->BindRenderTarget(0);
@@ -493,10 +490,6 @@ VOID CHDRPipeline::ApplyBloom()
 //the result into the last temporary bloom texture
 VOID CHDRPipeline::RenderBloom()
 {
-	vec2f sampleOffsets[16];
-	vec4f sampleWeights[16];
-	FLOAT fSampleOffsets[16];
-	
 	CQuadrionRenderTarget* tBloom1, *tBloom2, *bloom, *tBloom0;
 	tBloom1 = g_pRender->GetRenderTarget(m_tempBloom[1]);
 	tBloom2 = g_pRender->GetRenderTarget(m_tempBloom[2]);
@@ -531,12 +524,12 @@ VOID CHDRPipeline::RenderBloom()
 
 	cTextureRect coords;
 	QMATH_GET_TEXTURE_COORDINATES(srcDims, &src, destDims, &dest, &coords);
-	QMATH_GET_GAUSSIAN5X5_OFFSETS(bloomWidth, bloomHeight, sampleOffsets, sampleWeights, 1.0F);
+	const cKernelTable* gauss = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_GAUSSIAN5X5, bloomWidth, bloomHeight);
    
 	CQuadrionEffect* hEffect = g_pRender->GetEffect(m_effect);
 	hEffect->BeginEffect("gaussBlurTechnique");
-	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, sampleOffsets);
-	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, sampleWeights);
+	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, gauss->offsets);
+	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, gauss->weights);
 	hEffect->UploadParameters( "g_bEncodeLogLuv", QEFFECT_VARIABLE_BOOL, 1, &m_bUsingLogLuv );
 	
 	tBloom2->BindRenderTarget(0);
@@ -548,17 +541,11 @@ VOID CHDRPipeline::RenderBloom()
 	hEffect->EndEffect();
 //	g_pRender->DisableScissorTest();
 	
-	QMATH_GET_BLOOM_OFFSETS(tempBloomWidth2, fSampleOffsets, sampleWeights, 3.0F, 2.0F);
-	
-	for( INT i = 0; i < 16; ++i )
-	{
-		sampleOffsets[i].x = fSampleOffsets[i];
-		sampleOffsets[i].y = 0.0F;
-	}
+	const cKernelTable* bloomH = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_BLOOM_HORIZONTAL, tempBloomWidth2, tempBloomHeight2, 3.0F, 2.0F);
 	
 	hEffect->BeginEffect("bloomTechnique");
-	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, sampleOffsets);
-	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, sampleWeights);
+	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, bloomH->offsets);
+	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, bloomH->weights);
 	hEffect->UploadParameters( "g_bEncodeLogLuv", QEFFECT_VARIABLE_BOOL, 1, &m_bUsingLogLuv );
 
 	tBloom1->BindRenderTarget(0);
@@ -572,12 +559,7 @@ VOID CHDRPipeline::RenderBloom()
 	g_pRender->EvictRenderTarget(0);
 	g_pRender->EvictTextures();
 
-    QMATH_GET_BLOOM_OFFSETS(tempBloomHeight1, fSampleOffsets, sampleWeights, 3.0F, 2.0F);
-    for( INT i = 0; i < 16; ++i )
-    {
- 		sampleOffsets[i].x = 0.0F; 
-		sampleOffsets[i].y = fSampleOffsets[i];
-    }
+	const cKernelTable* bloomV = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_BLOOM_VERTICAL, tempBloomWidth1, tempBloomHeight1, 3.0F, 2.0F);
 	
 	srcDims.width = tempBloomWidth1;
 	srcDims.height = tempBloomHeight1;
@@ -588,8 +570,8 @@ VOID CHDRPipeline::RenderBloom()
 
 	QMATH_GET_TEXTURE_COORDINATES(srcDims, &src, destDims, NULL, &coords);
 
-	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, sampleOffsets);
-	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, sampleWeights);
+	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, bloomV->offsets);
+	hEffect->UploadParameters("g_staticSampleWeights", QEFFECT_VARIABLE_FLOAT_ARRAY, 4 * 16, bloomV->weights);
 
 	tBloom0->BindRenderTarget(0);
 	tBloom1->BindTexture(0);
@@ -688,15 +670,14 @@ VOID CHDRPipeline::Render( const CQuadrionRenderTarget* dest )
 	srcDims.height = scene->GetHeight();
 	QMATH_GET_TEXTURE_COORDINATES(srcDims, &src, destDims, NULL, &texRec);
 	
-	vec2f avSamples[16];
 	INT hdrWidth = scene->GetWidth();
 	INT hdrHeight = scene->GetHeight();
-	QMATH_GET_SAMPLE4X4_OFFSETS(hdrWidth, hdrHeight, avSamples);
+	const cKernelTable* downScale = QMATH_GET_KERNEL_TABLE(QMATH_KERNEL_SAMPLE4X4, hdrWidth, hdrHeight);
 
 	BOOL encodeLL = m_bUsingLogLuv;//( caps->maxFSAA == 0 );
 	CQuadrionEffect* hEffect = g_pRender->GetEffect(m_effect);
 	hEffect->BeginEffect("downScale4x4Technique");
-	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, avSamples);
+	hEffect->UploadParameters("g_staticSampleOffsets", QEFFECT_VARIABLE_FLOAT_ARRAY, 2 * 16, downScale->offsets);
 	hEffect->UploadParameters("g_dispWidth", QEFFECT_VARIABLE_FLOAT, 1, &dWidth);
 	hEffect->UploadParameters("g_dispHeight", QEFFECT_VARIABLE_FLOAT, 1, &dHeight);
 	hEffect->UploadParameters("g_bEncodeLogLuv", QEFFECT_VARIABLE_FLOAT, 1, &encodeLL);
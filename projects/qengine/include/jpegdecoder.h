@@ -25,10 +25,15 @@
 #include "jpegref.h"
 //------------------------------------------------------------------------------
 // Define SUPPORT_X86ASM to include the inline x86 assembler code.
+// Inline assembler is only available to 32-bit MSVC builds.
+#if defined(_MSC_VER) && defined(_M_IX86)
 #define SUPPORT_X86ASM
+#endif
 //------------------------------------------------------------------------------
 // Define SUPPORT_MMX to include MMX support.
+#ifdef SUPPORT_X86ASM
 #define SUPPORT_MMX
+#endif
 //------------------------------------------------------------------------------
 #define JPGD_INBUFSIZE       4096
 //------------------------------------------------------------------------------
@@ -150,13 +155,21 @@ typedef enum
 //------------------------------------------------------------------------------
 #define RST0 0xD0
 //------------------------------------------------------------------------------
+// Number of bits huff_decode() looks at in a single table lookup.
+#define JPGD_HUFF_LOOKAHEAD 10
+//------------------------------------------------------------------------------
+// look_up is indexed by the next JPGD_HUFF_LOOKAHEAD bits of the stream:
+//   bits 0-7   symbol
+//   bits 8-11  code length, 0 if the code is longer than the lookahead
+//   bits 12-15 code length plus the symbol's extra bits, 0 if they don't fit
+//   bits 16-31 the extra bits, sign extended (valid if bits 12-15 are set)
+// Longer codes are decoded canonically with maxcode/valoffset.
 typedef struct huff_tables_tag
 {
-  unsigned int  look_up[256];
-  unsigned char code_size[256];
-  // FIXME: Is 512 tree entries really enough to handle _all_ possible
-  // code sets? I think so but not 100% positive.
-  unsigned int  tree[512];
+  int           look_up[1 << JPGD_HUFF_LOOKAHEAD];
+  int           maxcode[18];
+  int           valoffset[18];
+  unsigned char val[256];
 } huff_tables_t, *Phuff_tables_t;
 //------------------------------------------------------------------------------
 typedef struct coeff_buf_tag
@@ -231,6 +244,15 @@ public:
   virtual void detach(void)
   {
   }
+
+  // Streams that hold the whole file in memory return it here, and its size
+  // in *Psize. The decoder then reads it in place instead of calling read(),
+  // and decode_image() looks for restart markers in it.
+  virtual const unsigned char *get_memory(unsigned int *Psize)
+  {
+    *Psize = 0;
+    return (NULL);
+  }
 };
 //------------------------------------------------------------------------------
 typedef jpeg_decoder_stream *Pjpeg_decoder_stream;
@@ -367,13 +389,74 @@ public:
 //------------------------------------------------------------------------------
 typedef jpeg_decoder_file_stream *Pjpeg_decoder_file_stream;
 //------------------------------------------------------------------------------
+// Stream over a file that's already in memory. The data isn't copied, it must
+// stay valid until the decoder is destroyed.
+class jpeg_decoder_mem_stream : public jpeg_decoder_stream
+{
+  const unsigned char *Pdata;
+  unsigned int size, ofs;
+
+public:
+
+  jpeg_decoder_mem_stream(const void *Pdata, unsigned int size)
+  {
+    open(Pdata, size);
+  }
+
+  void open(const void *Pdata, unsigned int size)
+  {
+    this->Pdata = (const unsigned char *)Pdata;
+    this->size = size;
+    ofs = 0;
+  }
+
+  virtual size_t read(unsigned char *Pbuf, unsigned int max_bytes_to_read, bool *Peof_flag)
+  {
+    unsigned int n = min(max_bytes_to_read, size - ofs);
+
+    memcpy(Pbuf, Pdata + ofs, n);
+    ofs += n;
+
+    if (ofs == size)
+      *Peof_flag = true;
+
+    return (n);
+  }
+
+  void reset(void)
+  {
+    ofs = 0;
+  }
+
+  int get_size(void)
+  {
+    return (size);
+  }
+
+  virtual const unsigned char *get_memory(unsigned int *Psize)
+  {
+    *Psize = size;
+    return (Pdata);
+  }
+};
+//------------------------------------------------------------------------------
+typedef jpeg_decoder_mem_stream *Pjpeg_decoder_mem_stream;
+//------------------------------------------------------------------------------
 #define QUANT_TYPE int16
 #define BLOCK_TYPE int16
 //------------------------------------------------------------------------------
-// Disable no return value warning, for rol() method
+// Dequantizes and transforms num_blocks consecutive blocks of quantized
+// coefficients in natural order, Pquant[i] is block i's quantization table
+// (natural order as well). Pdst receives 64 samples per block.
+typedef void (*Pidct_func)(const BLOCK_TYPE *Psrc, QUANT_TYPE * const *Pquant, int num_blocks, unsigned char *Pdst);
+//------------------------------------------------------------------------------
+// Disable no return value warning, for the inline asm huff_extend()
 #pragma warning(push)
 #pragma warning( disable : 4035 4799 )
 //------------------------------------------------------------------------------
+// A decoder object must only be used by one thread at a time, separate objects
+// may decode on separate threads. The decoder has no writable statics, the
+// tables it shares between objects are const.
 class jpeg_decoder
 {
   friend class progressive_block_decoder;
@@ -441,9 +524,6 @@ private:
   void load_next_row(void);
 
   void decode_next_row(void);
-#ifdef SUPPORT_MMX
-  void decode_next_row_mmx(void);
-#endif
 
   void make_huff_table(
     int index,
@@ -466,41 +546,44 @@ private:
 
   void init_progressive(void);
 
+  bool decode_progressive_scan(void);
+
+  void finish_progressive(void);
+
   void init_sequential(void);
 
   void decode_start(void);
 
   void decode_init(Pjpeg_decoder_stream Pstream, bool use_mmx);
 
-  void H2V2Convert(void);
-  void H2V1Convert(void);
-  void H1V2Convert(void);
-  void H1V1Convert(void);
-  void GrayConvert(void);
+  void convert_row(unsigned char *Pdst, int dst_bpp);
+  void convert_row_scaled(unsigned char *Pdst, int dst_bpp);
+  void convert_mcus(const unsigned char *Py, const unsigned char *Pc, int stride, bool h2,
+                    int num_mcus, unsigned char *Pdst, int dst_bpp);
 
   void find_eoi(void);
+
+  bool check_dst_bpp(int dst_bpp);
+
+  bool decode_restarts(unsigned char *Pdst, int dst_pitch, int dst_bpp, int *Pstatus);
+  static void decode_restart_units(void *Pjob, const unsigned int &begin, const unsigned int &end);
 //------------------
-  inline unsigned int jpeg_decoder::rol(unsigned int i, unsigned char j);
-  inline unsigned int jpeg_decoder::get_char(void);
-  inline unsigned int jpeg_decoder::get_char(bool *Ppadding_flag);
-  inline void jpeg_decoder::stuff_char(unsigned char q);
-  inline unsigned char jpeg_decoder::get_octet(void);
-  inline unsigned int jpeg_decoder::get_bits_1(int num_bits);
-  inline unsigned int jpeg_decoder::get_bits_2(int numbits);
-  inline int jpeg_decoder::huff_decode(Phuff_tables_t Ph);
+  void prime_bit_buf(bool entropy_coded);
+  int huff_decode_slow(Phuff_tables_t Ph);
+//------------------
+  inline unsigned int get_char(void);
+  inline unsigned int get_char(bool *Ppadding_flag);
+  inline void stuff_char(unsigned char q);
+  inline unsigned char get_octet(void);
+  inline void fill_bit_buf(void);
+  inline unsigned int get_bits_1(int num_bits);
+  inline unsigned int get_bits_2(int numbits);
+  inline int huff_decode(Phuff_tables_t Ph);
+  inline int huff_decode(Phuff_tables_t Ph, int *Pextra);
 #ifdef SUPPORT_X86ASM
-  inline unsigned int jpeg_decoder::huff_extend(unsigned int i, int c);
-#endif
-  inline unsigned char jpeg_decoder::clamp(int i);
-
-#ifdef SUPPORT_MMX
-  inline unsigned int jpeg_decoder::get_high_byte_mmx(void);
-  inline unsigned int jpeg_decoder::get_high_word_mmx(void);
-  inline void jpeg_decoder::get_bits_2_mmx_init(void);
-  inline void jpeg_decoder::get_bits_2_mmx_deinit(void);
-  inline unsigned int jpeg_decoder::get_bits_2_mmx(int numbits);
-  inline int jpeg_decoder::huff_decode_mmx(Phuff_tables_t Ph);
+  inline unsigned int huff_extend(unsigned int i, int c);
 #endif
+  inline unsigned char clamp(int i);
 //------------------
   int   image_x_size;
   int   image_y_size;
@@ -551,7 +634,7 @@ private:
 
   int   real_dest_bytes_per_scan_line;
   int   dest_bytes_per_scan_line;        /* rounded up */
-  int   dest_bytes_per_pixel;            /* currently, 4 (RGB) or 1 (Y) */
+  int   dest_bytes_per_pixel;            /* currently, 4 (RGBA) or 1 (Y) */
 
   void  *blocks[JPGD_MAXBLOCKS];         /* list of all dynamically allocated blocks */
 
@@ -564,25 +647,18 @@ private:
 
   int block_y_mcu[JPGD_MAXCOMPONENTS];
 
-  unsigned char *Pin_buf_ofs;
+  unsigned char *Pin_buf_ofs;            /* in in_buf, or the stream's memory if mem_flag */
   int in_buf_left;
   int tem_flag;
   bool eof_flag;
+  bool mem_flag;
 
   unsigned char padd_1[128];
   unsigned char in_buf[JPGD_INBUFSIZE + 128];
   unsigned char padd_2[128];
 
-  int   bits_left;
-  union
-  {
-    unsigned int bit_buf;
-    unsigned int bit_buf_64[2];
-  };
-  
-  unsigned int  saved_mm1[2];
-
-  bool  use_mmx_getbits;
+  int   bits_left;                       /* valid bits in bit_buf */
+  uint64 bit_buf;                        /* next bit in the MSB */
 
   int   restart_interval;
   int   restarts_left;
@@ -603,6 +679,8 @@ private:
   int   block_max_zag_set[JPGD_MAXBLOCKSPERROW];
 
   unsigned char *Psample_buf;
+
+  QUANT_TYPE * *Pblock_quant;                /* per block quant. table of a row, for Pidct */
   //int   block_num[JPGD_MAXBLOCKSPERROW];
 
   int   crr[256];
@@ -612,13 +690,21 @@ private:
   long  cbg[256];
 
   unsigned char *scan_line_0;
-  unsigned char *scan_line_1;
 
   BLOCK_TYPE temp_block[64];
 
   bool use_mmx;
   bool use_mmx_idct;
-  bool mmx_active;
+
+  Pidct_func Pidct;                          /* SSE2/AVX2 IDCT, NULL for the scalar one */
+  bool idct_dequant;                         /* coefficients are dequantized by the IDCT */
+
+  bool use_sse2_convert;                     /* ycc_convert_sse2() instead of convert_mcus() */
+
+  int scale_shift;                           /* output is 1/2^scale_shift the size, see set_scale() */
+
+  bool scans_pending;                        /* begin_scans(), decode_next_scan() has scans left */
+  int dc_comps;                              /* bit per component whose first DC scan was decoded */
 
   int error_code;
   bool ready_flag;
@@ -627,16 +713,59 @@ private:
 
   int total_bytes_read;
 
+  unsigned int scan_data_ofs;                /* stream offset of the scan's entropy coded data */
+
 public:
 
   // If SUPPORT_MMX is not defined, the use_mmx flag is ignored.
   jpeg_decoder(Pjpeg_decoder_stream Pstream,
                bool use_mmx);
 
+  // Decodes at 1/2^shift the size, shift 0 to 3, with reduced size IDCTs that
+  // only look at the low frequency coefficients. Call it before begin(), the
+  // decode then returns get_scaled_height() scan lines of get_scaled_width()
+  // pixels. Returns false if the decode has started already.
+  bool set_scale(int shift);
+
   int begin(void);
 
+  // Progressive images can be shown before all of their scans are decoded.
+  // Call begin_scans() instead of begin(), then decode_next_scan() decodes
+  // one scan per call and returns JPGD_OKAY, or JPGD_DONE once there are no
+  // more. In between, render_scans() makes an image out of the coefficients
+  // decoded so far, a usable one once is_dc_complete(). After JPGD_DONE the
+  // image is decoded as usual. Baseline images have nothing to wait for,
+  // decode_next_scan() returns JPGD_DONE at once.
+  int begin_scans(void);
+
+  int decode_next_scan(void);
+
+  // Writes the image the scans decoded so far give at 1/2^shift the size,
+  // shift 0 to 3, into Pdst. The rows are dst_pitch bytes apart, dst_bpp as
+  // for decode_scan_line(). The size is the image's rounded up, as for
+  // get_scaled_width(), whatever set_scale() said. At shift 3 only the DC
+  // coefficients are read. Progressive images only, and not between the
+  // scan lines of an MCU row of decode_scan_line().
+  int render_scans(void *Pdst, int dst_pitch, int dst_bpp, int shift);
+
+  // Returns the next scan line in the decoder's own buffer, get_bytes_per_pixel()
+  // bytes per pixel.
   int decode(void * *Pscan_line_ofs, unsigned int *Pscan_line_len);
 
+  // Decodes the next scan line straight into Pdst, image_x_size pixels of
+  // dst_bpp bytes. Colour images take 3 (RGB) or 4 (RGBA, alpha 255),
+  // greyscale ones 1, 3 or 4. Returns the same codes as decode(), JPGD_FAILED
+  // for an unsupported dst_bpp.
+  int decode_scan_line(void *Pdst, int dst_bpp);
+
+  // Decodes the remaining scan lines into Pdst, dst_pitch bytes apart, dst_bpp
+  // as for decode_scan_line(), get_scaled_height() rows of
+  // get_scaled_width() pixels. Row 0 is the image's first row even if some
+  // were already decoded. Baseline images with restart markers read from a
+  // memory stream are split at the markers and decoded on several threads,
+  // unless use_threads is false. Returns JPGD_OKAY or an error code.
+  int decode_image(void *Pdst, int dst_pitch, int dst_bpp, bool use_threads = true);
+
   ~jpeg_decoder();
 
   int get_error_code(void)
@@ -654,11 +783,32 @@ public:
     return (image_y_size);
   }
 
+  int get_scaled_width(void)
+  {
+    return ((image_x_size + (1 << scale_shift) - 1) >> scale_shift);
+  }
+
+  int get_scaled_height(void)
+  {
+    return ((image_y_size + (1 << scale_shift) - 1) >> scale_shift);
+  }
+
   int get_num_components(void)
   {
     return (comps_in_frame);
   }
 
+  bool is_progressive(void)
+  {
+    return (progressive_flag != 0);
+  }
+
+  // True once every component's first DC scan has been decoded.
+  bool is_dc_complete(void)
+  {
+    return (dc_comps == (1 << comps_in_frame) - 1);
+  }
+
   int get_bytes_per_pixel(void)
   {
     return (dest_bytes_per_pixel);
@@ -684,6 +834,55 @@ typedef jpeg_decoder *Pjpeg_decoder;
 // idct.cpp
 void idct(BLOCK_TYPE *data, unsigned char *Pdst_ptr);
 //------------------------------------------------------------------------------
+// idct_sse2.cpp, idct_avx2.cpp
+// Bit exact with idct(). idct_avx2() may only be called if the CPU reports AVX2.
+void idct_sse2(const BLOCK_TYPE *Psrc, QUANT_TYPE * const *Pquant, int num_blocks, unsigned char *Pdst);
+void idct_avx2(const BLOCK_TYPE *Psrc, QUANT_TYPE * const *Pquant, int num_blocks, unsigned char *Pdst);
+
+// Best kernel for the CPU and the engine's SIMD level, NULL if only idct() applies
+Pidct_func idct_select(void);
+//------------------------------------------------------------------------------
+// idct_reduced.cpp
+// Like a Pidct_func, but the blocks are transformed to 4x4, 2x2 or 1x1 samples
+// (shift 1, 2 or 3), at the top left of each block's 64 bytes in Pdst, 8 bytes
+// per row. A NULL Pquant means the coefficients are dequantized already.
+void idct_reduced(const BLOCK_TYPE *Psrc, QUANT_TYPE * const *Pquant, int num_blocks, unsigned char *Pdst, int shift);
+//------------------------------------------------------------------------------
+// ycc_sse2.cpp
+// Same arguments and results as jpeg_decoder::convert_mcus().
+void ycc_convert_sse2(const unsigned char *Py, const unsigned char *Pc, int stride, bool h2,
+                      int num_mcus, unsigned char *Pdst, int dst_bpp);
+
+// True if the CPU and the engine's SIMD level allow ycc_convert_sse2()
+bool ycc_sse2_avail(void);
+//------------------------------------------------------------------------------
+// jpegparallel.cpp
+// One image of a jpeg_decode_batch() call. Pdata is the whole file, Pdst gets
+// the image's rows as for decode_image(), at the set_scale() scale_shift.
+// status receives JPGD_OKAY or the error code.
+typedef struct jpeg_batch_job_tag
+{
+  const void    *Pdata;
+  unsigned int  data_size;
+
+  int           scale_shift;
+
+  void          *Pdst;
+  int           dst_pitch;
+  int           dst_bpp;
+
+  int           status;
+} jpeg_batch_job_t, *Pjpeg_batch_job_t;
+
+// Decodes all the jobs, on as many threads as QPARALLEL_FOR allows. Safe to
+// call from several threads at once. Returns the number of failed jobs.
+int jpeg_decode_batch(jpeg_batch_job_t *Pjobs, int num_jobs);
+
+// Reads the size of an in-memory JPEG file without decoding it, to size a
+// batch job's Pdst. Returns false if the header is bad.
+bool jpeg_get_info(const void *Pdata, unsigned int data_size,
+                   int *Pwidth, int *Pheight, int *Pnum_components);
+//------------------------------------------------------------------------------
 // fidctfst.cpp
 void jpeg_idct_ifast (
   BLOCK_TYPE* inptr,
@@ -1,22 +1,6 @@
 //------------------------------------------------------------------------------
 // inlines-- moved from .h file for clarity
 //------------------------------------------------------------------------------
-// Logical rotate left operation.
-inline unsigned int jpeg_decoder::rol(unsigned int i, unsigned char j)
-{
-#ifdef SUPPORT_X86ASM
-  // Breaks the rules a bit.. return value is in eax.
-  _asm
-  {
-    Mov eax, i
-    Mov cl, j
-    rol eax, cl
-  }
-#else
-  return ((i << j) | (i >> (32 - j)));
-#endif
-}
-//------------------------------------------------------------------------------
 // Retrieve one character from the input stream.
 inline unsigned int jpeg_decoder::get_char(void)
 {
@@ -73,10 +57,17 @@ inline unsigned int jpeg_decoder::get_char(bool *Ppadding_flag)
 }
 //------------------------------------------------------------------------------
 // Inserts a previously retrieved character back into the input buffer.
+// The stream's memory already holds it, the buffer is only switched away
+// from it at the end of the data.
 inline void jpeg_decoder::stuff_char(unsigned char q)
 {
-  *(--Pin_buf_ofs) = q;
+  --Pin_buf_ofs;
   in_buf_left++;
+
+  if (mem_flag)
+    assert(*Pin_buf_ofs == q);
+  else
+    *Pin_buf_ofs = q;
 }
 //------------------------------------------------------------------------------
 // Retrieves one character from the input stream, but does
@@ -113,29 +104,69 @@ inline unsigned char jpeg_decoder::get_octet(void)
   return (c);
 }
 //------------------------------------------------------------------------------
-// Retrieves a variable number of bits from the input stream.
-// Does not recognize markers.
-inline unsigned int jpeg_decoder::get_bits_1(int num_bits)
+// Big endian 64-bit load.
+static inline uint64 jpgd_load_be64(const unsigned char *p)
 {
-  unsigned int i;
+  uint64 c;
 
-  i = (bit_buf >> (16 - num_bits)) & ((1 << num_bits) - 1);
+  memcpy(&c, p, 8);
 
-  if ((bits_left -= num_bits) <= 0)
+#ifdef _MSC_VER
+  return (_byteswap_uint64(c));
+#else
+  return (__builtin_bswap64(c));
+#endif
+}
+//------------------------------------------------------------------------------
+// Tops up the bit buffer with entropy coded data, to at least 57 bits.
+// Plain bytes are taken 8 at a time straight from the input buffer. A 0xFF
+// (stuffed zero or marker) or the end of the buffer falls back to
+// get_octet(), which turns markers into an endless run of 1's.
+inline void jpeg_decoder::fill_bit_buf(void)
+{
+  if (in_buf_left >= 8)
   {
-    bit_buf = rol(bit_buf, num_bits += bits_left);
+    uint64 c = jpgd_load_be64(Pin_buf_ofs);
+    int n = (63 - bits_left) >> 3;
 
-    unsigned int c1 = get_char();
-    unsigned int c2 = get_char();
+    // Flags the 0xFF bytes (zero bytes of ~c). Bytes above a real one may be
+    // flagged too, which only costs a trip through the slow path.
+    uint64 t = ~c;
+    uint64 ff = (t - 0x0101010101010101ULL) & ~t & 0x8080808080808080ULL;
 
-    bit_buf = (bit_buf & 0xFFFF) | (((unsigned long)c1) << 24) | (((unsigned long)c2) << 16);
+    if ((ff >> (64 - n * 8)) == 0)
+    {
+      bit_buf |= (c >> (64 - n * 8)) << (64 - n * 8 - bits_left);
+      bits_left += n * 8;
 
-    bit_buf = rol(bit_buf, -bits_left);
+      Pin_buf_ofs += n;
+      in_buf_left -= n;
+      return;
+    }
+  }
 
-    bits_left += 16;
+  while (bits_left <= 56)
+  {
+    bit_buf |= ((uint64)get_octet()) << (56 - bits_left);
+    bits_left += 8;
+  }
+}
+//------------------------------------------------------------------------------
+// Retrieves a variable number of bits from the input stream.
+// Does not recognize markers. At least 16 bits are kept buffered, so the
+// next byte is always in the top of bit_buf.
+inline unsigned int jpeg_decoder::get_bits_1(int num_bits)
+{
+  unsigned int i = (uint)((bit_buf >> 1) >> (63 - num_bits));
+
+  bit_buf <<= num_bits;
+  bits_left -= num_bits;
+
+  while (bits_left < 16)
+  {
+    bit_buf |= ((uint64)get_char()) << (56 - bits_left);
+    bits_left += 8;
   }
-  else
-    bit_buf = rol(bit_buf, num_bits);
 
   return i;
 }
@@ -144,28 +175,15 @@ inline unsigned int jpeg_decoder::get_bits_1(int num_bits)
 // Markers will not be read into the input bit buffer. Instead,
 // an infinite number of all 1's will be returned when a marker
 // is encountered.
-// FIXME: Is it better to return all 0's instead, like the older implementation?
 inline unsigned int jpeg_decoder::get_bits_2(int numbits)
 {
-  unsigned int i;
-
-  i = (bit_buf >> (16 - numbits)) & ((1 << numbits) - 1);
-
-  if ((bits_left -= numbits) <= 0)
-  {
-    bit_buf = rol(bit_buf, numbits += bits_left);
+  if (bits_left < numbits)
+    fill_bit_buf();
 
-    unsigned int c1 = get_octet();
-    unsigned int c2 = get_octet();
+  unsigned int i = (uint)((bit_buf >> 1) >> (63 - numbits));
 
-    bit_buf = (bit_buf & 0xFFFF) | (((unsigned long)c1) << 24) | (((unsigned long)c2) << 16);
-
-    bit_buf = rol(bit_buf, -bits_left);
-
-    bits_left += 16;
-  }
-  else
-    bit_buf = rol(bit_buf, numbits);
+  bit_buf <<= numbits;
+  bits_left -= numbits;
 
   return i;
 }
@@ -173,23 +191,20 @@ inline unsigned int jpeg_decoder::get_bits_2(int numbits)
 // Decodes a Huffman encoded symbol.
 inline int jpeg_decoder::huff_decode(Phuff_tables_t Ph)
 {
-  int symbol;
+  if (bits_left < 16)
+    fill_bit_buf();
 
-  // Check first 8-bits: do we have a complete symbol?
-  if ((symbol = Ph->look_up[(bit_buf >> 8) & 0xFF]) < 0)
-  {
-    // Decode more bits, use a tree traversal to find symbol.
-    get_bits_2(8);
+  int e = Ph->look_up[bit_buf >> (64 - JPGD_HUFF_LOOKAHEAD)];
+  int len = (e >> 8) & 15;
 
-    do
-    {
-      symbol = Ph->tree[~symbol + (1 - get_bits_2(1))];
-    } while (symbol < 0);
-  }
-  else
-    get_bits_2(Ph->code_size[symbol]);
+  // Longer than the lookahead?
+  if (!len)
+    return (huff_decode_slow(Ph));
+
+  bit_buf <<= len;
+  bits_left -= len;
 
-  return symbol;
+  return (e & 0xFF);
 }
 //------------------------------------------------------------------------------
 // Tables and macro used to fully decode the DPCM differences.
@@ -255,202 +270,39 @@ inline unsigned char jpeg_decoder::clamp(int i)
   return (i);
 }
 //------------------------------------------------------------------------------
-#ifdef SUPPORT_MMX
-//------------------------------------------------------------------------------
-inline unsigned int jpeg_decoder::get_high_byte_mmx(void)
-{
-  _asm
-  {
-    movq mm1, mm0
-    psrlq mm1, 56
-    movd eax, mm1
-  }
-}
-//------------------------------------------------------------------------------
-inline unsigned int jpeg_decoder::get_high_word_mmx(void)
-{
-  _asm
-  {
-    movq mm1, mm0
-    psrlq mm1, 48
-    movd eax, mm1
-  }
-}
-//------------------------------------------------------------------------------
-inline void jpeg_decoder::get_bits_2_mmx_init(void)
+// Decodes a Huffman encoded symbol together with the extra bits that
+// follow it, as many as the symbol's low 4 bits say. *Pextra receives them
+// sign extended, 0 if there are none. The lookahead table covers both in
+// one lookup unless the code and its extra bits are longer than it.
+inline int jpeg_decoder::huff_decode(Phuff_tables_t Ph, int *Pextra)
 {
-  assert(!mmx_active);
-  mmx_active = true;
+  if (bits_left < 32)
+    fill_bit_buf();
 
-  _asm
-  {
-    mov esi, this
-    movq mm0, [esi].bit_buf
-    movq mm1, [esi].saved_mm1
-  }
-}
-//------------------------------------------------------------------------------
-inline void jpeg_decoder::get_bits_2_mmx_deinit(void)
-{
-  assert(mmx_active);
-  mmx_active = false;
+  int e = Ph->look_up[bit_buf >> (64 - JPGD_HUFF_LOOKAHEAD)];
+  int len = (e >> 12) & 15;
 
-  _asm
-  {
-    mov esi, this
-    movq [esi].bit_buf, mm0
-    movq [esi].saved_mm1, mm1
-    emms
-  }
-}
-//------------------------------------------------------------------------------
-static __int64 cmp_mask = 0xFFFFFFFFFFFFFFFF;
-static __int64 zero = 0;
-//------------------------------------------------------------------------------
-//FIXME: This function doesn't compile right with the Intel Compiler in Release builds.
-//Something to do with funciton inlining.
-inline unsigned int jpeg_decoder::get_bits_2_mmx(int numbits)
-{
-  _asm
+  if (len)
   {
-    // is the "mov esi, this" really necessary?
-    // this is safe but it's probably already "this" anyway
-    mov esi, this
-    mov ecx, numbits
-
-    mov edx, 64
-    movd mm3, ecx
-
-    sub edx, ecx
-    movq mm1, mm0
-
-    movd mm2, edx
-    sub [esi].bits_left, ecx
-
-    psrlq mm1, mm2
-    Jg gb2_done
-//-----------------------------
-    add ecx, [esi].bits_left
-    cmp [esi].in_buf_left, 12
-
-    movd mm4, ecx
-    mov edi, [esi].Pin_buf_ofs
-
-    psllq mm0, mm4
-    jb gb2_slowload
-//-----------------------------
-// FIXME: Pair better!
-
-    mov eax, [edi]
-    mov ebx, [edi+4]
-
-// FIXME: Is there a better way to do this other than using bswap?
-    bswap eax
-    bswap ebx
-
-    movd mm4, eax
-    movd mm3, ebx
-
-    psllq mm4, 32
-    add [esi].Pin_buf_ofs, 6
-
-    por mm3, mm4
-    mov ecx, [esi].bits_left
-
-    psrlq mm3, 16
-    neg ecx
+    bit_buf <<= len;
+    bits_left -= len;
 
-    movq mm4, mm3
-    sub [esi].in_buf_left, 6
+    *Pextra = e >> 16;
 
-    pcmpeqb mm4, cmp_mask
-    por mm0, mm3
-
-    pcmpeqd mm4, zero
-    movd mm3, ecx
-
-    pxor mm4, cmp_mask
-    movd eax, mm1
-
-    psrlq mm4, 1
-    add [esi].bits_left, 48
-
-    movd ebx, mm4
-    psllq mm0, mm3
-
-    test ebx, ebx
-    jz gb2_return
-//-----------------------------
-    psrlq mm0, mm3
-    sub [esi].bits_left, 48
-    sub [esi].Pin_buf_ofs, 6
-    add [esi].in_buf_left, 6
-
-gb2_slowload:
-    psrlq mm0, 48
+    return (e & 0xFF);
   }
 
-  for (int i = 0; i < 6; i++)
-  {
-    unsigned int c = get_octet();
-
-    _asm
-    {
-      movd mm3, c
-      psllq mm0, 8
-      por mm0, mm3
-    }
-  }
+  int symbol = huff_decode(Ph);
+  int s = symbol & 15;
 
-  _asm
+  if (s)
   {
-    mov esi, this
-    mov ecx, [esi].bits_left
-    neg ecx
-    movd mm3, ecx
-    add [esi].bits_left, 48
-
-gb2_done:
-    movd eax, mm1
-    psllq mm0, mm3
-  }
-gb2_return:;
-}
-//------------------------------------------------------------------------------
-inline int jpeg_decoder::huff_decode_mmx(Phuff_tables_t Ph)
-{
-  int symbol;
-  //unsigned int d = get_high_word_mmx();
-  unsigned int d;
-  _asm
-  {
-    movq mm1, mm0
-    psrlq mm1, 48
-    movd eax, mm1
-    mov d, eax
-  }
-
-  // Check first 8-bits: do we have a complete symbol?
-  if ((symbol = Ph->look_up[(d >> 8) & 0xFF]) < 0)
-  {
-    unsigned int ofs = 7;
-    d = ~d; // invert d here so we don't have to do it inside the loop
-
-    do
-    {
-      symbol = Ph->tree[~symbol + ((d >> ofs) & 1)];
-      ofs--;
-    } while (symbol < 0);
-
-    // Decode more bits, use a tree traversal to find symbol.
-    get_bits_2_mmx(8 + (7 - ofs));
+    int r = get_bits_2(s);
+    *Pextra = HUFF_EXTEND(r, s);
   }
   else
-    get_bits_2_mmx(Ph->code_size[symbol]);
+    *Pextra = 0;
 
-  return symbol;
+  return (symbol);
 }
 //------------------------------------------------------------------------------
-#endif
-//------------------------------------------------------------------------------
-
@@ -37,8 +37,7 @@ const int TMS_MAX_THREAD_LOAD = 255;
 enum TaskTypes
 {
 	TMS_TYPE_CALLBACK,
-	TMS_TYPE_TEXTURELOAD,
-	TMS_TYPE_NORMALMAPLOAD
+	TMS_TYPE_TEXTURELOAD			// userData is the texture object, sParam an optional source file
 };
 
 struct TaskStruct
@@ -13,11 +13,17 @@
 class CCamera;
 
 #include "qmath.h"
+#ifndef QENGINE_HEADLESS
 #include "qrender.h"
+#else
+class CQuadrionRender;
+#endif
 #include "qgeom.h"
 
 
-#ifdef QRENDER_EXPORTS
+#ifndef WIN32
+	#define QCAMERAEXPORT_API
+#elif defined(QRENDER_EXPORTS)
 	#define QCAMERAEXPORT_API		__declspec(dllexport)
 #else
 	#define QCAMERAEXPORT_API		__declspec(dllimport)
@@ -59,7 +65,7 @@ class QCAMERAEXPORT_API CCamera
 		
 		CCamera();
 		CCamera(CQuadrionRender* ptr);
-		~CCamera() {}	
+		~CCamera();
 
 		CCamera & operator=(const CCamera &rhs)
 		{
@@ -127,13 +133,25 @@ class QCAMERAEXPORT_API CCamera
 		const inline float			GetFOV() { return m_fov; }
 		
 		// obtain clip planes //
-		const inline void			GetPerspectiveClipPlanes( vec4f* outPlanes )	{ memcpy( outPlanes, frustumPlanes, sizeof( float ) * 24 ); }	
-		const inline void			GetWorldClipPlanes( vec4f* outPlanes ) { memcpy( outPlanes, m_frustumPlanesWS, sizeof( float ) * 24 ); }
+		inline void					GetPerspectiveClipPlanes( vec4f* outPlanes )	{ for( int i = 0; i < 6; ++i ) outPlanes[i] = frustumPlanes[i]; }	
+		inline void					GetWorldClipPlanes( vec4f* outPlanes ) { for( int i = 0; i < 6; ++i ) outPlanes[i] = m_frustumPlanesWS[i]; }
 		
 		// Frustum cull //
 		QMATH_INTERSECT_RESULT IsSphereInFrustum(vec3f v, const float& radius, const float& bias = 0.0F);
 		QMATH_INTERSECT_RESULT IsAABBInFrustum(vec3f mins, vec3f maxs, bool trivial = false);
 		QMATH_INTERSECT_RESULT IsLineInFrustum( vec3f a, vec3f b );
+		
+		// Batched frustum cull //
+		// Tests every volume of the list against the world space frustum in one pass. visibleMask
+		// receives one bit per volume ((count + 31) / 32 words) and visibleIndices the compacted
+		// indices of the visible volumes (count entries), either may be NULL.
+		// return value
+		//		unsigned int: number of visible volumes
+		unsigned int	CullAABBs(const CAABBList& boxes, unsigned int* visibleMask, unsigned int* visibleIndices = NULL);
+		unsigned int	CullSpheres(const CSphereList& spheres, unsigned int* visibleMask, unsigned int* visibleIndices = NULL);
+		
+		// Overrides the current clip planes (both clip and world space) with 6 normalized planes //
+		void			SetClipPlanes(const vec4f* planes);
 	
 		// SphereInCameraCone
 		// Checks that a bounding sphere is within the camera's worldspace cone shape
@@ -146,12 +164,15 @@ class QCAMERAEXPORT_API CCamera
 	
 		const inline float	GetRotationAngle() { return curRotAngle; }
 
-		void CCamera::SetRenderDevice(CQuadrionRender* ptr);
+		void SetRenderDevice(CQuadrionRender* ptr);
 
 	
 	private:
+		CCamera(const CCamera&);
+		
 		void Rotate(float ang, vec3f axis);
 		void GetFrustumPlanes();
+		unsigned int* GetCullMask(const unsigned int& count);
 		
 		friend class			CQuadrionRender;
 		CQuadrionRender*		m_pQuadrionRender;
@@ -184,6 +205,9 @@ class QCAMERAEXPORT_API CCamera
 		
 		vec4f			frustumPlanes[6];			// Current camera frustum planes in clip space
 		vec4f			m_frustumPlanesWS[6];		// Current camera frustum planes in world space
+		
+		unsigned int*	m_cullMask;					// Visibility bits of batched culls made without a caller mask
+		unsigned int	m_cullMaskCapacity;			// Words allocated in m_cullMask
 };
 
 #endif
\ No newline at end of file
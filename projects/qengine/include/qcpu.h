@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// QCPU.H
+//
+// Host processor queries for Quadrion Engine
+//
+// Reports which SIMD instruction sets the processor and operating system support so that
+// math, texture and decoder kernels can pick an implementation at runtime instead of at
+// compile time. Results are queried once and cached.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __QCPU_H_
+#define __QCPU_H_
+
+
+#ifndef WIN32
+#define QCPUEXPORT_API
+#elif defined(QRENDER_EXPORTS)
+#define QCPUEXPORT_API __declspec(dllexport)
+#else
+#define QCPUEXPORT_API __declspec(dllimport)
+#endif
+
+
+
+// Feature bits returned by QCPU_GET_FEATURES //
+#define QCPU_FEATURE_SSE		0x00000001
+#define QCPU_FEATURE_SSE2		0x00000002
+#define QCPU_FEATURE_SSE3		0x00000004
+#define QCPU_FEATURE_SSSE3		0x00000008
+#define QCPU_FEATURE_SSE41		0x00000010
+#define QCPU_FEATURE_SSE42		0x00000020
+#define QCPU_FEATURE_AVX		0x00000040
+#define QCPU_FEATURE_AVX2		0x00000080
+#define QCPU_FEATURE_FMA		0x00000100
+
+
+// Returns a mask of QCPU_FEATURE_* bits. AVX/AVX2/FMA are only reported when the OS saves YMM state //
+QCPUEXPORT_API unsigned int QCPU_GET_FEATURES();
+
+// Convenience test for a single (or several) feature bit(s) //
+QCPUEXPORT_API bool QCPU_HAS_FEATURE(const unsigned int& feature);
+
+// Number of logical processors available to this process //
+QCPUEXPORT_API unsigned int QCPU_GET_CORE_COUNT();
+
+
+#endif
@@ -68,6 +68,38 @@ class QFILEEXPORT_API CFile
 
 
 
+// Maps a whole file into memory. Pages are read from disk on first access and are copy on write, //
+// so the view may be modified in place without touching the file.                               //
+class QFILEEXPORT_API CMappedFile
+{
+	public:
+
+		CMappedFile();
+		~CMappedFile();
+
+		bool Open(const std::string& fName);
+		void Close();
+
+		const inline bool		IsOpen() { return view != NULL; }
+		inline unsigned char*	GetData() { return view; }
+		const inline size_t		GetSize() { return viewSize; }
+
+		// Whether p points into the view //
+		const inline bool		Contains(const void* p) { return view && (unsigned char*)p >= view && (unsigned char*)p < view + viewSize; }
+
+	private:
+
+		CMappedFile(const CMappedFile&);
+		CMappedFile& operator= (const CMappedFile&);
+
+		unsigned char*	view;
+		size_t			viewSize;
+		HANDLE			fileHandle;
+		HANDLE			mappingHandle;
+};
+
+
+
 class QFILEEXPORT_API CConfigFile : public CFile
 {
 	public:
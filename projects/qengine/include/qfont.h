@@ -11,6 +11,7 @@
 
 #include "qrender.h"
 #include "qtexture.h"
+#include "qtextureatlas.h"
 
 struct QFONTEXPORT_API texture_vertex_format
 {
@@ -41,6 +42,8 @@ private:
 	std::vector<SCharacterOffset*> m_vCharTexOffsets;
 	std::string m_sName;
 	std::string m_sPath;
+	CQuadrionTextureAtlas* m_pAtlas;	// set when the sheet lives in an atlas, offsets are then remapped through it
+	int m_iAtlasImage;
 	
 	SCharacterOffset* GenerateCharOffset(unsigned int charSize, unsigned char chr, unsigned int texWidth, unsigned int texHeight);
 
@@ -48,7 +51,9 @@ public:
 	CFont();
 	~CFont();
 
-	bool LoadFont(const std::string& name, const std::string& path, bool monospaced, unsigned int charSize = 16);
+	// atlas- add the font sheet to this atlas instead of making a texture of its own, the font can
+	//		  be drawn once the atlas has been built
+	bool LoadFont(const std::string& name, const std::string& path, bool monospaced, unsigned int charSize = 16, CQuadrionTextureAtlas* atlas = NULL);
 
 	void GenerateCharacterOffsets(CQuadrionTextureFile &fontFile, bool monospaced, unsigned int charSize, unsigned char* data = NULL);
 
@@ -2,10 +2,21 @@
 #define __QGEOM_H_
 
 
-#include "qrender.h"
+#ifndef QENGINE_HEADLESS
+	#include "qrender.h"
+#else
+	// Headless builds (no D3D, eg. qbench on Linux) only get the math types and handle convention //
+	#include "qmath.h"
+	#include <string>
+	
+	#define QRENDER_IS_VALID(x)		((x) >= 0)
+	const int QRENDER_INVALID_HANDLE = -1;
+#endif
 
 
-#ifdef QRENDER_EXPORTS
+#ifndef WIN32
+	#define QGEOMEXPORT_API
+#elif defined(QRENDER_EXPORTS)
 	#define QGEOMEXPORT_API __declspec(dllexport)
 #else
 	#define QGEOMEXPORT_API __declspec(dllimport)
@@ -177,6 +188,86 @@ class QMATHEXPORT_API CCone
 
 
 
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// CAABBList / CSphereList
+//
+// Structure of arrays bounding volume lists for batched frustum culling
+// (see CCamera::CullAABBs). Each component is kept in its own aligned array
+// padded to QMATH_CULL_PADDING entries so the SIMD kernels can load full
+// registers without a scalar tail.
+//
+/////////////////////////////////////////////////////////////////////////////////////
+class QGEOMEXPORT_API CAABBList
+{
+	public:
+	
+		CAABBList();
+		~CAABBList();
+		
+		// Reserve
+		// Grows storage to hold at least n volumes without reallocating
+		void			Reserve(const unsigned int& n);
+		
+		// Clear
+		// Empties the list, storage is kept
+		inline void		Clear() { m_count = 0; }
+		
+		// Add / Set
+		// Appends (or overwrites) a box given by its world space extremes. Add returns the index
+		unsigned int	Add(const vec3f& mins, const vec3f& maxs);
+		void			Set(const unsigned int& i, const vec3f& mins, const vec3f& maxs);
+		
+		inline unsigned int		GetCount() const { return m_count; }
+		
+		float*			m_centerX;
+		float*			m_centerY;
+		float*			m_centerZ;
+		float*			m_extentX;
+		float*			m_extentY;
+		float*			m_extentZ;
+	
+	private:
+	
+		CAABBList(const CAABBList&);
+		CAABBList& operator=(const CAABBList&);
+	
+		unsigned int	m_count;
+		unsigned int	m_capacity;
+};
+
+
+class QGEOMEXPORT_API CSphereList
+{
+	public:
+	
+		CSphereList();
+		~CSphereList();
+		
+		void			Reserve(const unsigned int& n);
+		inline void		Clear() { m_count = 0; }
+		
+		unsigned int	Add(const vec3f& center, const float& radius);
+		void			Set(const unsigned int& i, const vec3f& center, const float& radius);
+		
+		inline unsigned int		GetCount() const { return m_count; }
+		
+		float*			m_centerX;
+		float*			m_centerY;
+		float*			m_centerZ;
+		float*			m_radius;
+	
+	private:
+	
+		CSphereList(const CSphereList&);
+		CSphereList& operator=(const CSphereList&);
+	
+		unsigned int	m_count;
+		unsigned int	m_capacity;
+};
+
+
+
 struct CPolyTexture
 {
 	int				texHandle;      // Texture handle
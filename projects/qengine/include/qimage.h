@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// QIMAGE.H
+//
+// Device independent pixel processing for Quadrion Engine
+//
+// These routines work on raw, tightly packed pixel arrays and know nothing about the renderer,
+// CQuadrionTextureFile uses them for pixel format conversion, mipmap generation, normal map
+// generation and block (de)compression at load time.
+// Every kernel has a scalar, SSE2 and AVX version, the one matching QMATH_GET_SIMD_LEVEL is
+// used so QMATH_SET_SIMD_LEVEL also controls these. Large images are split across cores
+// through QPARALLEL_FOR.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __QIMAGE_H_
+#define __QIMAGE_H_
+
+
+#ifndef WIN32
+#define QIMAGEEXPORT_API
+#elif defined(QRENDER_EXPORTS)
+#define QIMAGEEXPORT_API __declspec(dllexport)
+#else
+#define QIMAGEEXPORT_API __declspec(dllimport)
+#endif
+
+
+
+// Storage type of a single channel //
+enum QIMAGE_CHANNEL_TYPE
+{
+	QIMAGE_CHANNEL_UNORM8 = 0,
+	QIMAGE_CHANNEL_UNORM16 = 1,
+	QIMAGE_CHANNEL_HALF = 2,
+	QIMAGE_CHANNEL_FLOAT = 3,
+};
+
+// Block compressed formats, 4x4 texel blocks of 8 (BC1, BC4) or 16 bytes //
+enum QIMAGE_BLOCK_FORMAT
+{
+	QIMAGE_BLOCK_BC1 = 0,		// DXT1, 5:6:5 colour endpoints and 2 bit indices, opaque
+	QIMAGE_BLOCK_BC2 = 1,		// DXT3, explicit 4 bit alpha followed by a BC1 colour block
+	QIMAGE_BLOCK_BC3 = 2,		// DXT5, interpolated alpha followed by a BC1 colour block
+	QIMAGE_BLOCK_BC4 = 3,		// ATI1N, one interpolated channel
+	QIMAGE_BLOCK_BC5 = 4,		// ATI2N, two interpolated channels one after the other
+};
+
+// 8 bit per channel and packed 16 bit texel layouts, as found in image files. Bytes are listed in //
+// memory order, packed layouts are little endian words with the first channel in the top bits.   //
+enum QIMAGE_PIXEL_LAYOUT
+{
+	QIMAGE_LAYOUT_I8 = 0,
+	QIMAGE_LAYOUT_IA8 = 1,
+	QIMAGE_LAYOUT_RGB8 = 2,
+	QIMAGE_LAYOUT_RGBA8 = 3,
+	QIMAGE_LAYOUT_BGR8 = 4,
+	QIMAGE_LAYOUT_BGRA8 = 5,
+	QIMAGE_LAYOUT_RGBX8 = 6,			// 4th byte undefined, read as opaque
+	QIMAGE_LAYOUT_BGRX8 = 7,
+	QIMAGE_LAYOUT_R5G6B5 = 8,
+	QIMAGE_LAYOUT_X1R5G5B5 = 9,
+	QIMAGE_LAYOUT_A1R5G5B5 = 10,
+};
+
+
+// sRGB transfer functions on [0, 1] values //
+QIMAGEEXPORT_API float QIMAGE_SRGB_TO_LINEAR(const float& c);
+QIMAGEEXPORT_API float QIMAGE_LINEAR_TO_SRGB(const float& c);
+
+// Exact 8 bit conversions through lookup tables, LINEAR_TO_SRGB8 rounds to the nearest code //
+QIMAGEEXPORT_API float QIMAGE_SRGB8_TO_LINEAR(const unsigned char& c);
+QIMAGEEXPORT_API unsigned char QIMAGE_LINEAR_TO_SRGB8(const float& c);
+
+// IEEE half precision conversions (round to nearest even) //
+QIMAGEEXPORT_API float QIMAGE_HALF_TO_FLOAT(const unsigned short& h);
+QIMAGEEXPORT_API unsigned short QIMAGE_FLOAT_TO_HALF(const float& f);
+
+
+// Mip dimension of a level 0 extent, halved and rounded down per level but never below 1 //
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_MIP_DIMENSION(const unsigned int& dim, const unsigned int& level);
+
+// Number of levels in a full chain down to 1x1x1 //
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_MIP_COUNT(const unsigned int& w, const unsigned int& h, const unsigned int& d);
+
+
+// Downsamples nImages consecutive w * h * d images (eg. the 6 faces of a cubemap) into dst, which //
+// receives the next level (every dimension halved, rounded down, never below 1). Any size works: //
+// even extents use a 2 tap box, odd extents a 3 tap box weighted by each texel's footprint so    //
+// no texel is dropped. Channels whose bit is set in srgbMask (8 bit types only) are decoded to   //
+// linear before filtering and encoded back afterwards, alpha should normally be left linear.     //
+QIMAGEEXPORT_API void QIMAGE_GENERATE_MIP(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& d, const unsigned int& nImages,
+										  const unsigned int& nChannels, const QIMAGE_CHANNEL_TYPE& type, const unsigned int& srgbMask = 0);
+
+// Fills in levels 1 to nLevels - 1 of a chain whose level 0 is at the start of pixels. The buffer //
+// must be large enough for the whole chain, laid out level after level with the nImages images   //
+// of a level stored consecutively. Returns the number of levels present afterwards.              //
+QIMAGEEXPORT_API unsigned int QIMAGE_GENERATE_MIP_CHAIN(void* pixels, const unsigned int& w, const unsigned int& h, const unsigned int& d, const unsigned int& nImages,
+														const unsigned int& nLevels, const unsigned int& nChannels, const QIMAGE_CHANNEL_TYPE& type, const unsigned int& srgbMask = 0);
+
+
+// Size in bytes of one 4x4 block //
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_BLOCK_BYTES(const QIMAGE_BLOCK_FORMAT& fmt);
+
+// Compresses nSlices consecutive w * h 8 bit images of nChannels channels (1 to 4) into dst, one //
+// slice after the other with blocks stored row by row. Any size works, edge blocks repeat the    //
+// last texels. BC1 to BC3 read 1 and 2 channel images as grey (+ alpha) and 3 channel images as  //
+// opaque, BC4 takes the first channel and BC5 the first two as stored.                          //
+QIMAGEEXPORT_API void QIMAGE_COMPRESS(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& nSlices,
+									  const unsigned int& nChannels, const QIMAGE_BLOCK_FORMAT& fmt);
+
+// Channels per texel of decoded data, 4 (RGBA) for BC1 to BC3, 1 for BC4 and 2 for BC5 //
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_BLOCK_CHANNELS(const QIMAGE_BLOCK_FORMAT& fmt);
+
+// Decodes nSlices consecutive w * h images in the QIMAGE_COMPRESS layout into tightly packed 8 bit //
+// texels of QIMAGE_GET_BLOCK_CHANNELS channels. BC1 blocks in 3 colour mode decode index 3 as     //
+// transparent black.                                                                              //
+QIMAGEEXPORT_API void QIMAGE_DECOMPRESS(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& nSlices,
+										const QIMAGE_BLOCK_FORMAT& fmt);
+
+// Decodes the rw * rh texels at (x, y) of one w * h compressed image into dst (rw texels per row). //
+// Only the blocks under the region are read. Returns false if the region is empty or outside.     //
+QIMAGEEXPORT_API bool QIMAGE_DECOMPRESS_REGION(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& x, const unsigned int& y,
+											   const unsigned int& rw, const unsigned int& rh, const QIMAGE_BLOCK_FORMAT& fmt);
+
+
+// Builds RGBA8 normal maps from nSlices consecutive w * h 8 bit height fields with a 5x5 Sobel //
+// filter that wraps around the edges. Heights are the first channel of 1 and 2 channel images  //
+// and rf * r + gf * g + bf * b otherwise. sz scales the z component against the gradients, the //
+// height ends up in alpha.                                                                     //
+QIMAGEEXPORT_API void QIMAGE_HEIGHT_TO_NORMAL(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& nSlices,
+											  const unsigned int& nChannels, const float& sz, const float& rf = 0.30f, const float& gf = 0.59f, const float& bf = 0.11f);
+
+
+// Bytes per texel of a layout //
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_LAYOUT_BYTES(const QIMAGE_PIXEL_LAYOUT& layout);
+
+// Converts a w * h image in one pass, optionally flipping it upside down. dstLayout must be one of //
+// I8 to BGRA8 and dst is tightly packed, srcPitch is the source row stride (0 for packed rows).   //
+// 5 and 6 bit channels are expanded by bit replication, I8 is broadcast to RGB and grey targets   //
+// keep the red channel. src may equal dst when both layouts have the same size and flipY is false. //
+QIMAGEEXPORT_API bool QIMAGE_CONVERT(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const QIMAGE_PIXEL_LAYOUT& srcLayout,
+									 const QIMAGE_PIXEL_LAYOUT& dstLayout, const bool& flipY = false, const unsigned int& srcPitch = 0);
+
+
+#endif
@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// QIMAGE_SIMD.H
+//
+// Internal to qengine. Kernel prototypes for the runtime dispatched pixel routines in qimage.
+// The AVX kernels live in qimage_avx.cpp, the only qimage file built with /arch:AVX. The pixel
+// format converter adds qimage_ssse3.cpp (pshufb) and qimage_avx2.cpp (/arch:AVX2).
+//
+// Row kernels work on n tightly packed channel values and tolerate unaligned pointers.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __QIMAGE_SIMD_H_
+#define __QIMAGE_SIMD_H_
+
+
+// out[i] = sum of rows[r][i] over nRows rows //
+void qimageSumRowsFloatAVX(const float* const* rows, unsigned int nRows, unsigned int n, float* out);
+
+// acc[i] += row[i] * weight //
+void qimageAccumulateFloatAVX(float* acc, const float* row, float weight, unsigned int n);
+
+
+// Block decoders, see qimage_bc.cpp. Palettes are built by the caller //
+
+// out[i] = RGBA palette entry at 2 bit index i of indices, for 16 texels //
+void qimageDecodeColorBlockAVX(const unsigned char* palette, unsigned int indices, unsigned char* out);
+
+// out[i] = palette[3 bit index i], the 48 index bits start at block + 2 //
+void qimageDecodeAlphaBlockAVX(const unsigned char* block, const unsigned char* palette, unsigned char* out);
+
+
+// Normal map vertical pass and encode, see qimage_normal.cpp //
+void qimageBuildNormalRowAVX(const short* const* smooth, const short* const* deriv, const unsigned char* heights, unsigned int w, float sz, unsigned char* out);
+
+
+// Pixel layout conversion of n texels, see qimage_convert.cpp. Kernels keeping the texel size work in place //
+void qimageSwapRB3SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageSwapRB4SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageSwapRB4OpaqueSSSE3(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimagePad3SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimagePad3SwapRBSSSE3(const unsigned char* src, unsigned char* dst, unsigned int n);
+
+void qimageSwapRB4AVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageSwapRB4OpaqueAVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageOpaque4AVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimagePad3AVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimagePad3SwapRBAVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageGreyToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageR5G6B5ToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageX1R5G5B5ToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+void qimageA1R5G5B5ToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n);
+
+
+#endif
@@ -20,7 +20,9 @@
 
 
 
-#ifdef QRENDER_EXPORTS
+#ifndef WIN32
+#define QMATHEXPORT_API
+#elif defined(QRENDER_EXPORTS)
 #define QMATHEXPORT_API __declspec(dllexport)
 #else
 #define QMATHEXPORT_API __declspec(dllimport)
@@ -28,10 +30,23 @@
 
 
 
+#ifdef WIN32
 #include <windows.h>
+#include <d3dx9.h>
+#else
+// Only the texture rect helpers need RECT, match the win32 layout //
+typedef struct tagRECT
+{
+	long	left;
+	long	top;
+	long	right;
+	long	bottom;
+} RECT;
+#endif
+
 #include <math.h>
+#include <string.h>
 #include <xmmintrin.h>
-#include <d3dx9.h>
 
 
 
@@ -57,6 +72,33 @@ typedef mat mat3[9];
 typedef mat mat4[16];
 
 
+// Alignment for matrix storage handed to the SIMD kernels. //
+// Declare as: QMATH_ALIGN(16) mat4 m;  Heap arrays should come from QMATH_ALIGNED_MALLOC //
+#ifdef _MSC_VER
+#define QMATH_ALIGN(n)		__declspec(align(n))
+#else
+#define QMATH_ALIGN(n)		__attribute__((aligned(n)))
+#endif
+
+QMATHEXPORT_API void* QMATH_ALIGNED_MALLOC(const size_t& size, const size_t& alignment = 16);
+QMATHEXPORT_API void  QMATH_ALIGNED_FREE(void* p);
+
+
+// SIMD kernel selection //
+// The matrix kernels are dispatched at runtime. On startup the best level supported by the host //
+// is chosen, QMATH_SET_SIMD_LEVEL may force a lower one (eg. for comparisons or debugging) //
+enum QMATH_SIMD_LEVEL
+{
+	QMATH_SIMD_SCALAR = 0,
+	QMATH_SIMD_SSE = 1,
+	QMATH_SIMD_AVX = 2,
+};
+
+QMATHEXPORT_API QMATH_SIMD_LEVEL QMATH_GET_SIMD_SUPPORT();
+QMATHEXPORT_API QMATH_SIMD_LEVEL QMATH_GET_SIMD_LEVEL();
+QMATHEXPORT_API QMATH_SIMD_LEVEL QMATH_SET_SIMD_LEVEL(const QMATH_SIMD_LEVEL& level);
+
+
 
 enum QMATH_INTERSECT_RESULT
 {
@@ -253,7 +295,7 @@ class QMATHEXPORT_API vec4f
 		const inline void operator=  (const vec4f& v) { x = v.x; y = v.y; z = v.z; w = v.w; }
 		const inline void operator=  (const float* v) { x = v[0]; y = v[1]; z = v[2]; w = v[3]; }
 		
-		const inline void operator*= (const float& v) { x *= v; y *= v; z *= v; w *= w; }
+		const inline void operator*= (const float& v) { x *= v; y *= v; z *= v; w *= v; }
 	
 	private:
 };
@@ -328,7 +370,52 @@ class QMATHEXPORT_API point3f
 
 
 
-typedef vec4f quat;
+// Quaternion, (x, y, z) is the vector part and w the scalar part. Laid out as four packed floats //
+// so arrays of quats can be handed straight to the batch routines.                               //
+class QMATHEXPORT_API quat
+{
+	public:
+	
+		float x, y, z, w;
+		
+		quat();
+		~quat(){}
+		
+		quat(const float* q);
+		quat(const quat& q);
+		quat(const float& nx, const float& ny, const float& nz, const float& nw);
+		
+		const inline void set(const float* q) { x = q[0]; y = q[1]; z = q[2]; w = q[3]; }
+		const inline void set(const quat& q) { x = q.x; y = q.y; z = q.z; w = q.w; }
+		const inline void set(const float& nx, const float& ny, const float& nz, const float& nw) { x = nx; y = ny; z = nz; w = nw; }
+		const inline void identity() { x = 0.0F; y = 0.0F; z = 0.0F; w = 1.0F; }
+		
+		const inline void operator=  (const quat& q) { x = q.x; y = q.y; z = q.z; w = q.w; }
+		const inline void operator=  (const float* q) { x = q[0]; y = q[1]; z = q[2]; w = q[3]; }
+		const inline void operator*= (const float& s) { x *= s; y *= s; z *= s; w *= s; }
+		
+		const inline float dotProd(const quat& q) const
+		{
+			return (x * q.x) + (y * q.y) + (z * q.z) + (w * q.w);
+		}
+		
+		const inline float getLength() const
+		{
+			return sqrtf((x * x) + (y * y) + (z * z) + (w * w));
+		}
+		
+		// Zero length quaternions become the identity //
+		const inline void normalize()
+		{
+			float len = getLength();
+			if(len > 0.0F) { float iLen = 1.0F / len; x *= iLen; y *= iLen; z *= iLen; w *= iLen; }
+			else identity();
+		}
+		
+		const inline void conjugate() { x = -x; y = -y; z = -z; }
+	
+	private:
+};
 
 
 // Point and vector operators //
@@ -391,7 +478,14 @@ QMATHEXPORT_API void QMATH_MATRIX_LOADORTHO_DX(mat4& m, const float& l, const fl
 QMATHEXPORT_API void QMATH_MATRIX_LOADPERSPECTIVE_DX(mat4& m, const float& fov, const float& aspect, const float& n, const float& f);
 QMATHEXPORT_API void QMATH_MATRIX_TRANSPOSE(mat4& m);
 QMATHEXPORT_API void QMATH_MATRIX_TRANSPOSE(mat3& m);
+// In place general inverse, a singular matrix is left unchanged //
 QMATHEXPORT_API void QMATH_MATRIX_INVERT(mat4& m);
+// General 4x4 inverse. Returns false (out untouched) if m is singular. out may alias m //
+QMATHEXPORT_API bool QMATH_MATRIX_INVERSE(const mat4& m, mat4& out);
+// Inverse of an affine matrix (rotation, scale, shear and translation, bottom row 0 0 0 1) //
+QMATHEXPORT_API bool QMATH_MATRIX_INVERSE_AFFINE(const mat4& m, mat4& out);
+// Inverse of a rigid body matrix (orthonormal rotation and translation only) //
+QMATHEXPORT_API void QMATH_MATRIX_INVERSE_RIGID(const mat4& m, mat4& out);
 QMATHEXPORT_API void QMATH_MATRIX_COPY(mat4& to, const mat4& from);
 QMATHEXPORT_API void QMATH_MATRIX_COPY3TO4(mat4& l, const mat3& r);
 QMATHEXPORT_API void QMATH_MATRIX_ADD(const mat4& l, const mat4& r, mat4& out);
@@ -400,6 +494,18 @@ QMATHEXPORT_API void QMATH_MATRIX_MULTIPLY(const mat4& l, const mat4& r, mat4& o
 QMATHEXPORT_API void QMATH_MATRIX_MULVEC(const mat4& l, const vec4f& r, vec4f& out);
 QMATHEXPORT_API void QMATH_MATRIX_MULVEC(const mat3& l, const vec3f& r, vec3f& out);
 
+// Batch matrix operations //
+// Matrix arrays are tightly packed column major float[16] blocks (eg. instance buffers) //
+// out[i] = l * r[i] for each of the n matrices. out may alias r //
+QMATHEXPORT_API void QMATH_MATRIX_MULTIPLY_BATCH(const mat4& l, const float* r, float* out, const unsigned int& n);
+// out[i] = l * r[i] for n homogeneous vectors. out may alias r //
+QMATHEXPORT_API void QMATH_MATRIX_MULVEC_BATCH(const mat4& l, const vec4f* r, vec4f* out, const unsigned int& n);
+// Transforms n points (w = 1) by an affine matrix, the resulting w is discarded. out may alias r //
+QMATHEXPORT_API void QMATH_MATRIX_TRANSFORM_POINTS(const mat4& l, const vec3f* r, vec3f* out, const unsigned int& n);
+// Normal matrices for n affine matrices: the inverse transpose of each upper 3x3, returned as a mat4 //
+// with zero translation. Singular inputs produce a zero 3x3. out may alias in                       //
+QMATHEXPORT_API void QMATH_MATRIX_INVERSETRANSPOSE_BATCH(const float* in, float* out, const unsigned int& n);
+
 QMATHEXPORT_API float QMATH_MATRIX_DETERMINANT( const mat3& m );
 QMATHEXPORT_API void  QMATH_MATRIX_DETERMINANT( const mat3& m, float& res );
 
@@ -407,13 +513,44 @@ QMATHEXPORT_API void  QMATH_MATRIX_DETERMINANT( const mat3& m, float& res );
 // Quaternion operations //
 QMATHEXPORT_API void QMATH_QUATERNION_ROTATE(quat& q, const float& rad, vec3f& axis);
 QMATHEXPORT_API void QMATH_QUATERNION_MAKEMATRIX(mat4& m, const quat& q);
+// Rotation by unit quaternion q followed by translation t //
+QMATHEXPORT_API void QMATH_QUATERNION_MAKEMATRIX(mat4& m, const quat& q, const vec3f& t);
+// out = l * r, out may alias either operand //
 QMATHEXPORT_API void QMATH_QUATERNION_MULQUAT(const quat& l, const quat& r, quat& out);
 QMATHEXPORT_API void QMATH_QUATERNION_CONJUGATE(quat& q);
 QMATHEXPORT_API float QMATH_QUATERNION_GETANGLE(const quat& q);
+QMATHEXPORT_API void QMATH_QUATERNION_NORMALIZE(quat& q);
+QMATHEXPORT_API float QMATH_QUATERNION_DOTPROD(const quat& l, const quat& r);
+// Axis angle conversion. The axis need not be normalized, a zero axis gives the identity //
+QMATHEXPORT_API void QMATH_QUATERNION_FROMAXISANGLE(quat& q, const vec3f& axis, const float& rad);
+// Angle is in [0, 2pi], an identity rotation returns the x axis //
+QMATHEXPORT_API void QMATH_QUATERNION_TOAXISANGLE(const quat& q, vec3f& axis, float& rad);
+// Rotates v by unit quaternion q //
+QMATHEXPORT_API void QMATH_QUATERNION_ROTATEVEC(const quat& q, const vec3f& v, vec3f& out);
+// Spherical and normalized linear interpolation between unit quaternions along the shortest arc. //
+// out may alias l or r                                                                          //
+QMATHEXPORT_API void QMATH_QUATERNION_SLERP(const quat& l, const quat& r, const float& t, quat& out);
+QMATHEXPORT_API void QMATH_QUATERNION_NLERP(const quat& l, const quat& r, const float& t, quat& out);
+
+// Batch quaternion operations //
+// out[i] = slerp(l[i], r[i], t[i]) for n pairs of unit quaternions. The SIMD paths evaluate the //
+// arc with a polynomial rather than acos/sin (error below 3e-6). out may alias l or r           //
+QMATHEXPORT_API void QMATH_QUATERNION_SLERP_BATCH(const quat* l, const quat* r, const float* t, quat* out, const unsigned int& n);
+QMATHEXPORT_API void QMATH_QUATERNION_NLERP_BATCH(const quat* l, const quat* r, const float* t, quat* out, const unsigned int& n);
+// Packs n rigid transforms (unit quaternion q[i] then translation t[i]) into column major float[16] //
+// blocks, eg. for instance buffers. t may be NULL for pure rotations                               //
+QMATHEXPORT_API void QMATH_QUATERNION_MAKEMATRIX_BATCH(const quat* q, const vec3f* t, float* out, const unsigned int& n);
 
 
 // Geometric functions //
+// Area weighted smooth normals, one per vertex (norms holds nVerts * 3 floats). Runs in linear time, //
+// large meshes are split across cores.                                                                //
 QMATHEXPORT_API void QMATH_CREATE_VERTEX_NORMALS(const vec3f* verts, const unsigned int& nVerts, const unsigned int* polys, const unsigned int& nPolys, float* norms);
+// Per vertex tangent frames. Vertices sharing position, normal and uv (within weldEpsilon) are welded //
+// through a spatial hash so split vertices get identical frames. Tangents are orthonormal to norms,   //
+// bitangents (may be NULL) are cross(norm, tangent) flipped to match the uv handedness.                //
+QMATHEXPORT_API void QMATH_CREATE_TANGENT_FRAMES(const vec3f* verts, const unsigned int& nVerts, const unsigned int* polys, const unsigned int& nPolys, const vec2f* texcoords, 
+												  const vec3f* norms, vec3f* tangents, vec3f* bitangents, const float& weldEpsilon = 0.0001F);
 QMATHEXPORT_API void QMATH_CREATE_TANGENT_SPACE(const vec3f* verts, const unsigned int& nVerts, const unsigned int* polys, const unsigned int& nPolys, const vec2f* texcoords, const vec3f* norms, vec3f* tangent);
 QMATHEXPORT_API float QMATH_POINT_ROTATEZ(const vec3f& p, const mat4& m);
 
@@ -455,6 +592,37 @@ QMATHEXPORT_API void QMATH_GET_SAMPLE3X3_OFFSETS(const int& bbWidth, const int&
 QMATHEXPORT_API void QMATH_GET_BILATERAL_OFFSETS(const int& bbWidth, const int& bbHeight, vec2f* avSampleOffsets);
 
 
+// Cached post process kernel tables //
+enum QMATH_KERNEL_TYPE
+{
+	QMATH_KERNEL_GAUSSIAN5X5 = 0,			// 13 taps, weights scaled by mul
+	QMATH_KERNEL_GAUSSIAN10X10 = 1,			// 61 taps, weights scaled by mul
+	QMATH_KERNEL_BLOOM_HORIZONTAL = 2,		// 15 taps along u, shaped by dev and mul
+	QMATH_KERNEL_BLOOM_VERTICAL = 3,		// 15 taps along v, shaped by dev and mul
+	QMATH_KERNEL_SAMPLE2X2 = 4,				// offsets only
+	QMATH_KERNEL_SAMPLE3X3 = 5,				// offsets only
+	QMATH_KERNEL_SAMPLE4X4 = 6,				// offsets only
+	QMATH_KERNEL_BILATERAL = 7,				// offsets only
+};
+
+const unsigned int QMATH_KERNEL_MAX_TAPS = 64;
+
+// Offsets and weights are laid out to be uploaded as-is (2 and 4 floats per tap), taps past nTaps are zero //
+struct cKernelTable
+{
+	unsigned int	nTaps;
+	vec2f			offsets[QMATH_KERNEL_MAX_TAPS];
+	vec4f			weights[QMATH_KERNEL_MAX_TAPS];
+};
+
+// Returns the table for (type, width, height, dev, mul), building it on first use. The pointer stays //
+// valid until QMATH_FLUSH_KERNEL_TABLES so it only needs fetching again when the resolution changes. //
+// Parameters a kernel does not use are ignored. Not thread safe, call from the render thread          //
+QMATHEXPORT_API const cKernelTable* QMATH_GET_KERNEL_TABLE(const QMATH_KERNEL_TYPE& type, const unsigned int& width, const unsigned int& height, 
+															const float& dev = 1.0F, const float& mul = 1.0F);
+QMATHEXPORT_API void QMATH_FLUSH_KERNEL_TABLES();
+
+
 // Interpolative Functions //
 QMATHEXPORT_API void QMATH_LERP_FLOAT3(const float* x, const float* y, const float& dv, float* out);
 QMATHEXPORT_API void QMATH_LERP_FLOAT(const float x, const float y, const float& dv, float& out);
@@ -465,5 +633,17 @@ QMATHEXPORT_API void QMATH_SMOOTHSTEP_FLOAT(const float min, const float max, co
 QMATHEXPORT_API bool QMATH_POINT_IN_SPHERE(const vec3f& test, const vec3f& sphereOrigin, const float& sphereRad);
 QMATHEXPORT_API bool QMATH_POINT_IN_FRUSTUM(const vec4f* planes, vec3f& point);
 
+// Batched frustum culling //
+// Volumes are passed as structure of arrays. Every array must be readable up to n rounded up to //
+// a multiple of 8 (QMATH_CULL_PADDING). planes are the 6 frustum planes, they must be normalized //
+// for the sphere test to be exact (the box test only depends on the plane sign).                  //
+// Bit i of visibleMask[i / 32] is set when volume i is inside or intersecting the frustum, the mask //
+// must hold (n + 31) / 32 words and bits past n are cleared. Returns the number of visible volumes. //
+#define QMATH_CULL_PADDING		8
+QMATHEXPORT_API unsigned int QMATH_FRUSTUM_CULL_AABBS(const vec4f* planes, const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, const unsigned int& n, unsigned int* visibleMask);
+QMATHEXPORT_API unsigned int QMATH_FRUSTUM_CULL_SPHERES(const vec4f* planes, const float* cx, const float* cy, const float* cz, const float* radius, const unsigned int& n, unsigned int* visibleMask);
+// Expands a visibility mask into a compacted list of set bit indices, returns the count //
+QMATHEXPORT_API unsigned int QMATH_MASK_TO_INDICES(const unsigned int* mask, const unsigned int& n, unsigned int* indices);
+
 
 #endif
\ No newline at end of file
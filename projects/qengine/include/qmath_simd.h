@@ -0,0 +1,29 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// QMATH_SIMD.H
+//
+// Internal to qengine. Kernel prototypes for the runtime dispatched matrix routines in qmath.
+// The AVX kernels live in their own translation unit (qmath_avx.cpp) which is the only file
+// built with /arch:AVX, so nothing else in the engine picks up VEX encoded instructions.
+//
+// All kernels operate on column major float[16] matrices and tolerate unaligned pointers.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __QMATH_SIMD_H_
+#define __QMATH_SIMD_H_
+
+
+void qmathMatMulBatchAVX(const float* l, const float* r, float* out, unsigned int n);
+void qmathMulVecBatchAVX(const float* l, const float* r, float* out, unsigned int n);
+void qmathTransformPointsAVX(const float* l, const float* r, float* out, unsigned int n);
+
+
+// Frustum culling kernels. planes is 6 * 4 floats, outputs one visibility bit per volume into //
+// mask (8 volumes per byte), n is already rounded up to a multiple of 8.                      //
+void qmathCullAABBsAVX(const float* planes, const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, unsigned int n, unsigned char* mask);
+void qmathCullSpheresAVX(const float* planes, const float* cx, const float* cy, const float* cz, const float* radius, unsigned int n, unsigned char* mask);
+
+
+#endif
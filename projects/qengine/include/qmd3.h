@@ -44,7 +44,7 @@ struct SMD3VertexFormat
 {
 	float x, y, z;						// world space position
 	float nx, ny, nz;					// normal coords (already normalized)
-	float vx, vy, vz;					// x, y and z vector to the next vertex, used for interpolation.
+	float vx, vy, vz;					// tangent (bound to QVERTEXFORMAT_USAGE_TANGENT)
 	float u, v;							// texture coords
 };
 
@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// QPARALLEL.H
+//
+// Fork/join helper for data parallel loops in Quadrion Engine
+//
+// QPARALLEL_FOR splits an index range into contiguous chunks and runs them on worker threads,
+// the calling thread processes the first chunk itself and returns once every chunk is done.
+// It is meant for coarse grained work (mesh processing, image filtering, decoding) where the
+// range is large enough that thread startup is negligible. Small ranges run inline.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __QPARALLEL_H_
+#define __QPARALLEL_H_
+
+
+#ifndef WIN32
+#define QPARALLELEXPORT_API
+#elif defined(QRENDER_EXPORTS)
+#define QPARALLELEXPORT_API __declspec(dllexport)
+#else
+#define QPARALLELEXPORT_API __declspec(dllimport)
+#endif
+
+
+
+// Processes indices [begin, end) of the range //
+typedef void (*QPARALLEL_FUNC)(void* data, const unsigned int& begin, const unsigned int& end);
+
+
+// Runs func over [0, count). grain is the minimum number of indices given to one thread, //
+// so ranges below 2 * grain never leave the calling thread.                             //
+QPARALLELEXPORT_API void QPARALLEL_FOR(const unsigned int& count, const unsigned int& grain, QPARALLEL_FUNC func, void* data);
+
+// Upper bound on threads used by QPARALLEL_FOR. 0 (the default) uses every core, 1 disables threading. //
+// Other values are used as given, even above the core count (eg. to run threaded paths on one core)   //
+QPARALLELEXPORT_API void QPARALLEL_SET_MAX_THREADS(const unsigned int& n);
+QPARALLELEXPORT_API unsigned int QPARALLEL_GET_MAX_THREADS();
+
+
+#endif
@@ -375,6 +375,14 @@ class QRENDEREXPORT_API CQuadrionRender
 		//		m- A mat4 object in which the matrix will be copied
 		bool		GetMatrix(const unsigned int& type, mat4& m);
 		
+		// GetMatrix - Obtain a state matrix with a modifier applied
+		// Paramters:
+		//		type- one of the QRENDER_MATRIX_ state matrix flags (MODEL through MODELVIEWPROJECTION)
+		//		modifier- QRENDER_MATRIX_TRANSPOSE, QRENDER_MATRIX_INVERSE or QRENDER_MATRIX_INVERSETRANSPOSE
+		//		m- A mat4 object in which the matrix will be copied
+		// Returns false if the state matrix could not be obtained or is singular
+		bool		GetMatrix(const unsigned int& type, const unsigned int& modifier, mat4& m);
+		
 
 		// Font and sprite mgmt //
 		int			CreateFont(const unsigned int& height, const unsigned int& width, const unsigned int& weight, const bool& italic, const char* fontName);	
@@ -485,8 +493,16 @@ class QRENDEREXPORT_API CQuadrionRender
 		CQuadrionTextureObject*			GetTextureObject(const std::string& name, const std::string& path = "./");
 		void							UnloadTextureObject(const std::string& name, const std::string& path = "./");
 		const inline void				UnloadTextureObject(const int& handle) { m_textureObjectResources->RemoveResource(handle); }
+		// Unbinds every texture, memory is handed back by the texture residency manager //
 		void							EvictTextures();
 		int								GetIncrementalTextureRefference();
+		// Processed textures are cached on disk, an empty directory turns the cache off //
+		inline CQuadrionTextureCache*	GetTextureCache() { return m_textureCache; }
+		void							SetTextureCacheDirectory(const std::string& dir) { m_textureCache->SetDirectory(dir); }
+		// Texture memory budgets and residency stats, updated by BeginRendering //
+		inline CQuadrionTextureResidency*	GetTextureResidency() { return m_textureResidency; }
+		// Full chains of QTEXTURE_STREAM textures, swapped in by BeginRendering //
+		inline CQuadrionTextureStreamer*	GetTextureStreamer() { return m_textureStreamer; }
 		// New render to texture interface //
 		int									AddRenderTarget( unsigned int flags, const unsigned int& w, const unsigned int& h, 
 														     const ETexturePixelFormat& fmt, bool msaa = false );
@@ -554,6 +570,9 @@ class QRENDEREXPORT_API CQuadrionRender
 		CQuadrionResourceManager<CQuadrionTextureObject>*			m_textureObjectResources;
 		CQuadrionResourceManager<CQuadrionRenderTarget>*			m_renderTargetResources;
 		CQuadrionResourceManager<CQuadrionDepthStencilTarget>*		m_depthStencilTargetResources;
+		CQuadrionTextureCache*										m_textureCache;
+		CQuadrionTextureResidency*									m_textureResidency;
+		CQuadrionTextureStreamer*									m_textureStreamer;
 		
 		std::vector<LPDIRECT3DSWAPCHAIN9>			m_swapChains;
 		std::vector<LPDIRECT3DSURFACE9>				m_swapDepthStencils;
@@ -40,6 +40,12 @@
 #endif
 
 
+class CMappedFile;
+class CQuadrionTextureCache;
+class CQuadrionTextureResidency;
+class CQuadrionTextureStreamer;
+
+
 const unsigned int			QTEXTURE_ALL_MIPMAPS			= 127;
 
 
@@ -76,6 +82,24 @@ const unsigned int			QTEXTURE_STATIC					= 0x00020000;
 
 const unsigned int			QDEPTHTARGET_LOCKABLE			= 0x00040000;
 
+// Texels are data (masks, lookup tables) rather than sRGB colour, mipmaps filter the stored values //
+const unsigned int			QTEXTURE_LINEAR					= 0x00080000;
+
+// Block compress at load time. Colour goes to DXT1 or DXT5 (with alpha), normal maps to ATI2N  //
+// (x and y only, the shader rebuilds z) or DXT5 when the height is kept                        //
+const unsigned int			QTEXTURE_COMPRESS				= 0x00100000;
+
+// Map DDS files instead of reading them. Chains that need no conversion are used straight from the //
+// mapping, which is released once the texture has been uploaded                                    //
+const unsigned int			QTEXTURE_MAPFILE				= 0x00200000;
+
+// Upload only the levels up to QTEXTURE_STREAM_EXTENT at once and bring in the full chain on the  //
+// texture streamer's thread. The texture is drawable right away and sharpens when the chain lands //
+const unsigned int			QTEXTURE_STREAM					= 0x00400000;
+
+// Largest side of the chain a streamed texture starts out with //
+const unsigned int			QTEXTURE_STREAM_EXTENT			= 64;
+
 
 
 //QTEXTUREEXPORT_API unsigned int		QTEXTURE_FOURCC(unsigned char c0, unsigned char c1, UCHAR c2, UCHAR c3);
@@ -150,13 +174,38 @@ class QTEXTUREEXPORT_API CQuadrionTextureFile
 		bool		LoadFromColor( const unsigned int& color );
 		
 		// Load texture from filename //
-		bool		LoadTexture(const char* fname, const char* pname = "./");
+		// mapFile- map DDS files, chains stored the way they are kept in memory are not copied
+		// maxExtent- skip top levels until the base is no larger than this on either side (0 keeps them
+		//			  all). DDS files seek past them, JPGs are downscaled while decoding, TGAs load whole
+		bool		LoadTexture(const char* fname, const char* pname = "./", const bool mapFile = false, const unsigned int& maxExtent = 0);
+		
+		// Drop the file mapping behind a mapped load. If the current chain still lives in it the //
+		// texture is unloaded, otherwise only the original chain goes away                        //
+		void		ReleaseMapping();
 		
 		// Swap 2 channels in texture //
 		bool		SwapChannels(const unsigned int& ch0, const unsigned int& ch1, bool normalMap = false);
 		
 		// Generate mipmaps //
-		bool		GenerateMipMaps(const unsigned int nMips = QTEXTURE_ALL_MIPMAPS);
+		// nMips- number of levels including the base (defaults to a full chain)
+		// sRGB- 8 bit colour channels are sRGB encoded and are filtered in linear space
+		bool		GenerateMipMaps(const unsigned int nMips = QTEXTURE_ALL_MIPMAPS, const bool sRGB = false);
+		
+		// Block compress every mip level, CreateTexture then uploads the compressed chain //
+		// fmt- QTEXTURE_FORMAT_DXT1 (opaque), DXT3, DXT5 (alpha), ATI1N or ATI2N (normal maps)
+		// useNormalmap- compress the HeightToNormal output instead of the pixel data
+		// Only 8 bit plain formats can be compressed. Generate mipmaps first
+		bool		Compress(const ETexturePixelFormat& fmt, const bool useNormalmap = false);
+		
+		// Decode a block compressed chain on the CPU, DXT formats become RGBA8, ATI1N I8 and ATI2N IA8 //
+		// useNormalmap- decode the normal map chain instead of the pixel data
+		bool		Decompress(const bool useNormalmap = false);
+		
+		// Decode part of one compressed mip level without touching the rest //
+		// out- receives w * h tightly packed texels in the Decompress format
+		// slice- depth slice, or face * depth + slice for cubemaps
+		bool		DecompressRegion(const unsigned int& level, const unsigned int& x, const unsigned int& y, const unsigned int& w, const unsigned int& h,
+									 unsigned char* out, const unsigned int& slice = 0);
 		
 		// Normalmap gen //
 		bool		HeightToNormal(const bool useRGBA = TRUE, const bool keepHeight = FALSE, float sz = 1.0F, float mipScaleZ = 2.0F);
@@ -177,6 +226,9 @@ class QTEXTUREEXPORT_API CQuadrionTextureFile
 		
 		int					GetMipMapCount();
 		
+		// Level of the file the loaded chain starts at, non zero after LoadTexture skipped top levels //
+		const inline unsigned int	GetFirstLevel() { return firstLevel; }
+		
 		// Returns size in bytes of texture with mipmaps //
 		// first- first mip level (defaults to 0) 
 		// nLevels- number of mip levels from "first" to query (defaults to all mip maps)
@@ -212,6 +264,7 @@ class QTEXTUREEXPORT_API CQuadrionTextureFile
 		
 		
 		const inline bool	IsLoaded() { return m_bIsLoaded; }
+		const inline bool	IsMapped() { return mappedFile != NULL; }
 		
 		
 	protected:
@@ -219,16 +272,30 @@ class QTEXTUREEXPORT_API CQuadrionTextureFile
 	private:
 	
 		friend class			CQuadrionTextureObject;
+		friend class			CQuadrionTextureCache;
+		friend class			CQuadrionTextureAtlas;
 	
 		bool			LoadTGA(LPCSTR fname);
-		bool			LoadDDS(LPCSTR fname);
-		bool			LoadJPG(LPCSTR fname);
+		bool			LoadDDS(LPCSTR fname, const bool mapFile = false, const unsigned int& maxExtent = 0);
+		bool			LoadJPG(LPCSTR fname, const unsigned int& maxExtent = 0);
+		
+		bool			ConvertToGreyscaleCompressed(const float rf, const float gf, const float bf);
+		
+		// First level no larger than maxExtent on either side, the last level if none is (0 for no limit) //
+		unsigned int	GetLevelWithin(const unsigned int& maxExtent);
+		
+		// Rebase width, height, depth and the level count on a level of the file //
+		void			SetFirstLevel(const unsigned int& level);
+		
+		// Delete every pixel chain and the mapping behind them //
+		void			FreePixels();
 		
 		bool			m_bIsLoaded;
 	
 		std::vector<unsigned char*> pixels;				// Raw levels of pixmap data
 		std::vector<unsigned char*> normalMap;	
 		unsigned char* greyscale;		
+		CMappedFile*			mappedFile;				// backs pixels[0] after a mapped load, NULL otherwise
 		
 		std::string				fileName;				// file name and extension
 		std::string				m_pathName;				// Path name
@@ -238,12 +305,111 @@ class QTEXTUREEXPORT_API CQuadrionTextureFile
 		unsigned int			bpp;					// bits per pixel
 		unsigned int			depth;					// depth in pixels
 		unsigned int			nMipMaps;				// number of mipmaps associated with raw data ("pixels")
+		unsigned int			firstLevel;				// file level the chain starts at
 		
 		ETexturePixelFormat		pixelFormat;			// pixel format descriptor
 };
 
 
 
+// Resolves a texture name to an existing file. The name is tried as given, then with .dds, .tga //
+// and .jpg appended. found receives the first match                                             //
+QTEXTUREEXPORT_API bool QTEXTURE_FIND_FILE(const std::string& name, std::string& found);
+
+
+
+// Identifies a cache entry, the source file's contents and the flags that shaped the processing //
+struct SQuadrionTextureCacheKey
+{
+	unsigned long long		sourceHash;
+	unsigned long long		sourceSize;
+	unsigned int			flags;
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// CQuadrionTextureCache
+//
+// On disk cache of processed textures. An entry holds a chain exactly the way it is uploaded (final
+// pixel format, full mip chain, normal map already generated and compressed) so loading one skips
+// decoding and processing altogether. Entries are keyed by a hash of the source file's contents, an
+// edited source simply misses. Files are memory mapped and the texture uses the chain in place until
+// CQuadrionTextureFile::ReleaseMapping is called.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class QTEXTUREEXPORT_API CQuadrionTextureCache
+{
+	public:
+	
+		CQuadrionTextureCache(const std::string& dir = "");
+		~CQuadrionTextureCache();
+		
+		// Directory the entries live in, created on the first store. An empty string disables the cache //
+		void						SetDirectory(const std::string& dir);
+		const inline std::string	GetDirectory() { return directory; }
+		const inline bool			IsEnabled() { return !directory.empty(); }
+		
+		// Hash a source file, flags should only hold the bits that change the processed result //
+		bool		GetKey(const std::string& source, const unsigned int& flags, SQuadrionTextureCacheKey& key);
+		
+		// Load the entry for key into tex //
+		// autoGenMips- receives whether the driver has to generate the mipmaps
+		// maxExtent- start the chain at the first level no larger than this, as CQuadrionTextureFile::LoadTexture
+		bool		Load(const SQuadrionTextureCacheKey& key, CQuadrionTextureFile& tex, bool& autoGenMips, const unsigned int& maxExtent = 0);
+		
+		// Write the processed chain of tex as the entry for key //
+		// useNormalmap- store the normal map chain instead of the pixel data
+		bool		Store(const SQuadrionTextureCacheKey& key, CQuadrionTextureFile& tex, const bool useNormalmap, const bool autoGenMips);
+		
+		const inline unsigned int	GetHitCount() { return (unsigned int)hits; }
+		const inline unsigned int	GetMissCount() { return (unsigned int)misses; }
+		
+		
+	private:
+	
+		CQuadrionTextureCache(const CQuadrionTextureCache&);
+		CQuadrionTextureCache& operator= (const CQuadrionTextureCache&);
+	
+		std::string		GetEntryName(const SQuadrionTextureCacheKey& key);
+	
+		std::string		directory;
+		volatile long	hits;
+		volatile long	misses;
+};
+
+
+
+// Residency classes, each one has its own memory budget //
+enum ETextureResidencyClass
+{
+	QTEXTURE_RESIDENCY_COLOR = 0,				// Mipmapped 2D textures
+	QTEXTURE_RESIDENCY_NORMALMAP = 1,			// Textures loaded with QTEXTURE_NORMALMAP
+	QTEXTURE_RESIDENCY_ENVIRONMENT = 2,			// Cubemaps and volumes
+	QTEXTURE_RESIDENCY_UI = 3,					// Textures without mipmaps, fonts, sprites and atlas pages
+	QTEXTURE_RESIDENCY_CLASSES = 4,
+};
+
+// Dropping top mip levels stops once the top level would be smaller than this on both sides //
+const unsigned int			QTEXTURE_RESIDENCY_MIN_EXTENT		= 64;
+
+// Textures that get their dropped levels back per class and frame, each one is a reload //
+const unsigned int			QTEXTURE_RESIDENCY_RESTORES_PER_FRAME = 2;
+
+
+// Residency figures of one frame //
+struct SQuadrionTextureResidencyStats
+{
+	unsigned long long		residentBytes[QTEXTURE_RESIDENCY_CLASSES];		// Device memory held per class at the start of the frame
+	unsigned int			residentTextures;
+	unsigned int			evictions;					// Textures released whole
+	unsigned int			mipDrops;					// Top levels dropped
+	unsigned int			reloads;					// Textures reloaded, whole or to restore their top levels
+};
+
+
+
 ////////////////////////////////////////////////////////////////
 // 
 // SQuadrionTextureSampler
@@ -320,10 +486,32 @@ class QTEXTUREEXPORT_API CQuadrionTextureObject : public CQuadrionResource
 		// Query whether the texture is currently bound to a texture sampling unit 
 		const inline bool			IsBound() { return m_bIsBound; }
 
-		bool						CreateTextureFromFile(unsigned int& flags);
+		// source- file to load, defaults to the object's name. Missing extensions are resolved with
+		// QTEXTURE_FIND_FILE and processed textures go through the renderer's texture cache
+		bool						CreateTextureFromFile(unsigned int& flags, const std::string& source = "");
 		bool						CreateTextureFromData(unsigned int& flags, const void* dat);
 		bool						CreateTexture(CQuadrionTextureFile& tex, unsigned int& flags);
 		
+		// Residency class the texture is budgeted under. Picked from the flags on the first load //
+		// unless set beforehand                                                                   //
+		const inline int			GetResidencyClass() { return m_residencyClass; }
+		inline void					SetResidencyClass(const ETextureResidencyClass& cls) { m_residencyClass = cls; }
+		
+		// Only textures created from a file can be evicted, the others stay resident //
+		const inline bool			IsResident() { return m_pTextureObject != NULL; }
+		const inline bool			IsEvictable() { return !m_sourceFile.empty(); }
+		const inline unsigned int	GetResidentBytes() { return m_residentBytes; }
+		const inline unsigned int	GetDroppedMipCount() { return m_droppedMips; }
+		const inline unsigned int	GetLastUseFrame() { return m_lastUseFrame; }
+		
+		// Streaming, true while the full chain of a QTEXTURE_STREAM texture is still on its way //
+		const inline bool			IsStreaming() { return m_bStreaming; }
+		
+		// Largest side the texture covers on screen in pixels, orders the streamer's queue. 0 (the //
+		// default) asks for the full chain                                                         //
+		inline void					SetScreenExtent(const unsigned int& pixels) { m_screenExtent = pixels; }
+		const inline unsigned int	GetScreenExtent() { return m_screenExtent; }
+		
 		
 		
 	protected:
@@ -350,11 +538,169 @@ class QTEXTUREEXPORT_API CQuadrionTextureObject : public CQuadrionResource
 	
 	private:
 	
+		// Mipmaps, normal map, compression and channel order, leaves tex ready for UploadTexture //
+		// autoGenMips- receives whether the driver has to generate the mipmaps
+		static bool					PrepareForUpload(CQuadrionTextureFile& tex, unsigned int& flags, bool& autoGenMips);
+		
+		// Load and prepare a chain from a source file, through the cache. Touches no device state and //
+		// runs on the streamer's thread                                                                //
+		// maxExtent- as CQuadrionTextureFile::LoadTexture, partial chains bypass the cache
+		static bool					LoadChain(CQuadrionTextureCache* cache, const std::string& fileName, unsigned int& flags, const unsigned int& maxExtent,
+											  CQuadrionTextureFile& tex, bool& useNormalmap, bool& autoGenMips);
 		
+		// Create the device texture from the processed chain and set up the sampler //
+		bool						UploadTexture(CQuadrionTextureFile& tex, const unsigned int& flags, const bool useNormalmap, const bool autoGenMips);
 		
+		// Residency, driven by CQuadrionTextureResidency //
+		void						UpdateResidentBytes();
+		void						ReleaseFromSamplers();
+		void						Evict();
+		bool						DropMipMaps(const unsigned int& nLevels);
+		bool						Reload();
 		
+		// Swap the streamed full chain in for the small one //
+		bool						FinishStreaming(CQuadrionTextureFile& tex, const unsigned int& flags, const bool useNormalmap, const bool autoGenMips);
 		
 		unsigned int				m_anisotropy;				// Anisotropic level (0-16), 0 is off.
+		
+		friend class				CQuadrionTextureResidency;
+		friend class				CQuadrionTextureStreamer;
+		std::string					m_sourceFile;				// File the texture was created from, empty if it can't be reloaded
+		int							m_residencyClass;			// ETextureResidencyClass, -1 until the first load
+		unsigned int				m_residentBytes;			// Device memory held by the current chain
+		unsigned int				m_fullBytes;				// Device memory held by the full chain
+		unsigned int				m_droppedMips;				// Top levels dropped by the residency manager
+		unsigned int				m_lastUseFrame;				// Residency frame of the last bind
+		
+		bool						m_bStreaming;				// Full chain requested from the streamer
+		unsigned int				m_screenExtent;				// Largest side on screen in pixels, 0 if unknown
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// CQuadrionTextureResidency
+//
+// Keeps the textures of a CQuadrionRender within a memory budget per residency class. Binds stamp the
+// texture with the current frame; once per frame, classes over budget give memory back in least
+// recently used order. Textures unused for longer than the eviction age are released whole, the others
+// lose top mip levels one at a time and stay drawable at a lower resolution. A released texture is
+// reloaded when it is bound again, dropped levels come back once the texture is in use and its class
+// has room for them. Reloads go through the texture cache so they skip decoding and processing.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class QTEXTUREEXPORT_API CQuadrionTextureResidency
+{
+	public:
+	
+		CQuadrionTextureResidency();
+		~CQuadrionTextureResidency();
+		
+		// Byte budget of a class, 0 (the default) leaves the class unbounded //
+		void							SetBudget(const ETextureResidencyClass& cls, const unsigned long long& bytes);
+		const inline unsigned long long	GetBudget(const ETextureResidencyClass& cls) { return budget[cls]; }
+		
+		// Frames a texture has to go unused before it is released whole rather than losing top levels //
+		inline void						SetEvictionAge(const unsigned int& frames) { evictionAge = frames; }
+		const inline unsigned int		GetEvictionAge() { return evictionAge; }
+		
+		// Start a frame. Restores dropped levels that fit and brings classes over budget back under it //
+		void							Update(const std::vector<CQuadrionTextureObject*>* textures);
+		
+		// Called by every bind, reloads a released texture //
+		void							Touch(CQuadrionTextureObject* tex);
+		
+		const inline unsigned int		GetFrame() { return frame; }
+		
+		// Figures of the last complete frame //
+		const inline SQuadrionTextureResidencyStats& GetStats() { return lastStats; }
+		
+		
+	private:
+	
+		CQuadrionTextureResidency(const CQuadrionTextureResidency&);
+		CQuadrionTextureResidency& operator= (const CQuadrionTextureResidency&);
+		
+		void							Enforce(std::vector<CQuadrionTextureObject*>& lru, const unsigned int& cls);
+		void							DropLevels(std::vector<CQuadrionTextureObject*>& lru, const unsigned int& begin, const unsigned int& end, const unsigned int& cls);
+		
+		unsigned long long				budget[QTEXTURE_RESIDENCY_CLASSES];
+		unsigned int					evictionAge;
+		unsigned int					frame;
+		
+		SQuadrionTextureResidencyStats	stats;
+		SQuadrionTextureResidencyStats	lastStats;
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// CQuadrionTextureStreamer
+//
+// Loads the full chains of QTEXTURE_STREAM textures on a worker thread. The worker only reads, decodes
+// and processes (through the texture cache); the device textures are created on the render thread in
+// Update, a few per frame, and swapped in for the small chain the texture was created with. Requests
+// are served by priority: how much larger the texture is on screen than the chain it has, textures not
+// drawn last frame wait until nothing visible is left.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class QTEXTUREEXPORT_API CQuadrionTextureStreamer
+{
+	public:
+	
+		CQuadrionTextureStreamer(CQuadrionTextureCache* cache);
+		~CQuadrionTextureStreamer();
+		
+		// Queue the full chain of tex, replaces an earlier request for it //
+		void							Request(CQuadrionTextureObject* tex, const std::string& source, const unsigned int& flags);
+		
+		// Forget every request for tex, a load in progress is thrown away when it finishes //
+		void							Cancel(CQuadrionTextureObject* tex);
+		
+		// Render thread, once per frame. Orders the queue and swaps in finished chains //
+		// frame- the residency frame, last frame's binds mark the visible textures
+		void							Update(const unsigned int& frame);
+		
+		// Bytes of finished chains uploaded per frame, at least one chain always goes //
+		inline void						SetUploadBudget(const unsigned int& bytes) { uploadBudget = bytes; }
+		const inline unsigned int		GetUploadBudget() { return uploadBudget; }
+		
+		const inline unsigned int		GetPendingCount() { return pending.size() + finished.size() + (active != NULL); }
+		
+		
+	private:
+	
+		struct SStreamRequest
+		{
+			CQuadrionTextureObject*		tex;
+			std::string					source;
+			unsigned int				flags;
+			CQuadrionTextureFile*		file;			// loaded chain, NULL until the worker is done
+			bool						useNormalmap;
+			bool						autoGenMips;
+			float						priority;
+			bool						canceled;
+		};
+		
+		CQuadrionTextureStreamer(const CQuadrionTextureStreamer&);
+		CQuadrionTextureStreamer& operator= (const CQuadrionTextureStreamer&);
+		
+		static DWORD WINAPI				WorkerThread(LPVOID param);
+		void							Work();
+		
+		CQuadrionTextureCache*			cache;
+		unsigned int					uploadBudget;
+		
+		HANDLE							thread;
+		HANDLE							wake;			// released once per request
+		CRITICAL_SECTION				lock;
+		volatile bool					quit;
+		
+		std::vector<SStreamRequest*>	pending;
+		std::vector<SStreamRequest*>	finished;
+		SStreamRequest*					active;			// being loaded by the worker
 };
 
 
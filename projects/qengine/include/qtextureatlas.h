@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// QTEXTUREATLAS.H
+//
+// Packs small images (font sheets, sprites, UI icons) into shared texture pages so many of them can
+// be drawn with a single bind. Every image gets a cTextureRect locating it on its page, coordinates
+// in the image's own [0, 1] space are remapped through it. Pages are power of two RGBA8 textures,
+// large images (skybox faces, model textures) are better off as textures or cubemaps of their own.
+//
+// Images are placed with a skyline bottom-left packer, tallest first. Each one sits in a cell with a
+// gutter of replicated edge texels and the page mip chain is built image by image, so filtering never
+// picks up a neighbour at any of the page's levels.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __QTEXTUREATLAS_H_
+#define __QTEXTUREATLAS_H_
+
+
+#include <string>
+#include <vector>
+
+#include "qrender.h"
+#include "qtexture.h"
+
+
+
+class QTEXTUREEXPORT_API CQuadrionTextureAtlas
+{
+	public:
+
+		// pageSize- largest page extent (rounded down to a power of two). Pages shrink to the smallest
+		//			 power of two that holds their images
+		// padding- gutter around every image in texels, rounded down to a power of two. Pages get
+		//			log2(padding) + 1 mip levels, 4 texels keep 3 levels and 16 keep 5
+		CQuadrionTextureAtlas(const unsigned int& pageSize = 1024, const unsigned int& padding = 4);
+		~CQuadrionTextureAtlas();
+
+		// Queue an image, only its top level is used. Returns the image index or -1 //
+		// 8 bit plain formats and DXT/ATI chains are accepted, everything is stored as RGBA8
+		int						AddImage(CQuadrionTextureFile& tex);
+		int						AddImage(const std::string& name, const std::string& path = "./");
+
+		// Pack every image added since the last build into new pages and upload them //
+		// flags- page texture flags. Mipmap filters need at least 2 texels of padding and fall back to
+		//		  QTEXTURE_FILTER_LINEAR otherwise, normal map generation is not available and pages
+		//		  are never block compressed since 4x4 blocks would straddle cells at the small levels
+		// Returns false if an image did not fit on a page or a page failed to upload
+		bool					Build(unsigned int flags);
+
+		const inline unsigned int	GetImageCount() { return images.size(); }
+		const inline unsigned int	GetPageCount() { return pages.size(); }
+
+		// Texture object handle of a page, or of the page an image was placed on (-1 before Build) //
+		int						GetPageHandle(const unsigned int& page);
+		int						GetTextureHandle(const unsigned int& image);
+
+		// Size of an image in texels //
+		unsigned int			GetImageWidth(const unsigned int& image);
+		unsigned int			GetImageHeight(const unsigned int& image);
+
+		// Where an image lives on its page //
+		const cTextureRect&		GetTextureRect(const unsigned int& image);
+
+		// Remap coordinates in an image's own [0, 1] space onto its page //
+		cTextureRect			MapRect(const unsigned int& image, const cTextureRect& local);
+		vec2f					MapUV(const unsigned int& image, const vec2f& uv);
+
+
+	private:
+
+		struct SAtlasImage
+		{
+			unsigned char*		pixels;				// RGBA8 top level until the image is placed
+			unsigned int		width;
+			unsigned int		height;
+			int					page;				// -1 until placed
+			unsigned int		x, y;				// cell origin on the page
+			cTextureRect		rect;
+		};
+
+		struct SAtlasNode
+		{
+			int					x, y, width;
+		};
+
+		struct SAtlasPage
+		{
+			std::vector<SAtlasNode>		skyline;	// top edge of the filled area, left to right
+			unsigned int				usedWidth;
+			unsigned int				usedHeight;
+			unsigned int				width;
+			unsigned int				height;
+			int							handle;
+		};
+
+		CQuadrionTextureAtlas(const CQuadrionTextureAtlas&);
+		CQuadrionTextureAtlas& operator= (const CQuadrionTextureAtlas&);
+
+		unsigned int			GetCellSize(const unsigned int& extent);
+		bool					FindPosition(const SAtlasPage& page, const int& w, const int& h, int& node, int& x, int& y);
+		void					AddSkylineLevel(SAtlasPage& page, const int& node, const int& x, const int& y, const int& w, const int& h);
+		bool					UploadPage(const unsigned int& page, const unsigned int& flags, const unsigned int& nLevels);
+
+		std::vector<SAtlasImage>	images;
+		std::vector<SAtlasPage>		pages;
+
+		unsigned int			maxPageSize;
+		unsigned int			padding;
+		unsigned int			nMips;				// bleed free levels, cells are aligned to 2^(nMips - 1)
+};
+
+
+#endif
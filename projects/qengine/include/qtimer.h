@@ -20,6 +20,7 @@
 #else
 #include <sys/time.h>
 #include <unistd.h>
+#define QTIMEREXPORT_API
 #endif
 
 
@@ -49,6 +50,7 @@ public:
 #endif	
 		StartTime = 0;
 		EndTime = 0;
+		IsRunning = false;
 	}
 
 	~CTimer()
@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "jpegdecoder.h"
+
+#include <immintrin.h>
+
+//
+// This file is compiled with /arch:AVX2. Nothing in here may be called unless
+// QCPU_FEATURE_AVX2 was reported, idct_select() only returns idct_avx2 then.
+//
+// Same algorithm as idct_sse2.cpp, see there for the bit exactness notes.
+// Two blocks are transformed at once, one per 128-bit lane. The unpacks,
+// pmaddwd and packs all work per lane, so the lanes never mix. An odd block
+// at the end of a row goes through the SSE2 kernel.
+//
+/*----------------------------------------------------------------------------*/
+#define CONST_BITS  13
+#define PASS1_BITS  2
+/*----------------------------------------------------------------------------*/
+#define C_E0  ( 4433 + 6270)
+#define C_E1  ( 4433 - 15137)
+#define C_E2  ( 4433)
+#define C_ONE (1 << CONST_BITS)
+/*----------------------------------------------------------------------------*/
+#define C_00  ( 2446 - 7373 - 16069 + 9633)
+#define C_01  ( 9633)
+#define C_02  (-16069 + 9633)
+#define C_03  (-7373 + 9633)
+#define C_10  ( 9633)
+#define C_11  ( 16819 - 20995 - 3196 + 9633)
+#define C_12  (-20995 + 9633)
+#define C_13  (-3196 + 9633)
+#define C_20  (-16069 + 9633)
+#define C_21  (-20995 + 9633)
+#define C_22  ( 25172 - 20995 - 16069 + 9633)
+#define C_23  ( 9633)
+#define C_30  (-7373 + 9633)
+#define C_31  (-3196 + 9633)
+#define C_32  ( 9633)
+#define C_33  ( 12299 - 7373 - 3196 + 9633)
+/*----------------------------------------------------------------------------*/
+#define PAIR(a, b)  _mm256_set1_epi32((int)(((unsigned int)(b) << 16) | ((a) & 0xFFFF)))
+/*----------------------------------------------------------------------------*/
+static inline void transpose(__m256i *v)
+{
+  __m256i a0 = _mm256_unpacklo_epi16(v[0], v[1]);
+  __m256i a1 = _mm256_unpackhi_epi16(v[0], v[1]);
+  __m256i a2 = _mm256_unpacklo_epi16(v[2], v[3]);
+  __m256i a3 = _mm256_unpackhi_epi16(v[2], v[3]);
+  __m256i a4 = _mm256_unpacklo_epi16(v[4], v[5]);
+  __m256i a5 = _mm256_unpackhi_epi16(v[4], v[5]);
+  __m256i a6 = _mm256_unpacklo_epi16(v[6], v[7]);
+  __m256i a7 = _mm256_unpackhi_epi16(v[6], v[7]);
+
+  __m256i b0 = _mm256_unpacklo_epi32(a0, a2);
+  __m256i b1 = _mm256_unpackhi_epi32(a0, a2);
+  __m256i b2 = _mm256_unpacklo_epi32(a1, a3);
+  __m256i b3 = _mm256_unpackhi_epi32(a1, a3);
+  __m256i b4 = _mm256_unpacklo_epi32(a4, a6);
+  __m256i b5 = _mm256_unpackhi_epi32(a4, a6);
+  __m256i b6 = _mm256_unpacklo_epi32(a5, a7);
+  __m256i b7 = _mm256_unpackhi_epi32(a5, a7);
+
+  v[0] = _mm256_unpacklo_epi64(b0, b4);
+  v[1] = _mm256_unpackhi_epi64(b0, b4);
+  v[2] = _mm256_unpacklo_epi64(b1, b5);
+  v[3] = _mm256_unpackhi_epi64(b1, b5);
+  v[4] = _mm256_unpacklo_epi64(b2, b6);
+  v[5] = _mm256_unpackhi_epi64(b2, b6);
+  v[6] = _mm256_unpacklo_epi64(b3, b7);
+  v[7] = _mm256_unpackhi_epi64(b3, b7);
+}
+/*----------------------------------------------------------------------------*/
+static inline __m256i descale(__m256i lo, __m256i hi, __m256i round, int shift)
+{
+  lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), shift);
+  hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), shift);
+
+  lo = _mm256_srai_epi32(_mm256_slli_epi32(lo, 16), 16);
+  hi = _mm256_srai_epi32(_mm256_slli_epi32(hi, 16), 16);
+
+  return (_mm256_packs_epi32(lo, hi));
+}
+/*----------------------------------------------------------------------------*/
+static inline void idct_1d(__m256i *v, __m256i round, int shift)
+{
+  __m256i l26 = _mm256_unpacklo_epi16(v[2], v[6]), h26 = _mm256_unpackhi_epi16(v[2], v[6]);
+  __m256i l04 = _mm256_unpacklo_epi16(v[0], v[4]), h04 = _mm256_unpackhi_epi16(v[0], v[4]);
+  __m256i l75 = _mm256_unpacklo_epi16(v[7], v[5]), h75 = _mm256_unpackhi_epi16(v[7], v[5]);
+  __m256i l31 = _mm256_unpacklo_epi16(v[3], v[1]), h31 = _mm256_unpackhi_epi16(v[3], v[1]);
+
+  const __m256i e3 = PAIR(C_E0, C_E2);
+  const __m256i e2 = PAIR(C_E2, C_E1);
+  const __m256i e0 = PAIR(C_ONE, C_ONE);
+  const __m256i e1 = PAIR(C_ONE, -C_ONE);
+
+  __m256i l_tmp3 = _mm256_madd_epi16(l26, e3), h_tmp3 = _mm256_madd_epi16(h26, e3);
+  __m256i l_tmp2 = _mm256_madd_epi16(l26, e2), h_tmp2 = _mm256_madd_epi16(h26, e2);
+  __m256i l_tmp0 = _mm256_madd_epi16(l04, e0), h_tmp0 = _mm256_madd_epi16(h04, e0);
+  __m256i l_tmp1 = _mm256_madd_epi16(l04, e1), h_tmp1 = _mm256_madd_epi16(h04, e1);
+
+  __m256i l_tmp10 = _mm256_add_epi32(l_tmp0, l_tmp3), h_tmp10 = _mm256_add_epi32(h_tmp0, h_tmp3);
+  __m256i l_tmp13 = _mm256_sub_epi32(l_tmp0, l_tmp3), h_tmp13 = _mm256_sub_epi32(h_tmp0, h_tmp3);
+  __m256i l_tmp11 = _mm256_add_epi32(l_tmp1, l_tmp2), h_tmp11 = _mm256_add_epi32(h_tmp1, h_tmp2);
+  __m256i l_tmp12 = _mm256_sub_epi32(l_tmp1, l_tmp2), h_tmp12 = _mm256_sub_epi32(h_tmp1, h_tmp2);
+
+  const __m256i o0a = PAIR(C_00, C_01), o0b = PAIR(C_02, C_03);
+  const __m256i o1a = PAIR(C_10, C_11), o1b = PAIR(C_12, C_13);
+  const __m256i o2a = PAIR(C_20, C_21), o2b = PAIR(C_22, C_23);
+  const __m256i o3a = PAIR(C_30, C_31), o3b = PAIR(C_32, C_33);
+
+  __m256i l_o0 = _mm256_add_epi32(_mm256_madd_epi16(l75, o0a), _mm256_madd_epi16(l31, o0b));
+  __m256i h_o0 = _mm256_add_epi32(_mm256_madd_epi16(h75, o0a), _mm256_madd_epi16(h31, o0b));
+  __m256i l_o1 = _mm256_add_epi32(_mm256_madd_epi16(l75, o1a), _mm256_madd_epi16(l31, o1b));
+  __m256i h_o1 = _mm256_add_epi32(_mm256_madd_epi16(h75, o1a), _mm256_madd_epi16(h31, o1b));
+  __m256i l_o2 = _mm256_add_epi32(_mm256_madd_epi16(l75, o2a), _mm256_madd_epi16(l31, o2b));
+  __m256i h_o2 = _mm256_add_epi32(_mm256_madd_epi16(h75, o2a), _mm256_madd_epi16(h31, o2b));
+  __m256i l_o3 = _mm256_add_epi32(_mm256_madd_epi16(l75, o3a), _mm256_madd_epi16(l31, o3b));
+  __m256i h_o3 = _mm256_add_epi32(_mm256_madd_epi16(h75, o3a), _mm256_madd_epi16(h31, o3b));
+
+  v[0] = descale(_mm256_add_epi32(l_tmp10, l_o3), _mm256_add_epi32(h_tmp10, h_o3), round, shift);
+  v[7] = descale(_mm256_sub_epi32(l_tmp10, l_o3), _mm256_sub_epi32(h_tmp10, h_o3), round, shift);
+  v[1] = descale(_mm256_add_epi32(l_tmp11, l_o2), _mm256_add_epi32(h_tmp11, h_o2), round, shift);
+  v[6] = descale(_mm256_sub_epi32(l_tmp11, l_o2), _mm256_sub_epi32(h_tmp11, h_o2), round, shift);
+  v[2] = descale(_mm256_add_epi32(l_tmp12, l_o1), _mm256_add_epi32(h_tmp12, h_o1), round, shift);
+  v[5] = descale(_mm256_sub_epi32(l_tmp12, l_o1), _mm256_sub_epi32(h_tmp12, h_o1), round, shift);
+  v[3] = descale(_mm256_add_epi32(l_tmp13, l_o0), _mm256_add_epi32(h_tmp13, h_o0), round, shift);
+  v[4] = descale(_mm256_sub_epi32(l_tmp13, l_o0), _mm256_sub_epi32(h_tmp13, h_o0), round, shift);
+}
+/*----------------------------------------------------------------------------*/
+static inline __m256i load_pair(const int16 *a, const int16 *b)
+{
+  return (_mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)a)),
+                                  _mm_loadu_si128((const __m128i *)b), 1));
+}
+/*----------------------------------------------------------------------------*/
+void idct_avx2(const BLOCK_TYPE *Psrc, QUANT_TYPE * const *Pquant, int num_blocks, uchar *Pdst)
+{
+  const __m256i round1 = _mm256_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1));
+  const __m256i round2 = _mm256_set1_epi32(1 << (CONST_BITS+PASS1_BITS+3-1));
+  const __m256i bias = _mm256_set1_epi16(128);
+
+  for ( ; num_blocks > 1; num_blocks -= 2)
+  {
+    const QUANT_TYPE *q0 = Pquant[0];
+    const QUANT_TYPE *q1 = Pquant[1];
+    __m256i v[8];
+
+    for (int i = 0; i < 8; i++)
+      v[i] = _mm256_mullo_epi16(load_pair(Psrc + i * 8, Psrc + 64 + i * 8),
+                                load_pair(q0 + i * 8, q1 + i * 8));
+
+    transpose(v);
+    idct_1d(v, round1, CONST_BITS-PASS1_BITS);
+
+    transpose(v);
+    idct_1d(v, round2, CONST_BITS+PASS1_BITS+3);
+
+    for (int i = 0; i < 8; i += 2)
+    {
+      __m256i s = _mm256_packus_epi16(_mm256_add_epi16(v[i], bias), _mm256_add_epi16(v[i + 1], bias));
+
+      _mm_storeu_si128((__m128i *)(Pdst + i * 8), _mm256_castsi256_si128(s));
+      _mm_storeu_si128((__m128i *)(Pdst + 64 + i * 8), _mm256_extracti128_si256(s, 1));
+    }
+
+    Pquant += 2;
+    Psrc += 128;
+    Pdst += 128;
+  }
+
+  if (num_blocks)
+    idct_sse2(Psrc, Pquant, 1, Pdst);
+}
+/*----------------------------------------------------------------------------*/
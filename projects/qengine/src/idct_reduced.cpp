@@ -0,0 +1,300 @@
+#include "stdafx.h"
+
+
+//
+// Reduced size IDCTs for decoding at 1/2, 1/4 and 1/8 scale.
+// Derived from the IJG's JPEG software, jidctred.c.
+//
+
+/*
+ * jidctred.c
+ *
+ * Copyright (C) 1994-1998, Thomas G. Lane.
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains inverse-DCT routines that produce reduced-size output:
+ * either 4x4, 2x2, or 1x1 pixels from an 8x8 DCT block.
+ *
+ * The implementation is based on the Loeffler, Ligtenberg and Moschytz (LL&M)
+ * algorithm used in jidctint.c.  We simply replace each 8-to-8 1-D IDCT step
+ * with an 8-to-4 step that produces the four averages of two adjacent outputs
+ * (or an 8-to-2 step producing two averages of four outputs, for 2x2 output).
+ * These steps were derived by computing the corresponding values at the end
+ * of the normal LL&M code, then simplifying as much as possible.
+ *
+ * 1x1 is trivial: just take the DC coefficient divided by 8.
+ */
+
+/*----------------------------------------------------------------------------*/
+#include "jpegdecoder.h"
+/*----------------------------------------------------------------------------*/
+#define CONST_BITS  13
+#define PASS1_BITS  2
+#define SCALEDONE ((int32) 1)
+/*----------------------------------------------------------------------------*/
+#define FIX_0_211164243  ((int32)  1730)
+#define FIX_0_509795579  ((int32)  4176)
+#define FIX_0_601344887  ((int32)  4926)
+#define FIX_0_720959822  ((int32)  5906)
+#define FIX_0_765366865  ((int32)  6270)
+#define FIX_0_850430095  ((int32)  6967)
+#define FIX_0_899976223  ((int32)  7373)
+#define FIX_1_061594337  ((int32)  8697)
+#define FIX_1_272758580  ((int32)  10426)
+#define FIX_1_451774981  ((int32)  11893)
+#define FIX_1_847759065  ((int32)  15137)
+#define FIX_2_172734803  ((int32)  17799)
+#define FIX_2_562915447  ((int32)  20995)
+#define FIX_3_624509785  ((int32)  29692)
+/*----------------------------------------------------------------------------*/
+#define DESCALE(x,n)  (((x) + (SCALEDONE << ((n)-1))) >> (n))
+/*----------------------------------------------------------------------------*/
+#define MULTIPLY(var,cnst)  ((var) * (cnst))
+/*----------------------------------------------------------------------------*/
+// Dequantized coefficients are truncated to 16 bits like the decoder's
+// coefficient store does, a NULL table means they are dequantized already.
+#define DEQUANTIZE(coef,quantval)  ((q) ? (int32) (int16) ((coef) * (quantval)) : (int32) (coef))
+/*----------------------------------------------------------------------------*/
+static inline uchar range_limit(int32 i)
+{
+  i += 128;
+
+  if (i & 0xFFFFFF00)
+    return ((uchar)((~i) >> 31));
+
+  return ((uchar)i);
+}
+/*----------------------------------------------------------------------------*/
+static void idct_4x4(const BLOCK_TYPE *inptr, const QUANT_TYPE *q, uchar *outptr)
+{
+  int32 tmp0, tmp2, tmp10, tmp12;
+  int32 z1, z2, z3, z4;
+  int workspace[8*4];
+  int *wsptr = workspace;
+  int ctr;
+
+  /* Pass 1: process columns from input, store into work array. */
+
+  for (ctr = 0; ctr < 8; ctr++, wsptr++)
+  {
+    /* Don't bother to process column 4, because second pass won't use it */
+    if (ctr == 4)
+      continue;
+
+    if ((inptr[8*1+ctr] | inptr[8*2+ctr] | inptr[8*3+ctr] |
+         inptr[8*5+ctr] | inptr[8*6+ctr] | inptr[8*7+ctr]) == 0)
+    {
+      /* AC terms all zero; we need not examine term 4 for 4x4 output */
+      int dcval = DEQUANTIZE(inptr[ctr], q[ctr]) << PASS1_BITS;
+
+      wsptr[8*0] = dcval;
+      wsptr[8*1] = dcval;
+      wsptr[8*2] = dcval;
+      wsptr[8*3] = dcval;
+
+      continue;
+    }
+
+    /* Even part */
+
+    tmp0 = DEQUANTIZE(inptr[ctr], q[ctr]);
+    tmp0 <<= (CONST_BITS+1);
+
+    z2 = DEQUANTIZE(inptr[8*2+ctr], q[8*2+ctr]);
+    z3 = DEQUANTIZE(inptr[8*6+ctr], q[8*6+ctr]);
+
+    tmp2 = MULTIPLY(z2, FIX_1_847759065) + MULTIPLY(z3, - FIX_0_765366865);
+
+    tmp10 = tmp0 + tmp2;
+    tmp12 = tmp0 - tmp2;
+
+    /* Odd part */
+
+    z1 = DEQUANTIZE(inptr[8*7+ctr], q[8*7+ctr]);
+    z2 = DEQUANTIZE(inptr[8*5+ctr], q[8*5+ctr]);
+    z3 = DEQUANTIZE(inptr[8*3+ctr], q[8*3+ctr]);
+    z4 = DEQUANTIZE(inptr[8*1+ctr], q[8*1+ctr]);
+
+    tmp0 = MULTIPLY(z1, - FIX_0_211164243) /* sqrt(2) * (c3-c1) */
+         + MULTIPLY(z2, FIX_1_451774981)   /* sqrt(2) * (c3+c7) */
+         + MULTIPLY(z3, - FIX_2_172734803) /* sqrt(2) * (-c1-c5) */
+         + MULTIPLY(z4, FIX_1_061594337);  /* sqrt(2) * (c5+c7) */
+
+    tmp2 = MULTIPLY(z1, - FIX_0_509795579) /* sqrt(2) * (c7-c5) */
+         + MULTIPLY(z2, - FIX_0_601344887) /* sqrt(2) * (c5-c1) */
+         + MULTIPLY(z3, FIX_0_899976223)   /* sqrt(2) * (c3+c7) */
+         + MULTIPLY(z4, FIX_2_562915447);  /* sqrt(2) * (c1+c3) */
+
+    /* Final output stage */
+
+    wsptr[8*0] = (int) DESCALE(tmp10 + tmp2, CONST_BITS-PASS1_BITS+1);
+    wsptr[8*3] = (int) DESCALE(tmp10 - tmp2, CONST_BITS-PASS1_BITS+1);
+    wsptr[8*1] = (int) DESCALE(tmp12 + tmp0, CONST_BITS-PASS1_BITS+1);
+    wsptr[8*2] = (int) DESCALE(tmp12 - tmp0, CONST_BITS-PASS1_BITS+1);
+  }
+
+  /* Pass 2: process 4 rows from work array, store into output array. */
+
+  wsptr = workspace;
+
+  for (ctr = 0; ctr < 4; ctr++, wsptr += 8, outptr += 8)
+  {
+    if ((wsptr[1] | wsptr[2] | wsptr[3] | wsptr[5] | wsptr[6] | wsptr[7]) == 0)
+    {
+      uchar outv = range_limit(DESCALE((int32) wsptr[0], PASS1_BITS+3));
+
+      outptr[0] = outv;
+      outptr[1] = outv;
+      outptr[2] = outv;
+      outptr[3] = outv;
+
+      continue;
+    }
+
+    /* Even part */
+
+    tmp0 = ((int32) wsptr[0]) << (CONST_BITS+1);
+
+    tmp2 = MULTIPLY((int32) wsptr[2], FIX_1_847759065)
+         + MULTIPLY((int32) wsptr[6], - FIX_0_765366865);
+
+    tmp10 = tmp0 + tmp2;
+    tmp12 = tmp0 - tmp2;
+
+    /* Odd part */
+
+    z1 = (int32) wsptr[7];
+    z2 = (int32) wsptr[5];
+    z3 = (int32) wsptr[3];
+    z4 = (int32) wsptr[1];
+
+    tmp0 = MULTIPLY(z1, - FIX_0_211164243) /* sqrt(2) * (c3-c1) */
+         + MULTIPLY(z2, FIX_1_451774981)   /* sqrt(2) * (c3+c7) */
+         + MULTIPLY(z3, - FIX_2_172734803) /* sqrt(2) * (-c1-c5) */
+         + MULTIPLY(z4, FIX_1_061594337);  /* sqrt(2) * (c5+c7) */
+
+    tmp2 = MULTIPLY(z1, - FIX_0_509795579) /* sqrt(2) * (c7-c5) */
+         + MULTIPLY(z2, - FIX_0_601344887) /* sqrt(2) * (c5-c1) */
+         + MULTIPLY(z3, FIX_0_899976223)   /* sqrt(2) * (c3+c7) */
+         + MULTIPLY(z4, FIX_2_562915447);  /* sqrt(2) * (c1+c3) */
+
+    /* Final output stage */
+
+    outptr[0] = range_limit(DESCALE(tmp10 + tmp2, CONST_BITS+PASS1_BITS+3+1));
+    outptr[3] = range_limit(DESCALE(tmp10 - tmp2, CONST_BITS+PASS1_BITS+3+1));
+    outptr[1] = range_limit(DESCALE(tmp12 + tmp0, CONST_BITS+PASS1_BITS+3+1));
+    outptr[2] = range_limit(DESCALE(tmp12 - tmp0, CONST_BITS+PASS1_BITS+3+1));
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void idct_2x2(const BLOCK_TYPE *inptr, const QUANT_TYPE *q, uchar *outptr)
+{
+  int32 tmp0, tmp10, z1;
+  int workspace[8*2];
+  int *wsptr = workspace;
+  int ctr;
+
+  /* Pass 1: process columns from input, store into work array. */
+
+  for (ctr = 0; ctr < 8; ctr++, wsptr++)
+  {
+    /* Don't bother to process columns 2,4,6 */
+    if ((ctr == 2) || (ctr == 4) || (ctr == 6))
+      continue;
+
+    if ((inptr[8*1+ctr] | inptr[8*3+ctr] | inptr[8*5+ctr] | inptr[8*7+ctr]) == 0)
+    {
+      /* AC terms all zero; we need not examine terms 2,4,6 for 2x2 output */
+      int dcval = DEQUANTIZE(inptr[ctr], q[ctr]) << PASS1_BITS;
+
+      wsptr[8*0] = dcval;
+      wsptr[8*1] = dcval;
+
+      continue;
+    }
+
+    /* Even part */
+
+    z1 = DEQUANTIZE(inptr[ctr], q[ctr]);
+    tmp10 = z1 << (CONST_BITS+2);
+
+    /* Odd part */
+
+    z1 = DEQUANTIZE(inptr[8*7+ctr], q[8*7+ctr]);
+    tmp0 = MULTIPLY(z1, - FIX_0_720959822);  /* sqrt(2) * (c7-c5+c3-c1) */
+    z1 = DEQUANTIZE(inptr[8*5+ctr], q[8*5+ctr]);
+    tmp0 += MULTIPLY(z1, FIX_0_850430095);   /* sqrt(2) * (-c1+c3+c5+c7) */
+    z1 = DEQUANTIZE(inptr[8*3+ctr], q[8*3+ctr]);
+    tmp0 += MULTIPLY(z1, - FIX_1_272758580); /* sqrt(2) * (-c1+c3-c5-c7) */
+    z1 = DEQUANTIZE(inptr[8*1+ctr], q[8*1+ctr]);
+    tmp0 += MULTIPLY(z1, FIX_3_624509785);   /* sqrt(2) * (c1+c3+c5+c7) */
+
+    /* Final output stage */
+
+    wsptr[8*0] = (int) DESCALE(tmp10 + tmp0, CONST_BITS-PASS1_BITS+2);
+    wsptr[8*1] = (int) DESCALE(tmp10 - tmp0, CONST_BITS-PASS1_BITS+2);
+  }
+
+  /* Pass 2: process 2 rows from work array, store into output array. */
+
+  wsptr = workspace;
+
+  for (ctr = 0; ctr < 2; ctr++, wsptr += 8, outptr += 8)
+  {
+    if ((wsptr[1] | wsptr[3] | wsptr[5] | wsptr[7]) == 0)
+    {
+      uchar outv = range_limit(DESCALE((int32) wsptr[0], PASS1_BITS+3));
+
+      outptr[0] = outv;
+      outptr[1] = outv;
+
+      continue;
+    }
+
+    /* Even part */
+
+    tmp10 = ((int32) wsptr[0]) << (CONST_BITS+2);
+
+    /* Odd part */
+
+    tmp0 = MULTIPLY((int32) wsptr[7], - FIX_0_720959822)  /* sqrt(2) * (c7-c5+c3-c1) */
+         + MULTIPLY((int32) wsptr[5], FIX_0_850430095)    /* sqrt(2) * (-c1+c3+c5+c7) */
+         + MULTIPLY((int32) wsptr[3], - FIX_1_272758580)  /* sqrt(2) * (-c1+c3-c5-c7) */
+         + MULTIPLY((int32) wsptr[1], FIX_3_624509785);   /* sqrt(2) * (c1+c3+c5+c7) */
+
+    /* Final output stage */
+
+    outptr[0] = range_limit(DESCALE(tmp10 + tmp0, CONST_BITS+PASS1_BITS+3+2));
+    outptr[1] = range_limit(DESCALE(tmp10 - tmp0, CONST_BITS+PASS1_BITS+3+2));
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void idct_1x1(const BLOCK_TYPE *inptr, const QUANT_TYPE *q, uchar *outptr)
+{
+  /* We hardly need an inverse DCT routine for this: just take the
+   * average pixel value, which is one-eighth of the DC coefficient.
+   */
+  outptr[0] = range_limit(DESCALE(DEQUANTIZE(inptr[0], q[0]), 3));
+}
+/*----------------------------------------------------------------------------*/
+void idct_reduced(const BLOCK_TYPE *Psrc, QUANT_TYPE * const *Pquant, int num_blocks, uchar *Pdst, int shift)
+{
+  void (*Pfunc)(const BLOCK_TYPE *, const QUANT_TYPE *, uchar *);
+
+  switch (shift)
+  {
+    case 1:  Pfunc = idct_4x4; break;
+    case 2:  Pfunc = idct_2x2; break;
+    default: Pfunc = idct_1x1; break;
+  }
+
+  for ( ; num_blocks > 0; num_blocks--)
+  {
+    Pfunc(Psrc, (Pquant) ? *Pquant++ : NULL, Pdst);
+
+    Psrc += 64;
+    Pdst += 64;
+  }
+}
+/*----------------------------------------------------------------------------*/
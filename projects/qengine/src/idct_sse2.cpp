@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include "jpegdecoder.h"
+#include "qmath.h"
+#include "qcpu.h"
+
+#include <emmintrin.h>
+
+//
+// SSE2 version of idct.cpp's slow-but-accurate integer IDCT, with the
+// dequantization folded in. The output is bit exact with idct():
+//
+// - Every 1-D output is formed in 32 bits as a sum of products of the 8
+//   inputs with the IJG constants (pmaddwd), the sums of constants are
+//   folded ahead of time so all 16-bit operands are the inputs themselves.
+//   Integer addition and multiplication wrap the same way in both versions,
+//   so even overflowing blocks from damaged streams come out identical.
+// - Pass 1 results are truncated to 16 bits the way idct() stores them in
+//   the block, pass 2 results are truncated, offset by 128 and clamped.
+// - Dequantization (pmullw) keeps the low 16 bits of the product, as the
+//   decoder's int16 coefficient store does.
+//
+// Both passes run over all 8 rows/columns at once, the block is transposed
+// before each pass so the lanes hold the rows, then the columns.
+//
+/*----------------------------------------------------------------------------*/
+#define CONST_BITS  13
+#define PASS1_BITS  2
+/*----------------------------------------------------------------------------*/
+// Even part: (x2, x6) and (x0, x4) pairs
+#define C_E0  ( 4433 + 6270)    /* x2:  FIX_0_541196100 + FIX_0_765366865 */
+#define C_E1  ( 4433 - 15137)   /* x6:  FIX_0_541196100 - FIX_1_847759065 */
+#define C_E2  ( 4433)           /*      FIX_0_541196100 */
+#define C_ONE (1 << CONST_BITS)
+/*----------------------------------------------------------------------------*/
+// Odd part, tmp0-3 = x7, x5, x3, x1 expanded over z1-z5
+#define C_00  ( 2446 - 7373 - 16069 + 9633)
+#define C_01  ( 9633)
+#define C_02  (-16069 + 9633)
+#define C_03  (-7373 + 9633)
+#define C_10  ( 9633)
+#define C_11  ( 16819 - 20995 - 3196 + 9633)
+#define C_12  (-20995 + 9633)
+#define C_13  (-3196 + 9633)
+#define C_20  (-16069 + 9633)
+#define C_21  (-20995 + 9633)
+#define C_22  ( 25172 - 20995 - 16069 + 9633)
+#define C_23  ( 9633)
+#define C_30  (-7373 + 9633)
+#define C_31  (-3196 + 9633)
+#define C_32  ( 9633)
+#define C_33  ( 12299 - 7373 - 3196 + 9633)
+/*----------------------------------------------------------------------------*/
+#define PAIR(a, b)  _mm_set_epi16(b, a, b, a, b, a, b, a)
+/*----------------------------------------------------------------------------*/
+static inline void transpose(__m128i *v)
+{
+  __m128i a0 = _mm_unpacklo_epi16(v[0], v[1]);
+  __m128i a1 = _mm_unpackhi_epi16(v[0], v[1]);
+  __m128i a2 = _mm_unpacklo_epi16(v[2], v[3]);
+  __m128i a3 = _mm_unpackhi_epi16(v[2], v[3]);
+  __m128i a4 = _mm_unpacklo_epi16(v[4], v[5]);
+  __m128i a5 = _mm_unpackhi_epi16(v[4], v[5]);
+  __m128i a6 = _mm_unpacklo_epi16(v[6], v[7]);
+  __m128i a7 = _mm_unpackhi_epi16(v[6], v[7]);
+
+  __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+  __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+  __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+  __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+  __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+  __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+  __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+  __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+  v[0] = _mm_unpacklo_epi64(b0, b4);
+  v[1] = _mm_unpackhi_epi64(b0, b4);
+  v[2] = _mm_unpacklo_epi64(b1, b5);
+  v[3] = _mm_unpackhi_epi64(b1, b5);
+  v[4] = _mm_unpacklo_epi64(b2, b6);
+  v[5] = _mm_unpackhi_epi64(b2, b6);
+  v[6] = _mm_unpacklo_epi64(b3, b7);
+  v[7] = _mm_unpackhi_epi64(b3, b7);
+}
+/*----------------------------------------------------------------------------*/
+// DESCALE both halves and truncate to int16.
+static inline __m128i descale(__m128i lo, __m128i hi, __m128i round, int shift)
+{
+  lo = _mm_srai_epi32(_mm_add_epi32(lo, round), shift);
+  hi = _mm_srai_epi32(_mm_add_epi32(hi, round), shift);
+
+  lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+  hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+
+  return (_mm_packs_epi32(lo, hi));
+}
+/*----------------------------------------------------------------------------*/
+// 1-D IDCT down the lanes of v[0]-v[7], in place.
+static inline void idct_1d(__m128i *v, __m128i round, int shift)
+{
+  __m128i l26 = _mm_unpacklo_epi16(v[2], v[6]), h26 = _mm_unpackhi_epi16(v[2], v[6]);
+  __m128i l04 = _mm_unpacklo_epi16(v[0], v[4]), h04 = _mm_unpackhi_epi16(v[0], v[4]);
+  __m128i l75 = _mm_unpacklo_epi16(v[7], v[5]), h75 = _mm_unpackhi_epi16(v[7], v[5]);
+  __m128i l31 = _mm_unpacklo_epi16(v[3], v[1]), h31 = _mm_unpackhi_epi16(v[3], v[1]);
+
+  const __m128i e3 = PAIR(C_E0, C_E2);
+  const __m128i e2 = PAIR(C_E2, C_E1);
+  const __m128i e0 = PAIR(C_ONE, C_ONE);
+  const __m128i e1 = PAIR(C_ONE, -C_ONE);
+
+  __m128i l_tmp3 = _mm_madd_epi16(l26, e3), h_tmp3 = _mm_madd_epi16(h26, e3);
+  __m128i l_tmp2 = _mm_madd_epi16(l26, e2), h_tmp2 = _mm_madd_epi16(h26, e2);
+  __m128i l_tmp0 = _mm_madd_epi16(l04, e0), h_tmp0 = _mm_madd_epi16(h04, e0);
+  __m128i l_tmp1 = _mm_madd_epi16(l04, e1), h_tmp1 = _mm_madd_epi16(h04, e1);
+
+  __m128i l_tmp10 = _mm_add_epi32(l_tmp0, l_tmp3), h_tmp10 = _mm_add_epi32(h_tmp0, h_tmp3);
+  __m128i l_tmp13 = _mm_sub_epi32(l_tmp0, l_tmp3), h_tmp13 = _mm_sub_epi32(h_tmp0, h_tmp3);
+  __m128i l_tmp11 = _mm_add_epi32(l_tmp1, l_tmp2), h_tmp11 = _mm_add_epi32(h_tmp1, h_tmp2);
+  __m128i l_tmp12 = _mm_sub_epi32(l_tmp1, l_tmp2), h_tmp12 = _mm_sub_epi32(h_tmp1, h_tmp2);
+
+  const __m128i o0a = PAIR(C_00, C_01), o0b = PAIR(C_02, C_03);
+  const __m128i o1a = PAIR(C_10, C_11), o1b = PAIR(C_12, C_13);
+  const __m128i o2a = PAIR(C_20, C_21), o2b = PAIR(C_22, C_23);
+  const __m128i o3a = PAIR(C_30, C_31), o3b = PAIR(C_32, C_33);
+
+  __m128i l_o0 = _mm_add_epi32(_mm_madd_epi16(l75, o0a), _mm_madd_epi16(l31, o0b));
+  __m128i h_o0 = _mm_add_epi32(_mm_madd_epi16(h75, o0a), _mm_madd_epi16(h31, o0b));
+  __m128i l_o1 = _mm_add_epi32(_mm_madd_epi16(l75, o1a), _mm_madd_epi16(l31, o1b));
+  __m128i h_o1 = _mm_add_epi32(_mm_madd_epi16(h75, o1a), _mm_madd_epi16(h31, o1b));
+  __m128i l_o2 = _mm_add_epi32(_mm_madd_epi16(l75, o2a), _mm_madd_epi16(l31, o2b));
+  __m128i h_o2 = _mm_add_epi32(_mm_madd_epi16(h75, o2a), _mm_madd_epi16(h31, o2b));
+  __m128i l_o3 = _mm_add_epi32(_mm_madd_epi16(l75, o3a), _mm_madd_epi16(l31, o3b));
+  __m128i h_o3 = _mm_add_epi32(_mm_madd_epi16(h75, o3a), _mm_madd_epi16(h31, o3b));
+
+  v[0] = descale(_mm_add_epi32(l_tmp10, l_o3), _mm_add_epi32(h_tmp10, h_o3), round, shift);
+  v[7] = descale(_mm_sub_epi32(l_tmp10, l_o3), _mm_sub_epi32(h_tmp10, h_o3), round, shift);
+  v[1] = descale(_mm_add_epi32(l_tmp11, l_o2), _mm_add_epi32(h_tmp11, h_o2), round, shift);
+  v[6] = descale(_mm_sub_epi32(l_tmp11, l_o2), _mm_sub_epi32(h_tmp11, h_o2), round, shift);
+  v[2] = descale(_mm_add_epi32(l_tmp12, l_o1), _mm_add_epi32(h_tmp12, h_o1), round, shift);
+  v[5] = descale(_mm_sub_epi32(l_tmp12, l_o1), _mm_sub_epi32(h_tmp12, h_o1), round, shift);
+  v[3] = descale(_mm_add_epi32(l_tmp13, l_o0), _mm_add_epi32(h_tmp13, h_o0), round, shift);
+  v[4] = descale(_mm_sub_epi32(l_tmp13, l_o0), _mm_sub_epi32(h_tmp13, h_o0), round, shift);
+}
+/*----------------------------------------------------------------------------*/
+void idct_sse2(const BLOCK_TYPE *Psrc, QUANT_TYPE * const *Pquant, int num_blocks, uchar *Pdst)
+{
+  const __m128i round1 = _mm_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1));
+  const __m128i round2 = _mm_set1_epi32(1 << (CONST_BITS+PASS1_BITS+3-1));
+  const __m128i bias = _mm_set1_epi16(128);
+
+  for ( ; num_blocks > 0; num_blocks--)
+  {
+    const QUANT_TYPE *q = *Pquant++;
+    __m128i v[8];
+
+    for (int i = 0; i < 8; i++)
+      v[i] = _mm_mullo_epi16(_mm_loadu_si128((const __m128i *)(Psrc + i * 8)),
+                             _mm_loadu_si128((const __m128i *)(q + i * 8)));
+
+    // Rows
+    transpose(v);
+    idct_1d(v, round1, CONST_BITS-PASS1_BITS);
+
+    // Columns, the lanes are back in sample order afterwards
+    transpose(v);
+    idct_1d(v, round2, CONST_BITS+PASS1_BITS+3);
+
+    for (int i = 0; i < 8; i += 2)
+      _mm_storeu_si128((__m128i *)(Pdst + i * 8),
+        _mm_packus_epi16(_mm_add_epi16(v[i], bias), _mm_add_epi16(v[i + 1], bias)));
+
+    Psrc += 64;
+    Pdst += 64;
+  }
+}
+/*----------------------------------------------------------------------------*/
+// The AVX level picks up AVX2 when the CPU has it.
+Pidct_func idct_select(void)
+{
+  switch (QMATH_GET_SIMD_LEVEL())
+  {
+    case QMATH_SIMD_AVX:
+      if (QCPU_HAS_FEATURE(QCPU_FEATURE_AVX2))
+        return (idct_avx2);
+      // fall through
+
+    case QMATH_SIMD_SSE:
+      if (QCPU_HAS_FEATURE(QCPU_FEATURE_SSE2))
+        return (idct_sse2);
+      return (NULL);
+
+    default:
+      return (NULL);
+  }
+}
+/*----------------------------------------------------------------------------*/
@@ -1,6 +1,9 @@
 #include "stdafx.h"
 #include "jpegdecoder.h"
 
+// MMX inline assembler, the decoder only calls in here when SUPPORT_MMX is defined
+#ifdef SUPPORT_MMX
+
 #pragma warning(push)
 #pragma warning( disable : 4035 4799 )
 
@@ -1213,3 +1216,5 @@ bool jpeg_idct_ifast_avail(void)
 }
 
 #pragma warning(pop)
+
+#endif
@@ -27,7 +27,7 @@
 #include "jpegdecoder.h"
 //------------------------------------------------------------------------------
 // Coefficients are stored in this sequence in the data stream.
-static int ZAG[64] =
+static const int ZAG[64] =
 {
   0,  1,  8, 16,  9,  2,  3, 10,
  17, 24, 32, 25, 18, 11,  4,  5,
@@ -42,7 +42,7 @@ static int ZAG[64] =
 const int AAN_SCALE_BITS = 14;
 const int IFAST_SCALE_BITS = 2; /* fractional bits in scale factors */
 //------------------------------------------------------------------------------
-static int16 aan_scales[64] =
+static const int16 aan_scales[64] =
 {
   16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
   22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
@@ -115,7 +115,7 @@ void *jpeg_decoder::alloc(int n)
   blocks[i] = q;
 
   // Round to qword boundry, to avoid misaligned accesses with MMX code
-  return ((void *)(((uint)q + 7) & ~7));
+  return ((void *)(((size_t)q + 7) & ~(size_t)7));
 }
 //------------------------------------------------------------------------------
 // Clear buffer to word values.
@@ -136,15 +136,26 @@ void jpeg_decoder::prep_in_buffer(void)
 {
   in_buf_left = 0;
   Pin_buf_ofs = in_buf;
+  mem_flag = false;
 
   if (eof_flag)
     return;
 
-#ifdef SUPPORT_MMX
-  bool was_mmx_active = mmx_active;
-  if (mmx_active)
-    get_bits_2_mmx_deinit();
-#endif
+  // A stream that's all in memory is used in place, as a single buffer.
+  // Nothing is written to it, stuff_char() only puts back the bytes that
+  // were there.
+  uint mem_size;
+  const uchar *Pmem = (total_bytes_read) ? NULL : Pstream->get_memory(&mem_size);
+
+  if ((Pmem) && ((int)mem_size > 0))
+  {
+    Pin_buf_ofs = (uchar *)Pmem;
+    in_buf_left = mem_size;
+    total_bytes_read = mem_size;
+    eof_flag = true;
+    mem_flag = true;
+    return;
+  }
 
   do
   {
@@ -162,11 +173,6 @@ void jpeg_decoder::prep_in_buffer(void)
   total_bytes_read += in_buf_left;
 
   word_clear(Pin_buf_ofs + in_buf_left, 0xD9FF, 64);
-
-#ifdef SUPPORT_MMX
-  if (was_mmx_active)
-    get_bits_2_mmx_init();
-#endif
 }
 //------------------------------------------------------------------------------
 // Read a Huffman code table.
@@ -253,8 +259,10 @@ void jpeg_decoder::read_dqt_marker(void)
     if (n >= JPGD_MAXQUANTTABLES)
       terminate(JPGD_BAD_DQT_TABLE);
 
+    // The MMX IDCT's AAN scaled copy follows the table, the reduced size
+    // IDCTs of a scaled decode take the plain one
     if (!quant[n])
-      quant[n] = (QUANT_TYPE *)alloc(64 * sizeof(QUANT_TYPE));
+      quant[n] = (QUANT_TYPE *)alloc(((use_mmx_idct) ? 128 : 64) * sizeof(QUANT_TYPE));
 
     // read quantization entries, in zag order
     for (i = 0; i < 64; i++)
@@ -264,10 +272,13 @@ void jpeg_decoder::read_dqt_marker(void)
       if (prec)
         temp = (temp << 8) + get_bits_1(8);
 
-      if (use_mmx_idct)
-        quant[n][ZAG[i]] = (temp * aan_scales[ZAG[i]] + (1 << (AAN_SCALE_BITS - IFAST_SCALE_BITS - 1))) >> (AAN_SCALE_BITS - IFAST_SCALE_BITS);
+      if (idct_dequant)
+        quant[n][ZAG[i]] = temp;
       else
         quant[n][i] = temp;
+
+      if (use_mmx_idct)
+        quant[n][64 + ZAG[i]] = (temp * aan_scales[ZAG[i]] + (1 << (AAN_SCALE_BITS - IFAST_SCALE_BITS - 1))) >> (AAN_SCALE_BITS - IFAST_SCALE_BITS);
     }
 
     i = 64 + 1;
@@ -547,7 +558,7 @@ void jpeg_decoder::locate_soi_marker(void)
   /* Check the next character after marker: if it's not 0xFF, it can't
      be the start of the next marker, so it probably isn't a JPEG */
 
-  thischar = (bit_buf >> 8) & 0xFF;
+  thischar = (uint)(bit_buf >> 56);
 
   if (thischar != 0xFF)
     terminate(JPGD_NOT_JPEG);
@@ -622,6 +633,21 @@ void jpeg_decoder::init(Pjpeg_decoder_stream Pstream, bool use_mmx)
   use_mmx_idct = false;
 #endif
 
+  // The SSE2/AVX2 IDCT is exact, it's preferred over the MMX one
+  Pidct = idct_select();
+
+  if (Pidct)
+    use_mmx_idct = false;
+
+  idct_dequant = (use_mmx_idct) || (Pidct != NULL);
+
+  use_sse2_convert = ycc_sse2_avail();
+
+  scale_shift = 0;
+
+  scans_pending = false;
+  dc_comps = 0;
+
   progressive_flag = FALSE;
 
   memset(huff_num, 0, sizeof(huff_num));
@@ -681,6 +707,7 @@ void jpeg_decoder::init(Pjpeg_decoder_stream Pstream, bool use_mmx)
   Pin_buf_ofs = in_buf;
   in_buf_left = 0;
   eof_flag = false;
+  mem_flag = false;
   tem_flag = 0;
 
   memset(padd_1, 0, sizeof(padd_1));
@@ -701,25 +728,20 @@ void jpeg_decoder::init(Pjpeg_decoder_stream Pstream, bool use_mmx)
   memset(ac_huff_seg, 0, sizeof(ac_huff_seg));
   memset(block_seg, 0, sizeof(block_seg));
   Psample_buf = NULL;
+  Pblock_quant = NULL;
 
   total_bytes_read = 0;
 
+  scan_data_ofs = 0;
+
   // Tell the stream we're going to use it.
   Pstream->attach();
 
-  use_mmx_getbits = false;
-  mmx_active = false;
-
   // Ready the input buffer.
   prep_in_buffer();
 
   // Prime the bit buffer.
-  bits_left = 16;
-  bit_buf_64[0] = 0;
-  bit_buf_64[1] = 0;
-
-  get_bits_1(16);
-  get_bits_1(16);
+  prime_bit_buf(false);
 
   for (int i = 0; i < JPGD_MAXBLOCKSPERROW; i++)
     block_max_zag_set[i] = 64;
@@ -753,40 +775,56 @@ void jpeg_decoder::fix_in_buffer(void)
 {
   /* In case any 0xFF's where pulled into the buffer during marker scanning */
 
-  if (bits_left == 16)
-    stuff_char( (uchar)((bit_buf >> 16) & 0xFF));
+  assert((bits_left & 7) == 0);
 
-  if (bits_left >= 8)
-    stuff_char( (uchar)((bit_buf >> 24) & 0xFF));
+  // The next byte is in the top of bit_buf, put them back last one first
+  for (int i = (bits_left >> 3) - 1; i >= 0; i--)
+    stuff_char( (uchar)(bit_buf >> (56 - i * 8)) );
 
-  stuff_char( (uchar)(bit_buf & 0xFF) );
+  // Where decode_image() starts looking for restart markers
+  scan_data_ofs = total_bytes_read - in_buf_left;
 
-  stuff_char( (uchar)((bit_buf >> 8) & 0xFF) );
+  prime_bit_buf(true);
+}
+//------------------------------------------------------------------------------
+// Empties the bit buffer and fills it again. Entropy coded data is read with
+// markers stopping it (get_bits_2()), marker segments as plain bytes
+// (get_bits_1()).
+void jpeg_decoder::prime_bit_buf(bool entropy_coded)
+{
+  bit_buf = 0;
+  bits_left = 0;
 
-#ifdef SUPPORT_MMX
-  if (use_mmx_getbits)
-  {
-    bits_left = 48;
-    get_bits_2_mmx_init();
-    get_bits_2_mmx(16);
-    get_bits_2_mmx(16);
-    get_bits_2_mmx(16);
-    get_bits_2_mmx(16);
-    get_bits_2_mmx_deinit();
-  }
+  if (entropy_coded)
+    fill_bit_buf();
   else
-#endif
-  {
-    bits_left = 16;
-    //bit_buf = 0;
-    get_bits_2(16);
-    get_bits_2(16);
-  }
+    get_bits_1(0);
 }
 //------------------------------------------------------------------------------
 // Performs a 2D IDCT over the entire row's coefficient buffer.
 void jpeg_decoder::transform_row(void)
 {
+  if (scale_shift)
+  {
+    QUANT_TYPE * *Pquant_ptr = NULL;
+
+    // Unless the blocks were dequantized while decoding, as for idct()
+    if (idct_dequant)
+    {
+      Pquant_ptr = Pblock_quant;
+
+      for (int mcu_row = 0; mcu_row < mcus_per_row; mcu_row++)
+        for (int mcu_block = 0; mcu_block < blocks_per_mcu; mcu_block++)
+          *Pquant_ptr++ = quant[comp_quant[mcu_org[mcu_block]]];
+
+      Pquant_ptr = Pblock_quant;
+    }
+
+    idct_reduced(block_seg[0], Pquant_ptr, mcus_per_row * blocks_per_mcu, Psample_buf, scale_shift);
+
+    return;
+  }
+
 #ifdef SUPPORT_MMX
   if (use_mmx_idct)
   {
@@ -798,7 +836,7 @@ void jpeg_decoder::transform_row(void)
       for (int mcu_block = 0; mcu_block < blocks_per_mcu; mcu_block++)
       {
         int component_id = mcu_org[mcu_block];
-        QUANT_TYPE *Pquant_ptr = quant[comp_quant[component_id]];
+        QUANT_TYPE *Pquant_ptr = quant[comp_quant[component_id]] + 64;
 
         uchar * outptr[8];
         outptr[0] = Pdst_ptr;
@@ -825,6 +863,18 @@ void jpeg_decoder::transform_row(void)
   }
   else
 #endif
+  if (Pidct)
+  {
+    QUANT_TYPE * *Pquant_ptr = Pblock_quant;
+
+    for (int mcu_row = 0; mcu_row < mcus_per_row; mcu_row++)
+      for (int mcu_block = 0; mcu_block < blocks_per_mcu; mcu_block++)
+        *Pquant_ptr++ = quant[comp_quant[mcu_org[mcu_block]]];
+
+    // The source blocks are left untouched, no copy is needed
+    Pidct(block_seg[0], Pblock_quant, mcus_per_row * blocks_per_mcu, Psample_buf);
+  }
+  else
   {
     BLOCK_TYPE *Psrc_ptr = block_seg[0];
     uchar *Pdst_ptr = Psample_buf;
@@ -943,7 +993,7 @@ void jpeg_decoder::load_next_row(void)
       p[0] = pDC[0];
       memcpy(&p[1], &pAC[1], 63 * sizeof(BLOCK_TYPE));
 
-      if (!use_mmx_idct)
+      if (!idct_dequant)
       {
         for (i = 63; i > 0; i--)
           if (p[ZAG[i]])
@@ -1029,24 +1079,7 @@ void jpeg_decoder::process_restart(void)
   next_restart_num = (next_restart_num + 1) & 7;
 
   // Get the bit buffer going again...
-
-#ifdef SUPPORT_MMX
-  if (use_mmx_getbits)
-  {
-    bits_left = 48;
-    get_bits_2_mmx(16);
-    get_bits_2_mmx(16);
-    get_bits_2_mmx(16);
-    get_bits_2_mmx(16);
-  }
-  else
-#endif
-  {
-    bits_left = 16;
-    //bit_buf = 0;
-    get_bits_2(16);
-    get_bits_2(16);
-  }
+  prime_bit_buf(true);
 }
 //------------------------------------------------------------------------------
 // Decodes and dequantizes the next row of coefficients.
@@ -1071,17 +1104,13 @@ void jpeg_decoder::decode_next_row(void)
 
       BLOCK_TYPE *p = block_seg[row_block];
       QUANT_TYPE *q = quant[comp_quant[component_id]];
-      int r, s, k;
+      int r, s, k, extra;
 
-      if ((s = huff_decode(h[comp_dc_tab[component_id]])) != 0)
-      {
-        r = get_bits_2(s);
-        s = HUFF_EXTEND(r, s);
-      }
+      huff_decode(h[comp_dc_tab[component_id]], &s);
 
       last_dc_val[component_id] = (s += last_dc_val[component_id]);
 
-      if (use_mmx_idct)
+      if (idct_dequant)
         p[0] = s;
       else
         p[0] = s * q[0];
@@ -1092,7 +1121,7 @@ void jpeg_decoder::decode_next_row(void)
 
       for (k = 1; k < 64; k++)
       {
-        s = huff_decode(Ph);
+        s = huff_decode(Ph, &extra);
 
         r = s >> 4;
         s &= 15;
@@ -1115,15 +1144,12 @@ void jpeg_decoder::decode_next_row(void)
             k += r;
           }
 
-          r = get_bits_2(s);
-          s = HUFF_EXTEND(r, s);
-
           //assert(k < 64);
 
-          if (use_mmx_idct)
-            p[ZAG[k]] = s;
+          if (idct_dequant)
+            p[ZAG[k]] = extra;
           else
-            p[ZAG[k]] = s * q[k];
+            p[ZAG[k]] = extra * q[k];
         }
         else
         {
@@ -1169,264 +1195,257 @@ void jpeg_decoder::decode_next_row(void)
   }
 }
 //------------------------------------------------------------------------------
-#ifdef SUPPORT_MMX
-void jpeg_decoder::decode_next_row_mmx(void)
+//------------------------------------------------------------------------------
+// Converts num_mcus MCUs of one output row. Py is the first MCU's luma row, when
+// h2 is set a second luma block follows 64 bytes later. Pc is its Cb row, with
+// Cr 64 bytes later, or NULL for greyscale. Colour goes out as RGB (dst_bpp 3) or
+// RGBA (4), greyscale as Y (1) or replicated into RGB/RGBA.
+void jpeg_decoder::convert_mcus(
+  const uchar *Py, const uchar *Pc, int stride, bool h2,
+  int num_mcus, uchar *Pdst, int dst_bpp)
 {
-  int row_block = 0;
-
-  // Clearing the entire row block buffer can take a lot of time!
-  // Instead of clearing the entire buffer each row, keep track
-  // of the number of nonzero entries written to each block and do
-  // selective clears.
-  //memset(block_seg[0], 0, mcus_per_row * blocks_per_mcu * 64 * sizeof(BLOCK_TYPE));
-
-  get_bits_2_mmx_init();
-
-  for (int mcu_row = 0; mcu_row < mcus_per_row; mcu_row++)
+  if (!Pc)
   {
-    if ((restart_interval) && (restarts_left == 0))
-      process_restart();
-
-    for (int mcu_block = 0; mcu_block < blocks_per_mcu; mcu_block++)
+    for (int i = num_mcus; i > 0; i--)
     {
-      int component_id = mcu_org[mcu_block];
-
-      BLOCK_TYPE *p = block_seg[row_block];
-      QUANT_TYPE *q = quant[comp_quant[component_id]];
-      int r, s, k;
-
-      if ((s = huff_decode_mmx(h[comp_dc_tab[component_id]])) != 0)
+      if (dst_bpp == 1)
+        memcpy(Pdst, Py, 8);
+      else
       {
-        r = get_bits_2_mmx(s);
-        s = HUFF_EXTEND(r, s);
+        for (int j = 0; j < 8; j++)
+        {
+          Pdst[j * dst_bpp + 0] = Py[j];
+          Pdst[j * dst_bpp + 1] = Py[j];
+          Pdst[j * dst_bpp + 2] = Py[j];
+
+          if (dst_bpp == 4)
+            Pdst[j * 4 + 3] = 255;
+        }
       }
 
-      last_dc_val[component_id] = (s += last_dc_val[component_id]);
+      Pdst += 8 * dst_bpp;
+      Py += stride;
+    }
 
-      if (use_mmx_idct)
-        p[0] = s;
-      else
-        p[0] = s * q[0];
+    return;
+  }
 
-      int prev_num_set = block_max_zag_set[row_block];
+  for (int i = num_mcus; i > 0; i--)
+  {
+    for (int j = 0; j < 8; j++)
+    {
+      int cb = Pc[j];
+      int cr = Pc[64+j];
 
-      Phuff_tables_t Ph = h[comp_ac_tab[component_id]];
+      int rc = crr[cr];
+      int gc = ((crg[cr] + cbg[cb]) >> 16);
+      int bc = cbb[cb];
 
-      for (k = 1; k < 64; k++)
+      if (h2)
       {
-        s = huff_decode_mmx(Ph);
-
-        r = s >> 4;
-        s &= 15;
-
-        if (s)
+        // Pixels 2j and 2j+1, the right half of the row is the next block
+        const uchar *Ps = Py + (j >> 2) * 64 + (j & 3) * 2;
+        int y0 = Ps[0];
+        int y1 = Ps[1];
+
+        Pdst[0] = clamp(y0+rc);
+        Pdst[1] = clamp(y0+gc);
+        Pdst[2] = clamp(y0+bc);
+        Pdst[dst_bpp+0] = clamp(y1+rc);
+        Pdst[dst_bpp+1] = clamp(y1+gc);
+        Pdst[dst_bpp+2] = clamp(y1+bc);
+
+        if (dst_bpp == 4)
         {
-          if (r)
-          {
-            if ((k + r) > 63)
-              terminate(JPGD_DECODE_ERROR);
-
-            if (k < prev_num_set)
-            {
-              int n = min(r, prev_num_set - k);
-              int kt = k;
-              while (n--)
-                p[ZAG[kt++]] = 0;
-            }
-
-            k += r;
-          }
-
-          r = get_bits_2_mmx(s);
-          s = HUFF_EXTEND(r, s);
-
-          assert(k < 64);
-
-          if (use_mmx_idct)
-            p[ZAG[k]] = s;
-          else
-            p[ZAG[k]] = s * q[k];
+          Pdst[3] = 255;
+          Pdst[7] = 255;
         }
-        else
-        {
-          if (r == 15)
-          {
-            if ((k + 15) > 63)
-              terminate(JPGD_DECODE_ERROR);
-
-            if (k < prev_num_set)
-            {
-              int n = min(16, prev_num_set - k);		//bugfix Dec. 19, 2001 - was 15!
-              int kt = k;
-              while (n--)
-                p[ZAG[kt++]] = 0;
-            }
 
-            k += 15;
-          }
-          else
-            break;
-        }
+        Pdst += 2 * dst_bpp;
       }
-
-      if (k < prev_num_set)
+      else
       {
-        int kt = k;
-        while (kt < prev_num_set)
-          p[ZAG[kt++]] = 0;
-      }
+        int yy = Py[j];
 
-      block_max_zag_set[row_block] = k;
+        Pdst[0] = clamp(yy+rc);
+        Pdst[1] = clamp(yy+gc);
+        Pdst[2] = clamp(yy+bc);
 
-      //block_num[row_block++] = k;
-      row_block++;
+        if (dst_bpp == 4)
+          Pdst[3] = 255;
+
+        Pdst += dst_bpp;
+      }
     }
 
-    restarts_left--;
+    Py += stride;
+    Pc += stride;
   }
-
-  get_bits_2_mmx_deinit();
 }
-#endif
 //------------------------------------------------------------------------------
-// YCbCr H1V1 (1x1:1:1, 3 blocks per MCU) to 24-bit RGB
-void jpeg_decoder::H1V1Convert(void)
+// Upsamples and converts the current output row into Pdst, image_x_size pixels
+// of dst_bpp bytes. Chroma is replicated, each V2 chroma row serves two output
+// rows. The last MCU goes through a temporary if it sticks out past the row.
+void jpeg_decoder::convert_row(uchar *Pdst, int dst_bpp)
 {
   int row = max_mcu_y_size - mcu_lines_left;
-  uchar *d = scan_line_0;
-  uchar *s = Psample_buf + row * 8;
+  uchar *Py;
+  uchar *Pc = NULL;
+  int stride;
+  bool h2 = false;
 
-  for (int i = max_mcus_per_row; i > 0; i--)
+  switch (scan_type)
   {
-    for (int j = 0; j < 8; j++)
+    case JPGD_YH2V2:
     {
-      int y = s[j];
-      int cb = s[64+j];
-      int cr = s[128+j];
-
-      d[0] = clamp(y + crr[cr]);
-      d[1] = clamp(y + ((crg[cr] + cbg[cb]) >> 16));
-      d[2] = clamp(y + cbb[cb]);
-      d += 4;
+      Py = Psample_buf + ((row < 8) ? row * 8 : 64*2 + (row & 7) * 8);
+      Pc = Psample_buf + 64*4 + (row >> 1) * 8;
+      stride = 64*6;
+      h2 = true;
+      break;
+    }
+    case JPGD_YH2V1:
+    {
+      Py = Psample_buf + row * 8;
+      Pc = Psample_buf + 64*2 + row * 8;
+      stride = 64*4;
+      h2 = true;
+      break;
+    }
+    case JPGD_YH1V2:
+    {
+      Py = Psample_buf + ((row < 8) ? row * 8 : 64*1 + (row & 7) * 8);
+      Pc = Psample_buf + 64*2 + (row >> 1) * 8;
+      stride = 64*4;
+      break;
+    }
+    case JPGD_YH1V1:
+    {
+      Py = Psample_buf + row * 8;
+      Pc = Py + 64;
+      stride = 64*3;
+      break;
+    }
+    default:
+    {
+      Py = Psample_buf + row * 8;
+      stride = 64;
+      break;
     }
-
-    s += 64*3;
   }
-}
-//------------------------------------------------------------------------------
-// YCbCr H2V1 (2x1:1:1, 4 blocks per MCU) to 24-bit RGB
-void jpeg_decoder::H2V1Convert(void)
-{
-  int row = max_mcu_y_size - mcu_lines_left;
-  uchar *d0 = scan_line_0;
-  uchar *y = Psample_buf + row * 8;
-  uchar *c = Psample_buf + 2*64 + row * 8;
 
-  for (int i = max_mcus_per_row; i > 0; i--)
-  {
-    for (int l = 0; l < 2; l++)
-    {
-      for (int j = 0; j < 4; j++)
-      {
-        int cb = c[0];
-        int cr = c[64];
+  int num_mcus = image_x_size / max_mcu_x_size;
+  int partial = image_x_size - num_mcus * max_mcu_x_size;
 
-        int rc = crr[cr];
-        int gc = ((crg[cr] + cbg[cb]) >> 16);
-        int bc = cbb[cb];
+  if (use_sse2_convert)
+    ycc_convert_sse2(Py, Pc, stride, h2, num_mcus, Pdst, dst_bpp);
+  else
+    convert_mcus(Py, Pc, stride, h2, num_mcus, Pdst, dst_bpp);
 
-        int yy = y[j<<1];
-        d0[0] = clamp(yy+rc);
-        d0[1] = clamp(yy+gc);
-        d0[2] = clamp(yy+bc);
+  if (partial)
+  {
+    uchar temp[16*4];
 
-        yy = y[(j<<1)+1];
-        d0[4] = clamp(yy+rc);
-        d0[5] = clamp(yy+gc);
-        d0[6] = clamp(yy+bc);
+    Py += num_mcus * stride;
 
-        d0 += 8;
+    if (Pc)
+      Pc += num_mcus * stride;
 
-        c++;
-      }
-      y += 64;
-    }
+    if (use_sse2_convert)
+      ycc_convert_sse2(Py, Pc, stride, h2, 1, temp, dst_bpp);
+    else
+      convert_mcus(Py, Pc, stride, h2, 1, temp, dst_bpp);
 
-    y += 64*4 - 64*2;
-    c += 64*4 - 8;
+    memcpy(Pdst + num_mcus * max_mcu_x_size * dst_bpp, temp, partial * dst_bpp);
   }
 }
 //------------------------------------------------------------------------------
-// YCbCr H2V1 (1x2:1:1, 4 blocks per MCU) to 24-bit RGB
-void jpeg_decoder::H1V2Convert(void)
+// convert_row() for scaled decodes. Each block holds size x size samples at its
+// top left, 8 bytes per row. Scaled images are small, this goes pixel by pixel.
+void jpeg_decoder::convert_row_scaled(uchar *Pdst, int dst_bpp)
 {
-  int row = max_mcu_y_size - mcu_lines_left;
-  uchar *d0 = scan_line_0;
-  uchar *d1 = scan_line_1;
-  uchar *y;
-  uchar *c;
+  int size = 8 >> scale_shift;
+  int row = (max_mcu_y_size >> scale_shift) - mcu_lines_left;
+  int mcu_x_size = max_mcu_x_size >> scale_shift;
+  int width = get_scaled_width();
+  const uchar *Py;
+  const uchar *Pc = NULL;
+  int stride;
+  bool h2 = false;
 
-  if (row < 8)
-    y = Psample_buf + row * 8;
-  else
-    y = Psample_buf + 64*1 + (row & 7) * 8;
-
-  c = Psample_buf + 64*2 + (row >> 1) * 8;
-
-  for (int i = max_mcus_per_row; i > 0; i--)
+  switch (scan_type)
   {
-    for (int j = 0; j < 8; j++)
+    case JPGD_YH2V2:
     {
-      int cb = c[0+j];
-      int cr = c[64+j];
-
-      int rc = crr[cr];
-      int gc = ((crg[cr] + cbg[cb]) >> 16);
-      int bc = cbb[cb];
+      Py = Psample_buf + ((row < size) ? row * 8 : 64*2 + (row - size) * 8);
+      Pc = Psample_buf + 64*4 + (row >> 1) * 8;
+      stride = 64*6;
+      h2 = true;
+      break;
+    }
+    case JPGD_YH2V1:
+    {
+      Py = Psample_buf + row * 8;
+      Pc = Psample_buf + 64*2 + row * 8;
+      stride = 64*4;
+      h2 = true;
+      break;
+    }
+    case JPGD_YH1V2:
+    {
+      Py = Psample_buf + ((row < size) ? row * 8 : 64*1 + (row - size) * 8);
+      Pc = Psample_buf + 64*2 + (row >> 1) * 8;
+      stride = 64*4;
+      break;
+    }
+    case JPGD_YH1V1:
+    {
+      Py = Psample_buf + row * 8;
+      Pc = Py + 64;
+      stride = 64*3;
+      break;
+    }
+    default:
+    {
+      Py = Psample_buf + row * 8;
+      stride = 64;
+      break;
+    }
+  }
 
-      int yy = y[j];
-      d0[0] = clamp(yy+rc);
-      d0[1] = clamp(yy+gc);
-      d0[2] = clamp(yy+bc);
+  for (int x = 0, mcu_ofs = 0; x < width; mcu_ofs += stride)
+  {
+    for (int i = 0; (i < mcu_x_size) && (x < width); i++, x++)
+    {
+      // The right half of an H2 MCU is the next luma block
+      int yy = (i < size) ? Py[mcu_ofs + i] : Py[mcu_ofs + 64 + i - size];
 
-      yy = y[8+j];
-      d1[0] = clamp(yy+rc);
-      d1[1] = clamp(yy+gc);
-      d1[2] = clamp(yy+bc);
+      if (!Pc)
+      {
+        Pdst[0] = (uchar)yy;
 
-      d0 += 4;
-      d1 += 4;
-    }
+        if (dst_bpp > 1)
+        {
+          Pdst[1] = (uchar)yy;
+          Pdst[2] = (uchar)yy;
+        }
+      }
+      else
+      {
+        int j = mcu_ofs + ((h2) ? (i >> 1) : i);
+        int cb = Pc[j];
+        int cr = Pc[64+j];
 
-    y += 64*4;
-    c += 64*4;
-  }
-}
-//------------------------------------------------------------------------------
-// Y (1 block per MCU) to 8-bit greyscale
-void jpeg_decoder::GrayConvert(void)
-{
-  int row = max_mcu_y_size - mcu_lines_left;
-  uchar *d = scan_line_0;
-  uchar *s = Psample_buf + row * 8;
+        Pdst[0] = clamp(yy + crr[cr]);
+        Pdst[1] = clamp(yy + ((crg[cr] + cbg[cb]) >> 16));
+        Pdst[2] = clamp(yy + cbb[cb]);
+      }
 
-  for (int i = max_mcus_per_row; i > 0; i--)
-  {
-#if 0
-    d[0] = s[0];
-    d[1] = s[1];
-    d[2] = s[2];
-    d[3] = s[3];
-    d[4] = s[4];
-    d[5] = s[5];
-    d[6] = s[6];
-    d[7] = s[7];
-#endif
-    *(uint *)d = *(uint *)s;
-    *(uint *)(&d[4]) = *(uint *)(&s[4]);
+      if (dst_bpp == 4)
+        Pdst[3] = 255;
 
-    s += 64;
-    d += 8;
+      Pdst += dst_bpp;
+    }
   }
 }
 //------------------------------------------------------------------------------
@@ -1440,10 +1459,7 @@ void jpeg_decoder::find_eoi(void)
     //get_bits_2(bits_left & 7);
 
     // Prime the bit buffer
-    bits_left = 16;
-    //bit_buf = 0;
-    get_bits_1(16);
-    get_bits_1(16);
+    prime_bit_buf(false);
 
     // The next marker _should_ be EOI
     process_markers();
@@ -1459,7 +1475,34 @@ void jpeg_decoder::find_eoi(void)
 int jpeg_decoder::decode(
   void * *Pscan_line_ofs, uint *Pscan_line_len)
 {
-  if ((error_code) || (!ready_flag))
+  int status = decode_scan_line(scan_line_0, dest_bytes_per_pixel);
+
+  if (status != JPGD_OKAY)
+    return (status);
+
+  *Pscan_line_ofs = scan_line_0;
+  *Pscan_line_len = real_dest_bytes_per_scan_line;
+
+  return (JPGD_OKAY);
+}
+//------------------------------------------------------------------------------
+// True if scan lines can be converted to dst_bpp bytes per pixel.
+bool jpeg_decoder::check_dst_bpp(int dst_bpp)
+{
+  if (scan_type == JPGD_GRAYSCALE)
+    return ((dst_bpp == 1) || (dst_bpp == 3) || (dst_bpp == 4));
+
+  return ((dst_bpp == 3) || (dst_bpp == 4));
+}
+//------------------------------------------------------------------------------
+// Decodes the next scan line into the caller's buffer.
+// Returns the same codes as decode().
+int jpeg_decoder::decode_scan_line(void *Pdst, int dst_bpp)
+{
+  if ((error_code) || (!ready_flag) || (scans_pending))
+    return (JPGD_FAILED);
+
+  if (!check_dst_bpp(dst_bpp))
     return (JPGD_FAILED);
 
   if (total_lines_left == 0)
@@ -1473,72 +1516,21 @@ int jpeg_decoder::decode(
     if (progressive_flag)
       load_next_row();
     else
-    {
-#ifdef SUPPORT_MMX
-      if (use_mmx_getbits)
-        decode_next_row_mmx();
-      else
-#endif
-        decode_next_row();
-    }
+      decode_next_row();
 
     // Find the EOI marker if that was the last row.
-    if (total_lines_left <= max_mcu_y_size)
+    if (total_lines_left <= (max_mcu_y_size >> scale_shift))
       find_eoi();
 
     transform_row();
 
-    mcu_lines_left = max_mcu_y_size;
+    mcu_lines_left = max_mcu_y_size >> scale_shift;
   }
 
-  switch (scan_type)
-  {
-    case JPGD_YH2V2:
-    {
-      if ((mcu_lines_left & 1) == 0)
-      {
-        H2V2Convert();
-        *Pscan_line_ofs = scan_line_0;
-      }
-      else
-        *Pscan_line_ofs = scan_line_1;
-
-      break;
-    }
-    case JPGD_YH2V1:
-    {
-      H2V1Convert();
-      *Pscan_line_ofs = scan_line_0;
-      break;
-    }
-    case JPGD_YH1V2:
-    {
-      if ((mcu_lines_left & 1) == 0)
-      {
-        H1V2Convert();
-        *Pscan_line_ofs = scan_line_0;
-      }
-      else
-        *Pscan_line_ofs = scan_line_1;
-
-      break;
-    }
-    case JPGD_YH1V1:
-    {
-      H1V1Convert();
-      *Pscan_line_ofs = scan_line_0;
-      break;
-    }
-    case JPGD_GRAYSCALE:
-    {
-      GrayConvert();
-      *Pscan_line_ofs = scan_line_0;
-
-      break;
-    }
-  }
-
-  *Pscan_line_len = real_dest_bytes_per_scan_line;
+  if (scale_shift)
+    convert_row_scaled((uchar *)Pdst, dst_bpp);
+  else
+    convert_row((uchar *)Pdst, dst_bpp);
 
   mcu_lines_left--;
   total_lines_left--;
@@ -1555,11 +1547,8 @@ void jpeg_decoder::make_huff_table(
   uchar huffsize[257];
   uint huffcode[257];
   uint code;
-  uint subtree;
   int code_size;
   int lastp;
-  int nextfreeentry;
-  int currententry;
 
   p = 0;
 
@@ -1590,73 +1579,80 @@ void jpeg_decoder::make_huff_table(
   }
 
   memset(hs->look_up, 0, sizeof(hs->look_up));
-  memset(hs->tree, 0, sizeof(hs->tree));
-  memset(hs->code_size, 0, sizeof(hs->code_size));
-
-  nextfreeentry = -1;
-
-  p = 0;
+  memcpy(hs->val, huff_val[index], sizeof(hs->val));
 
-  while (p < lastp)
+  // Codes up to JPGD_HUFF_LOOKAHEAD bits long fill all the table entries
+  // they prefix. Where the code and its extra bits fit, the entries also
+  // carry the sign extended value of the bits that follow the code.
+  for (p = 0; p < lastp; p++)
   {
-    i = huff_val[index][p];
-    code = huffcode[p];
     code_size = huffsize[p];
+    code = huffcode[p];
 
-    hs->code_size[i] = code_size;
+    // Sizes only grow, and an oversubscribed table can't be decoded anyway
+    if ((code_size > JPGD_HUFF_LOOKAHEAD) || (code >= (1U << code_size)))
+      break;
 
-    if (code_size <= 8)
-    {
-      code <<= (8 - code_size);
+    int symbol = huff_val[index][p];
+    int extra_bits = symbol & 15;
+    int fill_bits = JPGD_HUFF_LOOKAHEAD - code_size;
 
-      for (l = 1 << (8 - code_size); l > 0; l--)
-      {
-        hs->look_up[code] = i;
-        code++;
-      }
-    }
-    else
+    for (l = 0; l < (1 << fill_bits); l++)
     {
-      subtree = (code >> (code_size - 8)) & 0xFF;
-
-      currententry = hs->look_up[subtree];
+      int entry = symbol | (code_size << 8);
 
-      if (currententry == 0)
+      if (extra_bits <= fill_bits)
       {
-        hs->look_up[subtree] = currententry = nextfreeentry;
+        int extra = (l >> (fill_bits - extra_bits)) & ((1 << extra_bits) - 1);
 
-        nextfreeentry -= 2;
-      }
-
-      code <<= (16 - (code_size - 8));
-
-      for (l = code_size; l > 9; l--)
-      {
-        if ((code & 0x8000) == 0)
-          currententry--;
+        extra = HUFF_EXTEND_TBL(extra, extra_bits);
 
-        if (hs->tree[-currententry - 1] == 0)
-        {
-          hs->tree[-currententry - 1] = nextfreeentry;
+        entry |= ((code_size + extra_bits) << 12) | (int)((uint)extra << 16);
+      }
 
-          currententry = nextfreeentry;
+      hs->look_up[(code << fill_bits) + l] = entry;
+    }
+  }
 
-          nextfreeentry -= 2;
-        }
-        else
-          currententry = hs->tree[-currententry - 1];
+  // Longer codes are decoded canonically, see huff_decode_slow()
+  p = 0;
 
-        code <<= 1;
-      }
+  for (l = 1; l <= 16; l++)
+  {
+    if (huff_num[index][l])
+    {
+      hs->valoffset[l] = p - (int)huffcode[p];
+      p += huff_num[index][l];
+      hs->maxcode[l] = huffcode[p - 1];
+    }
+    else
+      hs->maxcode[l] = -1;
+  }
+}
+//------------------------------------------------------------------------------
+// Decodes a code longer than JPGD_HUFF_LOOKAHEAD bits by growing it one bit
+// at a time until it is no larger than the largest code of that length.
+// Anything that is still no code by 16 bits is corrupt data, it decodes as
+// symbol 0.
+int jpeg_decoder::huff_decode_slow(Phuff_tables_t Ph)
+{
+  for (int l = JPGD_HUFF_LOOKAHEAD + 1; l <= 16; l++)
+  {
+    int code = (int)(bit_buf >> (64 - l));
 
-      if ((code & 0x8000) == 0)
-        currententry--;
+    if (code <= Ph->maxcode[l])
+    {
+      bit_buf <<= l;
+      bits_left -= l;
 
-      hs->tree[-currententry - 1] = i;
+      return (Ph->val[(code + Ph->valoffset[l]) & 0xFF]);
     }
-
-    p++;
   }
+
+  bit_buf <<= 16;
+  bits_left -= 16;
+
+  return (0);
 }
 //------------------------------------------------------------------------------
 // Verifies the quantization tables needed for this scan are available.
@@ -1779,9 +1775,6 @@ int jpeg_decoder::init_scan(void)
     next_restart_num = 0;
   }
 
-  if ((!progressive_flag) && (use_mmx))
-    use_mmx_getbits = true;
-
   fix_in_buffer();
 
   return TRUE;
@@ -1863,16 +1856,12 @@ void jpeg_decoder::init_frame(void)
 
   dest_bytes_per_scan_line = ((image_x_size + 15) & 0xFFF0) * dest_bytes_per_pixel;
 
-  real_dest_bytes_per_scan_line = (image_x_size * dest_bytes_per_pixel);
+  real_dest_bytes_per_scan_line = (get_scaled_width() * dest_bytes_per_pixel);
 
-  // Initialize two scan line buffers.
-  // FIXME: Only the V2 sampling factors need two buffers.
+  // Scan line buffer for decode(), decode_scan_line() writes to the caller's
   scan_line_0         = (uchar *)alloc(dest_bytes_per_scan_line + 8);
   memset(scan_line_0, 0, dest_bytes_per_scan_line);
 
-  scan_line_1         = (uchar *)alloc(dest_bytes_per_scan_line + 8);
-  memset(scan_line_1, 0, dest_bytes_per_scan_line);
-
   max_blocks_per_row = max_mcus_per_row * max_blocks_per_mcu;
 
   // Should never happen
@@ -1883,7 +1872,7 @@ void jpeg_decoder::init_frame(void)
   q = (uchar *)alloc(max_blocks_per_row * 64 * sizeof(BLOCK_TYPE) + 8);
 
   // Align to 8-byte boundry, for MMX code
-  q = (uchar *)(((uint)q + 7) & ~7);
+  q = (uchar *)(((size_t)q + 7) & ~(size_t)7);
 
   // The block_seg[] array's name dates back to the
   // 16-bit assembler implementation. "seg" stood for "segment".
@@ -1893,9 +1882,11 @@ void jpeg_decoder::init_frame(void)
   for (i = 0; i < max_blocks_per_row; i++)
     block_max_zag_set[i] = 64;
 
-  Psample_buf = (uchar *)(((uint)alloc(max_blocks_per_row * 64 + 8) + 7) & ~7);
+  Psample_buf = (uchar *)(((size_t)alloc(max_blocks_per_row * 64 + 8) + 7) & ~(size_t)7);
+
+  Pblock_quant = (QUANT_TYPE * *)alloc(max_blocks_per_row * sizeof(QUANT_TYPE *));
 
-  total_lines_left = image_y_size;
+  total_lines_left = get_scaled_height();
 
   mcu_lines_left = 0;
 
@@ -2171,59 +2162,80 @@ void jpeg_decoder::init_progressive(void)
                                   max_mcus_per_col * comp_v_samp[i], 8, 8);
   }
 
-  for ( ; ; )
-  {
-    int dc_only_scan, refinement_scan;
-    Pdecode_block_func decode_block_func;
+  // begin_scans() leaves the scans to decode_next_scan()
+  if (scans_pending)
+    return;
 
-    if (!init_scan())
-      break;
+  while (decode_progressive_scan())
+    ;
 
-    dc_only_scan    = (spectral_start == 0);
-    refinement_scan = (successive_high != 0);
+  finish_progressive();
+}
+//------------------------------------------------------------------------------
+// Decodes the next scan of a progressive image into the coefficient buffers.
+// Returns false if there are no more.
+bool jpeg_decoder::decode_progressive_scan(void)
+{
+  int dc_only_scan, refinement_scan;
+  Pdecode_block_func decode_block_func;
 
-    if ((spectral_start > spectral_end) || (spectral_end > 63))
-      terminate(JPGD_BAD_SOS_SPECTRAL);
+  if (!init_scan())
+    return (false);
 
-    if (dc_only_scan)
-    {
-      if (spectral_end)
-        terminate(JPGD_BAD_SOS_SPECTRAL);
-    }
-    else if (comps_in_scan != 1)  /* AC scans can only contain one component */
+  dc_only_scan    = (spectral_start == 0);
+  refinement_scan = (successive_high != 0);
+
+  if ((spectral_start > spectral_end) || (spectral_end > 63))
+    terminate(JPGD_BAD_SOS_SPECTRAL);
+
+  if (dc_only_scan)
+  {
+    if (spectral_end)
       terminate(JPGD_BAD_SOS_SPECTRAL);
+  }
+  else if (comps_in_scan != 1)  /* AC scans can only contain one component */
+    terminate(JPGD_BAD_SOS_SPECTRAL);
 
-    if ((refinement_scan) && (successive_low != successive_high - 1))
-      terminate(JPGD_BAD_SOS_SUCCESSIVE);
+  if ((refinement_scan) && (successive_low != successive_high - 1))
+    terminate(JPGD_BAD_SOS_SUCCESSIVE);
 
-    if (dc_only_scan)
-    {
-      if (refinement_scan)
-        decode_block_func = progressive_block_decoder::decode_block_dc_refine;
-      else
-        decode_block_func = progressive_block_decoder::decode_block_dc_first;
-    }
+  if (dc_only_scan)
+  {
+    if (refinement_scan)
+      decode_block_func = progressive_block_decoder::decode_block_dc_refine;
     else
-    {
-      if (refinement_scan)
-        decode_block_func = progressive_block_decoder::decode_block_ac_refine;
-      else
-        decode_block_func = progressive_block_decoder::decode_block_ac_first;
-    }
+      decode_block_func = progressive_block_decoder::decode_block_dc_first;
+  }
+  else
+  {
+    if (refinement_scan)
+      decode_block_func = progressive_block_decoder::decode_block_ac_refine;
+    else
+      decode_block_func = progressive_block_decoder::decode_block_ac_first;
+  }
 
-    decode_scan(decode_block_func);
+  decode_scan(decode_block_func);
 
-    //get_bits_2(bits_left & 7);
+  //get_bits_2(bits_left & 7);
 
-    bits_left = 16;
-    //bit_buf = 0;
-    get_bits_1(16);
-    get_bits_1(16);
+  prime_bit_buf(false);
+
+  if ((dc_only_scan) && (!refinement_scan))
+  {
+    for (int i = 0; i < comps_in_scan; i++)
+      dc_comps |= 1 << comp_list[i];
   }
 
+  return (true);
+}
+//------------------------------------------------------------------------------
+// Back to all of the frame's components in MCU order, as the rows are
+// loaded from the coefficient buffers.
+void jpeg_decoder::finish_progressive(void)
+{
   comps_in_scan = comps_in_frame;
 
-  for (i = 0; i < comps_in_frame; i++)
+  for (int i = 0; i < comps_in_frame; i++)
     comp_list[i] = i;
 
   calc_mcu_block_order();
@@ -2269,6 +2281,16 @@ jpeg_decoder::jpeg_decoder(Pjpeg_decoder_stream Pstream, bool use_mmx)
   decode_init(Pstream, use_mmx);
 }
 //------------------------------------------------------------------------------
+bool jpeg_decoder::set_scale(int shift)
+{
+  if ((ready_flag) || (error_code) || (shift < 0) || (shift > 3))
+    return (false);
+
+  scale_shift = shift;
+
+  return (true);
+}
+//------------------------------------------------------------------------------
 // If you wish to decompress the image, call this method after constructing
 // the object. If JPGD_OKAY is returned you may then call decode() to
 // fetch the scan lines.
@@ -2290,6 +2312,99 @@ int jpeg_decoder::begin(void)
   return (JPGD_OKAY);
 }
 //------------------------------------------------------------------------------
+int jpeg_decoder::begin_scans(void)
+{
+  if ((!ready_flag) && (!error_code))
+    scans_pending = (progressive_flag != 0);
+
+  return (begin());
+}
+//------------------------------------------------------------------------------
+int jpeg_decoder::decode_next_scan(void)
+{
+  if ((error_code) || (!ready_flag))
+    return (JPGD_FAILED);
+
+  if (!scans_pending)
+    return (JPGD_DONE);
+
+  if (setjmp(jmp_state))
+    return (JPGD_DECODE_ERROR);
+
+  if (decode_progressive_scan())
+    return (JPGD_OKAY);
+
+  finish_progressive();
+
+  scans_pending = false;
+
+  return (JPGD_DONE);
+}
+//------------------------------------------------------------------------------
+// Runs the rows through the same load, transform and convert steps as
+// decode_scan_line(), then puts back the state of the scan in progress and of
+// the scan lines already decoded. The coefficient buffers are only read.
+int jpeg_decoder::render_scans(void *Pdst, int dst_pitch, int dst_bpp, int shift)
+{
+  if ((error_code) || (!ready_flag) || (!progressive_flag) || (mcu_lines_left))
+    return (JPGD_FAILED);
+
+  if ((shift < 0) || (shift > 3) || (!check_dst_bpp(dst_bpp)))
+    return (JPGD_FAILED);
+
+  int save_comps_in_scan = comps_in_scan;
+  int save_comp_list[JPGD_MAXCOMPSINSCAN];
+  int save_block_y_mcu[JPGD_MAXCOMPONENTS];
+  int save_total_lines_left = total_lines_left;
+  int save_scale_shift = scale_shift;
+
+  memcpy(save_comp_list, comp_list, sizeof(comp_list));
+  memcpy(save_block_y_mcu, block_y_mcu, sizeof(block_y_mcu));
+
+  if (setjmp(jmp_state))
+    return (JPGD_DECODE_ERROR);
+
+  finish_progressive();
+
+  memset(block_y_mcu, 0, sizeof(block_y_mcu));
+
+  scale_shift = shift;
+
+  uchar *Prow = (uchar *)Pdst;
+
+  for (total_lines_left = get_scaled_height(); total_lines_left > 0; total_lines_left--)
+  {
+    if (mcu_lines_left == 0)
+    {
+      load_next_row();
+
+      transform_row();
+
+      mcu_lines_left = max_mcu_y_size >> scale_shift;
+    }
+
+    if (scale_shift)
+      convert_row_scaled(Prow, dst_bpp);
+    else
+      convert_row(Prow, dst_bpp);
+
+    mcu_lines_left--;
+
+    Prow += dst_pitch;
+  }
+
+  comps_in_scan = save_comps_in_scan;
+  memcpy(comp_list, save_comp_list, sizeof(comp_list));
+  memcpy(block_y_mcu, save_block_y_mcu, sizeof(block_y_mcu));
+  total_lines_left = save_total_lines_left;
+  scale_shift = save_scale_shift;
+  mcu_lines_left = 0;
+
+  calc_mcu_block_order();
+
+  return (JPGD_OKAY);
+}
+//------------------------------------------------------------------------------
 // Completely destroys the decoder object. May be called at any time.
 jpeg_decoder::~jpeg_decoder()
 {
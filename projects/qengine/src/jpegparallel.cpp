@@ -0,0 +1,358 @@
+#include "stdafx.h"
+//------------------------------------------------------------------------------
+// jpegparallel.cpp
+// Multithreaded decoding on top of jpeg_decoder.
+//
+// Restart markers reset all of the entropy decoder's state (the DC
+// predictions, the bit buffer), so the scan data between two of them can be
+// decoded without the data before. decode_image() looks for the markers in
+// the file and gives each thread a decoder of its own that reads the file's
+// headers followed by the scan data of its first restart interval. Threads
+// only ever start on a row that also starts an interval, and they write
+// disjoint rows of the caller's image.
+//
+// jpeg_decode_batch() decodes whole files on separate threads, each with its
+// own decoder.
+//------------------------------------------------------------------------------
+#include "jpegdecoder.h"
+#include "qparallel.h"
+#include "qcpu.h"
+//------------------------------------------------------------------------------
+// Fewest MCU rows worth giving a thread. A decoder of its own costs it about
+// as much as decoding a couple of MCUs.
+#define JPGD_MIN_ROWS_PER_THREAD 4
+//------------------------------------------------------------------------------
+// Reads Phead first, then Pdata.
+class jpeg_decoder_splice_stream : public jpeg_decoder_stream
+{
+  const uchar *Phead;
+  uint head_left;
+  const uchar *Pdata;
+  uint data_left;
+
+public:
+
+  jpeg_decoder_splice_stream(const uchar *Phead, uint head_size, const uchar *Pdata, uint data_size)
+  {
+    this->Phead = Phead;
+    head_left = head_size;
+    this->Pdata = Pdata;
+    data_left = data_size;
+  }
+
+  virtual size_t read(uchar *Pbuf, uint max_bytes_to_read, bool *Peof_flag)
+  {
+    uint n = min(max_bytes_to_read, head_left);
+
+    memcpy(Pbuf, Phead, n);
+    Phead += n;
+    head_left -= n;
+
+    uint m = min(max_bytes_to_read - n, data_left);
+
+    memcpy(Pbuf + n, Pdata, m);
+    Pdata += m;
+    data_left -= m;
+
+    if ((!head_left) && (!data_left))
+      *Peof_flag = true;
+
+    return (n + m);
+  }
+};
+//------------------------------------------------------------------------------
+// The rows of an image are split into units, the fewest MCU rows that start
+// and end on restart interval boundaries. Every thread decodes a run of
+// units.
+typedef struct restart_job_tag
+{
+  jpeg_decoder *Pd;
+
+  const uchar *Pdata;
+  uint size;
+
+  int num_units;
+  int unit_rows;                        /* MCU rows per unit */
+  int unit_restarts;                    /* restart intervals per unit */
+  uint *Punit_ofs;                      /* offset of each unit's scan data */
+  int *Punit_error;                     /* error code of the run starting at the unit */
+
+  uchar *Pdst;
+  int dst_pitch;
+  int dst_bpp;
+
+  int total_bytes_read;                 /* from the run with the last unit */
+} restart_job_t;
+//------------------------------------------------------------------------------
+static int gcd(int a, int b)
+{
+  while (b)
+  {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+
+  return (a);
+}
+//------------------------------------------------------------------------------
+// Stores the offset of the scan data following every step'th RSTn marker in
+// Pofs[1] to Pofs[count - 1], Pofs[0] is the start of the scan data. Returns
+// false if the scan ends first or a marker is out of sequence.
+static bool find_restarts(const uchar *Pdata, uint size, uint ofs, int step, uint *Pofs, int count)
+{
+  const uchar *p = Pdata + ofs;
+  const uchar *Pend = Pdata + size;
+  int restarts = 0;
+
+  Pofs[0] = ofs;
+
+  for (int i = 1; i < count; )
+  {
+    p = (const uchar *)memchr(p, 0xFF, Pend - p);
+    if (!p)
+      return (false);
+
+    // Markers may be preceded by any number of 0xFF fill bytes
+    while ((p < Pend) && (*p == 0xFF))
+      p++;
+
+    if (p == Pend)
+      return (false);
+
+    uint c = *p++;
+
+    // Stuffed zero, 0xFF was data
+    if (c == 0)
+      continue;
+
+    if (c != (uint)(M_RST0 + (restarts & 7)))
+      return (false);
+
+    if (++restarts == i * step)
+      Pofs[i++] = (uint)(p - Pdata);
+  }
+
+  return (true);
+}
+//------------------------------------------------------------------------------
+// Threads QPARALLEL_FOR may use.
+static uint max_threads(void)
+{
+  uint threads = QPARALLEL_GET_MAX_THREADS();
+
+  return ((threads) ? threads : QCPU_GET_CORE_COUNT());
+}
+//------------------------------------------------------------------------------
+// Decodes units [begin, end) with a decoder of its own.
+void jpeg_decoder::decode_restart_units(void *Pjob, const unsigned int &begin, const unsigned int &end)
+{
+  restart_job_t *Pj = (restart_job_t *)Pjob;
+  jpeg_decoder *Pd = Pj->Pd;
+
+  int unit_lines = Pj->unit_rows * (Pd->max_mcu_y_size >> Pd->scale_shift);
+  int first_line = begin * unit_lines;
+  int end_line = min((int)end * unit_lines, Pd->get_scaled_height());
+  uint ofs = Pj->Punit_ofs[begin];
+
+  jpeg_decoder_splice_stream stream(Pj->Pdata, Pd->scan_data_ofs, Pj->Pdata + ofs, Pj->size - ofs);
+
+  jpeg_decoder *Pw = new jpeg_decoder(&stream, Pd->use_mmx);
+  if (!Pw)
+  {
+    Pj->Punit_error[begin] = JPGD_NOTENOUGHMEM;
+    return;
+  }
+
+  Pw->set_scale(Pd->scale_shift);
+
+  if (Pw->begin() == JPGD_OKAY)
+  {
+    // Carry on as if the rows above had been decoded. The last run reads
+    // the EOI marker like a serial decode would.
+    Pw->next_restart_num = (begin * Pj->unit_restarts) & 7;
+    Pw->total_lines_left = Pd->get_scaled_height() - first_line;
+
+    uchar *Pdst = Pj->Pdst + first_line * Pj->dst_pitch;
+
+    for (int y = first_line; y < end_line; y++)
+    {
+      if (Pw->decode_scan_line(Pdst, Pj->dst_bpp) != JPGD_OKAY)
+        break;
+
+      Pdst += Pj->dst_pitch;
+    }
+  }
+
+  if ((int)end == Pj->num_units)
+    Pj->total_bytes_read = Pw->total_bytes_read - Pd->scan_data_ofs + ofs;
+
+  Pj->Punit_error[begin] = Pw->get_error_code();
+
+  delete Pw;
+}
+//------------------------------------------------------------------------------
+// Decodes the image on several threads if it can be split at its restart
+// markers. Returns false if not, nothing has been decoded then.
+bool jpeg_decoder::decode_restarts(uchar *Pdst, int dst_pitch, int dst_bpp, int *Pstatus)
+{
+  uint size;
+  const uchar *Pdata = Pstream->get_memory(&size);
+
+  if ((!Pdata) || (progressive_flag) || (!restart_interval))
+    return (false);
+
+  if ((comps_in_scan != comps_in_frame) || (total_lines_left != get_scaled_height()))
+    return (false);
+
+  if (max_threads() < 2)
+    return (false);
+
+  int unit_rows = restart_interval / gcd(restart_interval, mcus_per_row);
+  int unit_restarts = (unit_rows * mcus_per_row) / restart_interval;
+  int num_units = (mcus_per_col + unit_rows - 1) / unit_rows;
+
+  if (num_units < 2)
+    return (false);
+
+  uint *Punit_ofs = (uint *)malloc(num_units * (sizeof(uint) + sizeof(int)));
+  if (!Punit_ofs)
+    return (false);
+
+  // Damaged scan data is left to the serial decode, which reports it
+  if (!find_restarts(Pdata, size, scan_data_ofs, unit_restarts, Punit_ofs, num_units))
+  {
+    free(Punit_ofs);
+    return (false);
+  }
+
+  restart_job_t job;
+
+  job.Pd = this;
+  job.Pdata = Pdata;
+  job.size = size;
+  job.num_units = num_units;
+  job.unit_rows = unit_rows;
+  job.unit_restarts = unit_restarts;
+  job.Punit_ofs = Punit_ofs;
+  job.Punit_error = (int *)(Punit_ofs + num_units);
+  job.Pdst = Pdst;
+  job.dst_pitch = dst_pitch;
+  job.dst_bpp = dst_bpp;
+  job.total_bytes_read = total_bytes_read;
+
+  memset(job.Punit_error, 0, num_units * sizeof(int));
+
+  uint grain = (JPGD_MIN_ROWS_PER_THREAD + unit_rows - 1) / unit_rows;
+
+  QPARALLEL_FOR(num_units, grain, decode_restart_units, &job);
+
+  for (int i = 0; (i < num_units) && (!error_code); i++)
+    error_code = job.Punit_error[i];
+
+  free(Punit_ofs);
+
+  total_lines_left = 0;
+  total_bytes_read = job.total_bytes_read;
+
+  *Pstatus = (error_code) ? JPGD_DECODE_ERROR : JPGD_OKAY;
+
+  return (true);
+}
+//------------------------------------------------------------------------------
+int jpeg_decoder::decode_image(void *Pdst, int dst_pitch, int dst_bpp, bool use_threads)
+{
+  int status;
+
+  if ((error_code) || (!ready_flag) || (scans_pending))
+    return (JPGD_FAILED);
+
+  if (!check_dst_bpp(dst_bpp))
+    return (JPGD_FAILED);
+
+  if ((use_threads) && (decode_restarts((uchar *)Pdst, dst_pitch, dst_bpp, &status)))
+    return (status);
+
+  uchar *Prow = (uchar *)Pdst + (get_scaled_height() - total_lines_left) * dst_pitch;
+
+  while ((status = decode_scan_line(Prow, dst_bpp)) == JPGD_OKAY)
+    Prow += dst_pitch;
+
+  return ((status == JPGD_DONE) ? JPGD_OKAY : status);
+}
+//------------------------------------------------------------------------------
+static void decode_batch_job(Pjpeg_batch_job_t Pj, bool use_threads)
+{
+  jpeg_decoder_mem_stream stream(Pj->Pdata, Pj->data_size);
+
+  Pjpeg_decoder Pd = new jpeg_decoder(&stream, true);
+  if (!Pd)
+  {
+    Pj->status = JPGD_NOTENOUGHMEM;
+    return;
+  }
+
+  Pj->status = (Pd->set_scale(Pj->scale_shift)) ? Pd->begin() : JPGD_FAILED;
+
+  if (Pj->status == JPGD_OKAY)
+    Pj->status = Pd->decode_image(Pj->Pdst, Pj->dst_pitch, Pj->dst_bpp, use_threads);
+
+  delete Pd;
+}
+//------------------------------------------------------------------------------
+static void decode_batch_jobs(void *Pjobs, const unsigned int &begin, const unsigned int &end)
+{
+  for (uint i = begin; i < end; i++)
+    decode_batch_job((Pjpeg_batch_job_t)Pjobs + i, false);
+}
+//------------------------------------------------------------------------------
+int jpeg_decode_batch(jpeg_batch_job_t *Pjobs, int num_jobs)
+{
+  if (num_jobs <= 0)
+    return (0);
+
+  // The decoders pick their kernels from the CPU features, detect them here
+  // before the threads race to (the lazy init isn't thread safe on VC++ 2012)
+  QCPU_GET_FEATURES();
+
+  // Too few files to go around, split each of them instead
+  if ((uint)num_jobs < max_threads())
+  {
+    for (int i = 0; i < num_jobs; i++)
+      decode_batch_job(&Pjobs[i], true);
+  }
+  else
+    QPARALLEL_FOR(num_jobs, 1, decode_batch_jobs, Pjobs);
+
+  int failed = 0;
+
+  for (int i = 0; i < num_jobs; i++)
+    if (Pjobs[i].status != JPGD_OKAY)
+      failed++;
+
+  return (failed);
+}
+//------------------------------------------------------------------------------
+bool jpeg_get_info(const void *Pdata, uint data_size,
+                   int *Pwidth, int *Pheight, int *Pnum_components)
+{
+  jpeg_decoder_mem_stream stream(Pdata, data_size);
+
+  Pjpeg_decoder Pd = new jpeg_decoder(&stream, false);
+  if (!Pd)
+    return (false);
+
+  bool ok = (Pd->get_error_code() == 0);
+
+  if (ok)
+  {
+    *Pwidth = Pd->get_width();
+    *Pheight = Pd->get_height();
+    *Pnum_components = Pd->get_num_components();
+  }
+
+  delete Pd;
+
+  return (ok);
+}
+//------------------------------------------------------------------------------
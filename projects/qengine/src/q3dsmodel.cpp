@@ -51,8 +51,6 @@ static void sortTriangles(chunk_mesh3ds* out);
 static void calculateMeshNormals(chunk_mesh3ds* dat);
 static void calculateMeshTangentSpace(chunk_mesh3ds* dat);									
 static void calculateMeshBoundingBox(chunk_mesh3ds* dat);									
-static void smoothTangentSpace(chunk_mesh3ds* dat);													
-static void tangentSpace(float* v1, float* v2, float* v3, float* t1, float* t2, float* t3, float* norm, float* tangentSpace);  
 
 static FILE* g_pFile = NULL;
 static char g_szString[64];
@@ -236,11 +234,7 @@ void calculate3DSNormals(chunk_data3ds* dat)
 void calculate3DSTangentSpace(chunk_data3ds* dat)
 {
 	for(int i = 0; i < dat->meshCount; ++i)
-	{
 		calculateMeshTangentSpace(&dat->meshes[i]);
-		if(dat->meshes[i].tangentSpace)
-			smoothTangentSpace(&dat->meshes[i]);
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -975,14 +969,32 @@ void sortTriangles(chunk_mesh3ds* dat)
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// meshArrays
+// Copies the 3ds vertex and triangle lists into the layouts the qmath mesh routines take
+static void meshArrays(chunk_mesh3ds* mesh, vec3f* verts, unsigned int* polys)
+{
+	for(int i = 0; i < mesh->vertCount; ++i)
+		verts[i].set(mesh->verts[i]);
+	
+	for(int i = 0; i < mesh->triCount; ++i)
+	{
+		polys[i * 3 + 0] = (unsigned int)mesh->tris[i][0];
+		polys[i * 3 + 1] = (unsigned int)mesh->tris[i][1];
+		polys[i * 3 + 2] = (unsigned int)mesh->tris[i][2];
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // calculateMeshTangentSpace
+// Builds one tangent frame per vertex (tangent, bitangent, normal) with the engine's
+// welded tangent generator
 void calculateMeshTangentSpace(chunk_mesh3ds* mesh)
 {
 	if(mesh->norms == NULL)
 		calculateMeshNormals(mesh);
 	
-	if((mesh->norms == NULL) || (mesh->texCoords == NULL))
+	if((mesh->norms == NULL) || (mesh->texCoords == NULL) || (mesh->texCoordCount < mesh->vertCount))
 		return;
 	
 	if(mesh->tangentSpace != NULL)
@@ -991,20 +1003,45 @@ void calculateMeshTangentSpace(chunk_mesh3ds* mesh)
 		mesh->tangentSpace = NULL;
 	}
 	
+	if(mesh->vertCount <= 0 || mesh->triCount <= 0)
+		return;
 	
-	mesh->tangentSpace = (float(*)[9])malloc(sizeof(float) * 9 * mesh->triCount * 3);
-
+	vec3f* verts = new vec3f[mesh->vertCount];
+	vec3f* norms = new vec3f[mesh->vertCount];
+	vec2f* texCoords = new vec2f[mesh->vertCount];
+	vec3f* tangents = new vec3f[mesh->vertCount];
+	vec3f* bitangents = new vec3f[mesh->vertCount];
+	unsigned int* polys = new unsigned int[mesh->triCount * 3];
 	
-	memset(mesh->tangentSpace, 0, sizeof(float) * 9 * mesh->triCount * 3);
-	for(int i = 0; i < mesh->triCount; ++i)
+	meshArrays(mesh, verts, polys);
+	for(int i = 0; i < mesh->vertCount; ++i)
 	{
-		for(int j = 0; j < 3; ++j)
-		{
-			tangentSpace(mesh->verts[mesh->tris[i][0]], mesh->verts[mesh->tris[i][1]], mesh->verts[mesh->tris[i][2]],
-						 mesh->texCoords[mesh->tris[i][0]], mesh->texCoords[mesh->tris[i][1]], mesh->texCoords[mesh->tris[i][2]],
-						 mesh->norms[i * 3 + j], mesh->tangentSpace[i * 3 + j]);
-		}
+		norms[i].set(mesh->norms[i]);
+		texCoords[i].set(mesh->texCoords[i][0], mesh->texCoords[i][1]);
+	}
+	
+	QMATH_CREATE_TANGENT_FRAMES(verts, mesh->vertCount, polys, mesh->triCount, texCoords, norms, tangents, bitangents);
+	
+	mesh->tangentSpace = (float(*)[9])malloc(sizeof(float) * 9 * mesh->vertCount);
+	for(int i = 0; i < mesh->vertCount; ++i)
+	{
+		mesh->tangentSpace[i][0] = tangents[i].x;
+		mesh->tangentSpace[i][1] = tangents[i].y;
+		mesh->tangentSpace[i][2] = tangents[i].z;
+		mesh->tangentSpace[i][3] = bitangents[i].x;
+		mesh->tangentSpace[i][4] = bitangents[i].y;
+		mesh->tangentSpace[i][5] = bitangents[i].z;
+		mesh->tangentSpace[i][6] = norms[i].x;
+		mesh->tangentSpace[i][7] = norms[i].y;
+		mesh->tangentSpace[i][8] = norms[i].z;
 	}
+	
+	delete[] verts;
+	delete[] norms;
+	delete[] texCoords;
+	delete[] tangents;
+	delete[] bitangents;
+	delete[] polys;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -1036,232 +1073,25 @@ void calculateMeshBoundingBox(chunk_mesh3ds* mesh)
 	mesh->center[2] = mesh->min[2] + (mesh->max[2] - mesh->min[2]) * 0.5f;
 }
 
-//////////////////////////////////////////////////////////////////////////////////////////////
-// smoothTangentSpace
-void smoothTangentSpace(chunk_mesh3ds* mesh)
-{
-	int i, j, k;
-	int tri, vert;
-	int tanCount;
-	int (*tanRefs)[50];
-	float tanSpace[9];
-	float tempBinorm[3];
-	float dotTangent;
-	float dotBinormal;
-	float dotNormal;
-	float (*newTanSpace)[9];
-	
-	newTanSpace = (float(*)[9])malloc(sizeof(float) * 9 * mesh->triCount * 3);
-	tanRefs = (int(*)[50])malloc(sizeof(int) * 50 * mesh->vertCount);
-
-	
-	memset(tanRefs, 0, sizeof(int) * 50 * mesh->vertCount);
-	
-	for(i = 0; i < mesh->triCount; ++i)
-	{
-		for(j = 0; j < 3; ++j)
-		{
-			if(tanRefs[mesh->tris[i][j]][0] < 48)
-			{
-				tanRefs[mesh->tris[i][j]][0]++;
-				tanRefs[mesh->tris[i][j]][tanRefs[mesh->tris[i][j]][0]] = i * 3 + j;
-			}
-		}
-	}
-	
-	for(i = 0; i < mesh->triCount; ++i)
-	{
-		for(j = 0; j < 3; ++j)
-		{
-			memset(tanSpace, 0, sizeof(float) * 9);
-			tanCount = 0;
-			
-			for(k = 0; k <= tanRefs[mesh->tris[i][j]][0]; ++k)
-			{
-				tri = tanRefs[mesh->tris[i][j]][k] / 3;
-				vert = tanRefs[mesh->tris[i][j]][k] % 3;
-				
-				dotTangent = QMATH_VEC3F_DOTPROD(&mesh->tangentSpace[i * 3 + j][0], &mesh->tangentSpace[tri * 3 + vert][0]);
-				dotBinormal = QMATH_VEC3F_DOTPROD(&mesh->tangentSpace[i * 3 + j][3], &mesh->tangentSpace[tri * 3 + vert][3]);
-				dotNormal = QMATH_VEC3F_DOTPROD(&mesh->tangentSpace[i * 3 + j][6], &mesh->tangentSpace[tri * 3 + vert][6]);
-				
-				if((dotTangent > 0.85) && (dotBinormal > 0.85) && (dotNormal > 0.85))
-				{
-					QMATH_VEC3F_ADDCOPY(&tanSpace[0], &mesh->tangentSpace[tri * 3 + vert][0]);
-					QMATH_VEC3F_ADDCOPY(&tanSpace[3], &mesh->tangentSpace[tri * 3 + vert][3]);
-					QMATH_VEC3F_ADDCOPY(&tanSpace[6], &mesh->tangentSpace[tri * 3 + vert][6]);
-					++tanCount;
-				}
-			}
-			
-			float iScale = 1.0f / (float)tanCount;
-			tanSpace[0] *= iScale;
-			tanSpace[1] *= iScale;
-			tanSpace[2] *= iScale;
-			tanSpace[3] *= iScale;
-			tanSpace[4] *= iScale;
-			tanSpace[5] *= iScale;
-			tanSpace[6] *= iScale;
-			tanSpace[7] *= iScale;
-			tanSpace[8] *= iScale;
-			QMATH_VEC3F_NORMALIZE(&tanSpace[0]);
-			QMATH_VEC3F_NORMALIZE(&tanSpace[3]);
-			QMATH_VEC3F_NORMALIZE(&tanSpace[6]);
-
-			QMATH_VEC3F_CROSSPROD(&tanSpace[0], &tanSpace[6], tempBinorm);
-			QMATH_VEC3F_NORMALIZE(tempBinorm);
-			dotBinormal = QMATH_VEC3F_DOTPROD(&tanSpace[3], tempBinorm);
-			if(dotBinormal < 0.0f)
-			{
-				tempBinorm[0] = -tempBinorm[0];
-				tempBinorm[1] = -tempBinorm[1];
-				tempBinorm[2] = -tempBinorm[2];
-			}
-			
-			memcpy(newTanSpace[i * 3 + j], tanSpace, sizeof(float) * 9);
-			memcpy(&newTanSpace[i * 3 + j][3], tempBinorm, sizeof(float) * 3);
-		}
-	}
-	
-	free(mesh->tangentSpace);
-	mesh->tangentSpace = newTanSpace;
-	
-	if(tanRefs)
-	{
-		free(tanRefs);
-		tanRefs = NULL;
-	}
-}
-
-//////////////////////////////////////////////////////////////////////////////////////////////////////
-// tangentSpace
-void tangentSpace(float* vert1, float* vert2, float* vert3, float* t1, float* t2, float* t3, float* norm, float* tangentSpace)
-{
-	float a, b;
-	float u1, u2;
-	float v1, v2;
-	float edge1[3];
-	float edge2[3];
-	float dot;
-	float dvTmp[3];
-	float duTmp[3];
-	
-	if((t1[0] == t2[0]) ||
-	   (t1[1] == t2[1]) ||
-	   (t1[0] == t3[0]) ||
-	   (t1[1] == t3[1]))
-	{
-		tangentSpace[0] = 1.0f;
-		tangentSpace[1] = 0.0f;
-		tangentSpace[2] = 0.0f;
-		
-		tangentSpace[3] = 0.0f;
-		tangentSpace[4] = 1.0f;
-		tangentSpace[5] = 0.0f;
-		
-		tangentSpace[6] = 0.0f;
-		tangentSpace[7] = 0.0f;
-		tangentSpace[8] = 1.0f;
-		
-		return;
-	}
-	
-	edge1[0] = vert2[0] - vert1[0];
-	edge1[1] = vert2[1] - vert1[1];
-	edge1[2] = vert2[2] - vert1[2];
-	edge2[0] = vert3[0] - vert1[0];
-	edge2[1] = vert3[1] - vert1[1];
-	edge2[2] = vert3[2] - vert1[2];
-	
-	u1 = t2[0] - t1[0];
-    u2 = t3[0] - t1[0];
-    v1 = t2[1] - t1[1];
-    v2 = t3[1] - t1[1];
-    
-    a = (u1 - v1 * u2 / v2);
-    if(a != 0.0f)
-		a = 1.0f / a;
-	
-	b = (u2 - v2 * u1 / v1);
-	if(b != 0.0f)
-		b = 1.0f / b;
-	
-	duTmp[0] = a * edge1[0] + b * edge2[0];
-	duTmp[1] = a * edge1[1] + b * edge2[1];
-	duTmp[2] = a * edge1[2] + b * edge2[2];
-	QMATH_VEC3F_NORMALIZE(duTmp);
-	
-	a = (v1 - u1 * v2 / u2);
-	if(a != 0.0f)
-		a = 1.0f / a;
-	
-	b = (v2 - u2 * v1 / u1);
-	if(b != 0.0f)
-		b = 1.0f / b;
-	
-	dvTmp[0] = a * edge1[0] + b * edge2[0];
-	dvTmp[1] = a * edge1[1] + b * edge2[1];
-	dvTmp[2] = a * edge1[2] + b * edge2[2];
-	QMATH_VEC3F_NORMALIZE(dvTmp);
-	
-	tangentSpace[6] = norm[0];
-	tangentSpace[7] = norm[1];
-	tangentSpace[8] = norm[2];
-	dot = QMATH_VEC3F_DOTPROD(duTmp, &tangentSpace[6]);
-	
-	tangentSpace[0] = duTmp[0] - (dot * tangentSpace[6]);
-	tangentSpace[1] = duTmp[1] - (dot * tangentSpace[7]);
-	tangentSpace[2] = duTmp[2] - (dot * tangentSpace[8]);
-	QMATH_VEC3F_NORMALIZE(tangentSpace);
-	
-	dot = QMATH_VEC3F_DOTPROD(dvTmp, &tangentSpace[6]);
-	
-	tangentSpace[3] = dvTmp[0] - (dot * tangentSpace[6]);
-	tangentSpace[4] = dvTmp[1] - (dot * tangentSpace[7]);
-	tangentSpace[5] = dvTmp[2] - (dot * tangentSpace[8]);
-	QMATH_VEC3F_NORMALIZE(&tangentSpace[3]);
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // calculateMeshNormals
 void calculateMeshNormals(chunk_mesh3ds* mesh)
 {
-	mesh->norms = ( float(*)[3] )malloc( sizeof( float ) * 3 * mesh->triCount * 3 );
-	memset( mesh->norms, 0, sizeof( float ) * 3 * mesh->triCount * 3 );
+	int normCount = ( mesh->vertCount > mesh->triCount * 3 ) ? mesh->vertCount : mesh->triCount * 3;
+	mesh->norms = ( float(*)[3] )malloc( sizeof( float ) * 3 * normCount );
+	memset( mesh->norms, 0, sizeof( float ) * 3 * normCount );
 	
-	for( unsigned i = 0; i < mesh->triCount; ++i )
-	{
-		vec3f n, v1, v2, v3;
-		int vertA, vertB, vertC;
-		
-		vertA = mesh->tris[i][0];
-		vertB = mesh->tris[i][1];
-		vertC = mesh->tris[i][2];
-		
-		v1.set( mesh->verts[vertA] );
-		v2.set( mesh->verts[vertB] );
-		v3.set( mesh->verts[vertC] );
-		
-		vec3f u, v;
-		u = v2 - v1;
-		v = v3 - v1;
-		n = u.crossProd( v );
-		n.normalize();
-		
-		mesh->norms[vertA][0] += n.x;
-		mesh->norms[vertA][1] += n.y;
-		mesh->norms[vertA][2] += n.z;
-		mesh->norms[vertB][0] += n.x;
-		mesh->norms[vertB][1] += n.y;
-		mesh->norms[vertB][2] += n.z;
-		mesh->norms[vertC][0] += n.x;
-		mesh->norms[vertC][1] += n.y;
-		mesh->norms[vertC][2] += n.z;
-		
-		QMATH_VEC3F_NORMALIZE( mesh->norms[vertA] );
-		QMATH_VEC3F_NORMALIZE( mesh->norms[vertB] );
-		QMATH_VEC3F_NORMALIZE( mesh->norms[vertC] );
-	}
+	if( mesh->vertCount <= 0 || mesh->triCount <= 0 )
+		return;
+	
+	vec3f* verts = new vec3f[mesh->vertCount];
+	unsigned int* polys = new unsigned int[mesh->triCount * 3];
+	meshArrays( mesh, verts, polys );
+	
+	QMATH_CREATE_VERTEX_NORMALS( verts, mesh->vertCount, polys, mesh->triCount, &mesh->norms[0][0] );
+	
+	delete[] verts;
+	delete[] polys;
 /*
 	int i, j, k;
 	int normCount;
@@ -1469,7 +1299,7 @@ bool c3DSModel::LoadModel( bool loadNormalmaps )
 		memset(mdlData.materials[i].texture, 0, sizeof(char) * 32);
 		strcpy(mdlData.materials[i].texture, strTex.c_str());
 		
-		unsigned int tex_flags = QTEXTURE_FILTER_TRILINEAR;
+		unsigned int tex_flags = QTEXTURE_FILTER_TRILINEAR | QTEXTURE_STREAM;
 		textureHandleList[i].textureRef = g_pRender->AddTextureObject(tex_flags, strTex.c_str());  // m_filePath
 		if(QRENDER_IS_VALID(textureHandleList[i].textureRef))
 			textureHandleList[i].fileName.assign(strTex);
@@ -104,7 +104,7 @@ DWORD WINAPI ParentThread(LPVOID lpParam)
 							gTMS->tasks[i]->done = true;
 							CQuadrionTextureObject* tex = (CQuadrionTextureObject*)gTMS->tasks[i]->userData;
 							
-							if(!tex->CreateTextureFromFile(gTMS->tasks[i]->uiParam))
+							if(!tex->CreateTextureFromFile(gTMS->tasks[i]->uiParam, gTMS->tasks[i]->sParam))
 							{
 								//tex->CreateTextureFromFile(gTMS->tasks[i]->uiParam)
 							}
@@ -114,47 +114,6 @@ DWORD WINAPI ParentThread(LPVOID lpParam)
 							break;
 						}
 
-						case TMS_TYPE_NORMALMAPLOAD:
-						{
-							if(!gTMS->tasks[i])
-								continue;
-
-							gTMS->tasks[i]->done = true;
-							CQuadrionTextureFile*	texFl = (CQuadrionTextureFile*)gTMS->tasks[i]->userData;
-							std::string				newName;
-							std::string				oldName = texFl->GetFileName(); // LoadTexture changes the fileName, so we need to store the old one here temporarily
-							
-							if(!texFl->LoadTexture(gTMS->tasks[i]->sParam.c_str(), texFl->GetFilePath().c_str()))
-							{
-								newName = gTMS->tasks[i]->sParam;
-								newName.append(".dds");
-
-								if(!texFl->LoadTexture(newName.c_str(), texFl->GetFilePath().c_str()))
-								{
-									newName = gTMS->tasks[i]->sParam;
-									newName.append(".tga");
-
-									if(!texFl->LoadTexture(newName.c_str(), texFl->GetFilePath().c_str()))
-									{
-										newName = gTMS->tasks[i]->sParam;
-										newName.append(".jpg");
-
- 										texFl->LoadTexture(newName.c_str(), texFl->GetFilePath().c_str());
-									}
-								}
-							}
-
-							// Set the filename back to the original so StreamTextureObject will get a proper handle
-							newName = texFl->GetFileName();
-							texFl->SetFileName(oldName);
-							g_pRender->StreamTextureObject(*texFl, gTMS->tasks[i]->uiParam);
-							texFl->SetFileName(newName);	// Now set it back
-
-							
-							delete gTMS->tasks[i];
-							gTMS->tasks.erase(gTMS->tasks.begin() + i);
-							break;
-						}
 					}
 
 				} else {
@@ -17,6 +17,18 @@ CCamera::CCamera()
 	camType = 0;
 	curRotAngle = 0.0F;
 	camHasChanged = false;
+	
+	m_cullMask = NULL;
+	m_cullMaskCapacity = 0;
+}
+
+CCamera::~CCamera()
+{
+	if(m_cullMask)
+	{
+		delete[] m_cullMask;
+		m_cullMask = NULL;
+	}
 }
 
 
@@ -128,7 +140,9 @@ void CCamera::CreatePerspective(float fov, float aspectRatio, float nearP, float
 	QMATH_MATRIX_COPY(curProjMat, P);
 
 	// set perspective matrix
+#ifndef QENGINE_HEADLESS
 	g_pRender->SetMatrix(QRENDER_MATRIX_PROJECTION, P);
+#endif
 
 
 	nearPlane = nearP;
@@ -154,7 +168,9 @@ void CCamera::CreateOrthographic(float l, float r, float b, float t, float n, fl
 	// load in an orthographic matrix
 	mat4 O;
 	QMATH_MATRIX_LOADORTHO_DX(O, l, r, b, t, n, f);
+#ifndef QENGINE_HEADLESS
 	g_pRender->SetMatrix(QRENDER_MATRIX_PROJECTION, O);
+#endif
 
 	// re-calc the camera view planes
 
@@ -274,56 +290,125 @@ void CCamera::RotateByMouse( int mouseX, int mouseY, int midScreenX, int midScre
 
 
 
-void CCamera::GetFrustumPlanes()
+#ifndef QENGINE_HEADLESS
+// Extracts the six clip planes of the given transform and normalizes them //
+static void extractClipPlanes(const mat4& viewProj, vec4f* planes)
 {
-	mat4 viewProj;
-	g_pRender->GetMatrix( QRENDER_MATRIX_MODELVIEWPROJECTION, viewProj );
-
-	frustumPlanes[0].x = viewProj[3] + viewProj[0];
-	frustumPlanes[0].y = viewProj[7] + viewProj[4];
-	frustumPlanes[0].z = viewProj[11] + viewProj[8];
-	frustumPlanes[0].w = viewProj[15] + viewProj[12];
+	planes[0].x = viewProj[3] + viewProj[0];
+	planes[0].y = viewProj[7] + viewProj[4];
+	planes[0].z = viewProj[11] + viewProj[8];
+	planes[0].w = viewProj[15] + viewProj[12];
 	
-	frustumPlanes[1].x = viewProj[3] - viewProj[0];
-	frustumPlanes[1].y = viewProj[7] - viewProj[4];
-	frustumPlanes[1].z = viewProj[11] - viewProj[8];
-	frustumPlanes[1].w = viewProj[15] - viewProj[12];
+	planes[1].x = viewProj[3] - viewProj[0];
+	planes[1].y = viewProj[7] - viewProj[4];
+	planes[1].z = viewProj[11] - viewProj[8];
+	planes[1].w = viewProj[15] - viewProj[12];
 	
-	frustumPlanes[2].x = viewProj[3] - viewProj[1];
-	frustumPlanes[2].y = viewProj[7] - viewProj[5];
-	frustumPlanes[2].z = viewProj[11] - viewProj[9];
-	frustumPlanes[2].w = viewProj[15] - viewProj[13];
+	planes[2].x = viewProj[3] - viewProj[1];
+	planes[2].y = viewProj[7] - viewProj[5];
+	planes[2].z = viewProj[11] - viewProj[9];
+	planes[2].w = viewProj[15] - viewProj[13];
 	
-	frustumPlanes[3].x = viewProj[3] + viewProj[1];
-	frustumPlanes[3].y = viewProj[7] + viewProj[5];
-	frustumPlanes[3].z = viewProj[11] + viewProj[9];
-	frustumPlanes[3].w = viewProj[15] + viewProj[13];
+	planes[3].x = viewProj[3] + viewProj[1];
+	planes[3].y = viewProj[7] + viewProj[5];
+	planes[3].z = viewProj[11] + viewProj[9];
+	planes[3].w = viewProj[15] + viewProj[13];
 	
-	frustumPlanes[4].x = viewProj[3] + viewProj[2];
-	frustumPlanes[4].y = viewProj[7] + viewProj[6];
-	frustumPlanes[4].z = viewProj[11] + viewProj[10];
-	frustumPlanes[4].w = viewProj[15] + viewProj[14];
+	planes[4].x = viewProj[3] + viewProj[2];
+	planes[4].y = viewProj[7] + viewProj[6];
+	planes[4].z = viewProj[11] + viewProj[10];
+	planes[4].w = viewProj[15] + viewProj[14];
 	
-	frustumPlanes[5].x = viewProj[3] - viewProj[2];
-	frustumPlanes[5].y = viewProj[7] - viewProj[6];
-	frustumPlanes[5].z = viewProj[11] - viewProj[10];
-	frustumPlanes[5].w = viewProj[15] - viewProj[14];
+	planes[5].x = viewProj[3] - viewProj[2];
+	planes[5].y = viewProj[7] - viewProj[6];
+	planes[5].z = viewProj[11] - viewProj[10];
+	planes[5].w = viewProj[15] - viewProj[14];
 	
 	
 	float mag = 0.0f;
 	float iMag = 0.0f;
 	for(int i = 0; i < 6; ++i)
 	{
-		mag = sqrt( frustumPlanes[i].x * frustumPlanes[i].x + frustumPlanes[i].y * frustumPlanes[i].y +    
-					frustumPlanes[i].z * frustumPlanes[i].z );
+		mag = sqrt( planes[i].x * planes[i].x + planes[i].y * planes[i].y +    
+					planes[i].z * planes[i].z );
 		iMag = 1.0F / mag;
 		
-		frustumPlanes[i].x *= iMag;
-		frustumPlanes[i].y *= iMag;
-		frustumPlanes[i].z *= iMag;
-		frustumPlanes[i].w *= iMag;
+		planes[i].x *= iMag;
+		planes[i].y *= iMag;
+		planes[i].z *= iMag;
+		planes[i].w *= iMag;
 	}
 }
+#endif
+
+// Headless builds have no device to read the transforms back from, planes come from SetClipPlanes //
+void CCamera::GetFrustumPlanes()
+{
+#ifndef QENGINE_HEADLESS
+	mat4 viewProj;
+	g_pRender->GetMatrix( QRENDER_MATRIX_MODELVIEWPROJECTION, viewProj );
+	extractClipPlanes( viewProj, frustumPlanes );
+	
+	// World space planes ignore the current model transform so batched culling of //
+	// world space bounds (CullAABBs / CullSpheres) is independent of draw state   //
+	g_pRender->GetMatrix( QRENDER_MATRIX_VIEWPROJECTION, viewProj );
+	extractClipPlanes( viewProj, m_frustumPlanesWS );
+#endif
+}
+
+void CCamera::SetClipPlanes(const vec4f* planes)
+{
+	for( int i = 0; i < 6; ++i )
+	{
+		frustumPlanes[i] = planes[i];
+		m_frustumPlanesWS[i] = planes[i];
+	}
+}
+
+// Grows the scratch mask as lists grow, per frame culls then allocate nothing //
+unsigned int* CCamera::GetCullMask(const unsigned int& count)
+{
+	unsigned int nWords = (count + 31) / 32;
+	if( m_cullMaskCapacity < nWords )
+	{
+		delete[] m_cullMask;
+		m_cullMask = new unsigned int[nWords];
+		m_cullMaskCapacity = nWords;
+	}
+	
+	return m_cullMask;
+}
+
+unsigned int CCamera::CullAABBs(const CAABBList& boxes, unsigned int* visibleMask, unsigned int* visibleIndices)
+{
+	unsigned int n = boxes.GetCount();
+	if( !n )
+		return 0;
+	
+	// A mask is needed to compact indices even when the caller does not want one //
+	unsigned int* mask = visibleMask ? visibleMask : GetCullMask( n );
+	unsigned int nVisible = QMATH_FRUSTUM_CULL_AABBS( m_frustumPlanesWS, boxes.m_centerX, boxes.m_centerY, boxes.m_centerZ,
+													  boxes.m_extentX, boxes.m_extentY, boxes.m_extentZ, n, mask );
+	if( visibleIndices )
+		QMATH_MASK_TO_INDICES( mask, n, visibleIndices );
+	
+	return nVisible;
+}
+
+unsigned int CCamera::CullSpheres(const CSphereList& spheres, unsigned int* visibleMask, unsigned int* visibleIndices)
+{
+	unsigned int n = spheres.GetCount();
+	if( !n )
+		return 0;
+	
+	unsigned int* mask = visibleMask ? visibleMask : GetCullMask( n );
+	unsigned int nVisible = QMATH_FRUSTUM_CULL_SPHERES( m_frustumPlanesWS, spheres.m_centerX, spheres.m_centerY, spheres.m_centerZ,
+														spheres.m_radius, n, mask );
+	if( visibleIndices )
+		QMATH_MASK_TO_INDICES( mask, n, visibleIndices );
+	
+	return nVisible;
+}
 
 QMATH_INTERSECT_RESULT CCamera::IsSphereInFrustum(vec3f v, const float& radius, const float& bias)
 { 
@@ -433,12 +518,14 @@ void CCamera::Apply()
 	{
 		mat4 V;
 		QMATH_MATRIX_LOADVIEW_DX(V, vec3f(camPos), vec3f(lookPos), vec3f(upVec));
+#ifndef QENGINE_HEADLESS
 		g_pRender->SetMatrix(QRENDER_MATRIX_MODELVIEW, V );
 
 
 		mat4 MVP;
 		g_pRender->GetMatrix(QRENDER_MATRIX_VIEWPROJECTION, MVP);
 		QMATH_MATRIX_TRANSPOSE(MVP);
+#endif
 
 		GetFrustumPlanes();
 
@@ -0,0 +1,110 @@
+#include "qcpu.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+
+
+static void cpuid(int info[4], const int& leaf, const int& subleaf)
+{
+#ifdef _MSC_VER
+	__cpuidex(info, leaf, subleaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	info[0] = (int)a;
+	info[1] = (int)b;
+	info[2] = (int)c;
+	info[3] = (int)d;
+#endif
+}
+
+// Reads XCR0 to confirm the OS preserves XMM/YMM registers across context switches //
+static unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static unsigned int detectFeatures()
+{
+	int info[4];
+	unsigned int features = 0;
+
+	cpuid(info, 0, 0);
+	int maxLeaf = info[0];
+	if(maxLeaf < 1)
+		return 0;
+
+	cpuid(info, 1, 0);
+	if(info[3] & (1 << 25))		features |= QCPU_FEATURE_SSE;
+	if(info[3] & (1 << 26))		features |= QCPU_FEATURE_SSE2;
+	if(info[2] & (1 << 0))		features |= QCPU_FEATURE_SSE3;
+	if(info[2] & (1 << 9))		features |= QCPU_FEATURE_SSSE3;
+	if(info[2] & (1 << 19))		features |= QCPU_FEATURE_SSE41;
+	if(info[2] & (1 << 20))		features |= QCPU_FEATURE_SSE42;
+
+	// AVX needs both the cpu bit and OSXSAVE with YMM state enabled //
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool ymmEnabled = osxsave && ((xgetbv0() & 0x6) == 0x6);
+	if(ymmEnabled)
+	{
+		if(info[2] & (1 << 28))		features |= QCPU_FEATURE_AVX;
+		if(info[2] & (1 << 12))		features |= QCPU_FEATURE_FMA;
+
+		if(maxLeaf >= 7)
+		{
+			cpuid(info, 7, 0);
+			if(info[1] & (1 << 5))	features |= QCPU_FEATURE_AVX2;
+		}
+	}
+
+	return features;
+}
+
+
+
+QCPUEXPORT_API unsigned int QCPU_GET_FEATURES()
+{
+	static unsigned int features = detectFeatures();
+	return features;
+}
+
+QCPUEXPORT_API bool QCPU_HAS_FEATURE(const unsigned int& feature)
+{
+	return (QCPU_GET_FEATURES() & feature) == feature;
+}
+
+QCPUEXPORT_API unsigned int QCPU_GET_CORE_COUNT()
+{
+	static unsigned int count = 0;
+	if(count)
+		return count;
+
+#ifdef WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	count = (unsigned int)si.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	count = (n > 0) ? (unsigned int)n : 1;
+#endif
+
+	if(count < 1)
+		count = 1;
+	return count;
+}
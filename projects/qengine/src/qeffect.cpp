@@ -93,7 +93,7 @@ static void GetStateMatrix(const LPDIRECT3DDEVICE9 dev, const void* inVal, void*
 		
 
 	if(type & QEFFECT_MATRIX_INVERSE)
-		D3DXMatrixInverse(&M, NULL, &M);
+		QMATH_MATRIX_INVERT(*(mat4*)&M.m);
 	
 	if(!(type & QEFFECT_MATRIX_TRANSPOSE))
 		D3DXMatrixTranspose(&M, &M);
@@ -153,6 +153,82 @@ bool CFile::CacheFile()
 
 
 
+CMappedFile::CMappedFile()
+{
+	view = NULL;
+	viewSize = 0;
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+
+bool CMappedFile::Open(const std::string& fName)
+{
+	Close();
+
+	fileHandle = CreateFileA(fName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Empty files can not be mapped, files beyond the address space are not worth trying //
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(fileHandle, &size) || size.QuadPart <= 0 || (unsigned long long)size.QuadPart > (size_t)-1)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(!mappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	view = (unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+	if(!view)
+	{
+		Close();
+		return false;
+	}
+
+	viewSize = (size_t)size.QuadPart;
+	return true;
+}
+
+
+void CMappedFile::Close()
+{
+	if(view)
+	{
+		UnmapViewOfFile(view);
+		view = NULL;
+	}
+
+	if(mappingHandle)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+
+	if(fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+
+	viewSize = 0;
+}
+
+
+
+
+
 CConfigFile::CConfigFile() : CFile()
 {
 	
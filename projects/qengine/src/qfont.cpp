@@ -6,6 +6,8 @@
 CFont::CFont()
 {
 	m_iTextureHandle = -1;
+	m_pAtlas = NULL;
+	m_iAtlasImage = -1;
 };
 
 CFont::~CFont()
@@ -22,7 +24,7 @@ CFont::~CFont()
 	m_vCharTexOffsets.clear();
 };
 
-bool CFont::LoadFont(const std::string& name, const std::string& path, bool monospaced, unsigned int charSize)
+bool CFont::LoadFont(const std::string& name, const std::string& path, bool monospaced, unsigned int charSize, CQuadrionTextureAtlas* atlas)
 {
 	CQuadrionTextureFile fontFile;
 
@@ -37,10 +39,23 @@ bool CFont::LoadFont(const std::string& name, const std::string& path, bool mono
 	unsigned char* data = fontFile.GetData();
 
 	GenerateCharacterOffsets(fontFile, monospaced, charSize, data);
-	m_iTextureHandle = g_pRender->AddTextureObject(fontFile, textureFlags);
 
-	if(m_iTextureHandle < 0)
-		return false;
+	if(atlas)
+	{
+		// Offsets stay relative to the sheet, WriteText maps them onto the page //
+		m_iAtlasImage = atlas->AddImage(fontFile);
+		if(m_iAtlasImage < 0)
+			return false;
+
+		m_pAtlas = atlas;
+	}
+	else
+	{
+		m_iTextureHandle = g_pRender->AddTextureObject(fontFile, textureFlags);
+
+		if(m_iTextureHandle < 0)
+			return false;
+	}
 
 	m_sName = std::string(name);
 	m_sPath = std::string(path);
@@ -172,6 +187,9 @@ SCharacterOffset* CFont::GetCharOffset(char character)
 
 int CFont::GetFontTextureHandle()
 {
+	if(m_pAtlas)
+		return m_pAtlas->GetTextureHandle(m_iAtlasImage);
+
 	return m_iTextureHandle;
 }
 
@@ -191,7 +209,10 @@ void CFont::WriteText(const std::string& str, vec2f pos, vec2f bounds, ETextAlig
 	texture_vertex_format vert[6];// = gGUI->getGlobalTextureShiftPtr();
 
 	//tex = g_pRender->GetTextureObject(m_sPath + m_sName, _BASE_DIR);
-	tex = g_pRender->GetTextureObject(m_iTextureHandle);
+	tex = g_pRender->GetTextureObject(GetFontTextureHandle());
+	if(!tex)
+		return;
+
 	tex->BindTexture(0);
 
 	for(unsigned int i = 0; i < str.size(); ++i)
@@ -230,6 +251,9 @@ void CFont::WriteText(const std::string& str, vec2f pos, vec2f bounds, ETextAlig
 		tc.topV = vert[0].v;
 		tc.rightU = vert[2].u;
 		tc.bottomV = vert[2].v;
+
+		if(m_pAtlas)
+			tc = m_pAtlas->MapRect(m_iAtlasImage, tc);
 		
 		vec2f ul( pos.x + curWidth, pos.y );
 		vec2f wh( charOffset->xScale, charOffset->yScale );
@@ -45,21 +45,9 @@ bool CRay::GetRayIntersection(CRay ray, point3f& intersection)
 	if(lenWSqr <= 0.000001F)
 		return false;
 	
-	mat4 dt0;
-	dt0[0] = U.x;		dt0[4] = U.y;		dt0[8] = U.z;			dt0[12] = 0.0F;
-	dt0[1] = rDir.x;	dt0[5] = rDir.y;	dt0[9] = rDir.z;		dt0[13] = 0.0F;
-	dt0[2] = W.x;		dt0[6] = W.y;		dt0[10] = W.z;			dt0[14] = 0.0F;
-	dt0[3] = 0.0F;		dt0[7] = 0.0F;		dt0[11] = 0.0F;			dt0[15] = 1.0F;
-	
-	
-	mat4 dt1;		
-	dt1[0] = U.x;		dt1[4] = U.y;		dt1[8] = U.z;			dt1[12] = 0.0F;
-	dt1[1] = m_dir.x;	dt1[5] = m_dir.y;	dt1[9] = m_dir.z;		dt1[13] = 0.0F;
-	dt1[2] = W.x;		dt1[6] = W.y;		dt1[10] = W.z;			dt1[14] = 0.0F;
-	dt1[3] = 0.0F;		dt1[7] = 0.0F;		dt1[11] = 0.0F;			dt1[15] = 1.0F;
-
-	float detDT0 = D3DXMatrixDeterminant(&D3DXMATRIX(dt0));
-	float detDT1 = D3DXMatrixDeterminant(&D3DXMATRIX(dt1));
+	// det | U rDir W | and det | U m_dir W |, as scalar triple products //
+	float detDT0 = U.tripleScalar(rDir, W);
+	float detDT1 = U.tripleScalar(m_dir, W);
 	
 	float t0 = detDT0 / lenWSqr;
 	float t1 = detDT1 / lenWSqr;
@@ -253,6 +241,131 @@ void CTriangle::SetupTriangle(vec3f a, vec3f b, vec3f c)
 
 
 
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// BOUNDING VOLUME LIST METHODS 
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Grows one SoA component to newCap floats keeping the first count entries, padding is zeroed //
+static float* growComponent(float* old, const unsigned int& count, const unsigned int& newCap)
+{
+	float* data = (float*)QMATH_ALIGNED_MALLOC(sizeof(float) * newCap, 32);
+	if(old && count)
+		memcpy(data, old, sizeof(float) * count);
+	memset(data + count, 0, sizeof(float) * (newCap - count));
+	QMATH_ALIGNED_FREE(old);
+	return data;
+}
+
+static unsigned int paddedCapacity(const unsigned int& n, const unsigned int& cur)
+{
+	unsigned int cap = (cur < QMATH_CULL_PADDING) ? QMATH_CULL_PADDING : cur;
+	while(cap < n)
+		cap *= 2;
+	return (cap + QMATH_CULL_PADDING - 1) & ~(QMATH_CULL_PADDING - 1);
+}
+
+CAABBList::CAABBList()
+{
+	m_centerX = m_centerY = m_centerZ = NULL;
+	m_extentX = m_extentY = m_extentZ = NULL;
+	m_count = 0;
+	m_capacity = 0;
+}
+
+CAABBList::~CAABBList()
+{
+	QMATH_ALIGNED_FREE(m_centerX);
+	QMATH_ALIGNED_FREE(m_centerY);
+	QMATH_ALIGNED_FREE(m_centerZ);
+	QMATH_ALIGNED_FREE(m_extentX);
+	QMATH_ALIGNED_FREE(m_extentY);
+	QMATH_ALIGNED_FREE(m_extentZ);
+}
+
+void CAABBList::Reserve(const unsigned int& n)
+{
+	if(n <= m_capacity)
+		return;
+	
+	unsigned int cap = paddedCapacity(n, m_capacity);
+	m_centerX = growComponent(m_centerX, m_count, cap);
+	m_centerY = growComponent(m_centerY, m_count, cap);
+	m_centerZ = growComponent(m_centerZ, m_count, cap);
+	m_extentX = growComponent(m_extentX, m_count, cap);
+	m_extentY = growComponent(m_extentY, m_count, cap);
+	m_extentZ = growComponent(m_extentZ, m_count, cap);
+	m_capacity = cap;
+}
+
+unsigned int CAABBList::Add(const vec3f& mins, const vec3f& maxs)
+{
+	Reserve(m_count + 1);
+	unsigned int i = m_count++;
+	Set(i, mins, maxs);
+	return i;
+}
+
+void CAABBList::Set(const unsigned int& i, const vec3f& mins, const vec3f& maxs)
+{
+	m_centerX[i] = (mins.x + maxs.x) * 0.5F;
+	m_centerY[i] = (mins.y + maxs.y) * 0.5F;
+	m_centerZ[i] = (mins.z + maxs.z) * 0.5F;
+	m_extentX[i] = (maxs.x - mins.x) * 0.5F;
+	m_extentY[i] = (maxs.y - mins.y) * 0.5F;
+	m_extentZ[i] = (maxs.z - mins.z) * 0.5F;
+}
+
+
+
+CSphereList::CSphereList()
+{
+	m_centerX = m_centerY = m_centerZ = NULL;
+	m_radius = NULL;
+	m_count = 0;
+	m_capacity = 0;
+}
+
+CSphereList::~CSphereList()
+{
+	QMATH_ALIGNED_FREE(m_centerX);
+	QMATH_ALIGNED_FREE(m_centerY);
+	QMATH_ALIGNED_FREE(m_centerZ);
+	QMATH_ALIGNED_FREE(m_radius);
+}
+
+void CSphereList::Reserve(const unsigned int& n)
+{
+	if(n <= m_capacity)
+		return;
+	
+	unsigned int cap = paddedCapacity(n, m_capacity);
+	m_centerX = growComponent(m_centerX, m_count, cap);
+	m_centerY = growComponent(m_centerY, m_count, cap);
+	m_centerZ = growComponent(m_centerZ, m_count, cap);
+	m_radius = growComponent(m_radius, m_count, cap);
+	m_capacity = cap;
+}
+
+unsigned int CSphereList::Add(const vec3f& center, const float& radius)
+{
+	Reserve(m_count + 1);
+	unsigned int i = m_count++;
+	Set(i, center, radius);
+	return i;
+}
+
+void CSphereList::Set(const unsigned int& i, const vec3f& center, const float& radius)
+{
+	m_centerX[i] = center.x;
+	m_centerY[i] = center.y;
+	m_centerZ[i] = center.z;
+	m_radius[i] = radius;
+}
+
+
+
+
+
 
 
 
@@ -0,0 +1,1086 @@
+#include "stdafx.h"
+#include "qimage.h"
+#include "qimage_simd.h"
+#include "qmath.h"
+#include "qcpu.h"
+#include "qparallel.h"
+
+#include <emmintrin.h>
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// COLOR SPACE / HALF CONVERSION
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Linear to sRGB8 goes through 4096 buckets over [0, 1]. Each bucket stores the smallest code it //
+// can map to, the exact code is then found against the decision thresholds (the linear value    //
+// half way between two codes). The steepest part of the curve is under 0.8 codes per bucket, so  //
+// one comparison is always enough. Buckets keep the threshold they compare against as well, so    //
+// both reads depend on the bucket only.                                                          //
+#define QIMAGE_SRGB_BUCKETS		4096
+
+static float s_unorm8ToFloat[256];
+static float s_srgb8ToLinear[256];
+static float s_srgb8Threshold[257];
+static unsigned char s_linearToSrgb8[QIMAGE_SRGB_BUCKETS + 1];
+static float s_linearToSrgb8Next[QIMAGE_SRGB_BUCKETS + 1];		// threshold of the code after the bucket's
+
+
+QIMAGEEXPORT_API float QIMAGE_SRGB_TO_LINEAR(const float& c)
+{
+	if(c <= 0.04045F)
+		return c * (1.0F / 12.92F);
+	return powf((c + 0.055F) * (1.0F / 1.055F), 2.4F);
+}
+
+QIMAGEEXPORT_API float QIMAGE_LINEAR_TO_SRGB(const float& c)
+{
+	if(c <= 0.0031308F)
+		return c * 12.92F;
+	return 1.055F * powf(c, 1.0F / 2.4F) - 0.055F;
+}
+
+
+static struct qimageTableInit
+{
+	qimageTableInit()
+	{
+		for(int i = 0; i < 256; ++i)
+		{
+			s_unorm8ToFloat[i] = (float)i * (1.0F / 255.0F);
+			s_srgb8ToLinear[i] = (float)QIMAGE_SRGB_TO_LINEAR((float)i / 255.0F);
+			s_srgb8Threshold[i] = (i == 0) ? 0.0F : QIMAGE_SRGB_TO_LINEAR(((float)i - 0.5F) / 255.0F);
+		}
+		s_srgb8Threshold[256] = 2.0F;
+
+		int code = 0;
+		for(int i = 0; i <= QIMAGE_SRGB_BUCKETS; ++i)
+		{
+			float v = (float)i / (float)QIMAGE_SRGB_BUCKETS;
+			while(code < 255 && v >= s_srgb8Threshold[code + 1])
+				++code;
+			s_linearToSrgb8[i] = (unsigned char)code;
+			s_linearToSrgb8Next[i] = s_srgb8Threshold[code + 1];
+		}
+	}
+} s_tableInit;
+
+
+static inline unsigned char linearToSrgb8(float c)
+{
+	// clamp, NaN goes to 0 //
+	c = (c > 0.0F) ? ((c < 1.0F) ? c : 1.0F) : 0.0F;
+
+	int bucket = (int)(c * (float)QIMAGE_SRGB_BUCKETS);
+	return (unsigned char)(s_linearToSrgb8[bucket] + (c >= s_linearToSrgb8Next[bucket]));
+}
+
+static inline unsigned char floatToUnorm8(const float& c)
+{
+	if(!(c > 0.0F))
+		return 0;
+	if(c >= 1.0F)
+		return 255;
+	return (unsigned char)(c * 255.0F + 0.5F);
+}
+
+static inline unsigned short floatToUnorm16(const float& c)
+{
+	if(!(c > 0.0F))
+		return 0;
+	if(c >= 1.0F)
+		return 65535;
+	return (unsigned short)(c * 65535.0F + 0.5F);
+}
+
+
+QIMAGEEXPORT_API float QIMAGE_SRGB8_TO_LINEAR(const unsigned char& c)
+{
+	return s_srgb8ToLinear[c];
+}
+
+QIMAGEEXPORT_API unsigned char QIMAGE_LINEAR_TO_SRGB8(const float& c)
+{
+	return linearToSrgb8(c);
+}
+
+
+QIMAGEEXPORT_API float QIMAGE_HALF_TO_FLOAT(const unsigned short& h)
+{
+	unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+	int exponent = (h >> 10) & 0x1F;
+	unsigned int mantissa = h & 0x3FF;
+	unsigned int bits;
+
+	if(exponent == 0)
+	{
+		if(mantissa == 0)
+			bits = sign;
+		else
+		{
+			// denormal, renormalize into a float //
+			exponent = 1;
+			while(!(mantissa & 0x400))
+			{
+				mantissa <<= 1;
+				--exponent;
+			}
+			mantissa &= 0x3FF;
+			bits = sign | ((unsigned int)(exponent + 112) << 23) | (mantissa << 13);
+		}
+	}
+	else if(exponent == 31)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else
+		bits = sign | ((unsigned int)(exponent + 112) << 23) | (mantissa << 13);
+
+	float f;
+	memcpy(&f, &bits, sizeof(float));
+	return f;
+}
+
+QIMAGEEXPORT_API unsigned short QIMAGE_FLOAT_TO_HALF(const float& f)
+{
+	unsigned int x;
+	memcpy(&x, &f, sizeof(float));
+	unsigned short sign = (unsigned short)((x >> 16) & 0x8000);
+	x &= 0x7FFFFFFF;
+
+	// inf / nan //
+	if(x >= 0x7F800000)
+		return sign | 0x7C00 | ((x > 0x7F800000) ? 0x200 : 0);
+
+	// 65520 and up round to infinity //
+	if(x >= 0x477FF000)
+		return sign | 0x7C00;
+
+	// below the smallest normal half, produce a denormal //
+	if(x < 0x38800000)
+	{
+		if(x < 0x33000000)
+			return sign;
+
+		unsigned int e = x >> 23;
+		unsigned int m = (x & 0x7FFFFF) | 0x800000;
+		unsigned int shift = 126 - e;
+		unsigned int r = m >> shift;
+		unsigned int rem = m & ((1U << shift) - 1);
+		unsigned int half = 1U << (shift - 1);
+		if(rem > half || (rem == half && (r & 1)))
+			++r;
+		return sign | (unsigned short)r;
+	}
+
+	unsigned int r = (x - 0x38000000) >> 13;
+	unsigned int rem = x & 0x1FFF;
+	if(rem > 0x1000 || (rem == 0x1000 && (r & 1)))
+		++r;
+	return sign | (unsigned short)r;
+}
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// MIP KERNELS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// The box filter runs in two passes per destination row. The source rows under the row are  //
+// summed vertically into a wide accumulator (the SumRows kernels, this is where most of the  //
+// bandwidth goes and it is plain element wise work for any channel count), then neighbouring //
+// pixels of the sum are added with a stride of one pixel and scaled back (the PairSum        //
+// kernels). Integer formats stay integer until the final rounding shift.                     //
+
+static void sumRows8Scalar(const unsigned char* const* rows, unsigned int nRows, unsigned int n, unsigned short* out)
+{
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		unsigned int s = 0;
+		for(unsigned int r = 0; r < nRows; ++r)
+			s += rows[r][i];
+		out[i] = (unsigned short)s;
+	}
+}
+
+static void pairSum8Scalar(const unsigned short* in, unsigned int c, unsigned int dw, unsigned int shift, unsigned char* out)
+{
+	unsigned int round = (1U << shift) >> 1;
+	for(unsigned int x = 0; x < dw; ++x)
+	{
+		const unsigned short* p = &in[x * 2 * c];
+		for(unsigned int i = 0; i < c; ++i)
+			out[x * c + i] = (unsigned char)((p[i] + p[i + c] + round) >> shift);
+	}
+}
+
+static void sumRows16Scalar(const unsigned short* const* rows, unsigned int nRows, unsigned int n, unsigned int* out)
+{
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		unsigned int s = 0;
+		for(unsigned int r = 0; r < nRows; ++r)
+			s += rows[r][i];
+		out[i] = s;
+	}
+}
+
+static void pairSum16Scalar(const unsigned int* in, unsigned int c, unsigned int dw, unsigned int shift, unsigned short* out)
+{
+	unsigned int round = (1U << shift) >> 1;
+	for(unsigned int x = 0; x < dw; ++x)
+	{
+		const unsigned int* p = &in[x * 2 * c];
+		for(unsigned int i = 0; i < c; ++i)
+			out[x * c + i] = (unsigned short)((p[i] + p[i + c] + round) >> shift);
+	}
+}
+
+static void sumRowsFloatScalar(const float* const* rows, unsigned int nRows, unsigned int n, float* out)
+{
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		float s = rows[0][i];
+		for(unsigned int r = 1; r < nRows; ++r)
+			s += rows[r][i];
+		out[i] = s;
+	}
+}
+
+static void pairSumFloatScalar(const float* in, unsigned int c, unsigned int dw, float scale, float* out)
+{
+	for(unsigned int x = 0; x < dw; ++x)
+	{
+		const float* p = &in[x * 2 * c];
+		for(unsigned int i = 0; i < c; ++i)
+			out[x * c + i] = (p[i] + p[i + c]) * scale;
+	}
+}
+
+static void accumulateFloatScalar(float* acc, const float* row, float weight, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		acc[i] += row[i] * weight;
+}
+
+static void halfToFloatScalar(const unsigned short* in, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		out[i] = QIMAGE_HALF_TO_FLOAT(in[i]);
+}
+
+static void floatToHalfScalar(const float* in, unsigned short* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		out[i] = QIMAGE_FLOAT_TO_HALF(in[i]);
+}
+
+
+// 8 bit rows with a mix of sRGB and linear channels. Element i of a row uses the decode table //
+// tables[i % 12] and is sRGB encoded when bit i % 12 of srgbLanes is set. 12 covers 1 to 4     //
+// channels and is a whole number of 4 wide vectors, each vector starts at phase 0, 4 or 8.     //
+#define QIMAGE_LANE_PERIOD		12
+
+static void decodeRow8Scalar(const float* const* tables, const unsigned char* row, float weight, bool first, unsigned int n, float* acc)
+{
+	unsigned int ph = 0;
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		float v = tables[ph][row[i]] * weight;
+		acc[i] = first ? v : acc[i] + v;
+		ph = (ph + 1 == QIMAGE_LANE_PERIOD) ? 0 : ph + 1;
+	}
+}
+
+static void encodeRow8Scalar(const float* in, unsigned int srgbLanes, unsigned int n, unsigned char* out)
+{
+	unsigned int ph = 0;
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		out[i] = (srgbLanes & (1 << ph)) ? linearToSrgb8(in[i]) : floatToUnorm8(in[i]);
+		ph = (ph + 1 == QIMAGE_LANE_PERIOD) ? 0 : ph + 1;
+	}
+}
+
+
+
+static void sumRows8SSE2(const unsigned char* const* rows, unsigned int nRows, unsigned int n, unsigned short* out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int i = 0;
+	for(; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&rows[0][i]);
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		for(unsigned int r = 1; r < nRows; ++r)
+		{
+			v = _mm_loadu_si128((const __m128i*)&rows[r][i]);
+			lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+			hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+		}
+		_mm_storeu_si128((__m128i*)&out[i], lo);
+		_mm_storeu_si128((__m128i*)&out[i + 8], hi);
+	}
+
+	if(i < n)
+	{
+		const unsigned char* tail[4];
+		for(unsigned int r = 0; r < nRows; ++r)
+			tail[r] = rows[r] + i;
+		sumRows8Scalar(tail, nRows, n - i, &out[i]);
+	}
+}
+
+// Adds pixel pairs of 1, 2 or 4 channel u16 sums. Each step yields 8 sums, two steps are packed //
+// into one 16 byte store. 3 channel pixels straddle the registers, those stay scalar.            //
+static inline __m128i pairSum8Step(const unsigned short* p, unsigned int c)
+{
+	__m128i a = _mm_loadu_si128((const __m128i*)p);
+	__m128i b = _mm_loadu_si128((const __m128i*)(p + 8));
+
+	if(c == 4)
+		return _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+
+	if(c == 2)
+	{
+		a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+		b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+		return _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+	}
+
+	const __m128i lowMask = _mm_set1_epi32(0x0000FFFF);
+	__m128i sa = _mm_add_epi32(_mm_and_si128(a, lowMask), _mm_srli_epi32(a, 16));
+	__m128i sb = _mm_add_epi32(_mm_and_si128(b, lowMask), _mm_srli_epi32(b, 16));
+	return _mm_packs_epi32(sa, sb);
+}
+
+static void pairSum8SSE2(const unsigned short* in, unsigned int c, unsigned int dw, unsigned int shift, unsigned char* out)
+{
+	unsigned int x = 0;
+	if(c == 1 || c == 2 || c == 4)
+	{
+		const __m128i round = _mm_set1_epi16((short)((1 << shift) >> 1));
+		const __m128i sh = _mm_cvtsi32_si128(shift);
+		unsigned int step = 8 / c;
+
+		for(; x + 2 * step <= dw; x += 2 * step)
+		{
+			const unsigned short* p = &in[x * 2 * c];
+			__m128i s0 = _mm_srl_epi16(_mm_add_epi16(pairSum8Step(p, c), round), sh);
+			__m128i s1 = _mm_srl_epi16(_mm_add_epi16(pairSum8Step(p + 16, c), round), sh);
+			_mm_storeu_si128((__m128i*)&out[x * c], _mm_packus_epi16(s0, s1));
+		}
+	}
+
+	if(x < dw)
+		pairSum8Scalar(&in[x * 2 * c], c, dw - x, shift, &out[x * c]);
+}
+
+static void sumRows16SSE2(const unsigned short* const* rows, unsigned int nRows, unsigned int n, unsigned int* out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int i = 0;
+	for(; i + 8 <= n; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&rows[0][i]);
+		__m128i lo = _mm_unpacklo_epi16(v, zero);
+		__m128i hi = _mm_unpackhi_epi16(v, zero);
+		for(unsigned int r = 1; r < nRows; ++r)
+		{
+			v = _mm_loadu_si128((const __m128i*)&rows[r][i]);
+			lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(v, zero));
+			hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(v, zero));
+		}
+		_mm_storeu_si128((__m128i*)&out[i], lo);
+		_mm_storeu_si128((__m128i*)&out[i + 4], hi);
+	}
+
+	if(i < n)
+	{
+		const unsigned short* tail[4];
+		for(unsigned int r = 0; r < nRows; ++r)
+			tail[r] = rows[r] + i;
+		sumRows16Scalar(tail, nRows, n - i, &out[i]);
+	}
+}
+
+// Same pairing as the 8 bit version on u32 sums, 4 sums per step //
+static inline __m128i pairSum16Step(const unsigned int* p, unsigned int c)
+{
+	__m128i a = _mm_loadu_si128((const __m128i*)p);
+	__m128i b = _mm_loadu_si128((const __m128i*)(p + 4));
+
+	if(c == 4)
+		return _mm_add_epi32(a, b);
+	if(c == 2)
+		return _mm_add_epi32(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+
+	__m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+	__m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm_add_epi32(even, odd);
+}
+
+static void pairSum16SSE2(const unsigned int* in, unsigned int c, unsigned int dw, unsigned int shift, unsigned short* out)
+{
+	unsigned int x = 0;
+	if(c == 1 || c == 2 || c == 4)
+	{
+		const __m128i round = _mm_set1_epi32((1 << shift) >> 1);
+		const __m128i sh = _mm_cvtsi32_si128(shift);
+		const __m128i bias = _mm_set1_epi32(0x8000);
+		const __m128i unbias = _mm_set1_epi16((short)0x8000);
+		unsigned int step = 4 / c;
+
+		// SSE2 has no unsigned 32 -> 16 pack, bias into the signed range and back //
+		for(; x + 2 * step <= dw; x += 2 * step)
+		{
+			const unsigned int* p = &in[x * 2 * c];
+			__m128i s0 = _mm_srl_epi32(_mm_add_epi32(pairSum16Step(p, c), round), sh);
+			__m128i s1 = _mm_srl_epi32(_mm_add_epi32(pairSum16Step(p + 8, c), round), sh);
+			__m128i packed = _mm_packs_epi32(_mm_sub_epi32(s0, bias), _mm_sub_epi32(s1, bias));
+			_mm_storeu_si128((__m128i*)&out[x * c], _mm_xor_si128(packed, unbias));
+		}
+	}
+
+	if(x < dw)
+		pairSum16Scalar(&in[x * 2 * c], c, dw - x, shift, &out[x * c]);
+}
+
+static void sumRowsFloatSSE(const float* const* rows, unsigned int nRows, unsigned int n, float* out)
+{
+	unsigned int i = 0;
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128 s = _mm_loadu_ps(&rows[0][i]);
+		for(unsigned int r = 1; r < nRows; ++r)
+			s = _mm_add_ps(s, _mm_loadu_ps(&rows[r][i]));
+		_mm_storeu_ps(&out[i], s);
+	}
+
+	if(i < n)
+	{
+		const float* tail[4];
+		for(unsigned int r = 0; r < nRows; ++r)
+			tail[r] = rows[r] + i;
+		sumRowsFloatScalar(tail, nRows, n - i, &out[i]);
+	}
+}
+
+static void pairSumFloatSSE(const float* in, unsigned int c, unsigned int dw, float scale, float* out)
+{
+	const __m128 s = _mm_set1_ps(scale);
+	unsigned int x = 0;
+
+	if(c == 4)
+	{
+		for(; x < dw; ++x)
+			_mm_storeu_ps(&out[x * 4], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&in[x * 8]), _mm_loadu_ps(&in[x * 8 + 4])), s));
+	}
+	else if(c == 2)
+	{
+		for(; x + 2 <= dw; x += 2)
+		{
+			__m128 a = _mm_loadu_ps(&in[x * 4]);
+			__m128 b = _mm_loadu_ps(&in[x * 4 + 4]);
+			_mm_storeu_ps(&out[x * 2], _mm_mul_ps(_mm_add_ps(_mm_movelh_ps(a, b), _mm_movehl_ps(b, a)), s));
+		}
+	}
+	else if(c == 1)
+	{
+		for(; x + 4 <= dw; x += 4)
+		{
+			__m128 a = _mm_loadu_ps(&in[x * 2]);
+			__m128 b = _mm_loadu_ps(&in[x * 2 + 4]);
+			__m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_ps(&out[x], _mm_mul_ps(_mm_add_ps(even, odd), s));
+		}
+	}
+
+	if(x < dw)
+		pairSumFloatScalar(&in[x * 2 * c], c, dw - x, scale, &out[x * c]);
+}
+
+static void accumulateFloatSSE(float* acc, const float* row, float weight, unsigned int n)
+{
+	const __m128 w = _mm_set1_ps(weight);
+	unsigned int i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm_storeu_ps(&acc[i], _mm_add_ps(_mm_loadu_ps(&acc[i]), _mm_mul_ps(_mm_loadu_ps(&row[i]), w)));
+	for(; i < n; ++i)
+		acc[i] += row[i] * weight;
+}
+
+// Half <-> float without F16C. Exponent and mantissa are shifted into place and rebiased with a  //
+// float multiply, which also renormalizes denormals, inf / nan get their exponent patched back. //
+static inline __m128 halfToFloat4(const __m128i& h)
+{
+	const __m128i expMant = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+	const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+	const __m128i infNan = _mm_and_si128(_mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7BFF)), _mm_set1_epi32(255 << 23));
+	const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expMant), 16);
+	return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan)));
+}
+
+static void halfToFloatSSE2(const unsigned short* in, float* out, unsigned int n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int i = 0;
+	for(; i + 8 <= n; i += 8)
+	{
+		__m128i h = _mm_loadu_si128((const __m128i*)&in[i]);
+		_mm_storeu_ps(&out[i], halfToFloat4(_mm_unpacklo_epi16(h, zero)));
+		_mm_storeu_ps(&out[i + 4], halfToFloat4(_mm_unpackhi_epi16(h, zero)));
+	}
+	for(; i < n; ++i)
+		out[i] = QIMAGE_HALF_TO_FLOAT(in[i]);
+}
+
+// Round to nearest even. Results below the half normal range are rounded by adding a magic float //
+// whose ulp is the half denormal step, normal results by adding 0xFFF (+1 when the kept mantissa //
+// is odd) before truncating 13 bits. Values at or above 65536 and nan go to the special codes.    //
+static inline __m128i floatToHalf4(const __m128& f)
+{
+	const __m128 justSign = _mm_and_ps(f, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+	const __m128 absF = _mm_xor_ps(f, justSign);
+	const __m128i absI = _mm_castps_si128(absF);
+
+	const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+	const __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), absI);
+	const __m128i infOrNan = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7C00));
+
+	const __m128i subMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	const __m128i isSub = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), absI);
+	const __m128i sub = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subMagic))), subMagic);
+
+	const __m128i mantOdd = _mm_srai_epi32(_mm_slli_epi32(absI, 31 - 13), 31);
+	const __m128i rounded = _mm_sub_epi32(_mm_add_epi32(absI, _mm_set1_epi32(0xFFF - ((127 - 15) << 23))), mantOdd);
+	const __m128i normal = _mm_srli_epi32(rounded, 13);
+
+	const __m128i finite = _mm_or_si128(_mm_and_si128(isSub, sub), _mm_andnot_si128(isSub, normal));
+	const __m128i joined = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infOrNan));
+	return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(justSign), 16));
+}
+
+static void floatToHalfSSE2(const float* in, unsigned short* out, unsigned int n)
+{
+	unsigned int i = 0;
+	for(; i + 8 <= n; i += 8)
+	{
+		__m128i lo = floatToHalf4(_mm_loadu_ps(&in[i]));
+		__m128i hi = floatToHalf4(_mm_loadu_ps(&in[i + 4]));
+		_mm_storeu_si128((__m128i*)&out[i], _mm_packs_epi32(lo, hi));
+	}
+	for(; i < n; ++i)
+		out[i] = QIMAGE_FLOAT_TO_HALF(in[i]);
+}
+
+// SSE2 has no gathers, the 4 table reads of a vector are scalar loads and the rest is vector work //
+static void decodeRow8SSE2(const float* const* tables, const unsigned char* row, float weight, bool first, unsigned int n, float* acc)
+{
+	const __m128 w = _mm_set1_ps(weight);
+	unsigned int i = 0, ph = 0;
+
+	// Every vector sees the same tables unless there are 3 channels, those stay in registers //
+	if(tables[0] == tables[4] && tables[1] == tables[5] && tables[2] == tables[6] && tables[3] == tables[7])
+	{
+		const float* t0 = tables[0];
+		const float* t1 = tables[1];
+		const float* t2 = tables[2];
+		const float* t3 = tables[3];
+		for(; i + 4 <= n; i += 4)
+		{
+			__m128 v = _mm_mul_ps(_mm_setr_ps(t0[row[i]], t1[row[i + 1]], t2[row[i + 2]], t3[row[i + 3]]), w);
+			_mm_storeu_ps(&acc[i], first ? v : _mm_add_ps(_mm_loadu_ps(&acc[i]), v));
+		}
+	}
+
+	for(; i + 4 <= n; i += 4)
+	{
+		const float* const* t = &tables[ph];
+		__m128 v = _mm_mul_ps(_mm_setr_ps(t[0][row[i]], t[1][row[i + 1]], t[2][row[i + 2]], t[3][row[i + 3]]), w);
+		_mm_storeu_ps(&acc[i], first ? v : _mm_add_ps(_mm_loadu_ps(&acc[i]), v));
+		ph = (ph + 4 == QIMAGE_LANE_PERIOD) ? 0 : ph + 4;
+	}
+
+	ph = i % QIMAGE_LANE_PERIOD;
+
+	for(; i < n; ++i, ++ph)
+	{
+		float v = tables[ph][row[i]] * weight;
+		acc[i] = first ? v : acc[i] + v;
+	}
+}
+
+// Clamping, scaling and rounding run 4 wide. sRGB lanes look up their bucket and threshold with //
+// scalar loads and are blended over the linear result, vectors without sRGB lanes skip that.    //
+static void encodeRow8SSE2(const float* in, unsigned int srgbLanes, unsigned int n, unsigned char* out)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0F);
+	const __m128 scale = _mm_set1_ps(255.0F);
+	const __m128 round = _mm_set1_ps(0.5F);
+	const __m128 buckets = _mm_set1_ps((float)QIMAGE_SRGB_BUCKETS);
+
+	__m128i laneMask[QIMAGE_LANE_PERIOD / 4];
+	for(unsigned int p = 0; p < QIMAGE_LANE_PERIOD / 4; ++p)
+	{
+		unsigned int bits = srgbLanes >> (p * 4);
+		laneMask[p] = _mm_setr_epi32(-(int)(bits & 1), -(int)((bits >> 1) & 1), -(int)((bits >> 2) & 1), -(int)((bits >> 3) & 1));
+	}
+
+	QMATH_ALIGN(16) int idx[4];
+	unsigned int i = 0, ph = 0;
+	for(; i + 4 <= n; i += 4)
+	{
+		// max returns its second operand for NaN, which sends NaN to 0 like the scalar clamp //
+		__m128 c = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&in[i]), zero), one);
+		__m128i codes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, scale), round));
+
+		if((srgbLanes >> ph) & 0xF)
+		{
+			_mm_store_si128((__m128i*)idx, _mm_cvttps_epi32(_mm_mul_ps(c, buckets)));
+			__m128i code = _mm_setr_epi32(s_linearToSrgb8[idx[0]], s_linearToSrgb8[idx[1]], s_linearToSrgb8[idx[2]], s_linearToSrgb8[idx[3]]);
+			__m128 next = _mm_setr_ps(s_linearToSrgb8Next[idx[0]], s_linearToSrgb8Next[idx[1]], s_linearToSrgb8Next[idx[2]], s_linearToSrgb8Next[idx[3]]);
+
+			// The compare gives -1 where the next code is reached //
+			__m128i srgb = _mm_sub_epi32(code, _mm_castps_si128(_mm_cmpge_ps(c, next)));
+			const __m128i& m = laneMask[ph >> 2];
+			codes = _mm_or_si128(_mm_and_si128(m, srgb), _mm_andnot_si128(m, codes));
+		}
+
+		__m128i packed = _mm_packs_epi32(codes, codes);
+		int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+		memcpy(&out[i], &bytes, 4);
+		ph = (ph + 4 == QIMAGE_LANE_PERIOD) ? 0 : ph + 4;
+	}
+
+	for(; i < n; ++i, ++ph)
+		out[i] = (srgbLanes & (1 << ph)) ? linearToSrgb8(in[i]) : floatToUnorm8(in[i]);
+}
+
+
+
+struct qimageKernelTable
+{
+	void (*sumRows8)(const unsigned char* const* rows, unsigned int nRows, unsigned int n, unsigned short* out);
+	void (*pairSum8)(const unsigned short* in, unsigned int c, unsigned int dw, unsigned int shift, unsigned char* out);
+	void (*sumRows16)(const unsigned short* const* rows, unsigned int nRows, unsigned int n, unsigned int* out);
+	void (*pairSum16)(const unsigned int* in, unsigned int c, unsigned int dw, unsigned int shift, unsigned short* out);
+	void (*sumRowsFloat)(const float* const* rows, unsigned int nRows, unsigned int n, float* out);
+	void (*pairSumFloat)(const float* in, unsigned int c, unsigned int dw, float scale, float* out);
+	void (*accumulateFloat)(float* acc, const float* row, float weight, unsigned int n);
+	void (*halfToFloat)(const unsigned short* in, float* out, unsigned int n);
+	void (*floatToHalf)(const float* in, unsigned short* out, unsigned int n);
+	void (*decodeRow8)(const float* const* tables, const unsigned char* row, float weight, bool first, unsigned int n, float* acc);
+	void (*encodeRow8)(const float* in, unsigned int srgbLanes, unsigned int n, unsigned char* out);
+};
+
+static const qimageKernelTable s_scalarKernels =
+{
+	sumRows8Scalar, pairSum8Scalar,
+	sumRows16Scalar, pairSum16Scalar,
+	sumRowsFloatScalar, pairSumFloatScalar, accumulateFloatScalar,
+	halfToFloatScalar, floatToHalfScalar,
+	decodeRow8Scalar, encodeRow8Scalar,
+};
+
+static const qimageKernelTable s_sseKernels =
+{
+	sumRows8SSE2, pairSum8SSE2,
+	sumRows16SSE2, pairSum16SSE2,
+	sumRowsFloatSSE, pairSumFloatSSE, accumulateFloatSSE,
+	halfToFloatSSE2, floatToHalfSSE2,
+	decodeRow8SSE2, encodeRow8SSE2,
+};
+
+// AVX1 has no 256 bit integer ops and the horizontal pairing needs in-lane shuffles that do not //
+// widen, so AVX only replaces the element wise float passes                                      //
+static const qimageKernelTable s_avxKernels =
+{
+	sumRows8SSE2, pairSum8SSE2,
+	sumRows16SSE2, pairSum16SSE2,
+	qimageSumRowsFloatAVX, pairSumFloatSSE, qimageAccumulateFloatAVX,
+	halfToFloatSSE2, floatToHalfSSE2,
+	decodeRow8SSE2, encodeRow8SSE2,
+};
+
+// Follows the qmath level so QMATH_SET_SIMD_LEVEL can force a path. The integer kernels need SSE2 //
+static const qimageKernelTable* qimageGetKernels()
+{
+	switch(QMATH_GET_SIMD_LEVEL())
+	{
+		case QMATH_SIMD_AVX:	return &s_avxKernels;
+		case QMATH_SIMD_SSE:	return QCPU_HAS_FEATURE(QCPU_FEATURE_SSE2) ? &s_sseKernels : &s_scalarKernels;
+		default:				return &s_scalarKernels;
+	}
+}
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// MIP GENERATION
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Minimum number of source channel values handed to one thread //
+#define QIMAGE_MIP_GRAIN		65536
+
+
+// Source texels under one destination texel along an axis. With n source texels and m = n / 2 //
+// destination texels, texel i covers [i * n / m, (i + 1) * n / m), at most 3 source texels.   //
+struct qimageMipAxis
+{
+	unsigned int	first;
+	unsigned int	nTaps;
+	float			weight[3];
+};
+
+static void qimageBuildMipAxis(const unsigned int& n, qimageMipAxis* axis)
+{
+	unsigned int m = (n > 1) ? (n >> 1) : 1;
+
+	// Work in units of 1 / m so the footprints are exact integers //
+	for(unsigned int i = 0; i < m; ++i)
+	{
+		unsigned int lo = i * n;
+		unsigned int hi = (i + 1) * n;
+		unsigned int first = lo / m;
+		unsigned int last = (hi - 1) / m;
+
+		axis[i].first = first;
+		axis[i].nTaps = last - first + 1;
+		for(unsigned int j = first; j <= last; ++j)
+		{
+			unsigned int l = (j * m > lo) ? j * m : lo;
+			unsigned int h = ((j + 1) * m < hi) ? (j + 1) * m : hi;
+			axis[i].weight[j - first] = (float)(h - l) / (float)n;
+		}
+	}
+}
+
+
+struct qimageMipJob
+{
+	const unsigned char*		src;
+	unsigned char*				dst;
+	unsigned int				w, h, d;
+	unsigned int				dw, dh, dd;
+	unsigned int				nChannels;
+	unsigned int				channelSize;
+	unsigned int				srgbMask;
+	QIMAGE_CHANNEL_TYPE			type;
+	bool						boxOnly;		// every axis even (or 1) and no sRGB channels
+	qimageMipAxis*				xAxis;
+	qimageMipAxis*				yAxis;
+	qimageMipAxis*				zAxis;
+	const qimageKernelTable*	kernels;
+};
+
+
+// 8 bit rows are decoded through the per channel tables straight into the accumulator, the first //
+// tap assigns so the accumulator needs no clearing                                                //
+static void qimageAccumulateRow8(const qimageMipJob& job, const unsigned char* row, float weight, bool first, float* acc)
+{
+	const float* tables[QIMAGE_LANE_PERIOD];
+	for(unsigned int i = 0; i < QIMAGE_LANE_PERIOD; ++i)
+		tables[i] = (job.srgbMask & (1 << (i % job.nChannels))) ? s_srgb8ToLinear : s_unorm8ToFloat;
+
+	job.kernels->decodeRow8(tables, row, weight, first, job.w * job.nChannels, acc);
+}
+
+// Converts one 16 bit source row to float //
+static void qimageDecodeRow(const qimageMipJob& job, const unsigned char* row, float* out)
+{
+	unsigned int n = job.w * job.nChannels;
+	const unsigned short* s = (const unsigned short*)row;
+
+	if(job.type == QIMAGE_CHANNEL_HALF)
+		job.kernels->halfToFloat(s, out, n);
+	else
+	{
+		for(unsigned int i = 0; i < n; ++i)
+			out[i] = (float)s[i] * (1.0F / 65535.0F);
+	}
+}
+
+// Converts one filtered row back to the storage type //
+static void qimageEncodeRow(const qimageMipJob& job, const float* in, unsigned char* row)
+{
+	unsigned int c = job.nChannels;
+	unsigned int n = job.dw * c;
+
+	if(job.type == QIMAGE_CHANNEL_UNORM8)
+	{
+		unsigned int srgbLanes = 0;
+		for(unsigned int i = 0; i < QIMAGE_LANE_PERIOD; ++i)
+			srgbLanes |= ((job.srgbMask >> (i % c)) & 1) << i;
+
+		job.kernels->encodeRow8(in, srgbLanes, n, row);
+	}
+	else if(job.type == QIMAGE_CHANNEL_UNORM16)
+	{
+		unsigned short* d = (unsigned short*)row;
+		for(unsigned int i = 0; i < n; ++i)
+			d[i] = floatToUnorm16(in[i]);
+	}
+	else if(job.type == QIMAGE_CHANNEL_HALF)
+		job.kernels->floatToHalf(in, (unsigned short*)row, n);
+	else
+		memcpy(row, in, n * sizeof(float));
+}
+
+
+static void qimageMipRows(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	const qimageMipJob& job = *(const qimageMipJob*)data;
+	const qimageKernelTable* k = job.kernels;
+
+	unsigned int c = job.nChannels;
+	unsigned int rowElems = job.w * c;
+	unsigned int rowBytes = rowElems * job.channelSize;
+	unsigned int dstRowBytes = job.dw * c * job.channelSize;
+	unsigned int rowsPerImage = job.dd * job.dh;
+
+	// Every scratch row has room for the widest source row as floats (u16 / u32 sums fit as well). //
+	// Half floats are boxed from up to 4 decoded rows                                             //
+	bool decodeRows = !job.boxOnly || job.type == QIMAGE_CHANNEL_HALF;
+	float* acc = new float[rowElems + 16];
+	float* lin = decodeRows ? new float[(job.boxOnly ? 4 : 1) * rowElems + 16] : NULL;
+	float* res = decodeRows ? new float[job.dw * c + 16] : NULL;
+
+	for(unsigned int r = begin; r < end; ++r)
+	{
+		unsigned int image = r / rowsPerImage;
+		unsigned int z = (r % rowsPerImage) / job.dh;
+		unsigned int y = r % job.dh;
+		unsigned char* dst = job.dst + (size_t)r * dstRowBytes;
+
+		const qimageMipAxis& za = job.zAxis[z];
+		const qimageMipAxis& ya = job.yAxis[y];
+
+		if(job.boxOnly)
+		{
+			// Every tap has the same weight, collect the 1, 2 or 4 source rows and divide by a shift //
+			const unsigned char* rows[4];
+			unsigned int nRows = 0;
+			for(unsigned int tz = 0; tz < za.nTaps; ++tz)
+			{
+				for(unsigned int ty = 0; ty < ya.nTaps; ++ty)
+				{
+					size_t srcRow = ((size_t)image * job.d + za.first + tz) * job.h + ya.first + ty;
+					rows[nRows++] = job.src + srcRow * rowBytes;
+				}
+			}
+
+			unsigned int fx = (job.w > 1) ? 2 : 1;
+			unsigned int shift = 0;
+			while((1U << shift) < nRows * fx)
+				++shift;
+
+			if(job.type == QIMAGE_CHANNEL_UNORM8)
+			{
+				unsigned short* sum = (unsigned short*)acc;
+				k->sumRows8(rows, nRows, rowElems, sum);
+				if(fx == 2)
+					k->pairSum8(sum, c, job.dw, shift, dst);
+				else
+				{
+					for(unsigned int i = 0; i < c; ++i)
+						dst[i] = (unsigned char)((sum[i] + ((1U << shift) >> 1)) >> shift);
+				}
+			}
+			else if(job.type == QIMAGE_CHANNEL_UNORM16)
+			{
+				unsigned int* sum = (unsigned int*)acc;
+				k->sumRows16((const unsigned short* const*)rows, nRows, rowElems, sum);
+				if(fx == 2)
+					k->pairSum16(sum, c, job.dw, shift, (unsigned short*)dst);
+				else
+				{
+					for(unsigned int i = 0; i < c; ++i)
+						((unsigned short*)dst)[i] = (unsigned short)((sum[i] + ((1U << shift) >> 1)) >> shift);
+				}
+			}
+			else if(job.type == QIMAGE_CHANNEL_HALF)
+			{
+				const float* decoded[4];
+				for(unsigned int i = 0; i < nRows; ++i)
+				{
+					decoded[i] = lin + i * rowElems;
+					k->halfToFloat((const unsigned short*)rows[i], lin + i * rowElems, rowElems);
+				}
+
+				float scale = 1.0F / (float)(nRows * fx);
+				k->sumRowsFloat(decoded, nRows, rowElems, acc);
+				if(fx == 2)
+					k->pairSumFloat(acc, c, job.dw, scale, res);
+				else
+				{
+					for(unsigned int i = 0; i < c; ++i)
+						res[i] = acc[i] * scale;
+				}
+
+				k->floatToHalf(res, (unsigned short*)dst, job.dw * c);
+			}
+			else
+			{
+				float scale = 1.0F / (float)(nRows * fx);
+				k->sumRowsFloat((const float* const*)rows, nRows, rowElems, acc);
+				if(fx == 2)
+					k->pairSumFloat(acc, c, job.dw, scale, (float*)dst);
+				else
+				{
+					for(unsigned int i = 0; i < c; ++i)
+						((float*)dst)[i] = acc[i] * scale;
+				}
+			}
+
+			continue;
+		}
+
+		// General path, weighted taps on linear float rows //
+		if(job.type != QIMAGE_CHANNEL_UNORM8)
+			memset(acc, 0, rowElems * sizeof(float));
+
+		for(unsigned int tz = 0; tz < za.nTaps; ++tz)
+		{
+			for(unsigned int ty = 0; ty < ya.nTaps; ++ty)
+			{
+				size_t srcRow = ((size_t)image * job.d + za.first + tz) * job.h + ya.first + ty;
+				const unsigned char* row = job.src + srcRow * rowBytes;
+				float weight = za.weight[tz] * ya.weight[ty];
+
+				if(job.type == QIMAGE_CHANNEL_UNORM8)
+					qimageAccumulateRow8(job, row, weight, tz == 0 && ty == 0, acc);
+				else if(job.type == QIMAGE_CHANNEL_FLOAT)
+					k->accumulateFloat(acc, (const float*)row, weight, rowElems);
+				else
+				{
+					qimageDecodeRow(job, row, lin);
+					k->accumulateFloat(acc, lin, weight, rowElems);
+				}
+			}
+		}
+
+		float* out = (job.type == QIMAGE_CHANNEL_FLOAT) ? (float*)dst : res;
+		if(job.w == 1)
+			memcpy(out, acc, c * sizeof(float));
+		else if(!(job.w & 1))
+			k->pairSumFloat(acc, c, job.dw, 0.5F, out);
+		else
+		{
+			for(unsigned int x = 0; x < job.dw; ++x)
+			{
+				const qimageMipAxis& xa = job.xAxis[x];
+				const float* p = &acc[xa.first * c];
+				for(unsigned int i = 0; i < c; ++i)
+				{
+					float s = 0.0F;
+					for(unsigned int t = 0; t < xa.nTaps; ++t)
+						s += p[t * c + i] * xa.weight[t];
+					out[x * c + i] = s;
+				}
+			}
+		}
+
+		if(job.type != QIMAGE_CHANNEL_FLOAT)
+			qimageEncodeRow(job, res, dst);
+	}
+
+	delete[] acc;
+	delete[] lin;
+	delete[] res;
+}
+
+
+
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_MIP_DIMENSION(const unsigned int& dim, const unsigned int& level)
+{
+	unsigned int a = (level < 32) ? (dim >> level) : 0;
+	return (a == 0) ? 1 : a;
+}
+
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_MIP_COUNT(const unsigned int& w, const unsigned int& h, const unsigned int& d)
+{
+	unsigned int maxDim = w;
+	if(h > maxDim) maxDim = h;
+	if(d > maxDim) maxDim = d;
+
+	unsigned int n = 0;
+	while(maxDim > 0)
+	{
+		maxDim >>= 1;
+		++n;
+	}
+	return n;
+}
+
+
+QIMAGEEXPORT_API void QIMAGE_GENERATE_MIP(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& d, const unsigned int& nImages,
+										  const unsigned int& nChannels, const QIMAGE_CHANNEL_TYPE& type, const unsigned int& srgbMask)
+{
+	if(!src || !dst || !w || !h || !d || !nImages || !nChannels || nChannels > 4)
+		return;
+
+	static const unsigned int channelSizes[] = { 1, 2, 2, 4 };
+
+	qimageMipJob job;
+	job.src = (const unsigned char*)src;
+	job.dst = (unsigned char*)dst;
+	job.w = w;
+	job.h = h;
+	job.d = d;
+	job.dw = QIMAGE_GET_MIP_DIMENSION(w, 1);
+	job.dh = QIMAGE_GET_MIP_DIMENSION(h, 1);
+	job.dd = QIMAGE_GET_MIP_DIMENSION(d, 1);
+	job.nChannels = nChannels;
+	job.channelSize = channelSizes[type];
+	job.type = type;
+	job.srgbMask = (type == QIMAGE_CHANNEL_UNORM8) ? (srgbMask & ((1U << nChannels) - 1)) : 0;
+	job.kernels = qimageGetKernels();
+
+	bool evenAxes = (w == 1 || !(w & 1)) && (h == 1 || !(h & 1)) && (d == 1 || !(d & 1));
+	job.boxOnly = evenAxes && !job.srgbMask;
+
+	job.xAxis = new qimageMipAxis[job.dw + job.dh + job.dd];
+	job.yAxis = job.xAxis + job.dw;
+	job.zAxis = job.yAxis + job.dh;
+	qimageBuildMipAxis(w, job.xAxis);
+	qimageBuildMipAxis(h, job.yAxis);
+	qimageBuildMipAxis(d, job.zAxis);
+
+	unsigned int nRows = nImages * job.dd * job.dh;
+	unsigned int grain = QIMAGE_MIP_GRAIN / (w * nChannels * 2) + 1;
+	QPARALLEL_FOR(nRows, grain, qimageMipRows, &job);
+
+	delete[] job.xAxis;
+}
+
+QIMAGEEXPORT_API unsigned int QIMAGE_GENERATE_MIP_CHAIN(void* pixels, const unsigned int& w, const unsigned int& h, const unsigned int& d, const unsigned int& nImages,
+														const unsigned int& nLevels, const unsigned int& nChannels, const QIMAGE_CHANNEL_TYPE& type, const unsigned int& srgbMask)
+{
+	static const unsigned int channelSizes[] = { 1, 2, 2, 4 };
+
+	unsigned int maxLevels = QIMAGE_GET_MIP_COUNT(w, h, d);
+	unsigned int levels = (nLevels < maxLevels) ? nLevels : maxLevels;
+	if(levels < 1)
+		levels = 1;
+
+	unsigned char* src = (unsigned char*)pixels;
+	unsigned int lw = w, lh = h, ld = d;
+	for(unsigned int i = 1; i < levels; ++i)
+	{
+		size_t size = (size_t)lw * lh * ld * nImages * nChannels * channelSizes[type];
+		QIMAGE_GENERATE_MIP(src, src + size, lw, lh, ld, nImages, nChannels, type, srgbMask);
+
+		src += size;
+		lw = QIMAGE_GET_MIP_DIMENSION(lw, 1);
+		lh = QIMAGE_GET_MIP_DIMENSION(lh, 1);
+		ld = QIMAGE_GET_MIP_DIMENSION(ld, 1);
+	}
+
+	return levels;
+}
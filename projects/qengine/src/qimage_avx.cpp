@@ -0,0 +1,156 @@
+#include "stdafx.h"
+#include "qimage.h"
+#include "qimage_simd.h"
+
+#include <immintrin.h>
+#include <math.h>
+
+
+// This file is compiled with /arch:AVX. Nothing in here may be called unless //
+// QCPU_FEATURE_AVX was reported, qimage only installs these kernels in that case. //
+
+void qimageSumRowsFloatAVX(const float* const* rows, unsigned int nRows, unsigned int n, float* out)
+{
+	unsigned int i = 0;
+	for(; i + 8 <= n; i += 8)
+	{
+		__m256 s = _mm256_loadu_ps(&rows[0][i]);
+		for(unsigned int r = 1; r < nRows; ++r)
+			s = _mm256_add_ps(s, _mm256_loadu_ps(&rows[r][i]));
+		_mm256_storeu_ps(&out[i], s);
+	}
+
+	for(; i < n; ++i)
+	{
+		float s = rows[0][i];
+		for(unsigned int r = 1; r < nRows; ++r)
+			s += rows[r][i];
+		out[i] = s;
+	}
+
+	_mm256_zeroupper();
+}
+
+void qimageAccumulateFloatAVX(float* acc, const float* row, float weight, unsigned int n)
+{
+	const __m256 w = _mm256_set1_ps(weight);
+	unsigned int i = 0;
+	for(; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(&acc[i], _mm256_add_ps(_mm256_loadu_ps(&acc[i]), _mm256_mul_ps(_mm256_loadu_ps(&row[i]), w)));
+	for(; i < n; ++i)
+		acc[i] += row[i] * weight;
+
+	_mm256_zeroupper();
+}
+
+
+// The block decoders only need the VEX encoded 128 bit integer ops, so no zeroupper is required //
+
+void qimageDecodeColorBlockAVX(const unsigned char* palette, unsigned int indices, unsigned char* out)
+{
+	const __m128i pal = _mm_loadu_si128((const __m128i*)palette);
+	const __m128i three = _mm_set1_epi32(3);
+	const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+	const __m128i byteOffset = _mm_set1_epi32(0x03020100);
+
+	// lane l holds the indices shifted so texel 4r + l sits at bit 8r //
+	const __m128i idx = _mm_set_epi32((int)(indices >> 6), (int)(indices >> 4), (int)(indices >> 2), (int)indices);
+
+	for(unsigned int r = 0; r < 4; ++r)
+	{
+		// entry * 4 in every byte of the texel, plus the byte offset within the entry //
+		__m128i sel = _mm_slli_epi32(_mm_and_si128(_mm_srl_epi32(idx, _mm_cvtsi32_si128(r * 8)), three), 2);
+		__m128i ctrl = _mm_add_epi8(_mm_shuffle_epi8(sel, spread), byteOffset);
+		_mm_storeu_si128((__m128i*)&out[r * 16], _mm_shuffle_epi8(pal, ctrl));
+	}
+}
+
+void qimageDecodeAlphaBlockAVX(const unsigned char* block, const unsigned char* palette, unsigned char* out)
+{
+	// Every 16 bit lane gathers the two bytes holding its 3 bit index, index i starts at bit 3i //
+	const __m128i bytesLo = _mm_setr_epi8(2, 3, 2, 3, 2, 3, 3, 4, 3, 4, 3, 4, 4, 5, 4, 5);
+	const __m128i bytesHi = _mm_setr_epi8(5, 6, 5, 6, 5, 6, 6, 7, 6, 7, 6, 7, 7, -128, 7, -128);
+
+	// No per lane shifts before AVX2, shift left by 13 - (3i & 7) with a multiply then right by 13 //
+	const __m128i scale = _mm_setr_epi16(1 << 13, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+
+	const __m128i bits = _mm_loadl_epi64((const __m128i*)block);
+	__m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bits, bytesLo), scale), 13);
+	__m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bits, bytesHi), scale), 13);
+
+	const __m128i pal = _mm_loadl_epi64((const __m128i*)palette);
+	_mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(pal, _mm_packus_epi16(lo, hi)));
+}
+
+void qimageBuildNormalRowAVX(const short* const* smooth, const short* const* deriv, const unsigned char* heights, unsigned int w, float sz, unsigned char* out)
+{
+	const __m256 scale = _mm256_set1_ps(1.0f / (48 * 255));
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 half = _mm256_set1_ps(127.5f);
+	const __m256 szv = _mm256_set1_ps(sz);
+	const __m256 sz2 = _mm256_mul_ps(szv, szv);
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i zero = _mm_setzero_si128();
+
+	unsigned int x = 0;
+	for(; x + 8 <= w; x += 8)
+	{
+		// Vertical pass in 16 bits, see qimage_normal.cpp //
+		__m128i d0 = _mm_loadu_si128((const __m128i*)&deriv[0][x]);
+		__m128i d1 = _mm_loadu_si128((const __m128i*)&deriv[1][x]);
+		__m128i d2 = _mm_loadu_si128((const __m128i*)&deriv[2][x]);
+		__m128i d3 = _mm_loadu_si128((const __m128i*)&deriv[3][x]);
+		__m128i d4 = _mm_loadu_si128((const __m128i*)&deriv[4][x]);
+		__m128i gx = _mm_add_epi16(_mm_add_epi16(d0, d4), _mm_slli_epi16(_mm_add_epi16(d1, d3), 2));
+		gx = _mm_add_epi16(gx, _mm_add_epi16(_mm_slli_epi16(d2, 2), _mm_slli_epi16(d2, 1)));
+
+		__m128i s0 = _mm_loadu_si128((const __m128i*)&smooth[0][x]);
+		__m128i s1 = _mm_loadu_si128((const __m128i*)&smooth[1][x]);
+		__m128i s3 = _mm_loadu_si128((const __m128i*)&smooth[3][x]);
+		__m128i s4 = _mm_loadu_si128((const __m128i*)&smooth[4][x]);
+		__m128i gy = _mm_add_epi16(_mm_sub_epi16(s0, s4), _mm_slli_epi16(_mm_sub_epi16(s1, s3), 1));
+
+		__m256i gx32 = _mm256_insertf128_si256(_mm256_castsi128_si256(_mm_cvtepi16_epi32(gx)), _mm_cvtepi16_epi32(_mm_unpackhi_epi64(gx, gx)), 1);
+		__m256i gy32 = _mm256_insertf128_si256(_mm256_castsi128_si256(_mm_cvtepi16_epi32(gy)), _mm_cvtepi16_epi32(_mm_unpackhi_epi64(gy, gy)), 1);
+
+		__m256 sX = _mm256_mul_ps(_mm256_cvtepi32_ps(gx32), scale);
+		__m256 sY = _mm256_mul_ps(_mm256_cvtepi32_ps(gy32), scale);
+		__m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sX, sX), _mm256_mul_ps(sY, sY)), sz2);
+		__m256 invLen = _mm256_div_ps(one, _mm256_sqrt_ps(len2));
+
+		__m256i r = _mm256_cvttps_epi32(_mm256_mul_ps(half, _mm256_add_ps(_mm256_mul_ps(sX, invLen), one)));
+		__m256i g = _mm256_cvttps_epi32(_mm256_mul_ps(half, _mm256_add_ps(_mm256_mul_ps(sY, invLen), one)));
+		__m256i b = _mm256_cvttps_epi32(_mm256_mul_ps(half, _mm256_add_ps(_mm256_mul_ps(szv, invLen), one)));
+
+		// No 256 bit integer ops, the texels are assembled per half //
+		__m128i h = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&heights[x]), zero);
+		for(unsigned int i = 0; i < 2; ++i)
+		{
+			__m128i ri = _mm_and_si128(i ? _mm256_extractf128_si256(r, 1) : _mm256_castsi256_si128(r), mask);
+			__m128i gi = _mm_and_si128(i ? _mm256_extractf128_si256(g, 1) : _mm256_castsi256_si128(g), mask);
+			__m128i bi = _mm_and_si128(i ? _mm256_extractf128_si256(b, 1) : _mm256_castsi256_si128(b), mask);
+			__m128i hi = i ? _mm_unpackhi_epi16(h, zero) : _mm_unpacklo_epi16(h, zero);
+
+			__m128i n = _mm_or_si128(ri, _mm_slli_epi32(gi, 8));
+			n = _mm_or_si128(n, _mm_slli_epi32(bi, 16));
+			_mm_storeu_si128((__m128i*)&out[x * 4 + i * 16], _mm_or_si128(n, _mm_slli_epi32(hi, 24)));
+		}
+	}
+
+	_mm256_zeroupper();
+
+	for(; x < w; ++x)
+	{
+		int gx = deriv[0][x] + 4 * deriv[1][x] + 6 * deriv[2][x] + 4 * deriv[3][x] + deriv[4][x];
+		int gy = smooth[0][x] + 2 * smooth[1][x] - 2 * smooth[3][x] - smooth[4][x];
+
+		float sX = (float)gx * (1.0f / (48 * 255));
+		float sY = (float)gy * (1.0f / (48 * 255));
+		float invLen = 1.0f / sqrtf(sX * sX + sY * sY + sz * sz);
+
+		out[x * 4 + 0] = (unsigned char)(int)(127.5f * (sX * invLen + 1.0f));
+		out[x * 4 + 1] = (unsigned char)(int)(127.5f * (sY * invLen + 1.0f));
+		out[x * 4 + 2] = (unsigned char)(int)(127.5f * (sz * invLen + 1.0f));
+		out[x * 4 + 3] = heights[x];
+	}
+}
@@ -0,0 +1,250 @@
+#include "stdafx.h"
+#include "qimage.h"
+#include "qimage_simd.h"
+
+#include <immintrin.h>
+
+
+// This file is compiled with /arch:AVX2. Nothing in here may be called unless //
+// QCPU_FEATURE_AVX2 was reported, qimage only installs these kernels in that case. //
+// The 256 bit shuffles work per 128 bit lane, the lane tables below repeat.      //
+
+static const char s_pad3Ctrl[32] =
+{
+	0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128,
+	0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128,
+};
+
+static const char s_pad3SwapCtrl[32] =
+{
+	2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128,
+	2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128,
+};
+
+static const char s_swapRB4Ctrl[32] =
+{
+	2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+	2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+};
+
+// Grey texels 0 - 3 of the lane's source quarter, the second table takes texels 8 - 15 //
+static const char s_greyCtrlLo[32] =
+{
+	0, 0, 0, -128, 1, 1, 1, -128, 2, 2, 2, -128, 3, 3, 3, -128,
+	4, 4, 4, -128, 5, 5, 5, -128, 6, 6, 6, -128, 7, 7, 7, -128,
+};
+
+static const char s_greyCtrlHi[32] =
+{
+	8, 8, 8, -128, 9, 9, 9, -128, 10, 10, 10, -128, 11, 11, 11, -128,
+	12, 12, 12, -128, 13, 13, 13, -128, 14, 14, 14, -128, 15, 15, 15, -128,
+};
+
+
+static inline unsigned char expand5(const unsigned int& v)
+{
+	return (unsigned char)((v << 3) | (v >> 2));
+}
+
+static inline unsigned char expand6(const unsigned int& v)
+{
+	return (unsigned char)((v << 2) | (v >> 4));
+}
+
+
+static inline void swapRB4AVX2(const unsigned char* src, unsigned char* dst, unsigned int n, const bool& opaque)
+{
+	const __m256i ctrl = _mm256_loadu_si256((const __m256i*)s_swapRB4Ctrl);
+	const __m256i alpha = (opaque) ? _mm256_set1_epi32(0xFF000000) : _mm256_setzero_si256();
+
+	unsigned int x = 0;
+	for(; x + 8 <= n; x += 8)
+		_mm256_storeu_si256((__m256i*)&dst[x * 4], _mm256_or_si256(_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)&src[x * 4]), ctrl), alpha));
+
+	_mm256_zeroupper();
+
+	for(; x < n; ++x)
+	{
+		unsigned char c0 = src[x * 4];
+		unsigned char c2 = src[x * 4 + 2];
+		dst[x * 4] = c2;
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = c0;
+		dst[x * 4 + 3] = (opaque) ? 255 : src[x * 4 + 3];
+	}
+}
+
+void qimageSwapRB4AVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	swapRB4AVX2(src, dst, n, false);
+}
+
+void qimageSwapRB4OpaqueAVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	swapRB4AVX2(src, dst, n, true);
+}
+
+void qimageOpaque4AVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+
+	unsigned int x = 0;
+	for(; x + 8 <= n; x += 8)
+		_mm256_storeu_si256((__m256i*)&dst[x * 4], _mm256_or_si256(_mm256_loadu_si256((const __m256i*)&src[x * 4]), alpha));
+
+	_mm256_zeroupper();
+
+	for(; x < n; ++x)
+	{
+		dst[x * 4] = src[x * 4];
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = src[x * 4 + 2];
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+
+// 8 texels per pass, each lane loads 4 packed texels. The upper load reaches 4 bytes past //
+// the 8th texel, hence the 10 texel condition                                             //
+static inline void pad3AVX2(const unsigned char* src, unsigned char* dst, unsigned int n, const char* ctrlBytes)
+{
+	const __m256i ctrl = _mm256_loadu_si256((const __m256i*)ctrlBytes);
+	const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+
+	unsigned int x = 0;
+	for(; x + 10 <= n; x += 8)
+	{
+		const unsigned char* s = &src[x * 3];
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)s)), _mm_loadu_si128((const __m128i*)(s + 12)), 1);
+		_mm256_storeu_si256((__m256i*)&dst[x * 4], _mm256_or_si256(_mm256_shuffle_epi8(v, ctrl), alpha));
+	}
+
+	_mm256_zeroupper();
+
+	for(; x < n; ++x)
+	{
+		dst[x * 4] = src[x * 3 + ctrlBytes[0]];
+		dst[x * 4 + 1] = src[x * 3 + 1];
+		dst[x * 4 + 2] = src[x * 3 + ctrlBytes[2]];
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+void qimagePad3AVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	pad3AVX2(src, dst, n, s_pad3Ctrl);
+}
+
+void qimagePad3SwapRBAVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	pad3AVX2(src, dst, n, s_pad3SwapCtrl);
+}
+
+
+void qimageGreyToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	const __m256i ctrlLo = _mm256_loadu_si256((const __m256i*)s_greyCtrlLo);
+	const __m256i ctrlHi = _mm256_loadu_si256((const __m256i*)s_greyCtrlHi);
+	const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+
+	unsigned int x = 0;
+	for(; x + 16 <= n; x += 16)
+	{
+		__m256i v = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&src[x]));
+		_mm256_storeu_si256((__m256i*)&dst[x * 4], _mm256_or_si256(_mm256_shuffle_epi8(v, ctrlLo), alpha));
+		_mm256_storeu_si256((__m256i*)&dst[x * 4 + 32], _mm256_or_si256(_mm256_shuffle_epi8(v, ctrlHi), alpha));
+	}
+
+	_mm256_zeroupper();
+
+	for(; x < n; ++x)
+	{
+		dst[x * 4] = dst[x * 4 + 1] = dst[x * 4 + 2] = src[x];
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+
+static inline __m256i expand5x16(const __m256i& v)
+{
+	return _mm256_or_si256(_mm256_slli_epi16(v, 3), _mm256_srli_epi16(v, 2));
+}
+
+// Interleaves 16 texels of 16 bit R, G, B and A lanes into RGBA8. The in lane unpacks leave //
+// texels 0 - 3 and 8 - 11 in lo, 4 - 7 and 12 - 15 in hi, the permutes restore the order   //
+static inline void storeRGBA8x16(unsigned char* dst, const __m256i& r, const __m256i& g, const __m256i& b, const __m256i& a)
+{
+	__m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+	__m256i ba = _mm256_or_si256(b, _mm256_slli_epi16(a, 8));
+	__m256i lo = _mm256_unpacklo_epi16(rg, ba);
+	__m256i hi = _mm256_unpackhi_epi16(rg, ba);
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*)(dst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+void qimageR5G6B5ToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	const __m256i mask5 = _mm256_set1_epi16(0x1F);
+	const __m256i mask6 = _mm256_set1_epi16(0x3F);
+	const __m256i alpha = _mm256_set1_epi16(0xFF);
+
+	unsigned int x = 0;
+	for(; x + 16 <= n; x += 16)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)&src[x * 2]);
+		__m256i r = expand5x16(_mm256_srli_epi16(p, 11));
+		__m256i g6 = _mm256_and_si256(_mm256_srli_epi16(p, 5), mask6);
+		__m256i g = _mm256_or_si256(_mm256_slli_epi16(g6, 2), _mm256_srli_epi16(g6, 4));
+		__m256i b = expand5x16(_mm256_and_si256(p, mask5));
+		storeRGBA8x16(&dst[x * 4], r, g, b, alpha);
+	}
+
+	_mm256_zeroupper();
+
+	for(; x < n; ++x)
+	{
+		unsigned int p = src[x * 2] | (src[x * 2 + 1] << 8);
+		dst[x * 4] = expand5(p >> 11);
+		dst[x * 4 + 1] = expand6((p >> 5) & 0x3F);
+		dst[x * 4 + 2] = expand5(p & 0x1F);
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+static inline void x1r5g5b5ToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n, const bool& hasAlpha)
+{
+	const __m256i mask5 = _mm256_set1_epi16(0x1F);
+	const __m256i mask8 = _mm256_set1_epi16(0xFF);
+
+	unsigned int x = 0;
+	for(; x + 16 <= n; x += 16)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)&src[x * 2]);
+		__m256i r = expand5x16(_mm256_and_si256(_mm256_srli_epi16(p, 10), mask5));
+		__m256i g = expand5x16(_mm256_and_si256(_mm256_srli_epi16(p, 5), mask5));
+		__m256i b = expand5x16(_mm256_and_si256(p, mask5));
+		__m256i a = (hasAlpha) ? _mm256_and_si256(_mm256_srai_epi16(p, 15), mask8) : mask8;
+		storeRGBA8x16(&dst[x * 4], r, g, b, a);
+	}
+
+	_mm256_zeroupper();
+
+	for(; x < n; ++x)
+	{
+		unsigned int p = src[x * 2] | (src[x * 2 + 1] << 8);
+		dst[x * 4] = expand5((p >> 10) & 0x1F);
+		dst[x * 4 + 1] = expand5((p >> 5) & 0x1F);
+		dst[x * 4 + 2] = expand5(p & 0x1F);
+		dst[x * 4 + 3] = (!hasAlpha || (p & 0x8000)) ? 255 : 0;
+	}
+}
+
+void qimageX1R5G5B5ToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	x1r5g5b5ToRGBAAVX2(src, dst, n, false);
+}
+
+void qimageA1R5G5B5ToRGBAAVX2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	x1r5g5b5ToRGBAAVX2(src, dst, n, true);
+}
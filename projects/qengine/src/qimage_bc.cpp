@@ -0,0 +1,1001 @@
+#include "stdafx.h"
+#include "qimage.h"
+#include "qmath.h"
+#include "qcpu.h"
+#include "qparallel.h"
+#include "qimage_simd.h"
+
+#include <emmintrin.h>
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// BLOCK TABLES
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Minimum number of 4x4 blocks handed to one thread //
+#define QIMAGE_BLOCK_GRAIN		1024
+
+
+// Endpoint pairs that reproduce an 8 bit value best through the 2/3 : 1/3 palette entry, //
+// used for blocks of a single colour where the two extremes would otherwise be the same  //
+static unsigned char s_match5[256][2];
+static unsigned char s_match6[256][2];
+
+
+static inline int expand5(const int& v)
+{
+	return (v << 3) | (v >> 2);
+}
+
+static inline int expand6(const int& v)
+{
+	return (v << 2) | (v >> 4);
+}
+
+// Third way between a and b, rounded //
+static inline int lerp13(const int& a, const int& b)
+{
+	return (2 * a + b + 1) / 3;
+}
+
+
+// The 4 RGBA entries of a colour block. BC1 switches to 3 colours plus transparent black when //
+// c0 <= c1, the colour half of BC2 / BC3 always has 4 colours                                 //
+static void qimageBuildColorPalette(const unsigned int& c0, const unsigned int& c1, const bool& fourColor, unsigned char* palette)
+{
+	int e0[3] = { expand5(c0 >> 11), expand6((c0 >> 5) & 0x3F), expand5(c0 & 0x1F) };
+	int e1[3] = { expand5(c1 >> 11), expand6((c1 >> 5) & 0x3F), expand5(c1 & 0x1F) };
+
+	bool interp3 = fourColor || (c0 > c1);
+	for(unsigned int i = 0; i < 3; ++i)
+	{
+		palette[0 + i] = (unsigned char)e0[i];
+		palette[4 + i] = (unsigned char)e1[i];
+		palette[8 + i] = (unsigned char)(interp3 ? lerp13(e0[i], e1[i]) : (e0[i] + e1[i]) >> 1);
+		palette[12 + i] = (unsigned char)(interp3 ? lerp13(e1[i], e0[i]) : 0);
+	}
+	palette[3] = palette[7] = palette[11] = 255;
+	palette[15] = interp3 ? 255 : 0;
+}
+
+// The 8 entries of a BC4 style block, 8 interpolated values when a0 > a1, else 6 plus 0 and 255 //
+static void qimageBuildAlphaPalette(const int& a0, const int& a1, unsigned char* palette)
+{
+	palette[0] = (unsigned char)a0;
+	palette[1] = (unsigned char)a1;
+	if(a0 > a1)
+	{
+		for(int i = 2; i < 8; ++i)
+			palette[i] = (unsigned char)(((8 - i) * a0 + (i - 1) * a1 + 3) / 7);
+	}
+	else
+	{
+		for(int i = 2; i < 6; ++i)
+			palette[i] = (unsigned char)(((6 - i) * a0 + (i - 1) * a1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+
+static void qimageBuildMatchTable(unsigned char (*table)[2], const int& bits)
+{
+	int size = 1 << bits;
+	for(int v = 0; v < 256; ++v)
+	{
+		int bestErr = 1 << 30;
+		for(int a = 0; a < size; ++a)
+		{
+			int ea = (bits == 5) ? expand5(a) : expand6(a);
+			for(int b = 0; b < size; ++b)
+			{
+				int eb = (bits == 5) ? expand5(b) : expand6(b);
+
+				// Prefer close endpoints on ties, decoders round the third way entries differently //
+				int err = abs(lerp13(ea, eb) - v) * 256 + abs(ea - eb);
+				if(err < bestErr)
+				{
+					bestErr = err;
+					table[v][0] = (unsigned char)a;
+					table[v][1] = (unsigned char)b;
+				}
+			}
+		}
+	}
+}
+
+static struct qimageBlockTableInit
+{
+	qimageBlockTableInit()
+	{
+		qimageBuildMatchTable(s_match5, 5);
+		qimageBuildMatchTable(s_match6, 6);
+	}
+} s_blockTableInit;
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// INDEX SELECTION KERNELS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Index selection is where the encoder spends its time, every texel is tested against every //
+// palette entry. Both versions pick the nearest entry by exact integer distance and settle  //
+// ties on the lower index, so the output does not depend on the SIMD level.                 //
+
+// block: 16 RGBA texels, palette: 4 RGBA entries (alpha ignored). Writes 16 2 bit indices, //
+// texel i at bit 2i, and returns the summed squared RGB error                               //
+static unsigned int selectColorIndicesScalar(const unsigned char* block, const unsigned char* palette, unsigned int* indices)
+{
+	unsigned int err = 0;
+	unsigned int packed = 0;
+	for(unsigned int i = 0; i < 16; ++i)
+	{
+		const unsigned char* p = &block[i * 4];
+		unsigned int best = 0xFFFFFFFF;
+		unsigned int bestIdx = 0;
+		for(unsigned int k = 0; k < 4; ++k)
+		{
+			int dr = (int)p[0] - (int)palette[k * 4 + 0];
+			int dg = (int)p[1] - (int)palette[k * 4 + 1];
+			int db = (int)p[2] - (int)palette[k * 4 + 2];
+			unsigned int d = (unsigned int)(dr * dr + dg * dg + db * db);
+			if(d < best)
+			{
+				best = d;
+				bestIdx = k;
+			}
+		}
+		err += best;
+		packed |= bestIdx << (i * 2);
+	}
+
+	*indices = packed;
+	return err;
+}
+
+// values: 16 channel values, palette: 8 entries. Writes the index of the nearest entry per value //
+static void selectAlphaIndicesScalar(const unsigned char* values, const unsigned char* palette, unsigned char* indices)
+{
+	for(unsigned int i = 0; i < 16; ++i)
+	{
+		int best = 256;
+		unsigned char bestIdx = 0;
+		for(unsigned int k = 0; k < 8; ++k)
+		{
+			int d = abs((int)values[i] - (int)palette[k]);
+			if(d < best)
+			{
+				best = d;
+				bestIdx = (unsigned char)k;
+			}
+		}
+		indices[i] = bestIdx;
+	}
+}
+
+
+// Texels are widened to 16 bits with alpha cleared, madd then gives r*r + g*g and b*b per texel //
+// in neighbouring 32 bit lanes which a pair of shuffles folds into one distance per lane        //
+static unsigned int selectColorIndicesSSE2(const unsigned char* block, const unsigned char* palette, unsigned int* indices)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgbMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+
+	__m128i px[8];
+	for(unsigned int i = 0; i < 4; ++i)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)&block[i * 16]);
+		px[i * 2 + 0] = _mm_and_si128(_mm_unpacklo_epi8(p, zero), rgbMask);
+		px[i * 2 + 1] = _mm_and_si128(_mm_unpackhi_epi8(p, zero), rgbMask);
+	}
+
+	__m128i bestErr[4];
+	__m128i bestIdx[4];
+	for(unsigned int k = 0; k < 4; ++k)
+	{
+		unsigned int c = (unsigned int)palette[k * 4] | ((unsigned int)palette[k * 4 + 1] << 8) | ((unsigned int)palette[k * 4 + 2] << 16);
+		__m128i col = _mm_and_si128(_mm_unpacklo_epi8(_mm_set1_epi32((int)c), zero), rgbMask);
+		__m128i kk = _mm_set1_epi32((int)k);
+
+		for(unsigned int j = 0; j < 4; ++j)
+		{
+			__m128i d0 = _mm_sub_epi16(px[j * 2 + 0], col);
+			__m128i d1 = _mm_sub_epi16(px[j * 2 + 1], col);
+			__m128 s0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0));
+			__m128 s1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+			__m128i dist = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))),
+										 _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))));
+
+			if(k == 0)
+			{
+				bestErr[j] = dist;
+				bestIdx[j] = zero;
+			}
+			else
+			{
+				__m128i less = _mm_cmplt_epi32(dist, bestErr[j]);
+				bestErr[j] = _mm_or_si128(_mm_and_si128(less, dist), _mm_andnot_si128(less, bestErr[j]));
+				bestIdx[j] = _mm_or_si128(_mm_and_si128(less, kk), _mm_andnot_si128(less, bestIdx[j]));
+			}
+		}
+	}
+
+	// Pack the 2 bit indices, lane l of group j holds texel j * 4 + l //
+	__m128i shifted = zero;
+	for(unsigned int j = 0; j < 4; ++j)
+	{
+		__m128i mul = _mm_set_epi32(1 << (j * 8 + 6), 1 << (j * 8 + 4), 1 << (j * 8 + 2), 1 << (j * 8));
+		__m128i lo = _mm_mul_epu32(bestIdx[j], mul);
+		__m128i hi = _mm_mul_epu32(_mm_srli_epi64(bestIdx[j], 32), _mm_srli_epi64(mul, 32));
+		shifted = _mm_or_si128(shifted, _mm_or_si128(lo, hi));
+	}
+	shifted = _mm_or_si128(shifted, _mm_shuffle_epi32(shifted, _MM_SHUFFLE(1, 0, 3, 2)));
+	*indices = (unsigned int)_mm_cvtsi128_si32(shifted);
+
+	__m128i err = _mm_add_epi32(_mm_add_epi32(bestErr[0], bestErr[1]), _mm_add_epi32(bestErr[2], bestErr[3]));
+	err = _mm_add_epi32(err, _mm_shuffle_epi32(err, _MM_SHUFFLE(1, 0, 3, 2)));
+	err = _mm_add_epi32(err, _mm_shuffle_epi32(err, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (unsigned int)_mm_cvtsi128_si32(err);
+}
+
+// All 16 values fit one register, the distance is the saturated difference taken both ways //
+static void selectAlphaIndicesSSE2(const unsigned char* values, const unsigned char* palette, unsigned char* indices)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i*)values);
+	const __m128i ones = _mm_set1_epi32(-1);
+
+	__m128i p = _mm_set1_epi8((char)palette[0]);
+	__m128i best = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+	__m128i bestIdx = _mm_setzero_si128();
+
+	for(unsigned int k = 1; k < 8; ++k)
+	{
+		p = _mm_set1_epi8((char)palette[k]);
+		__m128i d = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+		__m128i less = _mm_xor_si128(_mm_cmpeq_epi8(_mm_max_epu8(d, best), d), ones);
+		bestIdx = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi8((char)k)), _mm_andnot_si128(less, bestIdx));
+		best = _mm_min_epu8(best, d);
+	}
+
+	_mm_storeu_si128((__m128i*)indices, bestIdx);
+}
+
+
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// DECODE KERNELS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// The palette is built once per block by the caller, the kernels expand the indices into texels //
+
+// palette: 4 RGBA entries, texel i takes the entry at 2 bit index i. Writes 16 RGBA texels //
+static void decodeColorBlockScalar(const unsigned char* palette, unsigned int indices, unsigned char* out)
+{
+	for(unsigned int i = 0; i < 16; ++i, indices >>= 2)
+		memcpy(&out[i * 4], &palette[(indices & 3) * 4], 4);
+}
+
+// palette: 8 entries, the 16 3 bit indices are the 6 bytes following the endpoints in block //
+static void decodeAlphaBlockScalar(const unsigned char* block, const unsigned char* palette, unsigned char* out)
+{
+	for(unsigned int half = 0; half < 2; ++half)
+	{
+		const unsigned char* b = &block[2 + half * 3];
+		unsigned int bits = (unsigned int)b[0] | ((unsigned int)b[1] << 8) | ((unsigned int)b[2] << 16);
+		for(unsigned int i = 0; i < 8; ++i, bits >>= 3)
+			out[half * 8 + i] = palette[bits & 7];
+	}
+}
+
+
+// Four texels per register, every entry is masked in where the index matches //
+static void decodeColorBlockSSE2(const unsigned char* palette, unsigned int indices, unsigned char* out)
+{
+	const __m128i pal = _mm_loadu_si128((const __m128i*)palette);
+	const __m128i p0 = _mm_shuffle_epi32(pal, _MM_SHUFFLE(0, 0, 0, 0));
+	const __m128i p1 = _mm_shuffle_epi32(pal, _MM_SHUFFLE(1, 1, 1, 1));
+	const __m128i p2 = _mm_shuffle_epi32(pal, _MM_SHUFFLE(2, 2, 2, 2));
+	const __m128i p3 = _mm_shuffle_epi32(pal, _MM_SHUFFLE(3, 3, 3, 3));
+	const __m128i three = _mm_set1_epi32(3);
+
+	// lane l holds the indices shifted so texel 4r + l sits at bit 8r //
+	const __m128i idx = _mm_set_epi32((int)(indices >> 6), (int)(indices >> 4), (int)(indices >> 2), (int)indices);
+
+	for(unsigned int r = 0; r < 4; ++r)
+	{
+		__m128i sel = _mm_and_si128(_mm_srl_epi32(idx, _mm_cvtsi32_si128(r * 8)), three);
+		__m128i t = _mm_and_si128(_mm_cmpeq_epi32(sel, _mm_setzero_si128()), p0);
+		t = _mm_or_si128(t, _mm_and_si128(_mm_cmpeq_epi32(sel, _mm_set1_epi32(1)), p1));
+		t = _mm_or_si128(t, _mm_and_si128(_mm_cmpeq_epi32(sel, _mm_set1_epi32(2)), p2));
+		t = _mm_or_si128(t, _mm_and_si128(_mm_cmpeq_epi32(sel, three), p3));
+		_mm_storeu_si128((__m128i*)&out[r * 16], t);
+	}
+}
+
+
+
+struct qimageBlockKernelTable
+{
+	unsigned int (*selectColorIndices)(const unsigned char* block, const unsigned char* palette, unsigned int* indices);
+	void (*selectAlphaIndices)(const unsigned char* values, const unsigned char* palette, unsigned char* indices);
+	void (*decodeColorBlock)(const unsigned char* palette, unsigned int indices, unsigned char* out);
+	void (*decodeAlphaBlock)(const unsigned char* block, const unsigned char* palette, unsigned char* out);
+};
+
+static const qimageBlockKernelTable s_scalarBlockKernels =
+{
+	selectColorIndicesScalar, selectAlphaIndicesScalar,
+	decodeColorBlockScalar, decodeAlphaBlockScalar,
+};
+
+// SSE2 has no byte shuffle, the 3 bit alpha indices are unpacked and looked up as in the scalar code //
+static const qimageBlockKernelTable s_sseBlockKernels =
+{
+	selectColorIndicesSSE2, selectAlphaIndicesSSE2,
+	decodeColorBlockSSE2, decodeAlphaBlockScalar,
+};
+
+// AVX1 has no 256 bit integer ops, the encoder stays on SSE2. Decoding uses the VEX encoded byte //
+// shuffles that come with AVX for the palette lookups                                             //
+static const qimageBlockKernelTable s_avxBlockKernels =
+{
+	selectColorIndicesSSE2, selectAlphaIndicesSSE2,
+	qimageDecodeColorBlockAVX, qimageDecodeAlphaBlockAVX,
+};
+
+static const qimageBlockKernelTable* qimageGetBlockKernels()
+{
+	switch(QMATH_GET_SIMD_LEVEL())
+	{
+		case QMATH_SIMD_AVX:	return &s_avxBlockKernels;
+		case QMATH_SIMD_SSE:	return QCPU_HAS_FEATURE(QCPU_FEATURE_SSE2) ? &s_sseBlockKernels : &s_scalarBlockKernels;
+		default:				return &s_scalarBlockKernels;
+	}
+}
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// BLOCK ENCODERS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+static inline unsigned short pack565(const int& r, const int& g, const int& b)
+{
+	int r5 = (r * 31 + 127) / 255;
+	int g6 = (g * 63 + 127) / 255;
+	int b5 = (b * 31 + 127) / 255;
+	return (unsigned short)((r5 << 11) | (g6 << 5) | b5);
+}
+
+static inline void writeLE16(unsigned char* out, const unsigned int& v)
+{
+	out[0] = (unsigned char)v;
+	out[1] = (unsigned char)(v >> 8);
+}
+
+static inline void writeLE32(unsigned char* out, const unsigned int& v)
+{
+	out[0] = (unsigned char)v;
+	out[1] = (unsigned char)(v >> 8);
+	out[2] = (unsigned char)(v >> 16);
+	out[3] = (unsigned char)(v >> 24);
+}
+
+
+// Puts c0 above c1 (4 colour mode), builds the palette and picks the indices //
+static unsigned int qimageFitColorIndices(const qimageBlockKernelTable* k, const unsigned char* block, unsigned short& c0, unsigned short& c1, unsigned int& indices)
+{
+	if(c0 < c1)
+	{
+		unsigned short t = c0;
+		c0 = c1;
+		c1 = t;
+	}
+
+	// Equal endpoints leave 3 colour mode, where index 3 is black. The palette is flat so index 0 wins anyway //
+	unsigned char palette[16];
+	qimageBuildColorPalette(c0, c1, true, palette);
+	return k->selectColorIndices(block, palette, &indices);
+}
+
+// Least squares endpoints for a given index assignment. The weight of c0 is 3/3, 0, 2/3 or 1/3 //
+// per index, so the normal equations only need the texel count and colour sum of each index    //
+static bool qimageRefineColorEndpoints(const unsigned char* block, const unsigned int& indices, unsigned short& c0, unsigned short& c1)
+{
+	static const int w3[4] = { 3, 0, 2, 1 };
+
+	int count[4] = { 0, 0, 0, 0 };
+	int sum[4][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+	for(unsigned int i = 0; i < 16; ++i)
+	{
+		unsigned int k = (indices >> (i * 2)) & 3;
+		++count[k];
+		sum[k][0] += block[i * 4 + 0];
+		sum[k][1] += block[i * 4 + 1];
+		sum[k][2] += block[i * 4 + 2];
+	}
+
+	// Everything below is scaled by 3 (weights) or 9 (products of weights) //
+	int aa = 0, bb = 0, ab = 0;
+	int ax[3] = { 0, 0, 0 };
+	int bx[3] = { 0, 0, 0 };
+	for(unsigned int k = 0; k < 4; ++k)
+	{
+		int a = w3[k];
+		int b = 3 - a;
+		aa += count[k] * a * a;
+		bb += count[k] * b * b;
+		ab += count[k] * a * b;
+		for(unsigned int c = 0; c < 3; ++c)
+		{
+			ax[c] += a * sum[k][c];
+			bx[c] += b * sum[k][c];
+		}
+	}
+
+	int det = aa * bb - ab * ab;
+	if(det == 0)
+		return false;
+
+	float rcp = 3.0F / (float)det;
+	int p0[3], p1[3];
+	for(unsigned int c = 0; c < 3; ++c)
+	{
+		float v0 = (float)(ax[c] * bb - bx[c] * ab) * rcp;
+		float v1 = (float)(bx[c] * aa - ax[c] * ab) * rcp;
+		p0[c] = (int)(((v0 < 0.0F) ? 0.0F : (v0 > 255.0F) ? 255.0F : v0) + 0.5F);
+		p1[c] = (int)(((v1 < 0.0F) ? 0.0F : (v1 > 255.0F) ? 255.0F : v1) + 0.5F);
+	}
+
+	c0 = pack565(p0[0], p0[1], p0[2]);
+	c1 = pack565(p1[0], p1[1], p1[2]);
+	return true;
+}
+
+// BC1 colour block from 16 RGBA texels. Endpoints start at the extremes along the principal //
+// axis of the block and get one least squares pass, kept only when it lowers the error      //
+static void qimageEncodeColorBlock(const qimageBlockKernelTable* k, const unsigned char* block, unsigned char* out)
+{
+	bool solid = true;
+	for(unsigned int i = 1; i < 16 && solid; ++i)
+		solid = (block[i * 4] == block[0]) && (block[i * 4 + 1] == block[1]) && (block[i * 4 + 2] == block[2]);
+
+	if(solid)
+	{
+		unsigned int c0 = (s_match5[block[0]][0] << 11) | (s_match6[block[1]][0] << 5) | s_match5[block[2]][0];
+		unsigned int c1 = (s_match5[block[0]][1] << 11) | (s_match6[block[1]][1] << 5) | s_match5[block[2]][1];
+		unsigned int indices = 0xAAAAAAAA;
+		if(c0 < c1)
+		{
+			unsigned int t = c0;
+			c0 = c1;
+			c1 = t;
+			indices = 0xFFFFFFFF;
+		}
+		else if(c0 == c1)
+			indices = 0;
+
+		writeLE16(&out[0], c0);
+		writeLE16(&out[2], c1);
+		writeLE32(&out[4], indices);
+		return;
+	}
+
+	// Extents and covariance (times 256, from raw sums so it stays integer) //
+	int mn[3] = { 255, 255, 255 };
+	int mx[3] = { 0, 0, 0 };
+	int sum[3] = { 0, 0, 0 };
+	int prod[6] = { 0, 0, 0, 0, 0, 0 };
+	for(unsigned int i = 0; i < 16; ++i)
+	{
+		int r = block[i * 4 + 0];
+		int g = block[i * 4 + 1];
+		int b = block[i * 4 + 2];
+		sum[0] += r;
+		sum[1] += g;
+		sum[2] += b;
+		prod[0] += r * r;
+		prod[1] += r * g;
+		prod[2] += r * b;
+		prod[3] += g * g;
+		prod[4] += g * b;
+		prod[5] += b * b;
+		mn[0] = (r < mn[0]) ? r : mn[0];
+		mn[1] = (g < mn[1]) ? g : mn[1];
+		mn[2] = (b < mn[2]) ? b : mn[2];
+		mx[0] = (r > mx[0]) ? r : mx[0];
+		mx[1] = (g > mx[1]) ? g : mx[1];
+		mx[2] = (b > mx[2]) ? b : mx[2];
+	}
+
+	float cov[6] =
+	{
+		(float)(prod[0] * 16 - sum[0] * sum[0]), (float)(prod[1] * 16 - sum[0] * sum[1]), (float)(prod[2] * 16 - sum[0] * sum[2]),
+		(float)(prod[3] * 16 - sum[1] * sum[1]), (float)(prod[4] * 16 - sum[1] * sum[2]), (float)(prod[5] * 16 - sum[2] * sum[2]),
+	};
+
+	// Power iteration from the bounding box diagonal //
+	float axis[3] = { (float)(mx[0] - mn[0]), (float)(mx[1] - mn[1]), (float)(mx[2] - mn[2]) };
+	for(unsigned int it = 0; it < 4; ++it)
+	{
+		float r = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+		float g = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+		float b = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+		float m = fabsf(r);
+		if(fabsf(g) > m) m = fabsf(g);
+		if(fabsf(b) > m) m = fabsf(b);
+		if(m < 1e-6F)
+			break;
+		axis[0] = r / m;
+		axis[1] = g / m;
+		axis[2] = b / m;
+	}
+
+	int dir[3];
+	float m = fabsf(axis[0]);
+	if(fabsf(axis[1]) > m) m = fabsf(axis[1]);
+	if(fabsf(axis[2]) > m) m = fabsf(axis[2]);
+	if(m < 1e-3F)
+	{
+		// No dominant direction, fall back to luminance //
+		dir[0] = 299;
+		dir[1] = 587;
+		dir[2] = 114;
+	}
+	else
+	{
+		for(unsigned int c = 0; c < 3; ++c)
+			dir[c] = (int)(axis[c] * (512.0F / m));
+	}
+
+	unsigned int minIdx = 0, maxIdx = 0;
+	int minDot = 0x7FFFFFFF, maxDot = -0x7FFFFFFF;
+	for(unsigned int i = 0; i < 16; ++i)
+	{
+		int dot = block[i * 4] * dir[0] + block[i * 4 + 1] * dir[1] + block[i * 4 + 2] * dir[2];
+		if(dot < minDot)
+		{
+			minDot = dot;
+			minIdx = i;
+		}
+		if(dot > maxDot)
+		{
+			maxDot = dot;
+			maxIdx = i;
+		}
+	}
+
+	const unsigned char* hi = &block[maxIdx * 4];
+	const unsigned char* lo = &block[minIdx * 4];
+	unsigned short c0 = pack565(hi[0], hi[1], hi[2]);
+	unsigned short c1 = pack565(lo[0], lo[1], lo[2]);
+
+	unsigned int indices;
+	unsigned int err = qimageFitColorIndices(k, block, c0, c1, indices);
+
+	unsigned short r0, r1;
+	if(err > 0 && qimageRefineColorEndpoints(block, indices, r0, r1))
+	{
+		unsigned int rIndices;
+		unsigned int rErr = qimageFitColorIndices(k, block, r0, r1, rIndices);
+		if(rErr < err)
+		{
+			c0 = r0;
+			c1 = r1;
+			indices = rIndices;
+		}
+	}
+
+	if(c0 == c1)
+		indices = 0;
+
+	writeLE16(&out[0], c0);
+	writeLE16(&out[2], c1);
+	writeLE32(&out[4], indices);
+}
+
+// BC4 block (also the alpha half of BC3 and each half of BC5) from 16 values, 8 entry mode //
+static void qimageEncodeAlphaBlock(const qimageBlockKernelTable* k, const unsigned char* values, unsigned char* out)
+{
+	int mn = 255, mx = 0;
+	for(unsigned int i = 0; i < 16; ++i)
+	{
+		mn = (values[i] < mn) ? values[i] : mn;
+		mx = (values[i] > mx) ? values[i] : mx;
+	}
+
+	out[0] = (unsigned char)mx;
+	out[1] = (unsigned char)mn;
+	if(mx == mn)
+	{
+		memset(&out[2], 0, 6);
+		return;
+	}
+
+	unsigned char palette[8];
+	qimageBuildAlphaPalette(mx, mn, palette);
+
+	unsigned char indices[16];
+	k->selectAlphaIndices(values, palette, indices);
+
+	// 16 3 bit indices, little endian over 6 bytes //
+	for(unsigned int half = 0; half < 2; ++half)
+	{
+		unsigned int bits = 0;
+		for(unsigned int i = 0; i < 8; ++i)
+			bits |= (unsigned int)indices[half * 8 + i] << (i * 3);
+		out[2 + half * 3 + 0] = (unsigned char)bits;
+		out[2 + half * 3 + 1] = (unsigned char)(bits >> 8);
+		out[2 + half * 3 + 2] = (unsigned char)(bits >> 16);
+	}
+}
+
+// BC2 explicit 4 bit alpha //
+static void qimageEncodeExplicitAlphaBlock(const unsigned char* values, unsigned char* out)
+{
+	for(unsigned int i = 0; i < 8; ++i)
+	{
+		unsigned int a0 = (values[i * 2] * 15 + 127) / 255;
+		unsigned int a1 = (values[i * 2 + 1] * 15 + 127) / 255;
+		out[i] = (unsigned char)(a0 | (a1 << 4));
+	}
+}
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// COMPRESSION
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+struct qimageCompressJob
+{
+	const unsigned char*			src;
+	unsigned char*					dst;
+	unsigned int					w, h;
+	unsigned int					nChannels;
+	unsigned int					blocksX, blocksY;
+	unsigned int					blockBytes;
+	QIMAGE_BLOCK_FORMAT				format;
+	const qimageBlockKernelTable*	kernels;
+};
+
+
+// Reads the 4x4 block at (bx, by) as 16 RGBA texels. Texels past the right or bottom edge repeat //
+// the last column / row. Colour formats widen grey and grey + alpha images, BC4 / BC5 keep the   //
+// channels as stored in the first bytes of each texel                                            //
+static void qimageGatherBlock(const qimageCompressJob& job, const unsigned char* slice, const unsigned int& bx, const unsigned int& by, unsigned char* block)
+{
+	bool widen = (job.format <= QIMAGE_BLOCK_BC3);
+	unsigned int c = job.nChannels;
+
+	if(c == 4 && bx * 4 + 4 <= job.w && by * 4 + 4 <= job.h)
+	{
+		const unsigned char* row = slice + ((size_t)by * 4 * job.w + bx * 4) * 4;
+		for(unsigned int y = 0; y < 4; ++y, row += job.w * 4)
+			memcpy(&block[y * 16], row, 16);
+		return;
+	}
+
+	for(unsigned int y = 0; y < 4; ++y)
+	{
+		unsigned int sy = by * 4 + y;
+		if(sy >= job.h)
+			sy = job.h - 1;
+
+		const unsigned char* row = slice + (size_t)sy * job.w * c;
+		for(unsigned int x = 0; x < 4; ++x)
+		{
+			unsigned int sx = bx * 4 + x;
+			if(sx >= job.w)
+				sx = job.w - 1;
+
+			const unsigned char* p = &row[sx * c];
+			unsigned char* t = &block[(y * 4 + x) * 4];
+			if(c == 4)
+			{
+				t[0] = p[0]; t[1] = p[1]; t[2] = p[2]; t[3] = p[3];
+			}
+			else if(c == 3)
+			{
+				t[0] = p[0]; t[1] = p[1]; t[2] = p[2]; t[3] = 255;
+			}
+			else if(widen)
+			{
+				t[0] = t[1] = t[2] = p[0];
+				t[3] = (c == 2) ? p[1] : 255;
+			}
+			else
+			{
+				t[0] = p[0];
+				t[1] = (c == 2) ? p[1] : 0;
+				t[2] = 0;
+				t[3] = 255;
+			}
+		}
+	}
+}
+
+
+static void qimageCompressRows(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	const qimageCompressJob& job = *(const qimageCompressJob*)data;
+	const qimageBlockKernelTable* k = job.kernels;
+	size_t sliceBytes = (size_t)job.w * job.h * job.nChannels;
+
+	unsigned char block[64];
+	unsigned char channel[16];
+
+	for(unsigned int r = begin; r < end; ++r)
+	{
+		unsigned int slice = r / job.blocksY;
+		unsigned int by = r % job.blocksY;
+		const unsigned char* src = job.src + slice * sliceBytes;
+		unsigned char* out = job.dst + (size_t)r * job.blocksX * job.blockBytes;
+
+		for(unsigned int bx = 0; bx < job.blocksX; ++bx, out += job.blockBytes)
+		{
+			qimageGatherBlock(job, src, bx, by, block);
+
+			switch(job.format)
+			{
+				case QIMAGE_BLOCK_BC1:
+					qimageEncodeColorBlock(k, block, out);
+					break;
+
+				case QIMAGE_BLOCK_BC2:
+					for(unsigned int i = 0; i < 16; ++i)
+						channel[i] = block[i * 4 + 3];
+					qimageEncodeExplicitAlphaBlock(channel, out);
+					qimageEncodeColorBlock(k, block, out + 8);
+					break;
+
+				case QIMAGE_BLOCK_BC3:
+					for(unsigned int i = 0; i < 16; ++i)
+						channel[i] = block[i * 4 + 3];
+					qimageEncodeAlphaBlock(k, channel, out);
+					qimageEncodeColorBlock(k, block, out + 8);
+					break;
+
+				case QIMAGE_BLOCK_BC4:
+					for(unsigned int i = 0; i < 16; ++i)
+						channel[i] = block[i * 4];
+					qimageEncodeAlphaBlock(k, channel, out);
+					break;
+
+				case QIMAGE_BLOCK_BC5:
+					for(unsigned int i = 0; i < 16; ++i)
+						channel[i] = block[i * 4];
+					qimageEncodeAlphaBlock(k, channel, out);
+					for(unsigned int i = 0; i < 16; ++i)
+						channel[i] = block[i * 4 + 1];
+					qimageEncodeAlphaBlock(k, channel, out + 8);
+					break;
+			}
+		}
+	}
+}
+
+
+
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_BLOCK_BYTES(const QIMAGE_BLOCK_FORMAT& fmt)
+{
+	return (fmt == QIMAGE_BLOCK_BC1 || fmt == QIMAGE_BLOCK_BC4) ? 8 : 16;
+}
+
+QIMAGEEXPORT_API void QIMAGE_COMPRESS(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& nSlices,
+									  const unsigned int& nChannels, const QIMAGE_BLOCK_FORMAT& fmt)
+{
+	if(!src || !dst || !w || !h || !nSlices || !nChannels || nChannels > 4 || fmt > QIMAGE_BLOCK_BC5)
+		return;
+
+	qimageCompressJob job;
+	job.src = (const unsigned char*)src;
+	job.dst = (unsigned char*)dst;
+	job.w = w;
+	job.h = h;
+	job.nChannels = nChannels;
+	job.blocksX = (w + 3) >> 2;
+	job.blocksY = (h + 3) >> 2;
+	job.blockBytes = QIMAGE_GET_BLOCK_BYTES(fmt);
+	job.format = fmt;
+	job.kernels = qimageGetBlockKernels();
+
+	unsigned int grain = QIMAGE_BLOCK_GRAIN / job.blocksX + 1;
+	QPARALLEL_FOR(nSlices * job.blocksY, grain, qimageCompressRows, &job);
+}
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// DECOMPRESSION
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+struct qimageDecompressJob
+{
+	const unsigned char*			src;
+	unsigned char*					dst;
+	unsigned int					x, y, rw, rh;		// region decoded from every slice
+	unsigned int					blocksX;			// blocks per row of the whole image
+	unsigned int					bx0, by0;			// first block under the region
+	unsigned int					regionBlocksX, regionBlocksY;
+	size_t							sliceBytes;
+	unsigned int					blockBytes;
+	unsigned int					nChannels;
+	QIMAGE_BLOCK_FORMAT				format;
+	const qimageBlockKernelTable*	kernels;
+};
+
+
+static inline unsigned int readLE16(const unsigned char* p)
+{
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static inline unsigned int readLE32(const unsigned char* p)
+{
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+
+// Decodes one block into 16 texels of QIMAGE_GET_BLOCK_CHANNELS(fmt) bytes, row by row //
+static void qimageDecodeBlock(const qimageBlockKernelTable* k, const QIMAGE_BLOCK_FORMAT& fmt, const unsigned char* in, unsigned char* texels)
+{
+	unsigned char palette[16];
+	unsigned char channel[16];
+
+	switch(fmt)
+	{
+		case QIMAGE_BLOCK_BC1:
+			qimageBuildColorPalette(readLE16(&in[0]), readLE16(&in[2]), false, palette);
+			k->decodeColorBlock(palette, readLE32(&in[4]), texels);
+			break;
+
+		case QIMAGE_BLOCK_BC2:
+			qimageBuildColorPalette(readLE16(&in[8]), readLE16(&in[10]), true, palette);
+			k->decodeColorBlock(palette, readLE32(&in[12]), texels);
+			for(unsigned int i = 0; i < 16; ++i)
+				texels[i * 4 + 3] = (unsigned char)(((in[i >> 1] >> ((i & 1) * 4)) & 0xF) * 17);
+			break;
+
+		case QIMAGE_BLOCK_BC3:
+			qimageBuildColorPalette(readLE16(&in[8]), readLE16(&in[10]), true, palette);
+			k->decodeColorBlock(palette, readLE32(&in[12]), texels);
+			qimageBuildAlphaPalette(in[0], in[1], palette);
+			k->decodeAlphaBlock(in, palette, channel);
+			for(unsigned int i = 0; i < 16; ++i)
+				texels[i * 4 + 3] = channel[i];
+			break;
+
+		case QIMAGE_BLOCK_BC4:
+			qimageBuildAlphaPalette(in[0], in[1], palette);
+			k->decodeAlphaBlock(in, palette, texels);
+			break;
+
+		case QIMAGE_BLOCK_BC5:
+			qimageBuildAlphaPalette(in[0], in[1], palette);
+			k->decodeAlphaBlock(in, palette, channel);
+			for(unsigned int i = 0; i < 16; ++i)
+				texels[i * 2] = channel[i];
+			qimageBuildAlphaPalette(in[8], in[9], palette);
+			k->decodeAlphaBlock(in + 8, palette, channel);
+			for(unsigned int i = 0; i < 16; ++i)
+				texels[i * 2 + 1] = channel[i];
+			break;
+	}
+}
+
+
+// One block row of the region per iteration, edge blocks are clipped to the region //
+static void qimageDecompressRows(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	const qimageDecompressJob& job = *(const qimageDecompressJob*)data;
+	const unsigned int c = job.nChannels;
+	size_t regionBytes = (size_t)job.rw * job.rh * c;
+
+	unsigned char texels[64];
+
+	for(unsigned int r = begin; r < end; ++r)
+	{
+		unsigned int slice = r / job.regionBlocksY;
+		unsigned int by = job.by0 + r % job.regionBlocksY;
+		const unsigned char* in = job.src + slice * job.sliceBytes + ((size_t)by * job.blocksX + job.bx0) * job.blockBytes;
+		unsigned char* out = job.dst + slice * regionBytes;
+
+		unsigned int y0 = (by * 4 > job.y) ? by * 4 : job.y;
+		unsigned int y1 = (by * 4 + 4 < job.y + job.rh) ? by * 4 + 4 : job.y + job.rh;
+
+		for(unsigned int i = 0; i < job.regionBlocksX; ++i, in += job.blockBytes)
+		{
+			unsigned int bx = job.bx0 + i;
+			qimageDecodeBlock(job.kernels, job.format, in, texels);
+
+			unsigned int x0 = (bx * 4 > job.x) ? bx * 4 : job.x;
+			unsigned int x1 = (bx * 4 + 4 < job.x + job.rw) ? bx * 4 + 4 : job.x + job.rw;
+			// Whole blocks, fixed size copies //
+			if(x1 - x0 == 4 && y1 - y0 == 4)
+			{
+				unsigned char* row = &out[((size_t)(y0 - job.y) * job.rw + (x0 - job.x)) * c];
+				for(unsigned int ty = 0; ty < 4; ++ty, row += job.rw * c)
+				{
+					switch(c)
+					{
+						case 1:		memcpy(row, &texels[ty * 4], 4); break;
+						case 2:		memcpy(row, &texels[ty * 8], 8); break;
+						default:	memcpy(row, &texels[ty * 16], 16); break;
+					}
+				}
+				continue;
+			}
+
+			for(unsigned int ty = y0; ty < y1; ++ty)
+				memcpy(&out[((size_t)(ty - job.y) * job.rw + (x0 - job.x)) * c], &texels[((ty - by * 4) * 4 + (x0 - bx * 4)) * c], (x1 - x0) * c);
+		}
+	}
+}
+
+
+static void qimageDecompress(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& nSlices,
+							 const unsigned int& x, const unsigned int& y, const unsigned int& rw, const unsigned int& rh, const QIMAGE_BLOCK_FORMAT& fmt)
+{
+	qimageDecompressJob job;
+	job.src = (const unsigned char*)src;
+	job.dst = (unsigned char*)dst;
+	job.x = x;
+	job.y = y;
+	job.rw = rw;
+	job.rh = rh;
+	job.blocksX = (w + 3) >> 2;
+	job.bx0 = x >> 2;
+	job.by0 = y >> 2;
+	job.regionBlocksX = ((x + rw + 3) >> 2) - job.bx0;
+	job.regionBlocksY = ((y + rh + 3) >> 2) - job.by0;
+	job.blockBytes = QIMAGE_GET_BLOCK_BYTES(fmt);
+	job.sliceBytes = (size_t)job.blocksX * ((h + 3) >> 2) * job.blockBytes;
+	job.nChannels = QIMAGE_GET_BLOCK_CHANNELS(fmt);
+	job.format = fmt;
+	job.kernels = qimageGetBlockKernels();
+
+	unsigned int grain = QIMAGE_BLOCK_GRAIN / job.regionBlocksX + 1;
+	QPARALLEL_FOR(nSlices * job.regionBlocksY, grain, qimageDecompressRows, &job);
+}
+
+
+
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_BLOCK_CHANNELS(const QIMAGE_BLOCK_FORMAT& fmt)
+{
+	switch(fmt)
+	{
+		case QIMAGE_BLOCK_BC4:	return 1;
+		case QIMAGE_BLOCK_BC5:	return 2;
+		default:				return 4;
+	}
+}
+
+QIMAGEEXPORT_API void QIMAGE_DECOMPRESS(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& nSlices, const QIMAGE_BLOCK_FORMAT& fmt)
+{
+	if(!src || !dst || !w || !h || !nSlices || fmt > QIMAGE_BLOCK_BC5)
+		return;
+
+	qimageDecompress(src, dst, w, h, nSlices, 0, 0, w, h, fmt);
+}
+
+QIMAGEEXPORT_API bool QIMAGE_DECOMPRESS_REGION(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& x, const unsigned int& y,
+											   const unsigned int& rw, const unsigned int& rh, const QIMAGE_BLOCK_FORMAT& fmt)
+{
+	if(!src || !dst || !rw || !rh || fmt > QIMAGE_BLOCK_BC5)
+		return false;
+	if(x >= w || y >= h || rw > w - x || rh > h - y)
+		return false;
+
+	qimageDecompress(src, dst, w, h, 1, x, y, rw, rh, fmt);
+	return true;
+}
@@ -0,0 +1,551 @@
+#include "stdafx.h"
+#include "qimage.h"
+#include "qimage_simd.h"
+#include "qmath.h"
+#include "qcpu.h"
+#include "qparallel.h"
+
+#include <emmintrin.h>
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// CONVERSION KERNELS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Every kernel converts n texels of one row. Kernels that keep the texel size also work in place //
+
+static inline unsigned char expand5(const unsigned int& v)
+{
+	return (unsigned char)((v << 3) | (v >> 2));
+}
+
+static inline unsigned char expand6(const unsigned int& v)
+{
+	return (unsigned char)((v << 2) | (v >> 4));
+}
+
+
+static void swapRB3Scalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 3, dst += 3)
+	{
+		unsigned char c0 = src[0];
+		unsigned char c2 = src[2];
+		dst[0] = c2;
+		dst[1] = src[1];
+		dst[2] = c0;
+	}
+}
+
+static void swapRB4Scalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 4, dst += 4)
+	{
+		unsigned char c0 = src[0];
+		unsigned char c2 = src[2];
+		dst[0] = c2;
+		dst[1] = src[1];
+		dst[2] = c0;
+		dst[3] = src[3];
+	}
+}
+
+static void swapRB4OpaqueScalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 4, dst += 4)
+	{
+		unsigned char c0 = src[0];
+		unsigned char c2 = src[2];
+		dst[0] = c2;
+		dst[1] = src[1];
+		dst[2] = c0;
+		dst[3] = 255;
+	}
+}
+
+static void opaque4Scalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 4, dst += 4)
+	{
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 255;
+	}
+}
+
+static void pad3Scalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 3, dst += 4)
+	{
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 255;
+	}
+}
+
+static void pad3SwapRBScalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 3, dst += 4)
+	{
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = src[0];
+		dst[3] = 255;
+	}
+}
+
+static void greyToRGBAScalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, dst += 4)
+	{
+		dst[0] = dst[1] = dst[2] = src[i];
+		dst[3] = 255;
+	}
+}
+
+static void r5g6b5ToRGBAScalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 2, dst += 4)
+	{
+		unsigned int p = src[0] | (src[1] << 8);
+		dst[0] = expand5(p >> 11);
+		dst[1] = expand6((p >> 5) & 0x3F);
+		dst[2] = expand5(p & 0x1F);
+		dst[3] = 255;
+	}
+}
+
+static void x1r5g5b5ToRGBAScalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 2, dst += 4)
+	{
+		unsigned int p = src[0] | (src[1] << 8);
+		dst[0] = expand5((p >> 10) & 0x1F);
+		dst[1] = expand5((p >> 5) & 0x1F);
+		dst[2] = expand5(p & 0x1F);
+		dst[3] = 255;
+	}
+}
+
+static void a1r5g5b5ToRGBAScalar(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i, src += 2, dst += 4)
+	{
+		unsigned int p = src[0] | (src[1] << 8);
+		dst[0] = expand5((p >> 10) & 0x1F);
+		dst[1] = expand5((p >> 5) & 0x1F);
+		dst[2] = expand5(p & 0x1F);
+		dst[3] = (p & 0x8000) ? 255 : 0;
+	}
+}
+
+
+// Red and blue trade places with shifts inside each 32 bit texel, alphaOr forces alpha //
+static inline void swapRB4SSE2(const unsigned char* src, unsigned char* dst, unsigned int n, const __m128i& alphaOr)
+{
+	const __m128i rbMask = _mm_set1_epi32(0x00FF00FF);
+
+	unsigned int i = 0;
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&src[i * 4]);
+		__m128i rb = _mm_and_si128(v, rbMask);
+		__m128i ga = _mm_andnot_si128(rbMask, v);
+		rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+		_mm_storeu_si128((__m128i*)&dst[i * 4], _mm_or_si128(_mm_or_si128(rb, ga), alphaOr));
+	}
+
+	if(_mm_cvtsi128_si32(alphaOr))
+		swapRB4OpaqueScalar(&src[i * 4], &dst[i * 4], n - i);
+	else
+		swapRB4Scalar(&src[i * 4], &dst[i * 4], n - i);
+}
+
+static void swapRB4SSE2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	swapRB4SSE2(src, dst, n, _mm_setzero_si128());
+}
+
+static void swapRB4OpaqueSSE2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	swapRB4SSE2(src, dst, n, _mm_set1_epi32(0xFF000000));
+}
+
+static void opaque4SSE2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+	unsigned int i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm_storeu_si128((__m128i*)&dst[i * 4], _mm_or_si128(_mm_loadu_si128((const __m128i*)&src[i * 4]), alpha));
+
+	opaque4Scalar(&src[i * 4], &dst[i * 4], n - i);
+}
+
+static void greyToRGBASSE2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+	unsigned int i = 0;
+	for(; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&src[i]);
+		__m128i lo = _mm_unpacklo_epi8(v, v);
+		__m128i hi = _mm_unpackhi_epi8(v, v);
+		_mm_storeu_si128((__m128i*)&dst[i * 4], _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+		_mm_storeu_si128((__m128i*)&dst[i * 4 + 16], _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+		_mm_storeu_si128((__m128i*)&dst[i * 4 + 32], _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+		_mm_storeu_si128((__m128i*)&dst[i * 4 + 48], _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+	}
+
+	greyToRGBAScalar(&src[i], &dst[i * 4], n - i);
+}
+
+// Bit replicates 5 or 6 bit fields held in 16 bit lanes //
+static inline __m128i expand5x8(const __m128i& v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 3), _mm_srli_epi16(v, 2));
+}
+
+static inline __m128i expand6x8(const __m128i& v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 2), _mm_srli_epi16(v, 4));
+}
+
+// Interleaves 8 texels of 16 bit R, G, B and A lanes (0 - 255) into RGBA8 //
+static inline void storeRGBA8x8(unsigned char* dst, const __m128i& r, const __m128i& g, const __m128i& b, const __m128i& a)
+{
+	__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+	__m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+	_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(rg, ba));
+	_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+static void r5g6b5ToRGBASSE2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i mask6 = _mm_set1_epi16(0x3F);
+	const __m128i alpha = _mm_set1_epi16(0xFF);
+
+	unsigned int i = 0;
+	for(; i + 8 <= n; i += 8)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)&src[i * 2]);
+		__m128i r = expand5x8(_mm_srli_epi16(p, 11));
+		__m128i g = expand6x8(_mm_and_si128(_mm_srli_epi16(p, 5), mask6));
+		__m128i b = expand5x8(_mm_and_si128(p, mask5));
+		storeRGBA8x8(&dst[i * 4], r, g, b, alpha);
+	}
+
+	r5g6b5ToRGBAScalar(&src[i * 2], &dst[i * 4], n - i);
+}
+
+// The top bit is alpha for A1R5G5B5 and ignored for X1R5G5B5 //
+static inline void x1r5g5b5ToRGBASSE2(const unsigned char* src, unsigned char* dst, unsigned int n, const bool& hasAlpha)
+{
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i mask8 = _mm_set1_epi16(0xFF);
+
+	unsigned int i = 0;
+	for(; i + 8 <= n; i += 8)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)&src[i * 2]);
+		__m128i r = expand5x8(_mm_and_si128(_mm_srli_epi16(p, 10), mask5));
+		__m128i g = expand5x8(_mm_and_si128(_mm_srli_epi16(p, 5), mask5));
+		__m128i b = expand5x8(_mm_and_si128(p, mask5));
+		__m128i a = (hasAlpha) ? _mm_and_si128(_mm_srai_epi16(p, 15), mask8) : mask8;
+		storeRGBA8x8(&dst[i * 4], r, g, b, a);
+	}
+
+	if(hasAlpha)
+		a1r5g5b5ToRGBAScalar(&src[i * 2], &dst[i * 4], n - i);
+	else
+		x1r5g5b5ToRGBAScalar(&src[i * 2], &dst[i * 4], n - i);
+}
+
+static void x1r5g5b5ToRGBASSE2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	x1r5g5b5ToRGBASSE2(src, dst, n, false);
+}
+
+static void a1r5g5b5ToRGBASSE2(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	x1r5g5b5ToRGBASSE2(src, dst, n, true);
+}
+
+
+
+enum qimageConvertKernel
+{
+	QIMAGE_KERNEL_SWAP_RB3 = 0,			// RGB8 <-> BGR8
+	QIMAGE_KERNEL_SWAP_RB4,				// RGBA8 <-> BGRA8
+	QIMAGE_KERNEL_SWAP_RB4_OPAQUE,		// RGBX8 <-> BGRA8, alpha forced to 255
+	QIMAGE_KERNEL_OPAQUE4,				// RGBX8 -> RGBA8
+	QIMAGE_KERNEL_PAD3,					// RGB8 -> RGBA8
+	QIMAGE_KERNEL_PAD3_SWAP_RB,			// BGR8 -> RGBA8
+	QIMAGE_KERNEL_GREY_TO_RGBA,			// I8 -> RGBA8
+	QIMAGE_KERNEL_R5G6B5,				// R5G6B5 -> RGBA8
+	QIMAGE_KERNEL_X1R5G5B5,				// X1R5G5B5 -> RGBA8
+	QIMAGE_KERNEL_A1R5G5B5,				// A1R5G5B5 -> RGBA8
+	QIMAGE_KERNEL_COUNT,
+};
+
+typedef void (*qimageConvertFunc)(const unsigned char* src, unsigned char* dst, unsigned int n);
+
+struct qimageConvertKernelTable
+{
+	qimageConvertFunc	kernels[QIMAGE_KERNEL_COUNT];
+};
+
+static const qimageConvertKernelTable s_scalarConvertKernels =
+{
+	swapRB3Scalar, swapRB4Scalar, swapRB4OpaqueScalar, opaque4Scalar,
+	pad3Scalar, pad3SwapRBScalar, greyToRGBAScalar,
+	r5g6b5ToRGBAScalar, x1r5g5b5ToRGBAScalar, a1r5g5b5ToRGBAScalar,
+};
+
+// The 3 byte layouts need a byte shuffle, without SSSE3 they stay scalar //
+static const qimageConvertKernelTable s_sse2ConvertKernels =
+{
+	swapRB3Scalar, swapRB4SSE2, swapRB4OpaqueSSE2, opaque4SSE2,
+	pad3Scalar, pad3SwapRBScalar, greyToRGBASSE2,
+	r5g6b5ToRGBASSE2, x1r5g5b5ToRGBASSE2, a1r5g5b5ToRGBASSE2,
+};
+
+static const qimageConvertKernelTable s_ssse3ConvertKernels =
+{
+	qimageSwapRB3SSSE3, qimageSwapRB4SSSE3, qimageSwapRB4OpaqueSSSE3, opaque4SSE2,
+	qimagePad3SSSE3, qimagePad3SwapRBSSSE3, greyToRGBASSE2,
+	r5g6b5ToRGBASSE2, x1r5g5b5ToRGBASSE2, a1r5g5b5ToRGBASSE2,
+};
+
+// 256 bit shuffles stay within 128 bit lanes, packed 3 byte rows are left to SSSE3 //
+static const qimageConvertKernelTable s_avx2ConvertKernels =
+{
+	qimageSwapRB3SSSE3, qimageSwapRB4AVX2, qimageSwapRB4OpaqueAVX2, qimageOpaque4AVX2,
+	qimagePad3AVX2, qimagePad3SwapRBAVX2, qimageGreyToRGBAAVX2,
+	qimageR5G6B5ToRGBAAVX2, qimageX1R5G5B5ToRGBAAVX2, qimageA1R5G5B5ToRGBAAVX2,
+};
+
+// The AVX level picks up AVX2 when the CPU has it, SSSE3 otherwise //
+static const qimageConvertKernelTable* qimageGetConvertKernels()
+{
+	switch(QMATH_GET_SIMD_LEVEL())
+	{
+		case QMATH_SIMD_AVX:
+			if(QCPU_HAS_FEATURE(QCPU_FEATURE_AVX2))
+				return &s_avx2ConvertKernels;
+			// fall through
+
+		case QMATH_SIMD_SSE:
+			if(QCPU_HAS_FEATURE(QCPU_FEATURE_SSSE3))
+				return &s_ssse3ConvertKernels;
+			return QCPU_HAS_FEATURE(QCPU_FEATURE_SSE2) ? &s_sse2ConvertKernels : &s_scalarConvertKernels;
+
+		default:
+			return &s_scalarConvertKernels;
+	}
+}
+
+
+struct qimageConvertRoute
+{
+	QIMAGE_PIXEL_LAYOUT		src;
+	QIMAGE_PIXEL_LAYOUT		dst;
+	qimageConvertKernel		kernel;
+};
+
+// Conversions with a dedicated kernel, everything else goes through RGBA8 //
+static const qimageConvertRoute s_convertRoutes[] =
+{
+	{ QIMAGE_LAYOUT_BGR8,		QIMAGE_LAYOUT_RGB8,		QIMAGE_KERNEL_SWAP_RB3 },
+	{ QIMAGE_LAYOUT_RGB8,		QIMAGE_LAYOUT_BGR8,		QIMAGE_KERNEL_SWAP_RB3 },
+	{ QIMAGE_LAYOUT_BGRA8,		QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_SWAP_RB4 },
+	{ QIMAGE_LAYOUT_RGBA8,		QIMAGE_LAYOUT_BGRA8,	QIMAGE_KERNEL_SWAP_RB4 },
+	{ QIMAGE_LAYOUT_BGRX8,		QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_SWAP_RB4_OPAQUE },
+	{ QIMAGE_LAYOUT_RGBX8,		QIMAGE_LAYOUT_BGRA8,	QIMAGE_KERNEL_SWAP_RB4_OPAQUE },
+	{ QIMAGE_LAYOUT_RGBX8,		QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_OPAQUE4 },
+	{ QIMAGE_LAYOUT_BGRX8,		QIMAGE_LAYOUT_BGRA8,	QIMAGE_KERNEL_OPAQUE4 },
+	{ QIMAGE_LAYOUT_RGB8,		QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_PAD3 },
+	{ QIMAGE_LAYOUT_BGR8,		QIMAGE_LAYOUT_BGRA8,	QIMAGE_KERNEL_PAD3 },
+	{ QIMAGE_LAYOUT_BGR8,		QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_PAD3_SWAP_RB },
+	{ QIMAGE_LAYOUT_RGB8,		QIMAGE_LAYOUT_BGRA8,	QIMAGE_KERNEL_PAD3_SWAP_RB },
+	{ QIMAGE_LAYOUT_I8,			QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_GREY_TO_RGBA },
+	{ QIMAGE_LAYOUT_I8,			QIMAGE_LAYOUT_BGRA8,	QIMAGE_KERNEL_GREY_TO_RGBA },
+	{ QIMAGE_LAYOUT_R5G6B5,		QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_R5G6B5 },
+	{ QIMAGE_LAYOUT_X1R5G5B5,	QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_X1R5G5B5 },
+	{ QIMAGE_LAYOUT_A1R5G5B5,	QIMAGE_LAYOUT_RGBA8,	QIMAGE_KERNEL_A1R5G5B5 },
+};
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// GENERIC CONVERSION
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Any layout to RGBA8 //
+static void qimageUnpackRow(const QIMAGE_PIXEL_LAYOUT& layout, const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	switch(layout)
+	{
+		case QIMAGE_LAYOUT_I8:			greyToRGBAScalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_RGB8:		pad3Scalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_BGR8:		pad3SwapRBScalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_RGBA8:		memcpy(dst, src, n * 4); break;
+		case QIMAGE_LAYOUT_BGRA8:		swapRB4Scalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_RGBX8:		opaque4Scalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_BGRX8:		swapRB4OpaqueScalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_R5G6B5:		r5g6b5ToRGBAScalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_X1R5G5B5:	x1r5g5b5ToRGBAScalar(src, dst, n); break;
+		case QIMAGE_LAYOUT_A1R5G5B5:	a1r5g5b5ToRGBAScalar(src, dst, n); break;
+
+		case QIMAGE_LAYOUT_IA8:
+			for(unsigned int i = 0; i < n; ++i, src += 2, dst += 4)
+			{
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = src[1];
+			}
+			break;
+	}
+}
+
+// RGBA8 to a writable layout, grey layouts keep the red channel //
+static void qimagePackRow(const QIMAGE_PIXEL_LAYOUT& layout, const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	switch(layout)
+	{
+		case QIMAGE_LAYOUT_I8:
+			for(unsigned int i = 0; i < n; ++i)
+				dst[i] = src[i * 4];
+			break;
+
+		case QIMAGE_LAYOUT_IA8:
+			for(unsigned int i = 0; i < n; ++i)
+			{
+				dst[i * 2] = src[i * 4];
+				dst[i * 2 + 1] = src[i * 4 + 3];
+			}
+			break;
+
+		case QIMAGE_LAYOUT_RGB8:
+		case QIMAGE_LAYOUT_BGR8:
+		{
+			unsigned int r = (layout == QIMAGE_LAYOUT_RGB8) ? 0 : 2;
+			for(unsigned int i = 0; i < n; ++i, src += 4, dst += 3)
+			{
+				dst[0] = src[r];
+				dst[1] = src[1];
+				dst[2] = src[2 - r];
+			}
+			break;
+		}
+
+		case QIMAGE_LAYOUT_RGBA8:		memcpy(dst, src, n * 4); break;
+		case QIMAGE_LAYOUT_BGRA8:		swapRB4Scalar(src, dst, n); break;
+		default:						break;
+	}
+}
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// CONVERSION
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Minimum number of texels handed to one thread //
+#define QIMAGE_CONVERT_GRAIN		65536
+
+struct qimageConvertJob
+{
+	const unsigned char*	src;
+	unsigned char*			dst;
+	unsigned int			w, h;
+	unsigned int			srcPitch, dstPitch;
+	bool					flipY;
+	QIMAGE_PIXEL_LAYOUT		srcLayout, dstLayout;
+	qimageConvertFunc		kernel;			// NULL for a plain copy when both layouts match
+	bool					generic;
+};
+
+
+static void qimageConvertRows(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	const qimageConvertJob& job = *(const qimageConvertJob*)data;
+	unsigned char* rgba = (job.generic) ? new unsigned char[job.w * 4] : NULL;
+
+	for(unsigned int y = begin; y < end; ++y)
+	{
+		const unsigned char* src = job.src + (size_t)y * job.srcPitch;
+		unsigned char* dst = job.dst + (size_t)((job.flipY) ? job.h - 1 - y : y) * job.dstPitch;
+
+		if(job.generic)
+		{
+			qimageUnpackRow(job.srcLayout, src, rgba, job.w);
+			qimagePackRow(job.dstLayout, rgba, dst, job.w);
+		}
+		else if(job.kernel)
+			job.kernel(src, dst, job.w);
+		else if(src != dst)
+			memcpy(dst, src, job.dstPitch);
+	}
+
+	delete[] rgba;
+}
+
+
+
+QIMAGEEXPORT_API unsigned int QIMAGE_GET_LAYOUT_BYTES(const QIMAGE_PIXEL_LAYOUT& layout)
+{
+	static const unsigned int bytes[] = { 1, 2, 3, 4, 3, 4, 4, 4, 2, 2, 2 };
+	return (layout <= QIMAGE_LAYOUT_A1R5G5B5) ? bytes[layout] : 0;
+}
+
+QIMAGEEXPORT_API bool QIMAGE_CONVERT(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const QIMAGE_PIXEL_LAYOUT& srcLayout,
+									 const QIMAGE_PIXEL_LAYOUT& dstLayout, const bool& flipY, const unsigned int& srcPitch)
+{
+	if(!src || !dst || srcLayout > QIMAGE_LAYOUT_A1R5G5B5 || dstLayout > QIMAGE_LAYOUT_BGRA8)
+		return false;
+	if(!w || !h)
+		return true;
+
+	qimageConvertJob job;
+	job.src = (const unsigned char*)src;
+	job.dst = (unsigned char*)dst;
+	job.w = w;
+	job.h = h;
+	job.srcPitch = (srcPitch) ? srcPitch : w * QIMAGE_GET_LAYOUT_BYTES(srcLayout);
+	job.dstPitch = w * QIMAGE_GET_LAYOUT_BYTES(dstLayout);
+	job.flipY = flipY;
+	job.srcLayout = srcLayout;
+	job.dstLayout = dstLayout;
+	job.kernel = NULL;
+	job.generic = false;
+
+	// In place only works row for row //
+	if(job.src == job.dst && (flipY || job.srcPitch != job.dstPitch))
+		return false;
+
+	if(srcLayout != dstLayout)
+	{
+		const qimageConvertKernelTable* k = qimageGetConvertKernels();
+		job.generic = true;
+		for(unsigned int i = 0; i < sizeof(s_convertRoutes) / sizeof(s_convertRoutes[0]); ++i)
+		{
+			if(s_convertRoutes[i].src == srcLayout && s_convertRoutes[i].dst == dstLayout)
+			{
+				job.kernel = k->kernels[s_convertRoutes[i].kernel];
+				job.generic = false;
+				break;
+			}
+		}
+	}
+
+	unsigned int grain = QIMAGE_CONVERT_GRAIN / w + 1;
+	QPARALLEL_FOR(h, grain, qimageConvertRows, &job);
+	return true;
+}
@@ -0,0 +1,326 @@
+#include "stdafx.h"
+#include "qimage.h"
+#include "qmath.h"
+#include "qcpu.h"
+#include "qparallel.h"
+#include "qimage_simd.h"
+
+#include <emmintrin.h>
+#include <math.h>
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// NORMAL MAP KERNELS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// The 5x5 Sobel pair is separable. The x gradient is [1 2 0 -2 -1] along a row followed by     //
+// [1 4 6 4 1] down the column, the y gradient swaps the two. Each source row is filtered once   //
+// horizontally into a smooth and a derivative row, the vertical pass then combines 5 of those.  //
+// All sums fit 16 bits (at most 16 * 6 * 255) and are exact, so every path gives the same result //
+
+// padded: w + 4 heights with 2 wrapped texels on either side //
+static void filterHeightRowScalar(const unsigned char* padded, unsigned int w, short* smooth, short* deriv)
+{
+	for(unsigned int x = 0; x < w; ++x)
+	{
+		const unsigned char* p = &padded[x];
+		smooth[x] = (short)(p[0] + 4 * p[1] + 6 * p[2] + 4 * p[3] + p[4]);
+		deriv[x] = (short)(p[0] + 2 * p[1] - 2 * p[3] - p[4]);
+	}
+}
+
+// Encodes one normal, the gradients are raw Sobel sums //
+static inline unsigned int packNormal(int gx, int gy, unsigned char height, float sz)
+{
+	float sX = (float)gx * (1.0f / (48 * 255));
+	float sY = (float)gy * (1.0f / (48 * 255));
+	float invLen = 1.0f / sqrtf(sX * sX + sY * sY + sz * sz);
+
+	unsigned int r = (unsigned int)(int)(127.5f * (sX * invLen + 1.0f));
+	unsigned int g = (unsigned int)(int)(127.5f * (sY * invLen + 1.0f));
+	unsigned int b = (unsigned int)(int)(127.5f * (sz * invLen + 1.0f));
+	return (r & 0xFF) | ((g & 0xFF) << 8) | ((b & 0xFF) << 16) | ((unsigned int)height << 24);
+}
+
+// smooth / deriv: the 5 filtered rows centred on the output row. Writes w RGBA8 texels with the //
+// height in alpha                                                                               //
+static void buildNormalRowScalar(const short* const* smooth, const short* const* deriv, const unsigned char* heights, unsigned int w, float sz, unsigned char* out)
+{
+	for(unsigned int x = 0; x < w; ++x)
+	{
+		int gx = deriv[0][x] + 4 * deriv[1][x] + 6 * deriv[2][x] + 4 * deriv[3][x] + deriv[4][x];
+		int gy = smooth[0][x] + 2 * smooth[1][x] - 2 * smooth[3][x] - smooth[4][x];
+
+		unsigned int n = packNormal(gx, gy, heights[x], sz);
+		out[x * 4 + 0] = (unsigned char)n;
+		out[x * 4 + 1] = (unsigned char)(n >> 8);
+		out[x * 4 + 2] = (unsigned char)(n >> 16);
+		out[x * 4 + 3] = (unsigned char)(n >> 24);
+	}
+}
+
+
+static void filterHeightRowSSE2(const unsigned char* padded, unsigned int w, short* smooth, short* deriv)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	unsigned int x = 0;
+	for(; x + 8 <= w; x += 8)
+	{
+		__m128i p0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&padded[x]), zero);
+		__m128i p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&padded[x + 1]), zero);
+		__m128i p2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&padded[x + 2]), zero);
+		__m128i p3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&padded[x + 3]), zero);
+		__m128i p4 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&padded[x + 4]), zero);
+
+		__m128i outer = _mm_add_epi16(p0, p4);
+		__m128i inner = _mm_add_epi16(p1, p3);
+		__m128i s = _mm_add_epi16(_mm_add_epi16(outer, _mm_slli_epi16(inner, 2)), _mm_add_epi16(_mm_slli_epi16(p2, 2), _mm_slli_epi16(p2, 1)));
+		__m128i d = _mm_add_epi16(_mm_sub_epi16(p0, p4), _mm_slli_epi16(_mm_sub_epi16(p1, p3), 1));
+
+		_mm_storeu_si128((__m128i*)&smooth[x], s);
+		_mm_storeu_si128((__m128i*)&deriv[x], d);
+	}
+
+	filterHeightRowScalar(&padded[x], w - x, &smooth[x], &deriv[x]);
+}
+
+// Four normals from sign extended gradient sums and zero extended heights //
+static inline __m128i packNormal4(const __m128i& gx, const __m128i& gy, const __m128i& heights, const __m128& sz)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / (48 * 255));
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(127.5f);
+
+	__m128 sX = _mm_mul_ps(_mm_cvtepi32_ps(gx), scale);
+	__m128 sY = _mm_mul_ps(_mm_cvtepi32_ps(gy), scale);
+	__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, sX), _mm_mul_ps(sY, sY)), _mm_mul_ps(sz, sz));
+	__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(len2));
+
+	__m128i r = _mm_cvttps_epi32(_mm_mul_ps(half, _mm_add_ps(_mm_mul_ps(sX, invLen), one)));
+	__m128i g = _mm_cvttps_epi32(_mm_mul_ps(half, _mm_add_ps(_mm_mul_ps(sY, invLen), one)));
+	__m128i b = _mm_cvttps_epi32(_mm_mul_ps(half, _mm_add_ps(_mm_mul_ps(sz, invLen), one)));
+
+	// Masked like the scalar code, a zero length (sz = 0 on flat ground) must not spill into alpha //
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	__m128i n = _mm_or_si128(_mm_and_si128(r, mask), _mm_slli_epi32(_mm_and_si128(g, mask), 8));
+	n = _mm_or_si128(n, _mm_slli_epi32(_mm_and_si128(b, mask), 16));
+	return _mm_or_si128(n, _mm_slli_epi32(heights, 24));
+}
+
+static void buildNormalRowSSE2(const short* const* smooth, const short* const* deriv, const unsigned char* heights, unsigned int w, float sz, unsigned char* out)
+{
+	const __m128 szv = _mm_set1_ps(sz);
+	const __m128i zero = _mm_setzero_si128();
+
+	unsigned int x = 0;
+	for(; x + 8 <= w; x += 8)
+	{
+		__m128i d0 = _mm_loadu_si128((const __m128i*)&deriv[0][x]);
+		__m128i d1 = _mm_loadu_si128((const __m128i*)&deriv[1][x]);
+		__m128i d2 = _mm_loadu_si128((const __m128i*)&deriv[2][x]);
+		__m128i d3 = _mm_loadu_si128((const __m128i*)&deriv[3][x]);
+		__m128i d4 = _mm_loadu_si128((const __m128i*)&deriv[4][x]);
+		__m128i gx = _mm_add_epi16(_mm_add_epi16(d0, d4), _mm_slli_epi16(_mm_add_epi16(d1, d3), 2));
+		gx = _mm_add_epi16(gx, _mm_add_epi16(_mm_slli_epi16(d2, 2), _mm_slli_epi16(d2, 1)));
+
+		__m128i s0 = _mm_loadu_si128((const __m128i*)&smooth[0][x]);
+		__m128i s1 = _mm_loadu_si128((const __m128i*)&smooth[1][x]);
+		__m128i s3 = _mm_loadu_si128((const __m128i*)&smooth[3][x]);
+		__m128i s4 = _mm_loadu_si128((const __m128i*)&smooth[4][x]);
+		__m128i gy = _mm_add_epi16(_mm_sub_epi16(s0, s4), _mm_slli_epi16(_mm_sub_epi16(s1, s3), 1));
+
+		__m128i h = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&heights[x]), zero);
+
+		_mm_storeu_si128((__m128i*)&out[x * 4], packNormal4(_mm_srai_epi32(_mm_unpacklo_epi16(gx, gx), 16), _mm_srai_epi32(_mm_unpacklo_epi16(gy, gy), 16),
+															 _mm_unpacklo_epi16(h, zero), szv));
+		_mm_storeu_si128((__m128i*)&out[x * 4 + 16], packNormal4(_mm_srai_epi32(_mm_unpackhi_epi16(gx, gx), 16), _mm_srai_epi32(_mm_unpackhi_epi16(gy, gy), 16),
+																  _mm_unpackhi_epi16(h, zero), szv));
+	}
+
+	if(x < w)
+	{
+		const short* sTail[5] = { &smooth[0][x], &smooth[1][x], &smooth[2][x], &smooth[3][x], &smooth[4][x] };
+		const short* dTail[5] = { &deriv[0][x], &deriv[1][x], &deriv[2][x], &deriv[3][x], &deriv[4][x] };
+		buildNormalRowScalar(sTail, dTail, &heights[x], w - x, sz, &out[x * 4]);
+	}
+}
+
+
+
+struct qimageNormalKernelTable
+{
+	void (*filterHeightRow)(const unsigned char* padded, unsigned int w, short* smooth, short* deriv);
+	void (*buildNormalRow)(const short* const* smooth, const short* const* deriv, const unsigned char* heights, unsigned int w, float sz, unsigned char* out);
+};
+
+static const qimageNormalKernelTable s_scalarNormalKernels =
+{
+	filterHeightRowScalar, buildNormalRowScalar,
+};
+
+static const qimageNormalKernelTable s_sseNormalKernels =
+{
+	filterHeightRowSSE2, buildNormalRowSSE2,
+};
+
+// The horizontal pass is 16 bit integer work and stays on SSE2, AVX normalises 8 texels at a time //
+static const qimageNormalKernelTable s_avxNormalKernels =
+{
+	filterHeightRowSSE2, qimageBuildNormalRowAVX,
+};
+
+static const qimageNormalKernelTable* qimageGetNormalKernels()
+{
+	switch(QMATH_GET_SIMD_LEVEL())
+	{
+		case QMATH_SIMD_AVX:	return &s_avxNormalKernels;
+		case QMATH_SIMD_SSE:	return QCPU_HAS_FEATURE(QCPU_FEATURE_SSE2) ? &s_sseNormalKernels : &s_scalarNormalKernels;
+		default:				return &s_scalarNormalKernels;
+	}
+}
+
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// HEIGHT TO NORMAL
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Rows per tile, each tile filters 4 rows beyond its own //
+#define QIMAGE_NORMAL_TILE_ROWS		32
+
+// Minimum number of texels handed to one thread //
+#define QIMAGE_NORMAL_GRAIN			16384
+
+struct qimageNormalJob
+{
+	const unsigned char*			src;
+	unsigned char*					dst;
+	unsigned int					w, h;
+	unsigned int					nChannels;
+	unsigned int					tilesPerSlice;
+	float							weighted[3][256];		// channel value * weight, for 3 and 4 channel heights
+	float							sz;
+	const qimageNormalKernelTable*	kernels;
+};
+
+
+static inline unsigned int qimageWrap(const int& i, const unsigned int& n)
+{
+	int r = i % (int)n;
+	return (unsigned int)((r < 0) ? r + (int)n : r);
+}
+
+// Heights of one source row into padded[2, w + 2), the 2 texels on either side wrap around //
+static void qimageLoadHeightRow(const qimageNormalJob& job, const unsigned char* row, unsigned char* padded)
+{
+	unsigned int c = job.nChannels;
+	unsigned char* h = padded + 2;
+
+	if(c == 1)
+		memcpy(h, row, job.w);
+	else if(c == 2)
+	{
+		for(unsigned int x = 0; x < job.w; ++x)
+			h[x] = row[x * 2];
+	}
+	else
+	{
+		// Same products and order of additions as the plain weighted sum //
+		const float* rf = job.weighted[0];
+		const float* gf = job.weighted[1];
+		const float* bf = job.weighted[2];
+		for(unsigned int x = 0; x < job.w; ++x, row += c)
+			h[x] = (unsigned char)(rf[row[0]] + gf[row[1]] + bf[row[2]]);
+	}
+
+	padded[0] = h[qimageWrap(-2, job.w)];
+	padded[1] = h[qimageWrap(-1, job.w)];
+	padded[job.w + 2] = h[qimageWrap(job.w, job.w)];
+	padded[job.w + 3] = h[qimageWrap(job.w + 1, job.w)];
+}
+
+
+// Every tile keeps the last 5 filtered rows in a ring, a row is loaded and filtered exactly once //
+static void qimageNormalTiles(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	const qimageNormalJob& job = *(const qimageNormalJob*)data;
+	const qimageNormalKernelTable* k = job.kernels;
+
+	unsigned int w = job.w;
+	unsigned int paddedStride = (w + 4 + 15) & ~15;
+	unsigned int filteredStride = (w + 7) & ~7;
+	size_t srcSliceBytes = (size_t)w * job.h * job.nChannels;
+	size_t dstSliceBytes = (size_t)w * job.h * 4;
+
+	unsigned char* padded = new unsigned char[paddedStride * 5];
+	short* filtered = new short[filteredStride * 10];
+
+	for(unsigned int t = begin; t < end; ++t)
+	{
+		unsigned int slice = t / job.tilesPerSlice;
+		unsigned int y0 = (t % job.tilesPerSlice) * QIMAGE_NORMAL_TILE_ROWS;
+		unsigned int y1 = (y0 + QIMAGE_NORMAL_TILE_ROWS < job.h) ? y0 + QIMAGE_NORMAL_TILE_ROWS : job.h;
+		const unsigned char* src = job.src + slice * srcSliceBytes;
+		unsigned char* dst = job.dst + slice * dstSliceBytes;
+
+		// Ring slot i holds source row y0 - 2 + i (mod 5) //
+		for(int i = 0; i < (int)(y1 - y0) + 4; ++i)
+		{
+			unsigned int slot = i % 5;
+			unsigned int sy = qimageWrap((int)y0 - 2 + i, job.h);
+			unsigned char* p = &padded[slot * paddedStride];
+			qimageLoadHeightRow(job, src + (size_t)sy * w * job.nChannels, p);
+			k->filterHeightRow(p, w, &filtered[slot * filteredStride], &filtered[(slot + 5) * filteredStride]);
+
+			if(i < 4)
+				continue;
+
+			unsigned int y = y0 + i - 4;
+			const short* smooth[5];
+			const short* deriv[5];
+			for(unsigned int j = 0; j < 5; ++j)
+			{
+				unsigned int s = (i - 4 + j) % 5;
+				smooth[j] = &filtered[s * filteredStride];
+				deriv[j] = &filtered[(s + 5) * filteredStride];
+			}
+
+			const unsigned char* heights = &padded[((i - 2) % 5) * paddedStride + 2];
+			k->buildNormalRow(smooth, deriv, heights, w, job.sz, dst + (size_t)y * w * 4);
+		}
+	}
+
+	delete[] padded;
+	delete[] filtered;
+}
+
+
+
+QIMAGEEXPORT_API void QIMAGE_HEIGHT_TO_NORMAL(const void* src, void* dst, const unsigned int& w, const unsigned int& h, const unsigned int& nSlices,
+											  const unsigned int& nChannels, const float& sz, const float& rf, const float& gf, const float& bf)
+{
+	if(!src || !dst || !w || !h || !nSlices || !nChannels || nChannels > 4)
+		return;
+
+	qimageNormalJob job;
+	job.src = (const unsigned char*)src;
+	job.dst = (unsigned char*)dst;
+	job.w = w;
+	job.h = h;
+	job.nChannels = nChannels;
+	job.tilesPerSlice = (h + QIMAGE_NORMAL_TILE_ROWS - 1) / QIMAGE_NORMAL_TILE_ROWS;
+	for(unsigned int i = 0; i < 256; ++i)
+	{
+		job.weighted[0][i] = i * rf;
+		job.weighted[1][i] = i * gf;
+		job.weighted[2][i] = i * bf;
+	}
+	job.sz = sz;
+	job.kernels = qimageGetNormalKernels();
+
+	unsigned int grain = QIMAGE_NORMAL_GRAIN / (w * QIMAGE_NORMAL_TILE_ROWS) + 1;
+	QPARALLEL_FOR(nSlices * job.tilesPerSlice, grain, qimageNormalTiles, &job);
+}
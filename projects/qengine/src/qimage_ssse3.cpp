@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "qimage.h"
+#include "qimage_simd.h"
+
+#include <tmmintrin.h>
+
+
+// This file is compiled with SSSE3 enabled for pshufb. Nothing in here may be called unless //
+// QCPU_FEATURE_SSSE3 was reported, qimage only installs these kernels in that case.        //
+
+
+// Shuffles 4 packed 3 byte texels held in the low 12 bytes of every 16 byte load //
+static const unsigned char s_swapRB3Ctrl[16] = { 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 0x80, 0x80, 0x80, 0x80 };
+static const unsigned char s_pad3Ctrl[16] = { 0, 1, 2, 0x80, 3, 4, 5, 0x80, 6, 7, 8, 0x80, 9, 10, 11, 0x80 };
+static const unsigned char s_pad3SwapCtrl[16] = { 2, 1, 0, 0x80, 5, 4, 3, 0x80, 8, 7, 6, 0x80, 11, 10, 9, 0x80 };
+static const unsigned char s_swapRB4Ctrl[16] = { 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 };
+
+
+void qimageSwapRB3SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	const __m128i ctrl = _mm_loadu_si128((const __m128i*)s_swapRB3Ctrl);
+
+	// 16 texels per pass, all four loads happen before the three stores so in place works. //
+	// The last load reaches 4 bytes past the 16th texel, hence the 18 texel condition      //
+	unsigned int x = 0;
+	for(; x + 18 <= n; x += 16)
+	{
+		const unsigned char* s = &src[x * 3];
+		__m128i s0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)s), ctrl);
+		__m128i s1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 12)), ctrl);
+		__m128i s2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 24)), ctrl);
+		__m128i s3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 36)), ctrl);
+
+		unsigned char* d = &dst[x * 3];
+		_mm_storeu_si128((__m128i*)d, _mm_or_si128(s0, _mm_slli_si128(s1, 12)));
+		_mm_storeu_si128((__m128i*)(d + 16), _mm_or_si128(_mm_srli_si128(s1, 4), _mm_slli_si128(s2, 8)));
+		_mm_storeu_si128((__m128i*)(d + 32), _mm_or_si128(_mm_srli_si128(s2, 8), _mm_slli_si128(s3, 4)));
+	}
+
+	for(; x < n; ++x)
+	{
+		unsigned char c0 = src[x * 3];
+		unsigned char c2 = src[x * 3 + 2];
+		dst[x * 3] = c2;
+		dst[x * 3 + 1] = src[x * 3 + 1];
+		dst[x * 3 + 2] = c0;
+	}
+}
+
+
+static inline void pad3SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n, const unsigned char* ctrlBytes)
+{
+	const __m128i ctrl = _mm_loadu_si128((const __m128i*)ctrlBytes);
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+	unsigned int x = 0;
+	for(; x + 18 <= n; x += 16)
+	{
+		const unsigned char* s = &src[x * 3];
+		unsigned char* d = &dst[x * 4];
+		_mm_storeu_si128((__m128i*)d, _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)s), ctrl), alpha));
+		_mm_storeu_si128((__m128i*)(d + 16), _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 12)), ctrl), alpha));
+		_mm_storeu_si128((__m128i*)(d + 32), _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 24)), ctrl), alpha));
+		_mm_storeu_si128((__m128i*)(d + 48), _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 36)), ctrl), alpha));
+	}
+
+	for(; x < n; ++x)
+	{
+		dst[x * 4] = src[x * 3 + ctrlBytes[0]];
+		dst[x * 4 + 1] = src[x * 3 + 1];
+		dst[x * 4 + 2] = src[x * 3 + ctrlBytes[2]];
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+void qimagePad3SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	pad3SSSE3(src, dst, n, s_pad3Ctrl);
+}
+
+void qimagePad3SwapRBSSSE3(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	pad3SSSE3(src, dst, n, s_pad3SwapCtrl);
+}
+
+
+static inline void swapRB4SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n, const bool& opaque)
+{
+	const __m128i ctrl = _mm_loadu_si128((const __m128i*)s_swapRB4Ctrl);
+	const __m128i alpha = (opaque) ? _mm_set1_epi32(0xFF000000) : _mm_setzero_si128();
+
+	unsigned int x = 0;
+	for(; x + 4 <= n; x += 4)
+		_mm_storeu_si128((__m128i*)&dst[x * 4], _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[x * 4]), ctrl), alpha));
+
+	for(; x < n; ++x)
+	{
+		unsigned char c0 = src[x * 4];
+		unsigned char c2 = src[x * 4 + 2];
+		dst[x * 4] = c2;
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = c0;
+		dst[x * 4 + 3] = (opaque) ? 255 : src[x * 4 + 3];
+	}
+}
+
+void qimageSwapRB4SSSE3(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	swapRB4SSSE3(src, dst, n, false);
+}
+
+void qimageSwapRB4OpaqueSSSE3(const unsigned char* src, unsigned char* dst, unsigned int n)
+{
+	swapRB4SSSE3(src, dst, n, true);
+}
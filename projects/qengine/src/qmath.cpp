@@ -1,5 +1,12 @@
 #include "stdafx.h"
 #include "qmath.h"
+#include "qmath_simd.h"
+#include "qcpu.h"
+#include "qparallel.h"
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
 
 
 
@@ -49,9 +56,860 @@ QMATHEXPORT_API float QMATH_MIN(const float& l, const float& r)
 
 
 
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// MATRIX KERNELS
+//
+// Every kernel reads all of its inputs before writing, so out may alias l or r.
+// Matrices are column major: column c lives at m[c * 4] .. m[c * 4 + 3].
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
+static void matMulScalar(const float* l, const float* r, float* out)
+{
+	float t[16];
+	for(int c = 0; c < 4; ++c)
+	{
+		const float* rc = &r[c * 4];
+		t[c * 4]     = (l[0] * rc[0]) + (l[4] * rc[1]) + (l[8] * rc[2])  + (l[12] * rc[3]);
+		t[c * 4 + 1] = (l[1] * rc[0]) + (l[5] * rc[1]) + (l[9] * rc[2])  + (l[13] * rc[3]);
+		t[c * 4 + 2] = (l[2] * rc[0]) + (l[6] * rc[1]) + (l[10] * rc[2]) + (l[14] * rc[3]);
+		t[c * 4 + 3] = (l[3] * rc[0]) + (l[7] * rc[1]) + (l[11] * rc[2]) + (l[15] * rc[3]);
+	}
+	memcpy(out, t, sizeof(float) * 16);
+}
+
+static void mulVecScalar(const float* l, const float* r, float* out)
+{
+	float x = r[0], y = r[1], z = r[2], w = r[3];
+	out[0] = l[0] * x + l[4] * y + l[8] * z + l[12] * w;
+	out[1] = l[1] * x + l[5] * y + l[9] * z + l[13] * w;
+	out[2] = l[2] * x + l[6] * y + l[10] * z + l[14] * w;
+	out[3] = l[3] * x + l[7] * y + l[11] * z + l[15] * w;
+}
+
+static void matTransposeScalar(float* m)
+{
+	swap(m[1], m[4]);
+	swap(m[2], m[8]);
+	swap(m[3], m[12]);
+	swap(m[6], m[9]);
+	swap(m[7], m[13]);
+	swap(m[11], m[14]);
+}
+
+static void matMulBatchScalar(const float* l, const float* r, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		matMulScalar(l, &r[i * 16], &out[i * 16]);
+}
+
+static void mulVecBatchScalar(const float* l, const float* r, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		mulVecScalar(l, &r[i * 4], &out[i * 4]);
+}
+
+static void transformPointsScalar(const float* l, const float* r, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		float x = r[i * 3], y = r[i * 3 + 1], z = r[i * 3 + 2];
+		out[i * 3]     = l[0] * x + l[4] * y + l[8] * z + l[12];
+		out[i * 3 + 1] = l[1] * x + l[5] * y + l[9] * z + l[13];
+		out[i * 3 + 2] = l[2] * x + l[6] * y + l[10] * z + l[14];
+	}
+}
+
+
+// SSE //
+
+static inline __m128 sseMulCol(const __m128& c0, const __m128& c1, const __m128& c2, const __m128& c3, const float* v)
+{
+	__m128 vv = _mm_loadu_ps(v);
+	__m128 res = _mm_mul_ps(c0, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(0, 0, 0, 0)));
+	res = _mm_add_ps(res, _mm_mul_ps(c1, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(1, 1, 1, 1))));
+	res = _mm_add_ps(res, _mm_mul_ps(c2, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(2, 2, 2, 2))));
+	res = _mm_add_ps(res, _mm_mul_ps(c3, _mm_shuffle_ps(vv, vv, _MM_SHUFFLE(3, 3, 3, 3))));
+	return res;
+}
+
+static void matMulSSE(const float* l, const float* r, float* out)
+{
+	__m128 c0 = _mm_loadu_ps(&l[0]);
+	__m128 c1 = _mm_loadu_ps(&l[4]);
+	__m128 c2 = _mm_loadu_ps(&l[8]);
+	__m128 c3 = _mm_loadu_ps(&l[12]);
+
+	__m128 o0 = sseMulCol(c0, c1, c2, c3, &r[0]);
+	__m128 o1 = sseMulCol(c0, c1, c2, c3, &r[4]);
+	__m128 o2 = sseMulCol(c0, c1, c2, c3, &r[8]);
+	__m128 o3 = sseMulCol(c0, c1, c2, c3, &r[12]);
+
+	_mm_storeu_ps(&out[0], o0);
+	_mm_storeu_ps(&out[4], o1);
+	_mm_storeu_ps(&out[8], o2);
+	_mm_storeu_ps(&out[12], o3);
+}
+
+static void mulVecSSE(const float* l, const float* r, float* out)
+{
+	__m128 res = sseMulCol(_mm_loadu_ps(&l[0]), _mm_loadu_ps(&l[4]), _mm_loadu_ps(&l[8]), _mm_loadu_ps(&l[12]), r);
+	_mm_storeu_ps(out, res);
+}
+
+static void matTransposeSSE(float* m)
+{
+	__m128 c0 = _mm_loadu_ps(&m[0]);
+	__m128 c1 = _mm_loadu_ps(&m[4]);
+	__m128 c2 = _mm_loadu_ps(&m[8]);
+	__m128 c3 = _mm_loadu_ps(&m[12]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	_mm_storeu_ps(&m[0], c0);
+	_mm_storeu_ps(&m[4], c1);
+	_mm_storeu_ps(&m[8], c2);
+	_mm_storeu_ps(&m[12], c3);
+}
+
+static void matMulBatchSSE(const float* l, const float* r, float* out, unsigned int n)
+{
+	__m128 c0 = _mm_loadu_ps(&l[0]);
+	__m128 c1 = _mm_loadu_ps(&l[4]);
+	__m128 c2 = _mm_loadu_ps(&l[8]);
+	__m128 c3 = _mm_loadu_ps(&l[12]);
+
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		const float* ri = &r[i * 16];
+		float* oi = &out[i * 16];
+
+		__m128 o0 = sseMulCol(c0, c1, c2, c3, &ri[0]);
+		__m128 o1 = sseMulCol(c0, c1, c2, c3, &ri[4]);
+		__m128 o2 = sseMulCol(c0, c1, c2, c3, &ri[8]);
+		__m128 o3 = sseMulCol(c0, c1, c2, c3, &ri[12]);
+
+		_mm_storeu_ps(&oi[0], o0);
+		_mm_storeu_ps(&oi[4], o1);
+		_mm_storeu_ps(&oi[8], o2);
+		_mm_storeu_ps(&oi[12], o3);
+	}
+}
+
+static void mulVecBatchSSE(const float* l, const float* r, float* out, unsigned int n)
+{
+	__m128 c0 = _mm_loadu_ps(&l[0]);
+	__m128 c1 = _mm_loadu_ps(&l[4]);
+	__m128 c2 = _mm_loadu_ps(&l[8]);
+	__m128 c3 = _mm_loadu_ps(&l[12]);
+
+	for(unsigned int i = 0; i < n; ++i)
+		_mm_storeu_ps(&out[i * 4], sseMulCol(c0, c1, c2, c3, &r[i * 4]));
+}
+
+static void transformPointsSSE(const float* l, const float* r, float* out, unsigned int n)
+{
+	__m128 c0 = _mm_loadu_ps(&l[0]);
+	__m128 c1 = _mm_loadu_ps(&l[4]);
+	__m128 c2 = _mm_loadu_ps(&l[8]);
+	__m128 c3 = _mm_loadu_ps(&l[12]);
+
+	// All but the last point can be stored 4 wide, the 4th lane spilling into the next point //
+	// which is rewritten on the following iteration. Inputs are read before the store so    //
+	// in place transforms remain correct.                                                    //
+	unsigned int i = 0;
+	for(; i + 1 < n; ++i)
+	{
+		const float* p = &r[i * 3];
+		__m128 res = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(p[0])));
+		res = _mm_add_ps(res, _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+		res = _mm_add_ps(res, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+		__m128 next = _mm_set1_ps(r[i * 3 + 3]);
+		res = _mm_shuffle_ps(res, _mm_unpackhi_ps(res, next), _MM_SHUFFLE(3, 0, 1, 0));
+		_mm_storeu_ps(&out[i * 3], res);
+	}
+
+	transformPointsScalar(l, &r[i * 3], &out[i * 3], n - i);
+}
+
+
+// Frustum culling //
+// A box is rejected when its most positive vertex along a plane normal is behind the plane.   //
+// In center/extent form that vertex's distance is dot(n, c) + d + dot(abs(n), e) so no corners //
+// need to be built. Results are written 8 volumes per mask byte.                             //
+
+static void cullAABBsScalar(const float* planes, const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, unsigned int n, unsigned char* mask)
+{
+	for(unsigned int b = 0; b < n; b += 8)
+	{
+		unsigned char bits = 0;
+		for(unsigned int k = 0; k < 8; ++k)
+		{
+			unsigned int i = b + k;
+			bool visible = true;
+			for(int p = 0; p < 6 && visible; ++p)
+			{
+				const float* pl = &planes[p * 4];
+				float dist = pl[0] * cx[i] + pl[1] * cy[i] + pl[2] * cz[i] + pl[3];
+				float rad = fabsf(pl[0]) * ex[i] + fabsf(pl[1]) * ey[i] + fabsf(pl[2]) * ez[i];
+				visible = (dist + rad >= 0.0F);
+			}
+			if(visible)
+				bits |= (unsigned char)(1 << k);
+		}
+		mask[b >> 3] = bits;
+	}
+}
+
+static void cullSpheresScalar(const float* planes, const float* cx, const float* cy, const float* cz, const float* radius, unsigned int n, unsigned char* mask)
+{
+	for(unsigned int b = 0; b < n; b += 8)
+	{
+		unsigned char bits = 0;
+		for(unsigned int k = 0; k < 8; ++k)
+		{
+			unsigned int i = b + k;
+			bool visible = true;
+			for(int p = 0; p < 6 && visible; ++p)
+			{
+				const float* pl = &planes[p * 4];
+				float dist = pl[0] * cx[i] + pl[1] * cy[i] + pl[2] * cz[i] + pl[3];
+				visible = (dist + radius[i] >= 0.0F);
+			}
+			if(visible)
+				bits |= (unsigned char)(1 << k);
+		}
+		mask[b >> 3] = bits;
+	}
+}
+
+static void cullAABBsSSE(const float* planes, const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, unsigned int n, unsigned char* mask)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0F);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 pn[6][4], pa[6][3];
+	for(int p = 0; p < 6; ++p)
+	{
+		for(int c = 0; c < 4; ++c)
+			pn[p][c] = _mm_set1_ps(planes[p * 4 + c]);
+		for(int c = 0; c < 3; ++c)
+			pa[p][c] = _mm_andnot_ps(signMask, pn[p][c]);
+	}
+
+	for(unsigned int b = 0; b < n; b += 8)
+	{
+		int bits = 0;
+		for(unsigned int h = 0; h < 8; h += 4)
+		{
+			unsigned int i = b + h;
+			__m128 x = _mm_loadu_ps(&cx[i]), y = _mm_loadu_ps(&cy[i]), z = _mm_loadu_ps(&cz[i]);
+			__m128 ax = _mm_loadu_ps(&ex[i]), ay = _mm_loadu_ps(&ey[i]), az = _mm_loadu_ps(&ez[i]);
+			__m128 vis = _mm_cmpeq_ps(zero, zero);
+
+			for(int p = 0; p < 6; ++p)
+			{
+				__m128 d = _mm_add_ps(_mm_mul_ps(pn[p][0], x), pn[p][3]);
+				d = _mm_add_ps(d, _mm_mul_ps(pn[p][1], y));
+				d = _mm_add_ps(d, _mm_mul_ps(pn[p][2], z));
+				d = _mm_add_ps(d, _mm_mul_ps(pa[p][0], ax));
+				d = _mm_add_ps(d, _mm_mul_ps(pa[p][1], ay));
+				d = _mm_add_ps(d, _mm_mul_ps(pa[p][2], az));
+				vis = _mm_and_ps(vis, _mm_cmpge_ps(d, zero));
+			}
+
+			bits |= _mm_movemask_ps(vis) << h;
+		}
+		mask[b >> 3] = (unsigned char)bits;
+	}
+}
+
+static void cullSpheresSSE(const float* planes, const float* cx, const float* cy, const float* cz, const float* radius, unsigned int n, unsigned char* mask)
+{
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 pn[6][4];
+	for(int p = 0; p < 6; ++p)
+	{
+		for(int c = 0; c < 4; ++c)
+			pn[p][c] = _mm_set1_ps(planes[p * 4 + c]);
+	}
+
+	for(unsigned int b = 0; b < n; b += 8)
+	{
+		int bits = 0;
+		for(unsigned int h = 0; h < 8; h += 4)
+		{
+			unsigned int i = b + h;
+			__m128 x = _mm_loadu_ps(&cx[i]), y = _mm_loadu_ps(&cy[i]), z = _mm_loadu_ps(&cz[i]);
+			__m128 r = _mm_loadu_ps(&radius[i]);
+			__m128 vis = _mm_cmpeq_ps(zero, zero);
+
+			for(int p = 0; p < 6; ++p)
+			{
+				__m128 d = _mm_add_ps(_mm_mul_ps(pn[p][0], x), pn[p][3]);
+				d = _mm_add_ps(d, _mm_mul_ps(pn[p][1], y));
+				d = _mm_add_ps(d, _mm_mul_ps(pn[p][2], z));
+				vis = _mm_and_ps(vis, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+			}
+
+			bits |= _mm_movemask_ps(vis) << h;
+		}
+		mask[b >> 3] = (unsigned char)bits;
+	}
+}
+
+
+
+// Inverse kernels. Cofactor expansion, returns false (out untouched) when the matrix is singular //
+static bool matInverseScalar(const float* m, float* out)
+{
+	float inv[16];
+	
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+	
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if(det == 0.0F)
+		return false;
+	
+	float iDet = 1.0F / det;
+	for(int i = 0; i < 16; ++i)
+		out[i] = inv[i] * iDet;
+	return true;
+}
+
+// Upper 3x3 inverse transpose (the normal matrix) of n affine matrices, translation is zeroed. //
+// Rows of the 3x3 inverse are the cross products of the columns over the determinant.         //
+static void invTransposeBatchScalar(const float* in, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		const float* m = &in[i * 16];
+		float* o = &out[i * 16];
+		
+		float r0x = m[5] * m[10] - m[6] * m[9],  r0y = m[6] * m[8] - m[4] * m[10],  r0z = m[4] * m[9] - m[5] * m[8];
+		float r1x = m[9] * m[2] - m[10] * m[1],  r1y = m[10] * m[0] - m[8] * m[2],  r1z = m[8] * m[1] - m[9] * m[0];
+		float r2x = m[1] * m[6] - m[2] * m[5],   r2y = m[2] * m[4] - m[0] * m[6],   r2z = m[0] * m[5] - m[1] * m[4];
+		
+		float det = m[0] * r0x + m[1] * r0y + m[2] * r0z;
+		float iDet = (det != 0.0F) ? 1.0F / det : 0.0F;
+		
+		o[0] = r0x * iDet;	o[4] = r1x * iDet;	o[8] = r2x * iDet;		o[12] = 0.0F;
+		o[1] = r0y * iDet;	o[5] = r1y * iDet;	o[9] = r2y * iDet;		o[13] = 0.0F;
+		o[2] = r0z * iDet;	o[6] = r1z * iDet;	o[10] = r2z * iDet;		o[14] = 0.0F;
+		o[3] = 0.0F;		o[7] = 0.0F;		o[11] = 0.0F;			o[15] = 1.0F;
+	}
+}
+
+
+// Shuffle selector in memory order (lane 0 first), the reverse of _MM_SHUFFLE //
+#define QMATH_SHUF(x, y, z, w)		((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define QMATH_SWIZZLE(v, x, y, z, w)	_mm_shuffle_ps(v, v, QMATH_SHUF(x, y, z, w))
+
+// 2x2 block helpers, a 2x2 block is held as (m00, m01, m10, m11) //
+static inline __m128 sseMat2Mul(const __m128& a, const __m128& b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, QMATH_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(QMATH_SWIZZLE(a, 1, 0, 3, 2), QMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// adj(a) * b //
+static inline __m128 sseMat2AdjMul(const __m128& a, const __m128& b)
+{
+	return _mm_sub_ps(_mm_mul_ps(QMATH_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(QMATH_SWIZZLE(a, 1, 1, 2, 2), QMATH_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// a * adj(b) //
+static inline __m128 sseMat2MulAdj(const __m128& a, const __m128& b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, QMATH_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(QMATH_SWIZZLE(a, 1, 0, 3, 2), QMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// General inverse by 2x2 block decomposition. The routine treats the four loaded vectors as rows; //
+// since inverse(transpose(M)) == transpose(inverse(M)) it is equally valid on column major data.  //
+static bool matInverseSSE(const float* m, float* out)
+{
+	__m128 c0 = _mm_loadu_ps(&m[0]);
+	__m128 c1 = _mm_loadu_ps(&m[4]);
+	__m128 c2 = _mm_loadu_ps(&m[8]);
+	__m128 c3 = _mm_loadu_ps(&m[12]);
+	
+	__m128 A = _mm_movelh_ps(c0, c1);
+	__m128 B = _mm_movehl_ps(c1, c0);
+	__m128 C = _mm_movelh_ps(c2, c3);
+	__m128 D = _mm_movehl_ps(c3, c2);
+	
+	// (|A|, |B|, |C|, |D|) //
+	__m128 detSub = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(c0, c2, QMATH_SHUF(0, 2, 0, 2)), _mm_shuffle_ps(c1, c3, QMATH_SHUF(1, 3, 1, 3))),
+							   _mm_mul_ps(_mm_shuffle_ps(c0, c2, QMATH_SHUF(1, 3, 1, 3)), _mm_shuffle_ps(c1, c3, QMATH_SHUF(0, 2, 0, 2))));
+	__m128 detA = QMATH_SWIZZLE(detSub, 0, 0, 0, 0);
+	__m128 detB = QMATH_SWIZZLE(detSub, 1, 1, 1, 1);
+	__m128 detC = QMATH_SWIZZLE(detSub, 2, 2, 2, 2);
+	__m128 detD = QMATH_SWIZZLE(detSub, 3, 3, 3, 3);
+	
+	__m128 DC = sseMat2AdjMul(D, C);
+	__m128 AB = sseMat2AdjMul(A, B);
+	__m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), sseMat2Mul(B, DC));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), sseMat2Mul(C, AB));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), sseMat2MulAdj(D, AB));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), sseMat2MulAdj(A, DC));
+	
+	// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C) //
+	__m128 tr = _mm_mul_ps(AB, QMATH_SWIZZLE(DC, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, _mm_movehl_ps(tr, tr));
+	tr = _mm_add_ss(tr, QMATH_SWIZZLE(tr, 1, 1, 1, 1));
+	__m128 detM = _mm_sub_ss(_mm_add_ss(_mm_mul_ss(detA, detD), _mm_mul_ss(detB, detC)), tr);
+	
+	float det = _mm_cvtss_f32(detM);
+	if(det == 0.0F)
+		return false;
+	
+	__m128 rDet = _mm_div_ps(_mm_setr_ps(1.0F, -1.0F, -1.0F, 1.0F), QMATH_SWIZZLE(detM, 0, 0, 0, 0));
+	X = _mm_mul_ps(X, rDet);
+	Y = _mm_mul_ps(Y, rDet);
+	Z = _mm_mul_ps(Z, rDet);
+	W = _mm_mul_ps(W, rDet);
+	
+	_mm_storeu_ps(&out[0], _mm_shuffle_ps(X, Y, QMATH_SHUF(3, 1, 3, 1)));
+	_mm_storeu_ps(&out[4], _mm_shuffle_ps(X, Y, QMATH_SHUF(2, 0, 2, 0)));
+	_mm_storeu_ps(&out[8], _mm_shuffle_ps(Z, W, QMATH_SHUF(3, 1, 3, 1)));
+	_mm_storeu_ps(&out[12], _mm_shuffle_ps(Z, W, QMATH_SHUF(2, 0, 2, 0)));
+	return true;
+}
+
+static inline __m128 sseCross(const __m128& a, const __m128& b)
+{
+	__m128 r = _mm_sub_ps(_mm_mul_ps(a, QMATH_SWIZZLE(b, 1, 2, 0, 3)), _mm_mul_ps(QMATH_SWIZZLE(a, 1, 2, 0, 3), b));
+	return QMATH_SWIZZLE(r, 1, 2, 0, 3);
+}
+
+static void invTransposeBatchSSE(const float* in, float* out, unsigned int n)
+{
+	static const QMATH_ALIGN(16) unsigned int xyzBits[4] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0 };
+	const __m128 xyzMask = _mm_load_ps((const float*)xyzBits);
+	const __m128 wAxis = _mm_setr_ps(0.0F, 0.0F, 0.0F, 1.0F);
+	
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		const float* m = &in[i * 16];
+		float* o = &out[i * 16];
+		
+		__m128 c0 = _mm_and_ps(_mm_loadu_ps(&m[0]), xyzMask);
+		__m128 c1 = _mm_and_ps(_mm_loadu_ps(&m[4]), xyzMask);
+		__m128 c2 = _mm_and_ps(_mm_loadu_ps(&m[8]), xyzMask);
+		
+		__m128 r0 = sseCross(c1, c2);
+		__m128 r1 = sseCross(c2, c0);
+		__m128 r2 = sseCross(c0, c1);
+		
+		__m128 d = _mm_mul_ps(c0, r0);
+		__m128 det = _mm_add_ps(_mm_add_ps(QMATH_SWIZZLE(d, 0, 0, 0, 0), QMATH_SWIZZLE(d, 1, 1, 1, 1)), QMATH_SWIZZLE(d, 2, 2, 2, 2));
+		__m128 iDet = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0F), det), _mm_cmpneq_ps(det, _mm_setzero_ps()));
+		
+		_mm_storeu_ps(&o[0], _mm_mul_ps(r0, iDet));
+		_mm_storeu_ps(&o[4], _mm_mul_ps(r1, iDet));
+		_mm_storeu_ps(&o[8], _mm_mul_ps(r2, iDet));
+		_mm_storeu_ps(&o[12], wAxis);
+	}
+}
+
+// Quaternion kernels. Quaternions are packed (x, y, z, w), t holds one interpolant per pair. //
+static void quatSlerpScalar(const float* l, const float* r, const float& t, float* out)
+{
+	float cosOmega = l[0] * r[0] + l[1] * r[1] + l[2] * r[2] + l[3] * r[3];
+	float sign = 1.0F;
+	if(cosOmega < 0.0F)
+	{
+		cosOmega = -cosOmega;
+		sign = -1.0F;
+	}
+	
+	// Nearly parallel quaternions fall back to a normalized lerp, sin(omega) is too small to divide by //
+	float k0 = 1.0F - t, k1 = t;
+	bool renorm = true;
+	if(cosOmega < 0.9995F)
+	{
+		float omega = acosf(cosOmega);
+		float iSin = 1.0F / sinf(omega);
+		k0 = sinf(k0 * omega) * iSin;
+		k1 = sinf(t * omega) * iSin;
+		renorm = false;
+	}
+	k1 *= sign;
+	
+	float q[4];
+	for(int i = 0; i < 4; ++i)
+		q[i] = l[i] * k0 + r[i] * k1;
+	
+	float s = 1.0F;
+	if(renorm)
+	{
+		float len = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		s = (len > 0.0F) ? 1.0F / len : 0.0F;
+	}
+	for(int i = 0; i < 4; ++i)
+		out[i] = q[i] * s;
+}
+
+static void quatNlerpScalar(const float* l, const float* r, const float& t, float* out)
+{
+	float cosOmega = l[0] * r[0] + l[1] * r[1] + l[2] * r[2] + l[3] * r[3];
+	float k0 = 1.0F - t;
+	float k1 = (cosOmega < 0.0F) ? -t : t;
+	
+	float q[4];
+	for(int i = 0; i < 4; ++i)
+		q[i] = l[i] * k0 + r[i] * k1;
+	
+	float len = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	float s = (len > 0.0F) ? 1.0F / len : 0.0F;
+	for(int i = 0; i < 4; ++i)
+		out[i] = q[i] * s;
+}
+
+// Rotation from a unit quaternion plus an optional translation (t may be NULL) //
+static void quatToMatScalar(const float* q, const float* t, float* m)
+{
+	float x = q[0], y = q[1], z = q[2], w = q[3];
+	
+	m[0] = 1.0F - 2.0F * (y * y + z * z);
+	m[1] = 2.0F * (x * y + z * w);
+	m[2] = 2.0F * (x * z - y * w);
+	m[3] = 0.0F;
+	
+	m[4] = 2.0F * (x * y - z * w);
+	m[5] = 1.0F - 2.0F * (x * x + z * z);
+	m[6] = 2.0F * (z * y + x * w);
+	m[7] = 0.0F;
+	
+	m[8] = 2.0F * (x * z + y * w);
+	m[9] = 2.0F * (y * z - x * w);
+	m[10] = 1.0F - 2.0F * (x * x + y * y);
+	m[11] = 0.0F;
+	
+	m[12] = t ? t[0] : 0.0F;
+	m[13] = t ? t[1] : 0.0F;
+	m[14] = t ? t[2] : 0.0F;
+	m[15] = 1.0F;
+}
+
+static void slerpBatchScalar(const float* l, const float* r, const float* t, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		quatSlerpScalar(&l[i * 4], &r[i * 4], t[i], &out[i * 4]);
+}
+
+static void nlerpBatchScalar(const float* l, const float* r, const float* t, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		quatNlerpScalar(&l[i * 4], &r[i * 4], t[i], &out[i * 4]);
+}
+
+static void quatToMatBatchScalar(const float* q, const float* t, float* out, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; ++i)
+		quatToMatScalar(&q[i * 4], t ? &t[i * 3] : NULL, &out[i * 16]);
+}
+
+
+// sin(t * omega) / sin(omega) expanded as a polynomial in (cos(omega) - 1), after Eberly's "A Fast  //
+// and Accurate Algorithm for Computing SLERP". The last coefficient is scaled to absorb the          //
+// truncated tail of the series. With float rounding the result stays within 3e-6 of acos/sin.     //
+#define QMATH_SLERP_TERMS	12
+static const float s_slerpU[QMATH_SLERP_TERMS] = 
+{
+	0.333333333F, 0.1F, 0.0476190476F, 0.0277777778F, 0.0181818182F, 0.0128205128F, 
+	0.00952380952F, 0.00735294118F, 0.00584795322F, 0.00476190476F, 0.00395256917F, 0.00631241657F,
+};
+static const float s_slerpV[QMATH_SLERP_TERMS] = 
+{
+	0.333333333F, 0.4F, 0.428571429F, 0.444444444F, 0.454545455F, 0.461538462F, 
+	0.466666667F, 0.470588235F, 0.473684211F, 0.476190476F, 0.47826087F, 0.908987986F,
+};
+
+static inline __m128 sseSlerpCoeff(const __m128& t, const __m128& xm1)
+{
+	const __m128 one = _mm_set1_ps(1.0F);
+	__m128 sqrT = _mm_mul_ps(t, t);
+	
+	__m128 f = one;
+	for(int i = QMATH_SLERP_TERMS - 1; i >= 0; --i)
+	{
+		__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(s_slerpU[i]), sqrT), _mm_set1_ps(s_slerpV[i])), xm1);
+		f = _mm_add_ps(one, _mm_mul_ps(b, f));
+	}
+	return _mm_mul_ps(t, f);
+}
+
+typedef void (*qmathQuatPair4)(const float* l, const float* r, const __m128& t, float* out);
+
+// Four pairs at once in structure of arrays form //
+static void sseSlerp4(const float* l, const float* r, const __m128& t, float* out)
+{
+	__m128 lx = _mm_loadu_ps(&l[0]), ly = _mm_loadu_ps(&l[4]), lz = _mm_loadu_ps(&l[8]), lw = _mm_loadu_ps(&l[12]);
+	__m128 rx = _mm_loadu_ps(&r[0]), ry = _mm_loadu_ps(&r[4]), rz = _mm_loadu_ps(&r[8]), rw = _mm_loadu_ps(&r[12]);
+	_MM_TRANSPOSE4_PS(lx, ly, lz, lw);
+	_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+	
+	__m128 cosOmega = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, rx), _mm_mul_ps(ly, ry)), _mm_add_ps(_mm_mul_ps(lz, rz), _mm_mul_ps(lw, rw)));
+	__m128 sign = _mm_and_ps(cosOmega, _mm_set1_ps(-0.0F));
+	__m128 xm1 = _mm_sub_ps(_mm_xor_ps(cosOmega, sign), _mm_set1_ps(1.0F));
+	
+	__m128 k0 = sseSlerpCoeff(_mm_sub_ps(_mm_set1_ps(1.0F), t), xm1);
+	__m128 k1 = _mm_xor_ps(sseSlerpCoeff(t, xm1), sign);
+	
+	__m128 ox = _mm_add_ps(_mm_mul_ps(lx, k0), _mm_mul_ps(rx, k1));
+	__m128 oy = _mm_add_ps(_mm_mul_ps(ly, k0), _mm_mul_ps(ry, k1));
+	__m128 oz = _mm_add_ps(_mm_mul_ps(lz, k0), _mm_mul_ps(rz, k1));
+	__m128 ow = _mm_add_ps(_mm_mul_ps(lw, k0), _mm_mul_ps(rw, k1));
+	_MM_TRANSPOSE4_PS(ox, oy, oz, ow);
+	
+	_mm_storeu_ps(&out[0], ox);
+	_mm_storeu_ps(&out[4], oy);
+	_mm_storeu_ps(&out[8], oz);
+	_mm_storeu_ps(&out[12], ow);
+}
+
+static void sseNlerp4(const float* l, const float* r, const __m128& t, float* out)
+{
+	__m128 lx = _mm_loadu_ps(&l[0]), ly = _mm_loadu_ps(&l[4]), lz = _mm_loadu_ps(&l[8]), lw = _mm_loadu_ps(&l[12]);
+	__m128 rx = _mm_loadu_ps(&r[0]), ry = _mm_loadu_ps(&r[4]), rz = _mm_loadu_ps(&r[8]), rw = _mm_loadu_ps(&r[12]);
+	_MM_TRANSPOSE4_PS(lx, ly, lz, lw);
+	_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+	
+	__m128 cosOmega = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, rx), _mm_mul_ps(ly, ry)), _mm_add_ps(_mm_mul_ps(lz, rz), _mm_mul_ps(lw, rw)));
+	__m128 k0 = _mm_sub_ps(_mm_set1_ps(1.0F), t);
+	__m128 k1 = _mm_xor_ps(t, _mm_and_ps(cosOmega, _mm_set1_ps(-0.0F)));
+	
+	__m128 ox = _mm_add_ps(_mm_mul_ps(lx, k0), _mm_mul_ps(rx, k1));
+	__m128 oy = _mm_add_ps(_mm_mul_ps(ly, k0), _mm_mul_ps(ry, k1));
+	__m128 oz = _mm_add_ps(_mm_mul_ps(lz, k0), _mm_mul_ps(rz, k1));
+	__m128 ow = _mm_add_ps(_mm_mul_ps(lw, k0), _mm_mul_ps(rw, k1));
+	
+	__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_add_ps(_mm_mul_ps(oz, oz), _mm_mul_ps(ow, ow)));
+	__m128 iLen = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0F), _mm_sqrt_ps(lenSq)), _mm_cmpgt_ps(lenSq, _mm_setzero_ps()));
+	ox = _mm_mul_ps(ox, iLen);
+	oy = _mm_mul_ps(oy, iLen);
+	oz = _mm_mul_ps(oz, iLen);
+	ow = _mm_mul_ps(ow, iLen);
+	_MM_TRANSPOSE4_PS(ox, oy, oz, ow);
+	
+	_mm_storeu_ps(&out[0], ox);
+	_mm_storeu_ps(&out[4], oy);
+	_mm_storeu_ps(&out[8], oz);
+	_mm_storeu_ps(&out[12], ow);
+}
+
+// Runs a four wide pair kernel over n pairs, the tail is padded out with identities //
+static void sseQuatPairBatch(qmathQuatPair4 func, const float* l, const float* r, const float* t, float* out, unsigned int n)
+{
+	unsigned int i = 0;
+	for(; i + 4 <= n; i += 4)
+		func(&l[i * 4], &r[i * 4], _mm_loadu_ps(&t[i]), &out[i * 4]);
+	
+	if(i < n)
+	{
+		unsigned int rem = n - i;
+		float lt[16], rt[16], tt[4], ot[16];
+		for(unsigned int k = 0; k < 4; ++k)
+		{
+			for(unsigned int c = 0; c < 4; ++c)
+			{
+				lt[k * 4 + c] = (k < rem) ? l[(i + k) * 4 + c] : ((c == 3) ? 1.0F : 0.0F);
+				rt[k * 4 + c] = (k < rem) ? r[(i + k) * 4 + c] : ((c == 3) ? 1.0F : 0.0F);
+			}
+			tt[k] = (k < rem) ? t[i + k] : 0.0F;
+		}
+		
+		func(lt, rt, _mm_loadu_ps(tt), ot);
+		memcpy(&out[i * 4], ot, sizeof(float) * 4 * rem);
+	}
+}
+
+static void slerpBatchSSE(const float* l, const float* r, const float* t, float* out, unsigned int n)
+{
+	sseQuatPairBatch(sseSlerp4, l, r, t, out, n);
+}
+
+static void nlerpBatchSSE(const float* l, const float* r, const float* t, float* out, unsigned int n)
+{
+	sseQuatPairBatch(sseNlerp4, l, r, t, out, n);
+}
+
+// Four rigid transforms. The rotation terms are built in structure of arrays form and transposed //
+// back into columns, t holds four packed translations or is NULL.                                //
+static void sseQuatToMat4(const float* q, const float* t, float* out)
+{
+	__m128 x = _mm_loadu_ps(&q[0]), y = _mm_loadu_ps(&q[4]), z = _mm_loadu_ps(&q[8]), w = _mm_loadu_ps(&q[12]);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	
+	const __m128 one = _mm_set1_ps(1.0F);
+	__m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+	__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+	__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+	__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+	
+	__m128 c[3][4];
+	c[0][0] = _mm_sub_ps(one, _mm_add_ps(yy, zz));	c[0][1] = _mm_add_ps(xy, wz);	c[0][2] = _mm_sub_ps(xz, wy);
+	c[1][0] = _mm_sub_ps(xy, wz);	c[1][1] = _mm_sub_ps(one, _mm_add_ps(xx, zz));	c[1][2] = _mm_add_ps(yz, wx);
+	c[2][0] = _mm_add_ps(xz, wy);	c[2][1] = _mm_sub_ps(yz, wx);	c[2][2] = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+	
+	for(int col = 0; col < 3; ++col)
+	{
+		c[col][3] = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(c[col][0], c[col][1], c[col][2], c[col][3]);
+		for(int k = 0; k < 4; ++k)
+			_mm_storeu_ps(&out[k * 16 + col * 4], c[col][k]);
+	}
+	
+	for(int k = 0; k < 4; ++k)
+	{
+		__m128 trans = t ? _mm_setr_ps(t[k * 3], t[k * 3 + 1], t[k * 3 + 2], 1.0F) : _mm_setr_ps(0.0F, 0.0F, 0.0F, 1.0F);
+		_mm_storeu_ps(&out[k * 16 + 12], trans);
+	}
+}
+
+static void quatToMatBatchSSE(const float* q, const float* t, float* out, unsigned int n)
+{
+	unsigned int i = 0;
+	for(; i + 4 <= n; i += 4)
+		sseQuatToMat4(&q[i * 4], t ? &t[i * 3] : NULL, &out[i * 16]);
+	
+	for(; i < n; ++i)
+		quatToMatScalar(&q[i * 4], t ? &t[i * 3] : NULL, &out[i * 16]);
+}
+
+
+
+struct qmathKernelTable
+{
+	void (*matMul)(const float* l, const float* r, float* out);
+	void (*mulVec)(const float* l, const float* r, float* out);
+	void (*matTranspose)(float* m);
+	void (*matMulBatch)(const float* l, const float* r, float* out, unsigned int n);
+	void (*mulVecBatch)(const float* l, const float* r, float* out, unsigned int n);
+	void (*transformPoints)(const float* l, const float* r, float* out, unsigned int n);
+	void (*cullAABBs)(const float* planes, const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, unsigned int n, unsigned char* mask);
+	void (*cullSpheres)(const float* planes, const float* cx, const float* cy, const float* cz, const float* radius, unsigned int n, unsigned char* mask);
+	bool (*matInverse)(const float* m, float* out);
+	void (*invTransposeBatch)(const float* in, float* out, unsigned int n);
+	void (*slerpBatch)(const float* l, const float* r, const float* t, float* out, unsigned int n);
+	void (*nlerpBatch)(const float* l, const float* r, const float* t, float* out, unsigned int n);
+	void (*quatToMatBatch)(const float* q, const float* t, float* out, unsigned int n);
+};
+
+static const qmathKernelTable s_scalarKernels = 
+{
+	matMulScalar, mulVecScalar, matTransposeScalar,
+	matMulBatchScalar, mulVecBatchScalar, transformPointsScalar,
+	cullAABBsScalar, cullSpheresScalar,
+	matInverseScalar, invTransposeBatchScalar,
+	slerpBatchScalar, nlerpBatchScalar, quatToMatBatchScalar,
+};
+
+static const qmathKernelTable s_sseKernels = 
+{
+	matMulSSE, mulVecSSE, matTransposeSSE,
+	matMulBatchSSE, mulVecBatchSSE, transformPointsSSE,
+	cullAABBsSSE, cullSpheresSSE,
+	matInverseSSE, invTransposeBatchSSE,
+	slerpBatchSSE, nlerpBatchSSE, quatToMatBatchSSE,
+};
+
+// Single matrix ops gain nothing from 8 wide registers, so AVX only replaces the batch paths //
+static const qmathKernelTable s_avxKernels = 
+{
+	matMulSSE, mulVecSSE, matTransposeSSE,
+	qmathMatMulBatchAVX, qmathMulVecBatchAVX, qmathTransformPointsAVX,
+	qmathCullAABBsAVX, qmathCullSpheresAVX,
+	matInverseSSE, invTransposeBatchSSE,
+	slerpBatchSSE, nlerpBatchSSE, quatToMatBatchSSE,
+};
+
+// Holds the scalar kernels until qmathKernelInit below has run detection. QMATH_SET_SIMD_LEVEL swaps //
+// the table without a lock, change levels before other threads start calling in                    //
+static qmathKernelTable s_kernels = s_scalarKernels;
+static QMATH_SIMD_LEVEL s_simdLevel = QMATH_SIMD_SCALAR;
+
+
+QMATHEXPORT_API QMATH_SIMD_LEVEL QMATH_GET_SIMD_SUPPORT()
+{
+	if(QCPU_HAS_FEATURE(QCPU_FEATURE_AVX))
+		return QMATH_SIMD_AVX;
+	if(QCPU_HAS_FEATURE(QCPU_FEATURE_SSE))
+		return QMATH_SIMD_SSE;
+	return QMATH_SIMD_SCALAR;
+}
+
+QMATHEXPORT_API QMATH_SIMD_LEVEL QMATH_GET_SIMD_LEVEL()
+{
+	return s_simdLevel;
+}
+
+QMATHEXPORT_API QMATH_SIMD_LEVEL QMATH_SET_SIMD_LEVEL(const QMATH_SIMD_LEVEL& level)
+{
+	QMATH_SIMD_LEVEL support = QMATH_GET_SIMD_SUPPORT();
+	s_simdLevel = (level > support) ? support : level;
+
+	switch(s_simdLevel)
+	{
+		case QMATH_SIMD_AVX:	s_kernels = s_avxKernels;		break;
+		case QMATH_SIMD_SSE:	s_kernels = s_sseKernels;		break;
+		default:				s_kernels = s_scalarKernels;	break;
+	}
+
+	return s_simdLevel;
+}
+
+// Select the best kernels once the dll is loaded //
+static struct qmathKernelInit
+{
+	qmathKernelInit() { QMATH_SET_SIMD_LEVEL(QMATH_SIMD_AVX); }
+} s_kernelInit;
+
+
+QMATHEXPORT_API void* QMATH_ALIGNED_MALLOC(const size_t& size, const size_t& alignment)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(size, alignment);
+#else
+	void* p = NULL;
+	if(posix_memalign(&p, alignment, size) != 0)
+		return NULL;
+	return p;
+#endif
+}
+
+QMATHEXPORT_API void QMATH_ALIGNED_FREE(void* p)
+{
+	if(!p)
+		return;
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+
+
+
 
 vec3f::vec3f() : x(0), y(0), z(0) {}
 vec2f::vec2f() : x(0), y(0) {}
+quat::quat() : x(0), y(0), z(0), w(0) {}
 
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // VEC2F METHODS
@@ -160,6 +1018,36 @@ vec4f::vec4f(const float& nx, const float& ny, const float& nz, const float& nw)
 }
 
 
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// QUAT METHODS 
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
+quat::quat(const float* q)
+{
+	x = q[0];
+	y = q[1];
+	z = q[2];
+	w = q[3];
+}
+
+quat::quat(const quat& q)
+{
+	x = q.x;
+	y = q.y;
+	z = q.z;
+	w = q.w;
+}
+
+quat::quat(const float& nx, const float& ny, const float& nz, const float& nw)
+{
+	x = nx;
+	y = ny;
+	z = nz;
+	w = nw;
+}
+
+
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // POINT2F METHODS 
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -649,12 +1537,7 @@ QMATHEXPORT_API void QMATH_MATRIX_LOADPERSPECTIVE_DX(mat4& m, const float& fov,
 
 QMATHEXPORT_API void QMATH_MATRIX_TRANSPOSE(mat4& m)
 {
-	swap(m[1], m[4]);
-	swap(m[2], m[8]);
-	swap(m[3], m[12]);
-	swap(m[6], m[9]);
-	swap(m[7], m[13]);
-	swap(m[11], m[14]);	
+	s_kernels.matTranspose(m);
 }
 
 QMATHEXPORT_API void QMATH_MATRIX_TRANSPOSE(mat3& m)
@@ -666,17 +1549,51 @@ QMATHEXPORT_API void QMATH_MATRIX_TRANSPOSE(mat3& m)
 
 QMATHEXPORT_API void QMATH_MATRIX_INVERT(mat4& m)
 {
-	m[0] = -m[0];
-	m[1] = -m[1];
-	m[2] = -m[2];
+	s_kernels.matInverse(m, m);
+}
+
+QMATHEXPORT_API bool QMATH_MATRIX_INVERSE(const mat4& m, mat4& out)
+{
+	return s_kernels.matInverse(m, out);
+}
+
+QMATHEXPORT_API bool QMATH_MATRIX_INVERSE_AFFINE(const mat4& m, mat4& out)
+{
+	float r0x = m[5] * m[10] - m[6] * m[9],  r0y = m[6] * m[8] - m[4] * m[10],  r0z = m[4] * m[9] - m[5] * m[8];
+	float r1x = m[9] * m[2] - m[10] * m[1],  r1y = m[10] * m[0] - m[8] * m[2],  r1z = m[8] * m[1] - m[9] * m[0];
+	float r2x = m[1] * m[6] - m[2] * m[5],   r2y = m[2] * m[4] - m[0] * m[6],   r2z = m[0] * m[5] - m[1] * m[4];
+	
+	float det = m[0] * r0x + m[1] * r0y + m[2] * r0z;
+	if(det == 0.0F)
+		return false;
 	
-	m[4] = -m[4];
-	m[5] = -m[5];
-	m[6] = -m[6];
+	float iDet = 1.0F / det;
+	r0x *= iDet;	r0y *= iDet;	r0z *= iDet;
+	r1x *= iDet;	r1y *= iDet;	r1z *= iDet;
+	r2x *= iDet;	r2y *= iDet;	r2z *= iDet;
 	
-	m[8] = -m[8];
-	m[9] = -m[9];
-	m[10] = -m[10];	
+	float tx = m[12], ty = m[13], tz = m[14];
+	out[0] = r0x;	out[4] = r0y;	out[8] = r0z;		out[12] = -(r0x * tx + r0y * ty + r0z * tz);
+	out[1] = r1x;	out[5] = r1y;	out[9] = r1z;		out[13] = -(r1x * tx + r1y * ty + r1z * tz);
+	out[2] = r2x;	out[6] = r2y;	out[10] = r2z;		out[14] = -(r2x * tx + r2y * ty + r2z * tz);
+	out[3] = 0.0F;	out[7] = 0.0F;	out[11] = 0.0F;		out[15] = 1.0F;
+	return true;
+}
+
+QMATHEXPORT_API void QMATH_MATRIX_INVERSE_RIGID(const mat4& m, mat4& out)
+{
+	float tx = m[12], ty = m[13], tz = m[14];
+	float r[9] = { m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10] };
+	
+	out[0] = r[0];	out[4] = r[1];	out[8] = r[2];		out[12] = -(r[0] * tx + r[1] * ty + r[2] * tz);
+	out[1] = r[3];	out[5] = r[4];	out[9] = r[5];		out[13] = -(r[3] * tx + r[4] * ty + r[5] * tz);
+	out[2] = r[6];	out[6] = r[7];	out[10] = r[8];		out[14] = -(r[6] * tx + r[7] * ty + r[8] * tz);
+	out[3] = 0.0F;	out[7] = 0.0F;	out[11] = 0.0F;		out[15] = 1.0F;
+}
+
+QMATHEXPORT_API void QMATH_MATRIX_INVERSETRANSPOSE_BATCH(const float* in, float* out, const unsigned int& n)
+{
+	s_kernels.invTransposeBatch(in, out, n);
 }
 
 QMATHEXPORT_API void QMATH_MATRIX_COPY(mat4& to, const mat4& from)
@@ -723,33 +1640,36 @@ QMATHEXPORT_API void QMATH_MATRIX_SUBTRACT(const mat4& l, const mat4& r, mat4& o
 
 QMATHEXPORT_API void QMATH_MATRIX_MULTIPLY(const mat4& l, const mat4& r, mat4& out)
 {
-	out[0] = (l[0] * r[0]) + (l[4] * r[1]) + (l[8] * r[2]) + (l[12] * r[3]);
-	out[4] = (l[0] * r[4]) + (l[4] * r[5]) + (l[8] * r[6]) + (l[12] * r[7]);
-	out[8] = (l[0] * r[8]) + (l[4] * r[9]) + (l[8] * r[10]) + (l[12] * r[11]);
-	out[12] = (l[0] * r[12]) + (l[4] * r[13]) + (l[8] * r[14]) + (l[12] * r[15]);
+	s_kernels.matMul(l, r, out);
+}
 
-	out[1] = (l[1] * r[0]) + (l[5] * r[1]) + (l[9] * r[2]) + (l[13] * r[3]);
-	out[5] = (l[1] * r[4]) + (l[5] * r[5]) + (l[9] * r[6]) + (l[13] * r[7]);
-	out[9] = (l[1] * r[8]) + (l[5] * r[9]) + (l[9] * r[10]) + (l[13] * r[11]);
-	out[13] = (l[1] * r[12]) + (l[5] * r[13]) + (l[9] * r[14]) + (l[13] * r[15]);
+QMATHEXPORT_API void QMATH_MATRIX_MULVEC(const mat4& l, const vec4f& r, vec4f& out)
+{
+	s_kernels.mulVec(l, &r.x, &out.x);
+}
 
-	out[2] = (l[2] * r[0]) + (l[6] * r[1]) + (l[10] * r[2]) + (l[14] * r[3]);
-	out[6] = (l[2] * r[4]) + (l[6] * r[5]) + (l[10] * r[6]) + (l[14] * r[7]);
-	out[10] = (l[2] * r[8]) + (l[6] * r[9]) + (l[10] * r[10]) + (l[14] * r[11]);
-	out[14] = (l[2] * r[12]) + (l[6] * r[13]) + (l[10] * r[14]) + (l[14] * r[15]);
+QMATHEXPORT_API void QMATH_MATRIX_MULTIPLY_BATCH(const mat4& l, const float* r, float* out, const unsigned int& n)
+{
+	if(!r || !out || !n)
+		return;
 
-	out[3] = (l[3] * r[0]) + (l[7] * r[1]) + (l[11] * r[2]) + (l[15] * r[3]);
-	out[7] = (l[3] * r[4]) + (l[7] * r[5]) + (l[11] * r[6]) + (l[15] * r[7]);
-	out[11] = (l[3] * r[8]) + (l[7] * r[9]) + (l[11] * r[10]) + (l[15] * r[11]);
-	out[15] = (l[3] * r[12]) + (l[7] * r[13]) + (l[11] * r[14]) + (l[15] * r[15]);	
+	s_kernels.matMulBatch(l, r, out, n);
 }
 
-QMATHEXPORT_API void QMATH_MATRIX_MULVEC(const mat4& l, const vec4f& r, vec4f& out)
+QMATHEXPORT_API void QMATH_MATRIX_MULVEC_BATCH(const mat4& l, const vec4f* r, vec4f* out, const unsigned int& n)
+{
+	if(!r || !out || !n)
+		return;
+
+	s_kernels.mulVecBatch(l, &r[0].x, &out[0].x, n);
+}
+
+QMATHEXPORT_API void QMATH_MATRIX_TRANSFORM_POINTS(const mat4& l, const vec3f* r, vec3f* out, const unsigned int& n)
 {
-	out.x = l[0] * r.x + l[4] * r.y + l[8] * r.z + l[12] * r.w;
-	out.y = l[1] * r.x + l[5] * r.y + l[9] * r.z + l[13] * r.w;
-	out.z = l[2] * r.x + l[6] * r.y + l[10] * r.z + l[14] * r.w;
-	out.w = l[3] * r.x + l[7] * r.y + l[11] * r.z + l[15] * r.w; 	
+	if(!r || !out || !n)
+		return;
+
+	s_kernels.transformPoints(l, &r[0].x, &out[0].x, n);
 }
 
 
@@ -773,240 +1693,521 @@ QMATHEXPORT_API float QMATH_MATRIX_DETERMINANT( const mat3& m )
 	return aei - afh - bdi + bfg + cdh - ceg; 			
 }
 
-QMATHEXPORT_API void  QMATH_MATRIX_DETERMINANT( const mat3& m, float& res )
+QMATHEXPORT_API void  QMATH_MATRIX_DETERMINANT( const mat3& m, float& res )
+{
+	float aei, afh, bdi, bfg, cdh, ceg;
+	aei = m[0] * m[4] * m[8];
+	afh = m[0] * m[7] * m[5];
+	bdi = m[3] * m[1] * m[8];
+	bfg = m[3] * m[7] * m[2];
+	cdh = m[6] * m[2] * m[5];
+	ceg = m[6] * m[5] * m[2];
+	
+	res = aei - afh - bdi + bfg + cdh - ceg; 		
+}
+
+
+QMATHEXPORT_API void QMATH_QUATERNION_ROTATE(quat& q, const float& rad, vec3f& axis)
+{
+	if((axis.x != 0 && axis.x != 1) || (axis.y != 0 && axis.y != 1) || (axis.z != 0 && axis.z != 1))
+		axis.normalize();
+	
+	float s = (float)sin(rad / 2.0f);
+	
+	vec3f tm(axis.x * s, axis.y * s, axis.z * s);
+	float w = (float)cos(rad / 2.0F);
+	float len = 1.0F / (float)sqrt(tm.x * tm.x + tm.y * tm.y + tm.z * tm.z + w * w);
+	tm.x *= len;
+	tm.y *= len;
+	tm.z *= len;
+	q.set(tm.x, tm.y, tm.z, w);
+		
+}
+
+QMATHEXPORT_API float QMATH_QUATERNION_GETANGLE(const quat& q)
+{
+	return 2.0 * acosf(q.w);
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_MAKEMATRIX(mat4& m, const quat& q)
+{
+	quatToMatScalar(&q.x, NULL, m);
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_MAKEMATRIX(mat4& m, const quat& q, const vec3f& t)
+{
+	quatToMatScalar(&q.x, &t.x, m);
+}
+
+
+QMATHEXPORT_API void QMATH_QUATERNION_MULQUAT(const quat& l, const quat& r, quat& out)
+{
+	float x = l.w * r.x + l.x * r.w + l.y * r.z - l.z * r.y;
+	float y = l.w * r.y - l.x * r.z + l.y * r.w + l.z * r.x;
+	float z = l.w * r.z + l.x * r.y - l.y * r.x + l.z * r.w;
+	float w = l.w * r.w - l.x * r.x - l.y * r.y - l.z * r.z;
+	out.set(x, y, z, w);
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_CONJUGATE(quat& q)
+{
+	q.x = -q.x; q.y = -q.y; q.z = -q.z; q.w = q.w;	
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_NORMALIZE(quat& q)
+{
+	q.normalize();
+}
+
+QMATHEXPORT_API float QMATH_QUATERNION_DOTPROD(const quat& l, const quat& r)
+{
+	return l.dotProd(r);
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_FROMAXISANGLE(quat& q, const vec3f& axis, const float& rad)
+{
+	float len = sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+	if(len <= 0.0F)
+	{
+		q.identity();
+		return;
+	}
+	
+	float s = sinf(rad * 0.5F) / len;
+	q.set(axis.x * s, axis.y * s, axis.z * s, cosf(rad * 0.5F));
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_TOAXISANGLE(const quat& q, vec3f& axis, float& rad)
+{
+	// atan2 of the vector and scalar parts stays accurate near the identity where acos(w) does not //
+	float s = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z);
+	rad = 2.0F * atan2f(s, q.w);
+	
+	if(s < 0.000001F)
+		axis.set(1.0F, 0.0F, 0.0F);
+	else
+		axis.set(q.x / s, q.y / s, q.z / s);
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_ROTATEVEC(const quat& q, const vec3f& v, vec3f& out)
+{
+	// v + w * t + cross(q.xyz, t) with t = 2 * cross(q.xyz, v) //
+	float tx = 2.0F * (q.y * v.z - q.z * v.y);
+	float ty = 2.0F * (q.z * v.x - q.x * v.z);
+	float tz = 2.0F * (q.x * v.y - q.y * v.x);
+	
+	out.set(v.x + q.w * tx + (q.y * tz - q.z * ty),
+			v.y + q.w * ty + (q.z * tx - q.x * tz),
+			v.z + q.w * tz + (q.x * ty - q.y * tx));
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_SLERP(const quat& l, const quat& r, const float& t, quat& out)
+{
+	quatSlerpScalar(&l.x, &r.x, t, &out.x);
+}
+
+QMATHEXPORT_API void QMATH_QUATERNION_NLERP(const quat& l, const quat& r, const float& t, quat& out)
 {
-	float aei, afh, bdi, bfg, cdh, ceg;
-	aei = m[0] * m[4] * m[8];
-	afh = m[0] * m[7] * m[5];
-	bdi = m[3] * m[1] * m[8];
-	bfg = m[3] * m[7] * m[2];
-	cdh = m[6] * m[2] * m[5];
-	ceg = m[6] * m[5] * m[2];
-	
-	res = aei - afh - bdi + bfg + cdh - ceg; 		
+	quatNlerpScalar(&l.x, &r.x, t, &out.x);
 }
 
+QMATHEXPORT_API void QMATH_QUATERNION_SLERP_BATCH(const quat* l, const quat* r, const float* t, quat* out, const unsigned int& n)
+{
+	s_kernels.slerpBatch((const float*)l, (const float*)r, t, (float*)out, n);
+}
 
-QMATHEXPORT_API void QMATH_QUATERNION_ROTATE(quat& q, const float& rad, vec3f& axis)
+QMATHEXPORT_API void QMATH_QUATERNION_NLERP_BATCH(const quat* l, const quat* r, const float* t, quat* out, const unsigned int& n)
 {
-	if((axis.x != 0 && axis.x != 1) || (axis.y != 0 && axis.y != 1) || (axis.z != 0 && axis.z != 1))
-		axis.normalize();
-	
-	float s = (float)sin(rad / 2.0f);
-	
-	vec3f tm(axis.x * s, axis.y * s, axis.z * s);
-	float w = (float)cos(rad / 2.0F);
-	float len = 1.0F / (float)sqrt(tm.x * tm.x + tm.y * tm.y + tm.z * tm.z + w * w);
-	tm.x *= len;
-	tm.y *= len;
-	tm.z *= len;
-	q.set(tm.x, tm.y, tm.z, w);
-		
+	s_kernels.nlerpBatch((const float*)l, (const float*)r, t, (float*)out, n);
 }
 
-QMATHEXPORT_API float QMATH_QUATERNION_GETANGLE(const quat& q)
+QMATHEXPORT_API void QMATH_QUATERNION_MAKEMATRIX_BATCH(const quat* q, const vec3f* t, float* out, const unsigned int& n)
 {
-	return 2.0 * acosf(q.w);
+	s_kernels.quatToMatBatch((const float*)q, (const float*)t, (float*)out, n);
 }
 
-QMATHEXPORT_API void QMATH_QUATERNION_MAKEMATRIX(mat4& m, const quat& q)
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// VERTEX NORMALS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Meshes with fewer polys than this are processed on the calling thread //
+#define QMATH_NORMALS_PARALLEL_POLYS	16384
+#define QMATH_NORMALS_GRAIN				4096
+
+
+struct qmathNormalJob
 {
-	m[0] = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
-	m[1] = 2.0f * (q.x * q.y + q.z * q.w);
-	m[2] = 2.0f * (q.x * q.z - q.y * q.w);
-	m[3] = 0.0f;
-	
-	m[4] = 2.0f * (q.x * q.y - q.z * q.w);
-	m[5] = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
-	m[6] = 2.0f * (q.z * q.y + q.x * q.w);
-	m[7] = 0.0f;
-	
-	m[8] = 2.0f * (q.x * q.z + q.y * q.w);
-	m[9] = 2.0f * (q.y * q.z - q.x * q.w);
-	m[10] = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
-	m[11] = 0.0f;
+	const vec3f*			verts;
+	const unsigned int*		polys;
 	
-	m[12] = 0.0f;
-	m[13] = 0.0f;
-	m[14] = 0.0f;
-	m[15] = 1.0f;	
-}
+	float*					faceNorms;		// unnormalized cross products, length is twice the area
+	unsigned int*			adjStart;		// vertex -> face adjacency, faces of v are
+	unsigned int*			adjFaces;		// adjFaces[adjStart[v] .. adjStart[v + 1])
+	float*					out;
+};
 
 
-QMATHEXPORT_API void QMATH_QUATERNION_MULQUAT(const quat& l, const quat& r, quat& out)
+static void qmathFaceNormals(void* data, const unsigned int& begin, const unsigned int& end)
 {
-	out.x = l.w * r.x + l.x * r.w + l.y * r.z - l.z * r.y;
-	out.y = l.w * r.y - l.x * r.z + l.y * r.w + l.z * r.x;
-	out.z = l.w * r.z + l.x * r.y - l.y * r.x + l.z * r.w;
-	out.w = l.w * r.w - l.x * r.x - l.y * r.y - l.z * r.z;	
+	qmathNormalJob* job = (qmathNormalJob*)data;
+	for(unsigned int f = begin; f < end; ++f)
+	{
+		const vec3f& a = job->verts[job->polys[f * 3]];
+		const vec3f& b = job->verts[job->polys[f * 3 + 1]];
+		const vec3f& c = job->verts[job->polys[f * 3 + 2]];
+		
+		float abx = b.x - a.x, aby = b.y - a.y, abz = b.z - a.z;
+		float acx = c.x - a.x, acy = c.y - a.y, acz = c.z - a.z;
+		
+		float* n = &job->faceNorms[f * 3];
+		n[0] = aby * acz - abz * acy;
+		n[1] = abz * acx - abx * acz;
+		n[2] = abx * acy - aby * acx;
+	}
 }
 
-QMATHEXPORT_API void QMATH_QUATERNION_CONJUGATE(quat& q)
+static inline void qmathStoreNormal(float* out, float x, float y, float z)
 {
-	q.x = -q.x; q.y = -q.y; q.z = -q.z; q.w = q.w;	
+	float len = sqrtf(x * x + y * y + z * z);
+	float iLen = (len > 0.0F) ? 1.0F / len : 0.0F;
+	out[0] = x * iLen;
+	out[1] = y * iLen;
+	out[2] = z * iLen;
 }
 
+// Gathers the face normals around each vertex through the adjacency table //
+static void qmathGatherVertexNormals(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	qmathNormalJob* job = (qmathNormalJob*)data;
+	for(unsigned int v = begin; v < end; ++v)
+	{
+		float x = 0.0F, y = 0.0F, z = 0.0F;
+		for(unsigned int i = job->adjStart[v]; i < job->adjStart[v + 1]; ++i)
+		{
+			const float* n = &job->faceNorms[job->adjFaces[i] * 3];
+			x += n[0];
+			y += n[1];
+			z += n[2];
+		}
+		
+		qmathStoreNormal(&job->out[v * 3], x, y, z);
+	}
+}
 
+// Builds the vertex -> face table with a counting sort, adjStart holds nVerts + 1 entries //
+static void qmathBuildVertexAdjacency(const unsigned int* polys, const unsigned int& nVerts, const unsigned int& nPolys, unsigned int* adjStart, unsigned int* adjFaces)
+{
+	memset(adjStart, 0, sizeof(unsigned int) * (nVerts + 1));
+	for(unsigned int i = 0; i < nPolys * 3; ++i)
+		++adjStart[polys[i] + 1];
+	for(unsigned int v = 0; v < nVerts; ++v)
+		adjStart[v + 1] += adjStart[v];
+	
+	unsigned int* fill = new unsigned int[nVerts];
+	memcpy(fill, adjStart, sizeof(unsigned int) * nVerts);
+	for(unsigned int f = 0; f < nPolys; ++f)
+	{
+		adjFaces[fill[polys[f * 3]]++] = f;
+		adjFaces[fill[polys[f * 3 + 1]]++] = f;
+		adjFaces[fill[polys[f * 3 + 2]]++] = f;
+	}
+	delete[] fill;
+}
 
+// Vertex normals are the normalized sum of the unnormalized face normals touching each vertex, //
+// which weights every face by its area. Small meshes scatter directly, large ones build an     //
+// adjacency table so vertices can be gathered independently on every core.                    //
 QMATHEXPORT_API void QMATH_CREATE_VERTEX_NORMALS(const vec3f* verts, const unsigned int& nVerts, const unsigned int* polys, const unsigned int& nPolys, float* norms)
 {
-	unsigned int* tmp;
-	vec3f a, b, c, tmpNorm;
-	vec3f tmpList[64];
-	int counter;
+	if(!nVerts)
+		return;
 	
-	// iterate through every vertex //
-	for(unsigned int j = 0; j < nVerts; ++j)
+	qmathNormalJob job;
+	memset(&job, 0, sizeof(job));
+	job.verts = verts;
+	job.polys = polys;
+	job.out = norms;
+	job.faceNorms = new float[nPolys * 3 + 3];
+	
+	if(nPolys < QMATH_NORMALS_PARALLEL_POLYS)
 	{
-		counter = 0;
+		qmathFaceNormals(&job, 0, nPolys);
 		
-		// check every poly for this vert //
-		for(unsigned int v = 0; v < nPolys; ++v)
+		memset(norms, 0, sizeof(float) * nVerts * 3);
+		for(unsigned int f = 0; f < nPolys; ++f)
 		{
-			tmp = (unsigned int*)&polys[v * 3];
-			if(*tmp != j)
-			{
-				++tmp;
-				if(*tmp != j)
-				{
-					++tmp;
-					if(*tmp != j)
-						continue;
-				}
-			}
-			
-			// if we're here, this vert is in the tri, so fetch verts //
-			unsigned int i1, i2, i3;
-			i1 = polys[v * 3];
-			i2 = polys[v * 3 + 1];
-			i3 = polys[v * 3 + 2];
-			
-			a.x = verts[i1].x; 
-			a.y = verts[i1].y;
-			a.z = verts[i1].z;
-			b.x = verts[i2].x;
-			b.y = verts[i2].y;
-			b.z = verts[i2].z;
-			c.x = verts[i3].x;
-			c.y = verts[i3].y;
-			c.z = verts[i3].z;
-			
-			vec3f ab, ac;
-			ac = c - a;
-			ab = b - a;
-			tmpNorm = QMATH_VEC3F_CROSSPROD(ab, ac);
-//			tmpNorm = QMATH_VEC3F_CROSSPROD(ac, ab);
-			QMATH_VEC3F_NORMALIZE(tmpNorm);
-
-			// check through the buffer list for this vert and look for dupes //
-			for(int z = 0; z < counter; ++z)
+			const float* n = &job.faceNorms[f * 3];
+			for(unsigned int k = 0; k < 3; ++k)
 			{
-				if(tmpNorm == tmpList[z])
-					goto end;
+				float* o = &norms[polys[f * 3 + k] * 3];
+				o[0] += n[0];
+				o[1] += n[1];
+				o[2] += n[2];
 			}
-			
-			// add to buffer list //
-			tmpList[counter].x = tmpNorm.x;
-			tmpList[counter].y = tmpNorm.y;
-			tmpList[counter].z = tmpNorm.z;
-			
-			++counter;
-			end:;
 		}
 		
-		tmpNorm.x = 0.0F;
-		tmpNorm.y = 0.0F;
-		tmpNorm.z = 0.0F;
-		for(int q = 0; q < counter; ++q)
-		{
-			tmpNorm.x += tmpList[q].x;
-			tmpNorm.y += tmpList[q].y;
-			tmpNorm.z += tmpList[q].z;
-		}
+		for(unsigned int v = 0; v < nVerts; ++v)
+			qmathStoreNormal(&norms[v * 3], norms[v * 3], norms[v * 3 + 1], norms[v * 3 + 2]);
+	}
+	
+	else
+	{
+		job.adjStart = new unsigned int[nVerts + 1];
+		job.adjFaces = new unsigned int[nPolys * 3];
 		
-		// copy to norm list //
-		QMATH_VEC3F_NORMALIZE(tmpNorm);
-		norms[j * 3] = tmpNorm.x;
-		norms[j * 3 + 1] = tmpNorm.y;
-		norms[j * 3 + 2] = tmpNorm.z;
+		QPARALLEL_FOR(nPolys, QMATH_NORMALS_GRAIN, qmathFaceNormals, &job);
+		qmathBuildVertexAdjacency(polys, nVerts, nPolys, job.adjStart, job.adjFaces);
+		QPARALLEL_FOR(nVerts, QMATH_NORMALS_GRAIN, qmathGatherVertexNormals, &job);
+		
+		delete[] job.adjStart;
+		delete[] job.adjFaces;
 	}
+	
+	delete[] job.faceNorms;
 }
 
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// TANGENT SPACE
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
-struct tanIndex
-{
-	vec3f tan;
-	int vertRef;
-};
+// Welded vertices must also agree on their normals to within this cosine //
+#define QMATH_TANGENT_WELD_NORMAL_DOT	0.999F
 
 
-QMATHEXPORT_API void QMATH_CREATE_TANGENT_SPACE(const vec3f* verts, const unsigned int& nVerts, const unsigned int* polys, const unsigned int& nPolys, const vec2f* texcoords, const vec3f* norms, vec3f* tangent)
+struct qmathTangentJob
 {
-	tanIndex* tan1 = static_cast<tanIndex*>(calloc(nPolys * 3, sizeof(tanIndex)));
+	const vec3f*			verts;
+	const vec3f*			norms;
+	const vec2f*			texcoords;
+	const unsigned int*		polys;
 	
-	if(!tan1)
-		return;
+	unsigned int*			rep;			// welded representative of every vertex
+	float*					faceTans;		// per face unnormalized tangent and bitangent (6 floats)
+	float*					repTans;		// per representative accumulated frame (6 floats)
+	unsigned int*			adjStart;
+	unsigned int*			adjFaces;
 	
-	for(unsigned int i = 0; i < nPolys; ++i)
+	vec3f*					tangents;
+	vec3f*					bitangents;
+};
+
+
+static void qmathFaceTangents(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	qmathTangentJob* job = (qmathTangentJob*)data;
+	for(unsigned int f = begin; f < end; ++f)
 	{
-		unsigned int i1 = polys[i * 3];
-		unsigned int i2 = polys[i * 3 + 1];
-		unsigned int i3 = polys[i * 3 + 2];
+		unsigned int i1 = job->polys[f * 3];
+		unsigned int i2 = job->polys[f * 3 + 1];
+		unsigned int i3 = job->polys[f * 3 + 2];
+		
+		const vec3f& a = job->verts[i1];
+		const vec3f& b = job->verts[i2];
+		const vec3f& c = job->verts[i3];
+		const vec2f& ta = job->texcoords[i1];
+		const vec2f& tb = job->texcoords[i2];
+		const vec2f& tc = job->texcoords[i3];
+		
+		float x1 = b.x - a.x, x2 = c.x - a.x;
+		float y1 = b.y - a.y, y2 = c.y - a.y;
+		float z1 = b.z - a.z, z2 = c.z - a.z;
 		
-		tan1[i * 3].vertRef = i1;
-		tan1[i * 3 + 1].vertRef = i2;
-		tan1[i * 3 + 2].vertRef = i3;
-	
-		vec3f a, b, c;
-		QMATH_VEC3F_COPY(a, verts[i1]);
-		QMATH_VEC3F_COPY(b, verts[i2]);
-		QMATH_VEC3F_COPY(c, verts[i3]);
-
-		vec2f ta, tb, tc;
-		QMATH_VEC2F_COPY(ta, texcoords[i1]);
-		QMATH_VEC2F_COPY(tb, texcoords[i2]);
-		QMATH_VEC2F_COPY(tc, texcoords[i3]);
-
-		float x1 = b.x - a.x;
-		float x2 = c.x - a.x;
-		float y1 = b.y - a.y;
-		float y2 = c.y - a.y;
-		float z1 = b.z - a.z;
-		float z2 = c.z - a.z;
+		float s1 = tb.x - ta.x, s2 = tc.x - ta.x;
+		float t1 = tb.y - ta.y, t2 = tc.y - ta.y;
 		
-		float s1 = tb.x - ta.x;
-		float s2 = tc.x - ta.x;
-		float t1 = tb.y - ta.y;
-		float t2 = tc.y - ta.y;
+		// Faces with a degenerate uv mapping contribute nothing //
+		float det = s1 * t2 - s2 * t1;
+		float r = (fabsf(det) > 1e-12F) ? 1.0F / det : 0.0F;
+		
+		float* o = &job->faceTans[f * 6];
+		o[0] = (t2 * x1 - t1 * x2) * r;
+		o[1] = (t2 * y1 - t1 * y2) * r;
+		o[2] = (t2 * z1 - t1 * z2) * r;
+		o[3] = (s1 * x2 - s2 * x1) * r;
+		o[4] = (s1 * y2 - s2 * y1) * r;
+		o[5] = (s1 * z2 - s2 * z1) * r;
+	}
+}
+
+static void qmathGatherTangents(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	qmathTangentJob* job = (qmathTangentJob*)data;
+	for(unsigned int r = begin; r < end; ++r)
+	{
+		float acc[6] = { 0.0F, 0.0F, 0.0F, 0.0F, 0.0F, 0.0F };
+		for(unsigned int i = job->adjStart[r]; i < job->adjStart[r + 1]; ++i)
+		{
+			const float* t = &job->faceTans[job->adjFaces[i] * 6];
+			for(int k = 0; k < 6; ++k)
+				acc[k] += t[k];
+		}
 		
-		float r = 1.0F / (s1 * t2 - s2 * t1);
-		vec3f sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
-		vec3f tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
+		memcpy(&job->repTans[r * 6], acc, sizeof(float) * 6);
+	}
+}
 
-		tan1[i * 3].tan = tan1[i * 3].tan + sdir;
-		tan1[i * 3 + 1].tan = tan1[i * 3 + 1].tan + sdir;
-		tan1[i * 3 + 2].tan = tan1[i * 3 + 2].tan + sdir;
+// Gram-Schmidt orthogonalizes the welded tangent against each vertex normal and rebuilds the //
+// bitangent from the cross product, keeping the handedness of the accumulated bitangent      //
+static void qmathResolveTangents(void* data, const unsigned int& begin, const unsigned int& end)
+{
+	qmathTangentJob* job = (qmathTangentJob*)data;
+	for(unsigned int v = begin; v < end; ++v)
+	{
+		const float* acc = &job->repTans[job->rep[v] * 6];
+		const vec3f& n = job->norms[v];
 		
-		vec3f n, t, tan;
+		float d = n.x * acc[0] + n.y * acc[1] + n.z * acc[2];
+		float tx = acc[0] - n.x * d;
+		float ty = acc[1] - n.y * d;
+		float tz = acc[2] - n.z * d;
+		float len = sqrtf(tx * tx + ty * ty + tz * tz);
 		
-		for(unsigned int j = 0; j < 3; ++j )
+		// No usable uv gradient, pick any vector perpendicular to the normal //
+		if(len < 1e-12F)
 		{
-			QMATH_VEC3F_COPY(n, norms[tan1[i * 3 + j].vertRef]);
-			QMATH_VEC3F_COPY(t, tan1[i * 3 + j].tan);
-			
-			float dp3 = QMATH_VEC3F_DOTPROD(n, t);
-			n = n * dp3;
-			tan = t - n;
-			QMATH_VEC3F_NORMALIZE(tan);
-			QMATH_VEC3F_COPY(tangent[tan1[i * 3 + j].vertRef], tan);
+			if(fabsf(n.x) < 0.9F)	{ tx = 0.0F;  ty = n.z;  tz = -n.y; }
+			else					{ tx = -n.z;  ty = 0.0F; tz = n.x; }
+			len = sqrtf(tx * tx + ty * ty + tz * tz);
+		}
+		
+		float iLen = (len > 0.0F) ? 1.0F / len : 0.0F;
+		tx *= iLen;
+		ty *= iLen;
+		tz *= iLen;
+		job->tangents[v].set(tx, ty, tz);
+		
+		if(job->bitangents)
+		{
+			float bx = n.y * tz - n.z * ty;
+			float by = n.z * tx - n.x * tz;
+			float bz = n.x * ty - n.y * tx;
+			if(bx * acc[3] + by * acc[4] + bz * acc[5] < 0.0F)
+			{
+				bx = -bx;
+				by = -by;
+				bz = -bz;
+			}
+			job->bitangents[v].set(bx, by, bz);
 		}
 	}
+}
+
+static inline unsigned int qmathHashCell(const long long& x, const long long& y, const long long& z)
+{
+	unsigned long long h = (unsigned long long)x * 73856093ULL ^ (unsigned long long)y * 19349663ULL ^ (unsigned long long)z * 83492791ULL;
+	return (unsigned int)(h ^ (h >> 32));
+}
+
+// Assigns every vertex a representative that shares its position, normal and uv. Positions are //
+// bucketed on a grid of 2 * epsilon so any match lies in one of the 8 cells nearest the vertex. //
+// Returns the number of representatives, rep[v] indexes them densely.                         //
+static unsigned int qmathWeldVertices(const vec3f* verts, const vec3f* norms, const vec2f* texcoords, const unsigned int& nVerts, const float& epsilon, unsigned int* rep)
+{
+	unsigned int tableSize = 1;
+	while(tableSize < nVerts * 2)
+		tableSize <<= 1;
+	unsigned int tableMask = tableSize - 1;
+	
+	unsigned int* head = new unsigned int[tableSize];
+	unsigned int* next = new unsigned int[nVerts];
+	unsigned int* dense = new unsigned int[nVerts];
+	memset(head, 0xFF, sizeof(unsigned int) * tableSize);
 	
-	if(tan1)
+	double eps = (epsilon > 0.0F) ? epsilon : 1e-6;
+	double iCell = 1.0 / (eps * 2.0);
+	unsigned int nReps = 0;
+	
+	for(unsigned int v = 0; v < nVerts; ++v)
 	{
-		free(tan1);
-		tan1 = NULL;
-	}	
+		const vec3f& p = verts[v];
+		double fx = p.x * iCell, fy = p.y * iCell, fz = p.z * iCell;
+		long long cx = (long long)floor(fx), cy = (long long)floor(fy), cz = (long long)floor(fz);
+		long long ox = (fx - cx < 0.5) ? -1 : 1;
+		long long oy = (fy - cy < 0.5) ? -1 : 1;
+		long long oz = (fz - cz < 0.5) ? -1 : 1;
+		
+		unsigned int found = 0xFFFFFFFF;
+		for(int n = 0; n < 8 && found == 0xFFFFFFFF; ++n)
+		{
+			unsigned int h = qmathHashCell(cx + ((n & 1) ? ox : 0), cy + ((n & 2) ? oy : 0), cz + ((n & 4) ? oz : 0)) & tableMask;
+			for(unsigned int c = head[h]; c != 0xFFFFFFFF; c = next[c])
+			{
+				const vec3f& q = verts[c];
+				if(fabs(q.x - p.x) > eps || fabs(q.y - p.y) > eps || fabs(q.z - p.z) > eps)
+					continue;
+				if(fabs(texcoords[c].x - texcoords[v].x) > eps || fabs(texcoords[c].y - texcoords[v].y) > eps)
+					continue;
+				if(norms[c].x * norms[v].x + norms[c].y * norms[v].y + norms[c].z * norms[v].z < QMATH_TANGENT_WELD_NORMAL_DOT)
+					continue;
+				
+				found = c;
+				break;
+			}
+		}
+		
+		if(found != 0xFFFFFFFF)
+		{
+			rep[v] = dense[found];
+			continue;
+		}
+		
+		unsigned int h = qmathHashCell(cx, cy, cz) & tableMask;
+		next[v] = head[h];
+		head[h] = v;
+		dense[v] = nReps;
+		rep[v] = nReps++;
+	}
+	
+	delete[] head;
+	delete[] next;
+	delete[] dense;
+	return nReps;
+}
+
+QMATHEXPORT_API void QMATH_CREATE_TANGENT_FRAMES(const vec3f* verts, const unsigned int& nVerts, const unsigned int* polys, const unsigned int& nPolys, const vec2f* texcoords, 
+												  const vec3f* norms, vec3f* tangents, vec3f* bitangents, const float& weldEpsilon)
+{
+	if(!nVerts || !tangents)
+		return;
+	
+	qmathTangentJob job;
+	job.verts = verts;
+	job.norms = norms;
+	job.texcoords = texcoords;
+	job.polys = polys;
+	job.tangents = tangents;
+	job.bitangents = bitangents;
+	job.rep = new unsigned int[nVerts];
+	job.faceTans = new float[nPolys * 6 + 6];
+	
+	unsigned int nReps = qmathWeldVertices(verts, norms, texcoords, nVerts, weldEpsilon, job.rep);
+	
+	unsigned int* weldedPolys = new unsigned int[nPolys * 3 + 3];
+	for(unsigned int i = 0; i < nPolys * 3; ++i)
+		weldedPolys[i] = job.rep[polys[i]];
+	
+	job.repTans = new float[nReps * 6];
+	job.adjStart = new unsigned int[nReps + 1];
+	job.adjFaces = new unsigned int[nPolys * 3 + 3];
+	
+	QPARALLEL_FOR(nPolys, QMATH_NORMALS_GRAIN, qmathFaceTangents, &job);
+	qmathBuildVertexAdjacency(weldedPolys, nReps, nPolys, job.adjStart, job.adjFaces);
+	QPARALLEL_FOR(nReps, QMATH_NORMALS_GRAIN, qmathGatherTangents, &job);
+	QPARALLEL_FOR(nVerts, QMATH_NORMALS_GRAIN, qmathResolveTangents, &job);
+	
+	delete[] weldedPolys;
+	delete[] job.rep;
+	delete[] job.faceTans;
+	delete[] job.repTans;
+	delete[] job.adjStart;
+	delete[] job.adjFaces;
+}
+
+QMATHEXPORT_API void QMATH_CREATE_TANGENT_SPACE(const vec3f* verts, const unsigned int& nVerts, const unsigned int* polys, const unsigned int& nPolys, const vec2f* texcoords, const vec3f* norms, vec3f* tangent)
+{
+	QMATH_CREATE_TANGENT_FRAMES(verts, nVerts, polys, nPolys, texcoords, norms, tangent, NULL);
 }
 
 
@@ -1072,40 +2273,72 @@ QMATHEXPORT_API float QMATH_GET_GAUSSIAN_DISTRIBUTION(const float& x, const floa
 	return g;	
 }
 
-QMATHEXPORT_API void QMATH_GET_GAUSSIAN5X5_OFFSETS(const unsigned int& width, const unsigned int& height, vec2f* offsets, vec4f* weights, const float& mul)
+// Normalized rho = 1 gaussian weights over the diamond shaped 5x5 and 10x10 footprints. They do not //
+// depend on resolution, so they are generated once when the module loads instead of on every call.  //
+#define QMATH_GAUSSIAN5X5_TAPS		13
+#define QMATH_GAUSSIAN10X10_TAPS	61
+
+struct qmathGaussianTable
+{
+	int			nTaps;
+	int			x[QMATH_GAUSSIAN10X10_TAPS];
+	int			y[QMATH_GAUSSIAN10X10_TAPS];
+	float		weight[QMATH_GAUSSIAN10X10_TAPS];
+};
+
+static void qmathBuildGaussianTable(qmathGaussianTable& table, const int& radius)
 {
-	float tu = 1.0F / (float)width;
-	float tv = 1.0F / (float)height;
-	
-	vec4f white(1.0F, 1.0F, 1.0F, 1.0F);
 	float totalWeight = 0.0F;
-	int index = 0;
+	table.nTaps = 0;
 	
-	for(int x = -2; x <= 2; ++x)
+	for(int x = -radius; x <= radius; ++x)
 	{
-		for(int y = -2; y <= 2; ++y)
+		for(int y = -radius; y <= radius; ++y)
 		{
-			if(abs(x) + abs(y) > 2)
+			if(abs(x) + abs(y) > radius)
 				continue;
-				
-			offsets[index].x = x * tu;
-			offsets[index].y = y * tv;
-			weights[index].x = white.x * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			weights[index].y = white.y * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			weights[index].z = white.z * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			weights[index].w = white.w * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			totalWeight += weights[index].x;
-			++index;
+			
+			float w = QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
+			table.x[table.nTaps] = x;
+			table.y[table.nTaps] = y;
+			table.weight[table.nTaps] = w;
+			totalWeight += w;
+			++table.nTaps;
 		}
 	}
 	
-	for(int i = 0; i < index; ++i)
+	for(int i = 0; i < table.nTaps; ++i)
+		table.weight[i] /= totalWeight;
+}
+
+static struct qmathGaussianTables
+{
+	qmathGaussianTable		gauss5x5;
+	qmathGaussianTable		gauss10x10;
+	
+	qmathGaussianTables()
 	{
-		weights[i].x /= totalWeight; weights[i].x *= mul;
-		weights[i].y /= totalWeight; weights[i].y *= mul;
-		weights[i].z /= totalWeight; weights[i].z *= mul;
-		weights[i].w /= totalWeight; weights[i].w *= mul;
-	}	
+		qmathBuildGaussianTable(gauss5x5, 2);
+		qmathBuildGaussianTable(gauss10x10, 5);
+	}
+} s_gaussianTables;
+
+static void qmathFillGaussianOffsets(const qmathGaussianTable& table, const unsigned int& width, const unsigned int& height, vec2f* offsets, vec4f* weights, const float& mul)
+{
+	float tu = 1.0F / (float)width;
+	float tv = 1.0F / (float)height;
+	
+	for(int i = 0; i < table.nTaps; ++i)
+	{
+		float w = table.weight[i] * mul;
+		offsets[i].set(table.x[i] * tu, table.y[i] * tv);
+		weights[i].set(w, w, w, w);
+	}
+}
+
+QMATHEXPORT_API void QMATH_GET_GAUSSIAN5X5_OFFSETS(const unsigned int& width, const unsigned int& height, vec2f* offsets, vec4f* weights, const float& mul)
+{
+	qmathFillGaussianOffsets(s_gaussianTables.gauss5x5, width, height, offsets, weights, mul);
 }
 
 QMATHEXPORT_API void QMATH_GET_BILATERAL_OFFSETS(const int& bbWidth, const int& bbHeight, vec2f* avSampleOffsets)
@@ -1133,38 +2366,7 @@ QMATHEXPORT_API void QMATH_GET_BILATERAL_OFFSETS(const int& bbWidth, const int&
 
 QMATHEXPORT_API void QMATH_GET_GAUSSIAN10X10_OFFSETS(const unsigned int& width, const unsigned int& height, vec2f* offsets, vec4f* weights, const float& mul)
 {
-	float tu = 1.0F / (float)width;
-	float tv = 1.0F / (float)height;
-	
-	vec4f white(1.0, 1.0, 1.0, 1.0);
-	float totalWeight = 0.0F;
-	int index = 0;
-	
-	for(int x = -5; x <= 5; ++x)
-	{
-		for(int y = -5; y <= 5; ++y)
-		{
-			if(abs(x) + abs(y) > 5)
-				continue;
-			
-			offsets[index].x = x * tu;
-			offsets[index].y = y * tv;
-			weights[index].x = white.x * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			weights[index].y = white.y * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			weights[index].z = white.z * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			weights[index].w = white.w * QMATH_GET_GAUSSIAN_DISTRIBUTION((float)x, (float)y, 1.0F);
-			totalWeight += weights[index].x;
-			++index;
-		}
-	}
-	
-	for(int i = 0; i < index; ++i)
-	{
-		weights[i].x /= totalWeight; weights[i].x *= mul;
-		weights[i].y /= totalWeight; weights[i].y *= mul;
-		weights[i].z /= totalWeight; weights[i].z *= mul;
-		weights[i].w /= totalWeight; weights[i].w *= mul;
-	}
+	qmathFillGaussianOffsets(s_gaussianTables.gauss10x10, width, height, offsets, weights, mul);
 }
 
 
@@ -1241,7 +2443,7 @@ QMATHEXPORT_API void QMATH_GET_SAMPLE2X2_OFFSETS(const int& bbWidth, const int&
 		{
 			// adjust new sample offsets //
 			avSampleOffsets[index].x = (x - 0.5F) * tu;
-			avSampleOffsets[index].y = (y - 0.5F) * tu;
+			avSampleOffsets[index].y = (y - 0.5F) * tv;
 			++index;
 		}
 	}
@@ -1269,6 +2471,113 @@ QMATHEXPORT_API void QMATH_GET_SAMPLE3X3_OFFSETS(const int& bbWidth, const int&
 }
 
 
+struct qmathKernelCacheEntry
+{
+	QMATH_KERNEL_TYPE			type;
+	unsigned int				width, height;
+	float						dev, mul;
+	cKernelTable				table;
+	qmathKernelCacheEntry*		next;
+};
+
+// Entries are never moved or freed until a flush, which is what keeps handed out pointers valid //
+static qmathKernelCacheEntry* s_kernelCache = NULL;
+
+static void qmathBuildKernelTable(const QMATH_KERNEL_TYPE& type, const unsigned int& width, const unsigned int& height, const float& dev, const float& mul, cKernelTable& table)
+{
+	table.nTaps = 0;
+	for(unsigned int i = 0; i < QMATH_KERNEL_MAX_TAPS; ++i)
+	{
+		table.offsets[i].set(0.0F, 0.0F);
+		table.weights[i].set(0.0F, 0.0F, 0.0F, 0.0F);
+	}
+	
+	switch(type)
+	{
+		case QMATH_KERNEL_GAUSSIAN5X5:
+			QMATH_GET_GAUSSIAN5X5_OFFSETS(width, height, table.offsets, table.weights, mul);
+			table.nTaps = QMATH_GAUSSIAN5X5_TAPS;
+			break;
+		
+		case QMATH_KERNEL_GAUSSIAN10X10:
+			QMATH_GET_GAUSSIAN10X10_OFFSETS(width, height, table.offsets, table.weights, mul);
+			table.nTaps = QMATH_GAUSSIAN10X10_TAPS;
+			break;
+		
+		case QMATH_KERNEL_BLOOM_HORIZONTAL:
+		case QMATH_KERNEL_BLOOM_VERTICAL:
+		{
+			bool horizontal = (type == QMATH_KERNEL_BLOOM_HORIZONTAL);
+			float offsets[15];
+			QMATH_GET_BLOOM_OFFSETS(horizontal ? width : height, offsets, table.weights, dev, mul);
+			for(int i = 0; i < 15; ++i)
+				table.offsets[i].set(horizontal ? offsets[i] : 0.0F, horizontal ? 0.0F : offsets[i]);
+			table.nTaps = 15;
+			break;
+		}
+		
+		case QMATH_KERNEL_SAMPLE2X2:
+			QMATH_GET_SAMPLE2X2_OFFSETS(width, height, table.offsets);
+			table.nTaps = 4;
+			break;
+		
+		case QMATH_KERNEL_SAMPLE3X3:
+			QMATH_GET_SAMPLE3X3_OFFSETS(width, height, table.offsets);
+			table.nTaps = 9;
+			break;
+		
+		case QMATH_KERNEL_SAMPLE4X4:
+			QMATH_GET_SAMPLE4X4_OFFSETS(width, height, table.offsets);
+			table.nTaps = 16;
+			break;
+		
+		case QMATH_KERNEL_BILATERAL:
+			QMATH_GET_BILATERAL_OFFSETS(width, height, table.offsets);
+			table.nTaps = QMATH_GAUSSIAN5X5_TAPS;
+			break;
+	}
+}
+
+QMATHEXPORT_API const cKernelTable* QMATH_GET_KERNEL_TABLE(const QMATH_KERNEL_TYPE& type, const unsigned int& width, const unsigned int& height, const float& dev, const float& mul)
+{
+	// Clear whatever the kernel ignores so it can not split the cache //
+	bool bloom = (type == QMATH_KERNEL_BLOOM_HORIZONTAL || type == QMATH_KERNEL_BLOOM_VERTICAL);
+	bool weighted = bloom || type == QMATH_KERNEL_GAUSSIAN5X5 || type == QMATH_KERNEL_GAUSSIAN10X10;
+	unsigned int keyWidth = (type == QMATH_KERNEL_BLOOM_VERTICAL) ? 0 : width;
+	unsigned int keyHeight = (type == QMATH_KERNEL_BLOOM_HORIZONTAL) ? 0 : height;
+	float keyDev = bloom ? dev : 0.0F;
+	float keyMul = weighted ? mul : 0.0F;
+	
+	for(qmathKernelCacheEntry* e = s_kernelCache; e; e = e->next)
+	{
+		if(e->type == type && e->width == keyWidth && e->height == keyHeight && e->dev == keyDev && e->mul == keyMul)
+			return &e->table;
+	}
+	
+	qmathKernelCacheEntry* e = new qmathKernelCacheEntry;
+	e->type = type;
+	e->width = keyWidth;
+	e->height = keyHeight;
+	e->dev = keyDev;
+	e->mul = keyMul;
+	qmathBuildKernelTable(type, width, height, dev, mul, e->table);
+	
+	e->next = s_kernelCache;
+	s_kernelCache = e;
+	return &e->table;
+}
+
+QMATHEXPORT_API void QMATH_FLUSH_KERNEL_TABLES()
+{
+	while(s_kernelCache)
+	{
+		qmathKernelCacheEntry* next = s_kernelCache->next;
+		delete s_kernelCache;
+		s_kernelCache = next;
+	}
+}
+
+
 QMATHEXPORT_API float QMATH_POINT_ROTATEZ(const vec3f& p, const mat4& m)
 {
 	return (p.x * m[2]) + (p.y * m[6]) + (p.z * m[10]);
@@ -1369,4 +2678,75 @@ QMATHEXPORT_API bool QMATH_POINT_IN_FRUSTUM(const vec4f* planes, vec3f& point)
 	}	
 	
 	return true;
+}
+
+
+// Clears mask bits past n and returns the population count of the mask //
+static unsigned int finishCullMask(unsigned int* mask, const unsigned int& n)
+{
+	unsigned int nWords = (n + 31) / 32;
+	if(n & 31)
+		mask[nWords - 1] &= (1U << (n & 31)) - 1;
+
+	unsigned int count = 0;
+	for(unsigned int w = 0; w < nWords; ++w)
+	{
+		unsigned int v = mask[w];
+		v = v - ((v >> 1) & 0x55555555);
+		v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+		count += (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+	}
+
+	return count;
+}
+
+QMATHEXPORT_API unsigned int QMATH_FRUSTUM_CULL_AABBS(const vec4f* planes, const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, const unsigned int& n, unsigned int* visibleMask)
+{
+	if(!planes || !visibleMask || !n)
+		return 0;
+
+	// mask words are written a byte at a time, little endian keeps bit i == volume i //
+	unsigned int padded = (n + QMATH_CULL_PADDING - 1) & ~(QMATH_CULL_PADDING - 1);
+	unsigned int nWords = (n + 31) / 32;
+	visibleMask[nWords - 1] = 0;
+	s_kernels.cullAABBs(&planes[0].x, cx, cy, cz, ex, ey, ez, padded, (unsigned char*)visibleMask);
+
+	return finishCullMask(visibleMask, n);
+}
+
+QMATHEXPORT_API unsigned int QMATH_FRUSTUM_CULL_SPHERES(const vec4f* planes, const float* cx, const float* cy, const float* cz, const float* radius, const unsigned int& n, unsigned int* visibleMask)
+{
+	if(!planes || !visibleMask || !n)
+		return 0;
+
+	unsigned int padded = (n + QMATH_CULL_PADDING - 1) & ~(QMATH_CULL_PADDING - 1);
+	unsigned int nWords = (n + 31) / 32;
+	visibleMask[nWords - 1] = 0;
+	s_kernels.cullSpheres(&planes[0].x, cx, cy, cz, radius, padded, (unsigned char*)visibleMask);
+
+	return finishCullMask(visibleMask, n);
+}
+
+QMATHEXPORT_API unsigned int QMATH_MASK_TO_INDICES(const unsigned int* mask, const unsigned int& n, unsigned int* indices)
+{
+	if(!mask || !indices)
+		return 0;
+
+	unsigned int count = 0;
+	unsigned int nWords = (n + 31) / 32;
+	for(unsigned int w = 0; w < nWords; ++w)
+	{
+		unsigned int bits = mask[w];
+		unsigned int idx = w * 32;
+		for(; bits; bits >>= 1, ++idx)
+		{
+			if(!(bits & 1))
+				continue;
+			if(idx >= n)
+				return count;
+			indices[count++] = idx;
+		}
+	}
+
+	return count;
 }
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "qmath.h"
+#include "qmath_simd.h"
+
+#include <immintrin.h>
+
+
+// This file is compiled with /arch:AVX. Nothing in here may be called unless //
+// QCPU_FEATURE_AVX was reported, qmath only installs these kernels in that case. //
+
+// Each 256 bit register holds two columns (or two vectors), one per 128 bit lane. The left //
+// matrix is broadcast into both lanes and the per lane scalars are splatted with in-lane   //
+// shuffles, so two columns are produced per multiply-add chain.                            //
+static inline __m256 avxMulPair(const __m256& c0, const __m256& c1, const __m256& c2, const __m256& c3, const __m256& v)
+{
+	__m256 res = _mm256_mul_ps(c0, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+	res = _mm256_add_ps(res, _mm256_mul_ps(c1, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+	res = _mm256_add_ps(res, _mm256_mul_ps(c2, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+	res = _mm256_add_ps(res, _mm256_mul_ps(c3, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+	return res;
+}
+
+void qmathMatMulBatchAVX(const float* l, const float* r, float* out, unsigned int n)
+{
+	__m256 c0 = _mm256_broadcast_ps((const __m128*)&l[0]);
+	__m256 c1 = _mm256_broadcast_ps((const __m128*)&l[4]);
+	__m256 c2 = _mm256_broadcast_ps((const __m128*)&l[8]);
+	__m256 c3 = _mm256_broadcast_ps((const __m128*)&l[12]);
+
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		const float* ri = &r[i * 16];
+		float* oi = &out[i * 16];
+
+		__m256 o01 = avxMulPair(c0, c1, c2, c3, _mm256_loadu_ps(&ri[0]));
+		__m256 o23 = avxMulPair(c0, c1, c2, c3, _mm256_loadu_ps(&ri[8]));
+
+		_mm256_storeu_ps(&oi[0], o01);
+		_mm256_storeu_ps(&oi[8], o23);
+	}
+
+	_mm256_zeroupper();
+}
+
+void qmathMulVecBatchAVX(const float* l, const float* r, float* out, unsigned int n)
+{
+	__m256 c0 = _mm256_broadcast_ps((const __m128*)&l[0]);
+	__m256 c1 = _mm256_broadcast_ps((const __m128*)&l[4]);
+	__m256 c2 = _mm256_broadcast_ps((const __m128*)&l[8]);
+	__m256 c3 = _mm256_broadcast_ps((const __m128*)&l[12]);
+
+	unsigned int i = 0;
+	for(; i + 2 <= n; i += 2)
+		_mm256_storeu_ps(&out[i * 4], avxMulPair(c0, c1, c2, c3, _mm256_loadu_ps(&r[i * 4])));
+
+	if(i < n)
+	{
+		__m128 v = _mm_loadu_ps(&r[i * 4]);
+		__m256 res = avxMulPair(c0, c1, c2, c3, _mm256_castps128_ps256(v));
+		_mm_storeu_ps(&out[i * 4], _mm256_castps256_ps128(res));
+	}
+
+	_mm256_zeroupper();
+}
+
+void qmathTransformPointsAVX(const float* l, const float* r, float* out, unsigned int n)
+{
+	__m256 c0 = _mm256_broadcast_ps((const __m128*)&l[0]);
+	__m256 c1 = _mm256_broadcast_ps((const __m128*)&l[4]);
+	__m256 c2 = _mm256_broadcast_ps((const __m128*)&l[8]);
+	__m256 c3 = _mm256_broadcast_ps((const __m128*)&l[12]);
+
+	// Two points per iteration. Only whole 3 float points are written so the tail never //
+	// touches memory past out[n * 3 - 1].                                                //
+	unsigned int i = 0;
+	for(; i + 2 <= n; i += 2)
+	{
+		const float* p = &r[i * 3];
+		__m256 x = _mm256_set_ps(p[3], p[3], p[3], p[3], p[0], p[0], p[0], p[0]);
+		__m256 y = _mm256_set_ps(p[4], p[4], p[4], p[4], p[1], p[1], p[1], p[1]);
+		__m256 z = _mm256_set_ps(p[5], p[5], p[5], p[5], p[2], p[2], p[2], p[2]);
+
+		__m256 res = _mm256_add_ps(c3, _mm256_mul_ps(c0, x));
+		res = _mm256_add_ps(res, _mm256_mul_ps(c1, y));
+		res = _mm256_add_ps(res, _mm256_mul_ps(c2, z));
+
+		QMATH_ALIGN(32) float tmp[8];
+		_mm256_store_ps(tmp, res);
+		float* o = &out[i * 3];
+		o[0] = tmp[0];	o[1] = tmp[1];	o[2] = tmp[2];
+		o[3] = tmp[4];	o[4] = tmp[5];	o[5] = tmp[6];
+	}
+
+	if(i < n)
+	{
+		const float* p = &r[i * 3];
+		float x = p[0], y = p[1], z = p[2];
+		out[i * 3]     = l[0] * x + l[4] * y + l[8] * z + l[12];
+		out[i * 3 + 1] = l[1] * x + l[5] * y + l[9] * z + l[13];
+		out[i * 3 + 2] = l[2] * x + l[6] * y + l[10] * z + l[14];
+	}
+
+	_mm256_zeroupper();
+}
+
+void qmathCullAABBsAVX(const float* planes, const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, unsigned int n, unsigned char* mask)
+{
+	const __m256 signMask = _mm256_set1_ps(-0.0F);
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 pn[6][4], pa[6][3];
+	for(int p = 0; p < 6; ++p)
+	{
+		for(int c = 0; c < 4; ++c)
+			pn[p][c] = _mm256_broadcast_ss(&planes[p * 4 + c]);
+		for(int c = 0; c < 3; ++c)
+			pa[p][c] = _mm256_andnot_ps(signMask, pn[p][c]);
+	}
+
+	for(unsigned int i = 0; i < n; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&cx[i]), y = _mm256_loadu_ps(&cy[i]), z = _mm256_loadu_ps(&cz[i]);
+		__m256 ax = _mm256_loadu_ps(&ex[i]), ay = _mm256_loadu_ps(&ey[i]), az = _mm256_loadu_ps(&ez[i]);
+		__m256 vis = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+		for(int p = 0; p < 6; ++p)
+		{
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(pn[p][0], x), pn[p][3]);
+			d = _mm256_add_ps(d, _mm256_mul_ps(pn[p][1], y));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pn[p][2], z));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pa[p][0], ax));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pa[p][1], ay));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pa[p][2], az));
+			vis = _mm256_and_ps(vis, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+		}
+
+		mask[i >> 3] = (unsigned char)_mm256_movemask_ps(vis);
+	}
+
+	_mm256_zeroupper();
+}
+
+void qmathCullSpheresAVX(const float* planes, const float* cx, const float* cy, const float* cz, const float* radius, unsigned int n, unsigned char* mask)
+{
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 pn[6][4];
+	for(int p = 0; p < 6; ++p)
+	{
+		for(int c = 0; c < 4; ++c)
+			pn[p][c] = _mm256_broadcast_ss(&planes[p * 4 + c]);
+	}
+
+	for(unsigned int i = 0; i < n; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&cx[i]), y = _mm256_loadu_ps(&cy[i]), z = _mm256_loadu_ps(&cz[i]);
+		__m256 r = _mm256_loadu_ps(&radius[i]);
+		__m256 vis = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+		for(int p = 0; p < 6; ++p)
+		{
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(pn[p][0], x), pn[p][3]);
+			d = _mm256_add_ps(d, _mm256_mul_ps(pn[p][1], y));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pn[p][2], z));
+			vis = _mm256_and_ps(vis, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+		}
+
+		mask[i >> 3] = (unsigned char)_mm256_movemask_ps(vis);
+	}
+
+	_mm256_zeroupper();
+}
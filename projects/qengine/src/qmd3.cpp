@@ -245,24 +245,61 @@ bool CMD3Mesh::LoadModel()
 			
 			unsigned int numVerts = pSurface->m_vVerts.size();
 			
+			unsigned int numTriangles = pSurface->m_vTriangles.size();
+			
 			SMD3VertexFormat* pVerts = new SMD3VertexFormat[numVerts];
+			vec3f* pPositions = new vec3f[numVerts];
+			vec3f* pNormals = new vec3f[numVerts];
+			vec2f* pTexCoords = new vec2f[numVerts];
+			vec3f* pTangents = new vec3f[numVerts];
+			unsigned int* pPolys = new unsigned int[numTriangles * 3];
 			
 			for(unsigned int k = 0; k < numVerts; ++k)
 			{
 				SMD3Vertex* pVert = pSurface->m_vVerts[k];
 				
-				pVerts[k].x		= (float)pVert->Position[0] * MD3_XYZ_SCALE * 0.03f;
-				pVerts[k].y		= (float)pVert->Position[2] * MD3_XYZ_SCALE * 0.03f;
-				pVerts[k].z		= -(float)pVert->Position[1] * MD3_XYZ_SCALE * 0.03f;
-				pVerts[k].nx	= pVert->Normal[0] *= (2*QMATH_PI)/255;
-				pVerts[k].ny	= pVert->Normal[1] *= (2*QMATH_PI)/255;
-				pVerts[k].vx	= 0;
-				pVerts[k].vy	= 0;
-				pVerts[k].vz	= 0;
-				pVerts[k].u		= pSurface->m_vTexCoords[k]->ST[0];
-				pVerts[k].v		= pSurface->m_vTexCoords[k]->ST[1];
+				//	Normals are stored as spherical coordinates, longitude in the low byte.
+				float lat = (float)pVert->Normal[1] * (2 * QMATH_PI) / 255;
+				float lng = (float)pVert->Normal[0] * (2 * QMATH_PI) / 255;
+				vec3f n(cosf(lat) * sinf(lng), sinf(lat) * sinf(lng), cosf(lng));
+				
+				pPositions[k].set((float)pVert->Position[0] * MD3_XYZ_SCALE * 0.03f,
+								  (float)pVert->Position[2] * MD3_XYZ_SCALE * 0.03f,
+								  -(float)pVert->Position[1] * MD3_XYZ_SCALE * 0.03f);
+				pNormals[k].set(n.x, n.z, -n.y);
+				pTexCoords[k].set(pSurface->m_vTexCoords[k]->ST[0], pSurface->m_vTexCoords[k]->ST[1]);
+			}
+			
+			for(unsigned int k = 0; k < numTriangles; ++k)
+			{
+				pPolys[k * 3]	  = pSurface->m_vTriangles[k]->Indexes[0];
+				pPolys[k * 3 + 1] = pSurface->m_vTriangles[k]->Indexes[1];
+				pPolys[k * 3 + 2] = pSurface->m_vTriangles[k]->Indexes[2];
+			}
+			
+			QMATH_CREATE_TANGENT_FRAMES(pPositions, numVerts, pPolys, numTriangles, pTexCoords, pNormals, pTangents, NULL);
+			
+			for(unsigned int k = 0; k < numVerts; ++k)
+			{
+				pVerts[k].x		= pPositions[k].x;
+				pVerts[k].y		= pPositions[k].y;
+				pVerts[k].z		= pPositions[k].z;
+				pVerts[k].nx	= pNormals[k].x;
+				pVerts[k].ny	= pNormals[k].y;
+				pVerts[k].nz	= pNormals[k].z;
+				pVerts[k].vx	= pTangents[k].x;
+				pVerts[k].vy	= pTangents[k].y;
+				pVerts[k].vz	= pTangents[k].z;
+				pVerts[k].u		= pTexCoords[k].x;
+				pVerts[k].v		= pTexCoords[k].y;
 			}
 			
+			delete[] pPositions;
+			delete[] pNormals;
+			delete[] pTexCoords;
+			delete[] pTangents;
+			delete[] pPolys;
+			
 			pSurface->m_iVboHandle = g_pRender->AddVertexBuffer();
 			
 			vbo = g_pRender->GetVertexBuffer(pSurface->m_iVboHandle);
@@ -273,8 +310,6 @@ bool CMD3Mesh::LoadModel()
 			//	A surface shares the same index buffer regardless of it's frame #.
 			if(pSurface->m_iRefId == m_vFrames.size()-1)
 			{
-				unsigned int numTriangles = pSurface->m_vTriangles.size();
-				
 				unsigned short* pIndices = new unsigned short[numTriangles * 3];
 				
 				for(unsigned int j = 0; j < numTriangles; j++)
@@ -17,7 +17,7 @@ CModelObject::CModelObject(const unsigned int handle, const std::string& name, c
 	m_diffuseBindPoint = 0;
 	m_normalmapBindPoint = 2;
 
-	m_modelInstanceMatrices = new float[16 * MAX_MODEL_INSTANCES];
+	m_modelInstanceMatrices = (float*)QMATH_ALIGNED_MALLOC(sizeof(float) * 16 * MAX_MODEL_INSTANCES);
 	m_nModelInstances = 1;
 }
 
@@ -43,7 +43,7 @@ CModelObject::~CModelObject()
 
 	if(m_modelInstanceMatrices)
 	{
-		delete[] m_modelInstanceMatrices;
+		QMATH_ALIGNED_FREE(m_modelInstanceMatrices);
 		m_modelInstanceMatrices = 0;
 	}
 }
@@ -0,0 +1,119 @@
+#include "qparallel.h"
+#include "qcpu.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+
+
+#define QPARALLEL_THREAD_LIMIT		64
+
+static unsigned int s_maxThreads = 0;
+
+
+struct qparallelChunk
+{
+	QPARALLEL_FUNC	func;
+	void*			data;
+	unsigned int	begin;
+	unsigned int	end;
+};
+
+
+#ifdef WIN32
+static DWORD WINAPI qparallelWorker(LPVOID param)
+#else
+static void* qparallelWorker(void* param)
+#endif
+{
+	qparallelChunk* c = (qparallelChunk*)param;
+	c->func(c->data, c->begin, c->end);
+	return 0;
+}
+
+
+
+QPARALLELEXPORT_API void QPARALLEL_SET_MAX_THREADS(const unsigned int& n)
+{
+	s_maxThreads = n;
+}
+
+QPARALLELEXPORT_API unsigned int QPARALLEL_GET_MAX_THREADS()
+{
+	unsigned int n = (s_maxThreads) ? s_maxThreads : QCPU_GET_CORE_COUNT();
+	if(n > QPARALLEL_THREAD_LIMIT)
+		n = QPARALLEL_THREAD_LIMIT;
+	return n;
+}
+
+QPARALLELEXPORT_API void QPARALLEL_FOR(const unsigned int& count, const unsigned int& grain, QPARALLEL_FUNC func, void* data)
+{
+	if(!count)
+		return;
+
+	unsigned int g = grain ? grain : 1;
+	unsigned int nThreads = QPARALLEL_GET_MAX_THREADS();
+	if(count / g < nThreads)
+		nThreads = count / g;
+
+	if(nThreads < 2)
+	{
+		func(data, 0, count);
+		return;
+	}
+
+	qparallelChunk chunks[QPARALLEL_THREAD_LIMIT];
+	unsigned int per = count / nThreads;
+	unsigned int rem = count % nThreads;
+	unsigned int start = 0;
+	for(unsigned int i = 0; i < nThreads; ++i)
+	{
+		chunks[i].func = func;
+		chunks[i].data = data;
+		chunks[i].begin = start;
+		start += per + ((i < rem) ? 1 : 0);
+		chunks[i].end = start;
+	}
+
+	// Workers take chunks 1..n-1, the caller runs chunk 0. A worker that fails to //
+	// start is run inline instead so the range is always fully processed.         //
+#ifdef WIN32
+	HANDLE threads[QPARALLEL_THREAD_LIMIT];
+	DWORD nStarted = 0;
+	for(unsigned int i = 1; i < nThreads; ++i)
+	{
+		HANDLE h = CreateThread(NULL, 0, qparallelWorker, &chunks[i], 0, NULL);
+		if(h)
+			threads[nStarted++] = h;
+		else
+			qparallelWorker(&chunks[i]);
+	}
+
+	qparallelWorker(&chunks[0]);
+
+	if(nStarted)
+		WaitForMultipleObjects(nStarted, threads, TRUE, INFINITE);
+	for(DWORD i = 0; i < nStarted; ++i)
+		CloseHandle(threads[i]);
+#else
+	pthread_t threads[QPARALLEL_THREAD_LIMIT];
+	bool started[QPARALLEL_THREAD_LIMIT];
+	for(unsigned int i = 1; i < nThreads; ++i)
+	{
+		started[i] = (pthread_create(&threads[i], NULL, qparallelWorker, &chunks[i]) == 0);
+		if(!started[i])
+			qparallelWorker(&chunks[i]);
+	}
+
+	qparallelWorker(&chunks[0]);
+
+	for(unsigned int i = 1; i < nThreads; ++i)
+	{
+		if(started[i])
+			pthread_join(threads[i], NULL);
+	}
+#endif
+}
@@ -268,6 +268,9 @@ CQuadrionRender::CQuadrionRender()
 	m_renderTargetResources = NULL;
 	m_depthStencilTargetResources = NULL;
 	m_instancedVertexBufferResources = NULL;
+	m_textureCache = new CQuadrionTextureCache("texturecache/");
+	m_textureResidency = new CQuadrionTextureResidency;
+	m_textureStreamer = new CQuadrionTextureStreamer(m_textureCache);
 	m_vertexNameRef = 0;
 	m_instancedVertexNameRef = 0;
 	m_indexNameRef = 0;
@@ -298,6 +301,16 @@ CQuadrionRender::CQuadrionRender()
 CQuadrionRender::~CQuadrionRender()
 {
 	Release();	
+	
+	// The worker reads through the cache, it goes first //
+	delete m_textureStreamer;
+	m_textureStreamer = NULL;
+	
+	delete m_textureCache;
+	m_textureCache = NULL;
+	
+	delete m_textureResidency;
+	m_textureResidency = NULL;
 }
 
 
@@ -1027,6 +1040,12 @@ void CQuadrionRender::GetGreatestFloatFormat(const D3DFORMAT& adapterFormat)
 // Call prior to any rendering calls
 bool CQuadrionRender::BeginRendering()
 {
+	// Texture memory is rebalanced once per frame, before anything is bound //
+	if(m_textureObjectResources)
+		m_textureResidency->Update(m_textureObjectResources->GetResources());
+	
+	m_textureStreamer->Update(m_textureResidency->GetFrame());
+	
 	if(FAILED(m_pD3DDev->BeginScene()))
 		return false;
 	
@@ -2293,6 +2312,39 @@ bool CQuadrionRender::GetMatrix(const unsigned int& type, mat4& m)
 }
 
 
+bool CQuadrionRender::GetMatrix(const unsigned int& type, const unsigned int& modifier, mat4& m)
+{
+	mat4 state;
+	if(!GetMatrix(type, state))
+		return false;
+	
+	switch(modifier)
+	{
+		case QRENDER_MATRIX_TRANSPOSE:
+			memcpy(m, state, sizeof(mat4));
+			QMATH_MATRIX_TRANSPOSE(m);
+			break;
+		
+		case QRENDER_MATRIX_INVERSE:
+			if(!QMATH_MATRIX_INVERSE(state, m))
+				return false;
+			break;
+		
+		case QRENDER_MATRIX_INVERSETRANSPOSE:
+			if(!QMATH_MATRIX_INVERSE(state, m))
+				return false;
+			QMATH_MATRIX_TRANSPOSE(m);
+			break;
+		
+		default:
+			memcpy(m, state, sizeof(mat4));
+			break;
+	}
+	
+	return true;
+}
+
+
 
 int	CQuadrionRender::CreateFont(const unsigned int& height, const unsigned int& width, const unsigned int& weight, const bool& italic, LPCSTR fontName)
 {
@@ -2573,24 +2625,17 @@ int	CQuadrionRender::StreamTextureObject(unsigned int& flags, const std::string&
 			return handle;
 		else if(tex->GetRefCount() > 1 && (flags != tex->GetFlags()))
 		{
-			CQuadrionTextureFile *newtex = new CQuadrionTextureFile();
-			//newtex->LoadTexture(name.c_str(), path.c_str());
-
-			
-			
 			std::string newname = name;
 			char p[4];
 			itoa(m_textureNameRef, p, 10);
 			newname.append(p);
 			++m_textureNameRef;
-			newtex->SetFileName(newname);
-			newtex->SetFilePath(path);
 
+			// Same source under another name, loaded from the original file //
 			handle = m_textureObjectResources->AddResource(newname, path);
-
-			cTMS::Instance()->AddTask(NULL, TMS_TYPE_NORMALMAPLOAD, (void*)newtex, flags, name);
-			
-			//return AddTextureObject(newtex, flags);
+			CQuadrionTextureObject* texobj = m_textureObjectResources->GetResource(handle);
+			texobj->ChangeRenderDevice(this);
+			cTMS::Instance()->AddTask(NULL, TMS_TYPE_TEXTURELOAD, (void*)texobj, flags, path + name);
 		}
 		else
 		{
@@ -2674,51 +2719,23 @@ int	CQuadrionRender::AddTextureObject(unsigned int& flags, const std::string& na
 			return handle;
 		else if(tex->GetRefCount() > 1 && (flags != tex->GetFlags()))
 		{
-			CQuadrionTextureFile *newtex = new CQuadrionTextureFile();
-
 			// Append the refference count to the name
-			std::string		originalName;
 			std::string		newname = name;
 			char			p[4];
 
 			itoa(m_textureNameRef, p, 10);
 			newname.append(p);
 			++m_textureNameRef;
-			newtex->SetFileName(newname);
-			newtex->SetFilePath(path);
 
-			// Attain a handle for the texture (with the ref count appended)
+			// Attain a handle for the texture (with the ref count appended) and load it from the original file
 			handle = m_textureObjectResources->AddResource(newname, path);
-			originalName = name;//newtex->GetFileName(); // LoadTexture changes the fileName, so we need to store the old one here temporarily
-							
-			if(!newtex->LoadTexture(originalName.c_str(), newtex->GetFilePath().c_str()))
+			CQuadrionTextureObject* texobj = m_textureObjectResources->GetResource(handle);
+			texobj->ChangeRenderDevice(this);
+			if(!texobj->CreateTextureFromFile(flags, path + name))
 			{
-				newname = name;
-				newname.append(".dds");
-
-				if(!newtex->LoadTexture(newname.c_str(), newtex->GetFilePath().c_str()))
-				{
-					newname = name;
-					newname.append(".tga");
-
-					if(!newtex->LoadTexture(newname.c_str(), newtex->GetFilePath().c_str()))
-					{
-						newname = name;
-						newname.append(".jpg");
-
-						newtex->LoadTexture(newname.c_str(), newtex->GetFilePath().c_str());
-					}
-				}
+				m_textureObjectResources->RemoveResource(handle);
+				return -1;
 			}
-
-			// Set the filename back to the original so AddTextureObject will get a proper handle
-			newname = newtex->GetFileName();
-			newtex->SetFileName(originalName);
-
-			int result;
-			result = AddTextureObject(*newtex, flags);
-			newtex->SetFileName(newname);	// Now set it back
-			return result;
 		}
 		else
 		{
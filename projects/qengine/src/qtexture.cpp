@@ -2,6 +2,8 @@
 #include "stdafx.h"
 #include "qtexture.h"
 #include "qrender.h"
+#include "qimage.h"
+#include "qfile.h"
 
 
 const unsigned int DDPF_ALPHAPIXELS = 0x00000001;
@@ -124,6 +126,38 @@ static unsigned int QTEXTURE_GET_CHANNEL_COUNT(const ETexturePixelFormat& fmt)
 	return channels[fmt]; 	
 }
 
+static QIMAGE_CHANNEL_TYPE QTEXTURE_GET_CHANNEL_TYPE(const ETexturePixelFormat& fmt)
+{
+	if(fmt <= QTEXTURE_FORMAT_RGBA8) return QIMAGE_CHANNEL_UNORM8;
+	if(fmt <= QTEXTURE_FORMAT_RGBA16) return QIMAGE_CHANNEL_UNORM16;
+	if(fmt <= QTEXTURE_FORMAT_RGBA16F) return QIMAGE_CHANNEL_HALF;
+	return QIMAGE_CHANNEL_FLOAT;
+}
+
+static bool QTEXTURE_GET_BLOCK_FORMAT(const ETexturePixelFormat& fmt, QIMAGE_BLOCK_FORMAT& blockFormat)
+{
+	switch(fmt)
+	{
+		case QTEXTURE_FORMAT_DXT1:		blockFormat = QIMAGE_BLOCK_BC1; return true;
+		case QTEXTURE_FORMAT_DXT3:		blockFormat = QIMAGE_BLOCK_BC2; return true;
+		case QTEXTURE_FORMAT_DXT5:		blockFormat = QIMAGE_BLOCK_BC3; return true;
+		case QTEXTURE_FORMAT_ATI1N:		blockFormat = QIMAGE_BLOCK_BC4; return true;
+		case QTEXTURE_FORMAT_ATI2N:		blockFormat = QIMAGE_BLOCK_BC5; return true;
+		default:						return false;
+	}
+}
+
+// Plain format of the texels QIMAGE_DECOMPRESS writes //
+static ETexturePixelFormat QTEXTURE_GET_DECODED_FORMAT(const QIMAGE_BLOCK_FORMAT& fmt)
+{
+	switch(QIMAGE_GET_BLOCK_CHANNELS(fmt))
+	{
+		case 1:		return QTEXTURE_FORMAT_I8;
+		case 2:		return QTEXTURE_FORMAT_IA8;
+		default:	return QTEXTURE_FORMAT_RGBA8;
+	}
+}
+
 
 
 
@@ -184,60 +218,6 @@ static void swapChannel(TYPE* pixels, const int& nPixels, const int& nChannels,
 }
 
 
-template <typename TYPE>
-static void genMipMap(TYPE* src, TYPE* dest, const unsigned int w, const unsigned int h, const unsigned int d, const unsigned int c)
-{
-	unsigned int xOffset = (w < 2) ? 0 : c;
-	unsigned int yOffset = (h < 2) ? 0 : c * w;
-	unsigned int zOffset = (d < 2) ? 0 : c * w * h;
-	
-	for(unsigned int z = 0; z < d; z += 2)
-	{
-		for(unsigned int y = 0; y < h; y += 2)
-		{
-			for(unsigned int x = 0; x < w; x += 2)
-			{
-				for(unsigned int i = 0; i < c; ++i)
-				{
-					*dest++ = (src[0] + src[xOffset] + src[yOffset] + src[yOffset + xOffset] + src[zOffset] + 
-							   src[zOffset + xOffset] + src[zOffset + yOffset] + src[zOffset + yOffset + xOffset]) / 8;
-					src++;
-				}
-				src += xOffset;
-			}
-			src += yOffset;
-		}
-		src += zOffset;
-	}
-}
-
-
-
-
-static bool isPowerOfTwo(const int val)
-{
-	return (val & -val) == val;
-}
-
-
-
-static int getMipMapCount2(const int& maxDimension)
-{
-	int i = 0; 
-	int maxDim = maxDimension;
-	while(maxDim > 0)
-	{
-		maxDim >>= 1;
-		++i;
-	}
-	
-	return i;
-}
-
-
-
-
-
 static bool HasMipMapFlags(const unsigned int& flags)
 {
 	if(flags & QTEXTURE_FILTER_BILINEAR || flags & QTEXTURE_FILTER_TRILINEAR ||
@@ -266,6 +246,17 @@ static int GetChannelCount(const ETexturePixelFormat& fmt)
 }
 
 
+// Flag bits that change what PrepareForUpload produces, the rest only affect the sampler and usage //
+static unsigned int GetProcessingFlags(const unsigned int& flags)
+{
+	unsigned int processing = flags & (QTEXTURE_NORMALMAP | QTEXTURE_KEEPHEIGHT | QTEXTURE_LINEAR | QTEXTURE_COMPRESS);
+	if(HasMipMapFlags(flags))
+		processing |= QTEXTURE_FILTER_TRILINEAR;
+	
+	return processing;
+}
+
+
 static int GetFilterIndex(const unsigned int& flags)
 {
 	if(flags & QTEXTURE_FILTER_NEAREST) return 0;
@@ -277,6 +268,128 @@ static int GetFilterIndex(const unsigned int& flags)
 	else return -1;
 }
 
+
+// Applies QTEXTURE_COMPRESS before upload. D3D9 wants the base of a DXT surface in multiples of 4 //
+// and cannot generate its mipmaps, such textures are left uncompressed                           //
+static bool CompressForUpload(CQuadrionTextureFile& tex, const unsigned int& flags, const bool& autoGenMips)
+{
+	ETexturePixelFormat fmt = tex.GetPixelFormat();
+	if(!(flags & QTEXTURE_COMPRESS) || autoGenMips || fmt < QTEXTURE_FORMAT_I8 || fmt > QTEXTURE_FORMAT_RGBA8)
+		return true;
+	
+	if((tex.GetWidth() & 3) || (tex.GetHeight() & 3))
+		return true;
+	
+	bool normalMap = (flags & QTEXTURE_NORMALMAP) != 0;
+	ETexturePixelFormat target;
+	if(normalMap)
+		target = (flags & QTEXTURE_KEEPHEIGHT) ? QTEXTURE_FORMAT_DXT5 : QTEXTURE_FORMAT_ATI2N;
+	else if(GetChannelCount(fmt) == 2 || GetChannelCount(fmt) == 4)
+		target = QTEXTURE_FORMAT_DXT5;
+	else
+		target = QTEXTURE_FORMAT_DXT1;
+	
+	return tex.Compress(target, normalMap);
+}
+
+
+// Whether PrepareForUpload has real work to do on a loaded chain: mipmaps, a normal map, block //
+// compression or a channel added. The BGRA swap alone is cheaper than hashing the source file   //
+static bool NeedsProcessing(CQuadrionTextureFile& tex, const unsigned int& flags)
+{
+	ETexturePixelFormat fmt = tex.GetPixelFormat();
+	if(tex.GetMipMapCount() <= 1 && HasMipMapFlags(flags))
+		return true;
+	
+	if((tex.GetHeight() > 0 && tex.GetDepth() == 1) && (flags & QTEXTURE_NORMALMAP))
+		return true;
+	
+	if((flags & QTEXTURE_COMPRESS) && fmt >= QTEXTURE_FORMAT_I8 && fmt <= QTEXTURE_FORMAT_RGBA8 && !(tex.GetWidth() & 3) && !(tex.GetHeight() & 3))
+		return true;
+	
+	return IsPlainFormat(fmt) && GetChannelCount(fmt) == 3;
+}
+
+
+// Residency class a texture falls in when none was set //
+static ETextureResidencyClass ClassifyResidency(const unsigned int& flags, CQuadrionTextureFile& tex)
+{
+	if(flags & QTEXTURE_NORMALMAP)
+		return QTEXTURE_RESIDENCY_NORMALMAP;
+	
+	if(tex.IsCubemap() || tex.Is3D())
+		return QTEXTURE_RESIDENCY_ENVIRONMENT;
+	
+	if(tex.GetMipMapCount() <= 1 && !HasMipMapFlags(flags))
+		return QTEXTURE_RESIDENCY_UI;
+	
+	return QTEXTURE_RESIDENCY_COLOR;
+}
+
+
+// Bytes per 4x4 block of a device format, 0 for formats that are not block compressed //
+static unsigned int GetBlockBytes(const D3DFORMAT& fmt)
+{
+	switch(fmt)
+	{
+		case D3DFMT_DXT1:
+		case (D3DFORMAT)0x31495441:
+			return 8;
+		
+		case D3DFMT_DXT3:
+		case D3DFMT_DXT4:
+		case D3DFMT_DXT5:
+		case (D3DFORMAT)0x32495441:
+			return 16;
+		
+		default:
+			return 0;
+	}
+}
+
+
+// Size in bytes of one w * h level of a device format //
+static unsigned int GetLevelBytes(const D3DFORMAT& fmt, const unsigned int& w, const unsigned int& h)
+{
+	unsigned int blockBytes = GetBlockBytes(fmt);
+	if(blockBytes)
+		return ((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+	
+	unsigned int texelBytes;
+	switch(fmt)
+	{
+		case D3DFMT_L8:				texelBytes = 1; break;
+		case D3DFMT_A8L8:
+		case D3DFMT_L16:
+		case D3DFMT_R16F:			texelBytes = 2; break;
+		case D3DFMT_A16B16G16R16:
+		case D3DFMT_A16B16G16R16F:
+		case D3DFMT_G32R32F:		texelBytes = 8; break;
+		case D3DFMT_A32B32G32R32F:	texelBytes = 16; break;
+		default:					texelBytes = 4; break;
+	}
+	
+	return w * h * texelBytes;
+}
+
+
+// Lock one level (and face) of a 2D or cube texture //
+static bool LockTextureLevel(LPDIRECT3DBASETEXTURE9 texture, const unsigned int& face, const unsigned int& level, D3DLOCKED_RECT& rect, const DWORD& flags)
+{
+	if(texture->GetType() == D3DRTYPE_CUBETEXTURE)
+		return SUCCEEDED(((LPDIRECT3DCUBETEXTURE9)texture)->LockRect((D3DCUBEMAP_FACES)face, level, &rect, NULL, flags));
+	
+	return SUCCEEDED(((LPDIRECT3DTEXTURE9)texture)->LockRect(level, &rect, NULL, flags));
+}
+
+static void UnlockTextureLevel(LPDIRECT3DBASETEXTURE9 texture, const unsigned int& face, const unsigned int& level)
+{
+	if(texture->GetType() == D3DRTYPE_CUBETEXTURE)
+		((LPDIRECT3DCUBETEXTURE9)texture)->UnlockRect((D3DCUBEMAP_FACES)face, level);
+	else
+		((LPDIRECT3DTEXTURE9)texture)->UnlockRect(level);
+}
+
 template <typename DATA_TYPE>
 inline DATA_TYPE clamp(const DATA_TYPE x, const float lower, const float upper)
 {
@@ -359,8 +472,10 @@ CQuadrionTextureFile::CQuadrionTextureFile()
 	pixelFormat = QTEXTURE_FORMAT_NONE;
 	width = height = bpp = depth = 0;
 	nMipMaps = 0;
+	firstLevel = 0;
 	m_bIsLoaded = false;
 	greyscale = NULL;
+	mappedFile = NULL;
 }
 
 
@@ -372,7 +487,10 @@ CQuadrionTextureFile::CQuadrionTextureFile(const CQuadrionTextureFile& tex)
 	bpp = tex.bpp;
 	depth = tex.depth;
 	nMipMaps = tex.nMipMaps;
+	firstLevel = tex.firstLevel;
 	m_bIsLoaded = tex.m_bIsLoaded;
+	greyscale = NULL;
+	mappedFile = NULL;
 }
 
 
@@ -384,6 +502,7 @@ CQuadrionTextureFile& CQuadrionTextureFile::operator= (const CQuadrionTextureFil
 	this->depth = tex.depth;
 	this->bpp = tex.bpp;
 	this->nMipMaps = tex.nMipMaps;
+	this->firstLevel = tex.firstLevel;
 	this->m_bIsLoaded = tex.m_bIsLoaded;
 
 	return *this;
@@ -391,14 +510,7 @@ CQuadrionTextureFile& CQuadrionTextureFile::operator= (const CQuadrionTextureFil
 
 CQuadrionTextureFile::~CQuadrionTextureFile()
 {	
-	for(unsigned int i = 0; i < pixels.size(); ++i)
-	{
-		if(pixels[i])
-		{
-			delete[] pixels[i];
-			pixels[i] = NULL;
-		}
-	}
+	FreePixels();
 	
 	for(unsigned int i = 0; i < normalMap.size(); ++i)
 	{
@@ -422,6 +534,91 @@ CQuadrionTextureFile::~CQuadrionTextureFile()
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+// getLevelWithin
+// First level that fits in maxExtent on both sides, the smallest level when none
+// does and 0 when there is no limit
+unsigned int CQuadrionTextureFile::GetLevelWithin(const unsigned int& maxExtent)
+{
+	unsigned int level = 0;
+	if(maxExtent == 0)
+		return 0;
+	
+	while(level + 1 < nMipMaps && (GetWidth(level) > (int)maxExtent || GetHeight(level) > (int)maxExtent))
+		++level;
+	
+	return level;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// setFirstLevel
+// Rebases the header fields on a level of the file after the levels above it
+// were skipped
+void CQuadrionTextureFile::SetFirstLevel(const unsigned int& level)
+{
+	if(level == 0)
+		return;
+	
+	width = GetWidth(level);
+	height = GetHeight(level);
+	if(depth > 0)
+		depth = GetDepth(level);
+	
+	nMipMaps -= level;
+	firstLevel = level;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// freePixels
+// Buffers inside the mapping belong to it and are not deleted
+void CQuadrionTextureFile::FreePixels()
+{
+	for(unsigned int i = 0; i < pixels.size(); ++i)
+	{
+		if(pixels[i] && !(mappedFile && mappedFile->Contains(pixels[i])))
+			delete[] pixels[i];
+	}
+	
+	pixels.clear();
+	firstLevel = 0;
+	
+	if(mappedFile)
+	{
+		delete mappedFile;
+		mappedFile = NULL;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// releaseMapping
+// Called once the data has been uploaded, later chains (mipmaps, conversions) are kept
+void CQuadrionTextureFile::ReleaseMapping()
+{
+	if(!mappedFile)
+		return;
+	
+	if(!pixels.empty() && mappedFile->Contains(pixels[pixels.size() - 1]))
+	{
+		FreePixels();
+		nMipMaps = 0;
+		m_bIsLoaded = false;
+		return;
+	}
+	
+	for(unsigned int i = 0; i < pixels.size(); ++i)
+	{
+		if(mappedFile->Contains(pixels[i]))
+			pixels[i] = NULL;
+	}
+	
+	delete mappedFile;
+	mappedFile = NULL;
+}
+
+
 
 ////////////////////////////////////////////////////////////////////////
 // loadLightmap
@@ -430,14 +627,7 @@ CQuadrionTextureFile::~CQuadrionTextureFile()
 // Used for loading in lightmaps from the QBSP file format map 
 bool CQuadrionTextureFile::LoadLightmap(unsigned char* pix)
 {	
-	for(unsigned int i = 0; i < pixels.size(); ++i)
-	{
-		if(pixels[i])
-		{
-			delete[] pixels[i];
-			pixels[i] = NULL;
-		}
-	}
+	FreePixels();
 	
 	width = height = 128;
 	bpp = 24;
@@ -464,14 +654,7 @@ bool CQuadrionTextureFile::LoadLightmap(unsigned char* pix)
 
 bool CQuadrionTextureFile::LoadFromColor( const unsigned int& color )
 {
-	for(unsigned int i = 0; i < pixels.size(); ++i)
-	{
-		if(pixels[i])
-		{
-			delete[] pixels[i];
-			pixels[i] = NULL;
-		}
-	}
+	FreePixels();
 	
 	width = 2;
 	height = 2;
@@ -505,7 +688,7 @@ bool CQuadrionTextureFile::LoadFromColor( const unsigned int& color )
 // fname- file name with path and extension
 //
 // Load a texture file from filename
-bool CQuadrionTextureFile::LoadTexture(const char* fname, const char* pname)
+bool CQuadrionTextureFile::LoadTexture(const char* fname, const char* pname, const bool mapFile, const unsigned int& maxExtent)
 {
 	const char* ext = strrchr(fname, '.');
 	if(!ext)
@@ -516,34 +699,49 @@ bool CQuadrionTextureFile::LoadTexture(const char* fname, const char* pname)
 	
 	++ext;
 	if(stricmp(ext, "dds") == 0)
-		return LoadDDS(full.c_str());
+		return LoadDDS(full.c_str(), mapFile, maxExtent);
 	
 	else if(stricmp(ext, "tga") == 0)
 		return LoadTGA(full.c_str());
 	
 	else if(stricmp(ext, "jpg") == 0)
-		return LoadJPG(full.c_str());
+		return LoadJPG(full.c_str(), maxExtent);
 	
 	else 
 		return false;
 }
 
 
-
 ///////////////////////////////////////////////////////////////////////////////
-// loadTGA
-// Load .TGA texture from file name
-bool CQuadrionTextureFile::LoadTGA(const char* fname)
+// QTEXTURE_FIND_FILE
+// Only asks the file system, nothing is opened or decoded while probing
+bool QTEXTURE_FIND_FILE(const std::string& name, std::string& found)
 {
-	for(unsigned int i = 0; i < pixels.size(); ++i)
+	static const char* extensions[] = { "", ".dds", ".tga", ".jpg" };
+	
+	for(unsigned int i = 0; i < 4; ++i)
 	{
-		if(pixels[i])
+		std::string candidate = name + extensions[i];
+		DWORD attrib = GetFileAttributesA(candidate.c_str());
+		if(attrib != INVALID_FILE_ATTRIBUTES && !(attrib & FILE_ATTRIBUTE_DIRECTORY))
 		{
-			delete[] pixels[i];
-			pixels[i] = NULL;
+			found = candidate;
+			return true;
 		}
 	}
 	
+	return false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// loadTGA
+// Load .TGA texture from file name
+bool CQuadrionTextureFile::LoadTGA(const char* fname)
+{
+	FreePixels();
+	
 	sTGAHeader header;
 	FILE* file;
 	if((file = fopen(fname, "rb")) == NULL)
@@ -567,106 +765,43 @@ bool CQuadrionTextureFile::LoadTGA(const char* fname)
 	fread(pix, size, 1, file);
 	fclose(file);
 	
-	unsigned char* dest, *src = pix + width * (height - 1) * pixelSize;
-	unsigned char* newPix;
-	unsigned int x, y;
-	
+	QIMAGE_PIXEL_LAYOUT srcLayout, dstLayout;
 	switch(bpp)
 	{
 		case 8:
 			pixelFormat = QTEXTURE_FORMAT_I8;
-			dest = newPix = new unsigned char[width * height];
-			for(y = 0; y < height; ++y)
-			{
-				memcpy(dest, src, width);
-				dest += width;
-				src -= width;
-			}
+			srcLayout = dstLayout = QIMAGE_LAYOUT_I8;
 			break;
 		
+		// The low attribute bits hold the alpha depth, without it the top bit is unused //
 		case 16:
 			pixelFormat = QTEXTURE_FORMAT_RGBA8;
-			dest = newPix = new unsigned char[width * height * 4];
-			for(y = 0; y < height; ++y)
-			{
-				for(x = 0; x < width; ++x)
-				{
-					unsigned short tmpPix = *((unsigned char*)src);
-					dest[0] = ((tmpPix >> 10) & 0x1F) << 3;
-					dest[1] = ((tmpPix >> 5) & 0x1F) << 3;
-					dest[2] = ((tmpPix) & 0x1F) << 3;
-					dest[3] = ((tmpPix >> 15) ? 0xFF : 0);
-					dest += 4;
-					src += 4;
-				}
-				
-				src -= 4 * width;
-			}
+			srcLayout = (header.attrib & 0x0F) ? QIMAGE_LAYOUT_A1R5G5B5 : QIMAGE_LAYOUT_X1R5G5B5;
+			dstLayout = QIMAGE_LAYOUT_RGBA8;
 			break;
 		
 		case 24:
 			pixelFormat = QTEXTURE_FORMAT_RGB8;
-			dest = newPix = new unsigned char[width * height * 3];
-			for(y = 0; y < height; ++y)
-			{
-				for(x = 0; x < width; ++x)
-				{
-					*dest++ = src[2];
-					*dest++ = src[1];
-					*dest++ = src[0];
-					src += 3;
-				}
-				
-				src -= 6 * width;
-			}
+			srcLayout = QIMAGE_LAYOUT_BGR8;
+			dstLayout = QIMAGE_LAYOUT_RGB8;
 			break;
 		
 		case 32:
 			pixelFormat = QTEXTURE_FORMAT_RGBA8;
-			dest = newPix = new unsigned char[width * height * 4];
-			for(y = 0; y < height; ++y)
-			{
-				for(x = 0; x < width; ++x)
-				{
-					*dest++ = src[2];			
-					*dest++ = src[1];			
-					*dest++ = src[0];			
-					*dest++ = src[3];			
-					src += 4;
-				}
-				
-				src -= 8 * width;
-			}
+			srcLayout = QIMAGE_LAYOUT_BGRA8;
+			dstLayout = QIMAGE_LAYOUT_RGBA8;
 			break;
-	}
-	
-	if(header.attrib & 0x20)
-	{
-		if(QTEXTURE_IS_COMPRESSED_FORMAT(pixelFormat))
-		{
-			delete[] newPix;
-			newPix = NULL;
-			return false;
-		}
 		
-		unsigned int lineWidth = QTEXTURE_GET_BYTES_PER_PIXEL(pixelFormat) * width;
-		unsigned char* newPixels = new unsigned char[lineWidth * height];
-		if(!newPixels)
+		default:
+			delete[] pix;
 			return false;
-		
-		for(unsigned int i = 0; i < height; ++i)
-		{
-			memcpy(newPixels + i * lineWidth, newPix + (height - 1 - i) * lineWidth, lineWidth);
-		}
-		
-		pixels.push_back(newPixels);
-		delete[] newPix;
-		newPix = NULL;
 	}
 	
-	else
-		pixels.push_back(newPix);
+	// Rows are stored bottom up unless the origin bit is set, swizzle and flip happen in one pass //
+	unsigned char* newPix = new unsigned char[width * height * QTEXTURE_GET_BYTES_PER_PIXEL(pixelFormat)];
+	QIMAGE_CONVERT(pix, newPix, width, height, srcLayout, dstLayout, !(header.attrib & 0x20));
 	
+	pixels.push_back(newPix);
 	delete[] pix;
 	
 	fileName = fname;
@@ -679,16 +814,9 @@ bool CQuadrionTextureFile::LoadTGA(const char* fname)
 ////////////////////////////////////////////////////////////////////////
 // loadDDS
 // Load .DDS texture from filename
-bool CQuadrionTextureFile::LoadDDS(const char* fname)
+bool CQuadrionTextureFile::LoadDDS(const char* fname, const bool mapFile, const unsigned int& maxExtent)
 {
-	for(unsigned int i = 0; i < pixels.size(); ++i)
-	{
-		if(pixels[i])
-		{
-			delete[] pixels[i];
-			pixels[i] = NULL;
-		}
-	}
+	FreePixels();
 
 	depth = 0;
 	nMipMaps = 0;
@@ -721,6 +849,10 @@ bool CQuadrionTextureFile::LoadDDS(const char* fname)
 	
 	if(nMipMaps <= 0)
 		nMipMaps = 1;
+	
+	// Packed 16 bit colour is stored like IA8 (2 bytes per texel) and expanded to RGBA8 after reading //
+	ETexturePixelFormat fileFormat = QTEXTURE_FORMAT_NONE;
+	QIMAGE_PIXEL_LAYOUT fileLayout = QIMAGE_LAYOUT_RGBA8;
 		
 	switch(header.ddpfPixelFormat.dwFourCC)
 	{
@@ -779,7 +911,16 @@ bool CQuadrionTextureFile::LoadDDS(const char* fname)
 					break;
 					
 				case 16:
-					if(header.ddpfPixelFormat.dwRGBAlphaBitMask)
+					if(header.ddpfPixelFormat.dwRBitMask == 0xF800 || header.ddpfPixelFormat.dwRBitMask == 0x7C00)
+					{
+						pixelFormat = QTEXTURE_FORMAT_RGBA8;
+						fileFormat = QTEXTURE_FORMAT_IA8;
+						if(header.ddpfPixelFormat.dwRBitMask == 0xF800)
+							fileLayout = QIMAGE_LAYOUT_R5G6B5;
+						else
+							fileLayout = (header.ddpfPixelFormat.dwRGBAlphaBitMask) ? QIMAGE_LAYOUT_A1R5G5B5 : QIMAGE_LAYOUT_X1R5G5B5;
+					}
+					else if(header.ddpfPixelFormat.dwRGBAlphaBitMask)
 						pixelFormat = QTEXTURE_FORMAT_IA8;
 					else
 						pixelFormat = QTEXTURE_FORMAT_I16;
@@ -787,10 +928,16 @@ bool CQuadrionTextureFile::LoadDDS(const char* fname)
 				
 				case 24:
 					pixelFormat = QTEXTURE_FORMAT_RGB8;
+					fileLayout = (header.ddpfPixelFormat.dwBBitMask == 0xFF) ? QIMAGE_LAYOUT_BGR8 : QIMAGE_LAYOUT_RGB8;
 					break;
 				
+				// X8R8G8B8 and X8B8G8R8 leave the 4th byte undefined //
 				case 32:
 					pixelFormat = QTEXTURE_FORMAT_RGBA8;
+					if(header.ddpfPixelFormat.dwBBitMask == 0xFF)
+						fileLayout = (header.ddpfPixelFormat.dwRGBAlphaBitMask) ? QIMAGE_LAYOUT_BGRA8 : QIMAGE_LAYOUT_BGRX8;
+					else
+						fileLayout = (header.ddpfPixelFormat.dwRGBAlphaBitMask) ? QIMAGE_LAYOUT_RGBA8 : QIMAGE_LAYOUT_RGBX8;
 					break;
 				
 				default:
@@ -799,163 +946,243 @@ bool CQuadrionTextureFile::LoadDDS(const char* fname)
 			}
 	}
 	
-	int size = GetSizeWithMipMaps(0, nMipMaps);
+	if(fileFormat == QTEXTURE_FORMAT_NONE)
+		fileFormat = pixelFormat;
+	
+	QIMAGE_PIXEL_LAYOUT dstLayout = (pixelFormat == QTEXTURE_FORMAT_RGB8) ? QIMAGE_LAYOUT_RGB8 : QIMAGE_LAYOUT_RGBA8;
+	bool convert = (pixelFormat == QTEXTURE_FORMAT_RGB8 || pixelFormat == QTEXTURE_FORMAT_RGBA8) && fileLayout != dstLayout;
+	
+	unsigned int first = GetLevelWithin(maxExtent);
+	int skipSize = GetSizeWithMipMaps(0, first, fileFormat);
+	int size = GetSizeWithMipMaps(first, nMipMaps - first, fileFormat);
+	
+	// Chains stored exactly as they are kept in memory are used from the mapping. Cubemap faces //
+	// only line up when there is a single level                                                 //
+	if(mapFile && !convert && (!IsCubemap() || nMipMaps == 1))
+	{
+		CMappedFile* mapping = new CMappedFile;
+		if(mapping->Open(fname) && mapping->GetSize() >= sizeof(header) + skipSize + size)
+		{
+			fclose(file);
+			
+			SetFirstLevel(first);
+			mappedFile = mapping;
+			pixels.push_back(mapping->GetData() + sizeof(header) + skipSize);
+			fileName = fname;
+			m_bIsLoaded = true;
+			return true;
+		}
+		
+		delete mapping;
+	}
+	
 	unsigned char* newPix = new unsigned char[size];
 	
+	// The file stores every face with its whole chain, in memory the faces of a level are adjacent //
 	if(IsCubemap())
 	{
 		for(unsigned int face = 0; face < 6; ++face)
 		{
 			for(unsigned int mipLevel = 0; mipLevel < nMipMaps; ++mipLevel)
 			{
-				int faceSize = GetSizeWithMipMaps(mipLevel, 1) / 6;
-				unsigned char* src = GetData(mipLevel) + face * faceSize;
+				int faceSize = GetSizeWithMipMaps(mipLevel, 1, fileFormat) / 6;
+				if(mipLevel < first)
+				{
+					fseek(file, faceSize, SEEK_CUR);
+					continue;
+				}
+				
+				unsigned char* src = newPix + GetSizeWithMipMaps(first, mipLevel - first, fileFormat) + face * faceSize;
 				fread(src, 1, faceSize, file);
 			}
 		}
 	}
 	
 	else
-		fread(newPix, 1, size, file);
-	
-	if((pixelFormat == QTEXTURE_FORMAT_RGB8 || pixelFormat == QTEXTURE_FORMAT_RGBA8) && header.ddpfPixelFormat.dwBBitMask == 0xFF)
 	{
-		int nChannels = QTEXTURE_GET_CHANNEL_COUNT(pixelFormat);
-		swapChannel(newPix, size / nChannels, nChannels, 0, 2);
+		fseek(file, skipSize, SEEK_CUR);
+		fread(newPix, 1, size, file);
 	}
 	
 	fclose(file);
+	SetFirstLevel(first);
 	
-	pixels.push_back(newPix);
-	fileName = fname;
-	m_bIsLoaded = true;
-	return true;
-}
-
-
+	// The whole chain converts as one row of texels, in place unless the texel size changes //
+	if(convert)
+	{
+		unsigned int nTexels = size / QTEXTURE_GET_BYTES_PER_PIXEL(fileFormat);
+		unsigned char* dst = (fileFormat != pixelFormat) ? new unsigned char[nTexels * 4] : newPix;
+		bool converted = QIMAGE_CONVERT(newPix, dst, nTexels, 1, fileLayout, dstLayout);
+		if(dst != newPix)
+		{
+			delete[] newPix;
+			newPix = dst;
+		}
+		
+		if(!converted)
+		{
+			delete[] newPix;
+			return false;
+		}
+	}
+	
+	pixels.push_back(newPix);
+	fileName = fname;
+	m_bIsLoaded = true;
+	return true;
+}
+
+
 
 
 //////////////////////////////////////////////////////////////////////////////
 // loadJPG
-// Load .JPG texture from file name
-bool CQuadrionTextureFile::LoadJPG(const char* fname)
+// Load .JPG texture from file name. With a maxExtent the image is scaled down by a power
+// of two, up to 1/8 by the decoder's reduced IDCTs and beyond that by box filtering the
+// scanlines as they are decoded. The full size image is never stored.
+// The file is mapped and decoded from the mapped bytes, files that can't be mapped are read.
+// At 1/8 only the DC coefficients count, progressive files are then decoded scan by scan up to
+// the last component's first DC scan and their AC scans are never decoded. That is what makes
+// the small chain of a streamed texture quick
+bool CQuadrionTextureFile::LoadJPG(const char* fname, const unsigned int& maxExtent)
 {	
-	for(unsigned int i = 0; i < pixels.size(); ++i)
-	{
-		if(pixels[i])
-		{
-			delete[] pixels[i];
-			pixels[i] = NULL;
-		}
-	}
+	FreePixels();
 
 	
-	jpeg_decoder_file_stream jpegStream;
-	if(!jpegStream.open(fname))
-		return false;
+	CMappedFile mapping;
+	jpeg_decoder_mem_stream memStream(NULL, 0);
+	jpeg_decoder_file_stream fileStream;
+	jpeg_decoder_stream* jpegStream = &memStream;
 	
-	int fileSize = jpegStream.get_size();
-	size_t bytesRead;
-	bool eof;
-	unsigned char* fileBuf = new unsigned char[fileSize];
-	if(!fileBuf)
+	if(mapping.Open(fname) && mapping.GetSize() <= 0x7FFFFFFF)
+		memStream.open(mapping.GetData(), (unsigned int)mapping.GetSize());
+	else if(fileStream.open(fname))
+		jpegStream = &fileStream;
+	else
 		return false;
 	
-	bytesRead = jpegStream.read(fileBuf, fileSize, &eof);
-	jpegStream.reset();
+	jpeg_decoder jpegDecode(jpegStream, true);
+	
+	int srcWidth = jpegDecode.get_width();
+	int srcHeight = jpegDecode.get_height();
 	
-	jpeg_decoder jpegDecode(&jpegStream, true);
-	if(jpegDecode.begin() != JPGD_OKAY)
+	unsigned int shift = 0;
+	if(maxExtent > 0)
 	{
-		delete[] fileBuf;
-		fileBuf = NULL;
-		return false;
+		while((srcWidth >> shift) > (int)maxExtent || (srcHeight >> shift) > (int)maxExtent)
+			++shift;
 	}
 	
-	width = jpegDecode.get_width();
-	height = jpegDecode.get_height();
+	unsigned int dctShift = (shift < 3) ? shift : 3;
+	unsigned int boxShift = shift - dctShift;
+	jpegDecode.set_scale(dctShift);
+	
+	bool dcOnly = (dctShift == 3 && jpegDecode.is_progressive());
+	if((dcOnly ? jpegDecode.begin_scans() : jpegDecode.begin()) != JPGD_OKAY)
+		return false;
+	
 	bpp = jpegDecode.get_bytes_per_pixel() * 8;
 	depth = 1;
 	nMipMaps = 1;
 	
-	unsigned int lineLen = 0;
+	width = (srcWidth >> shift > 0) ? srcWidth >> shift : 1;
+	height = (srcHeight >> shift > 0) ? srcHeight >> shift : 1;
+	
+	// Scaled decodes round up, the mip chain rounds down //
+	int decWidth = jpegDecode.get_scaled_width();
+	int decHeight = jpegDecode.get_scaled_height();
+	bool direct = (decWidth == width && decHeight == height);
+	
 	int y, hr;
 	
 	unsigned char* newPix = new unsigned char[width * height * (bpp / 8)];
 	if(!newPix)
+		return false;
+
+	// The decoder writes RGBA (opaque) or I8 scanlines straight into the texel rows //
+	pixelFormat = (bpp == 8) ? QTEXTURE_FORMAT_I8 : QTEXTURE_FORMAT_RGBA8;
+	
+	unsigned int channels = bpp / 8;
+	unsigned int pitch = width * channels;
+	
+	// The rest is box filtered, every block of 2^boxShift decoded scanlines and columns is summed. //
+	// The last row and column of blocks also take the texels left over when the size is not a     //
+	// multiple of 2^boxShift                                                                       //
+	unsigned char* line = NULL;
+	unsigned int* sums = NULL;
+	if(!direct)
+	{
+		// DC only images are rendered whole, then filtered //
+		line = new unsigned char[decWidth * (dcOnly ? decHeight : 1) * channels];
+		sums = new unsigned int[pitch];
+		memset(sums, 0, pitch * sizeof(unsigned int));
+	}
+	
+	// Unfiltered images are decoded straight into the texels, by several threads when the file //
+	// is mapped and has restart markers                                                        //
+	hr = JPGD_OKAY;
+	if(dcOnly)
+	{
+		while(!jpegDecode.is_dc_complete() && hr == JPGD_OKAY)
+			hr = jpegDecode.decode_next_scan();
+		
+		if(hr == JPGD_OKAY || hr == JPGD_DONE)
+			hr = jpegDecode.render_scans(direct ? newPix : line, direct ? pitch : decWidth * channels, channels, 3);
+	}
+	else if(direct)
+		hr = jpegDecode.decode_image(newPix, pitch, channels);
+	
+	if(hr != JPGD_OKAY)
 	{
-		delete[] fileBuf;
-		fileBuf = NULL;
+		delete[] newPix;
+		delete[] line;
+		delete[] sums;
 		return false;
 	}
-
-	unsigned char* dest = newPix;
 	
-	switch(bpp)
+	for(y = 0; y < decHeight && !direct; ++y)
 	{
-		case 8:
-			pixelFormat = QTEXTURE_FORMAT_I8;
-			for(y = 0; y < height; ++y)
-			{
-				hr = jpegDecode.decode((void**)&dest, &lineLen);
-				if(hr == JPGD_FAILED || hr == JPGD_DECODE_ERROR)
-				{
-					delete[] newPix;
-					newPix = NULL;
-					dest = NULL;
-					delete[] fileBuf;
-					fileBuf = NULL;
-					return false;
-				}
-				memcpy(newPix + (y + width), dest, lineLen);
-				lineLen = 0;
-			}
-			break;
+		unsigned char* row = dcOnly ? line + y * decWidth * channels : line;
+		if(!dcOnly && jpegDecode.decode_scan_line(line, channels) != JPGD_OKAY)
+		{
+			delete[] newPix;
+			delete[] line;
+			delete[] sums;
+			newPix = NULL;
+			return false;
+		}
 		
-		case 24:
-			pixelFormat = QTEXTURE_FORMAT_RGB8;
-			for(y = 0; y < height; ++y)
-			{
-				hr = jpegDecode.decode((void**)&dest, &lineLen);
-				if(hr == JPGD_FAILED || hr == JPGD_DECODE_ERROR)
-				{
-					delete[] newPix;
-					delete[] fileBuf;
-					newPix = NULL;
-					fileBuf = NULL;
-					dest = NULL;
-					return false;
-				}	
-				memcpy(newPix + (y * width * 3), dest, lineLen);
-			}
-			break;
+		for(int x = 0; x < decWidth; ++x)
+		{
+			int bx = (x >> boxShift < width) ? x >> boxShift : width - 1;
+			for(unsigned int c = 0; c < channels; ++c)
+				sums[bx * channels + c] += row[x * channels + c];
+		}
 		
-		case 32:
-			pixelFormat = QTEXTURE_FORMAT_RGBA8;
-			for(y = 0; y < height; ++y)
-			{
-				hr = jpegDecode.decode((void**)&dest, &lineLen);
-				if(hr == JPGD_FAILED || hr == JPGD_DECODE_ERROR)
-				{
-					delete[] newPix;
-					delete[] fileBuf;
-					newPix = NULL;
-					fileBuf = NULL;
-					dest = NULL;
-					return false;
-				}
-				
-				memcpy(newPix + (y * width * 4), dest, lineLen);
-			}
-			break;
+		int by = (y >> boxShift < height) ? y >> boxShift : height - 1;
+		int nextBy = ((y + 1) >> boxShift < height) ? (y + 1) >> boxShift : height - 1;
+		if(y + 1 < decHeight && nextBy == by)
+			continue;
+		
+		int rows = y + 1 - (by << boxShift);
+		unsigned char* dst = newPix + by * pitch;
+		for(int bx = 0; bx < width; ++bx)
+		{
+			int cols = (bx < width - 1) ? (1 << boxShift) : decWidth - (bx << boxShift);
+			unsigned int count = rows * cols;
+			for(unsigned int c = 0; c < channels; ++c)
+				dst[bx * channels + c] = (unsigned char)((sums[bx * channels + c] + count / 2) / count);
+		}
+		
+		memset(sums, 0, pitch * sizeof(unsigned int));
 	}
 	
-	delete[] fileBuf;
-	fileBuf = NULL;
+	delete[] line;
+	delete[] sums;
+	firstLevel = shift;
 	
 	
 	pixels.push_back(newPix);
-	jpegDecode.~jpeg_decoder();
 	fileName = fname;
 	m_bIsLoaded = true;
 	
@@ -1060,6 +1287,9 @@ unsigned char* CQuadrionTextureFile::GetData(const unsigned int& level) const
 	d = depth >> 0;
 	if(d == 0) d = 1;
 	
+	if(pixels.empty())
+		return NULL;
+	
 	unsigned int highest = pixels.size() - 1;
 	
 	mipMappedSize = getImageSize(pixelFormat, w, h, (depth > 0) * d, level);
@@ -1109,6 +1339,9 @@ unsigned char* CQuadrionTextureFile::GetNormalmapData(const unsigned int& level)
 // Swap channels from ch0 to ch1 in existing texture
 bool CQuadrionTextureFile::SwapChannels(const unsigned int& ch0, const unsigned int& ch1, bool useNormalmap)
 {
+	if(QTEXTURE_IS_COMPRESSED_FORMAT(pixelFormat) && !Decompress(useNormalmap))
+		return false;
+	
 	if(!QTEXTURE_IS_PLAIN_FORMAT(pixelFormat))
 		return false;
 	
@@ -1175,81 +1408,130 @@ int CQuadrionTextureFile::GetPixelCount(const int firstMip, int nLevels) const
 
 
 
-bool CQuadrionTextureFile::GenerateMipMaps(const unsigned int nMips)
+// Any size, square or not, 2D, 3D and cubemaps. Odd extents round down like the D3D mip chain //
+bool CQuadrionTextureFile::GenerateMipMaps(const unsigned int nMips, const bool sRGB)
 {
-	if(!QTEXTURE_IS_PLAIN_FORMAT(pixelFormat))
-		return false;
-	if(!isPowerOfTwo(width) || !isPowerOfTwo(height))
-		return false;
-	if(width != height)
+	if(!QTEXTURE_IS_PLAIN_FORMAT(pixelFormat) || pixelFormat == QTEXTURE_FORMAT_NONE)
 		return false;
 	
-	nMipMaps = min(getMipMapCount2(max(max(width, height), depth)), nMips);
-	int mipMappedSize = GetSizeWithMipMaps();
+	// Cubemaps (depth 0) keep their 6 faces back to back within each level //
+	unsigned int d = (depth == 0) ? 1 : depth;
+	unsigned int nImages = (depth == 0) ? 6 : 1;
 	
+	nMipMaps = min(QIMAGE_GET_MIP_COUNT(width, height, d), nMips);
+	int mipMappedSize = GetSizeWithMipMaps(0, nMipMaps);
 
 	unsigned char* newPix = new unsigned char[mipMappedSize];
 	if(!newPix)
 		return false;
 
 	unsigned int largest = pixels.size() - 1;
-	int nChannels = QTEXTURE_GET_CHANNEL_COUNT(pixelFormat);
-	int channelSize = QTEXTURE_GET_BYTES_PER_CHANNEL(pixelFormat);
-	memcpy(newPix, pixels[largest], width * height * depth * nChannels * channelSize);
-	unsigned char* dest, *src = newPix;
+	unsigned int nChannels = QTEXTURE_GET_CHANNEL_COUNT(pixelFormat);
+	unsigned int channelSize = QTEXTURE_GET_BYTES_PER_CHANNEL(pixelFormat);
+	memcpy(newPix, pixels[largest], width * height * d * nImages * nChannels * channelSize);
+	
+	// Colour channels of 8 bit images are sRGB encoded, filter those in linear space. Alpha stays linear //
+	unsigned int srgbMask = 0;
+	if(sRGB && pixelFormat <= QTEXTURE_FORMAT_RGBA8)
+		srgbMask = (nChannels >= 3) ? 0x7 : 0x1;
+	
+	QIMAGE_GENERATE_MIP_CHAIN(newPix, width, height, d, nImages, nMipMaps, nChannels, QTEXTURE_GET_CHANNEL_TYPE(pixelFormat), srgbMask);
+	
+	pixels.push_back(newPix);
+	return true;
+}
 
+
+
+// Every level, face and slice is compressed on its own. ATI2N takes the first two channels, //
+// x and y for the HeightToNormal output                                                     //
+bool CQuadrionTextureFile::Compress(const ETexturePixelFormat& fmt, const bool useNormalmap)
+{
+	QIMAGE_BLOCK_FORMAT blockFormat;
+	if(!QTEXTURE_GET_BLOCK_FORMAT(fmt, blockFormat))
+		return false;
 	
-	if(depth == 0)
+	if(pixelFormat < QTEXTURE_FORMAT_I8 || pixelFormat > QTEXTURE_FORMAT_RGBA8)
+		return false;
+	
+	std::vector<unsigned char*>& chain = (useNormalmap) ? normalMap : pixels;
+	if(chain.empty())
+		return false;
+	
+	unsigned char* newPix = new unsigned char[GetSizeWithMipMaps(0, nMipMaps, fmt)];
+	if(!newPix)
+		return false;
+	
+	unsigned int nChannels = QTEXTURE_GET_CHANNEL_COUNT(pixelFormat);
+	unsigned int nImages = (depth == 0) ? 6 : 1;
+	for(unsigned int i = 0; i < nMipMaps; ++i)
 	{
-		int dim = width;
-		for(int i = 1; i < nMipMaps; ++i)
-		{
-			int sliceSize = dim * dim * nChannels * channelSize;
-			dest = src + 6 * sliceSize;
-			
-			for(unsigned int s = 0; s < 6; ++s)
-			{
-				if(channelSize == 1)
-					genMipMap(src + s * sliceSize, dest + s * sliceSize / 4, dim, dim, 1, nChannels);
-				else if(channelSize == 2)
-					genMipMap((unsigned short*)(src + s * sliceSize), (unsigned short*)(dest + s * sliceSize / 4), dim, dim, 1, nChannels);
-				else
-					genMipMap((float*)(src + s * sliceSize), (float*)(dest + s * sliceSize / 4), dim, dim, 1, nChannels);
-			}
-			
-			src = dest;
-			dim >>= 1;
-		}
+		unsigned char* src = (useNormalmap) ? GetNormalmapData(i) : GetData(i);
+		unsigned char* dst = newPix + GetSizeWithMipMaps(0, i, fmt);
+		QIMAGE_COMPRESS(src, dst, GetWidth(i), GetHeight(i), GetDepth(i) * nImages, nChannels, blockFormat);
 	}
 	
-	else
+	// The pixel data and the normal map share one format, whichever was not compressed is stale now //
+	chain.push_back(newPix);
+	pixelFormat = fmt;
+	bpp = QTEXTURE_GET_BYTES_PER_BLOCK(fmt) / 2;
+	
+	return true;
+}
+
+
+// Inverse of Compress, every level, face and slice is decoded into a new chain //
+bool CQuadrionTextureFile::Decompress(const bool useNormalmap)
+{
+	QIMAGE_BLOCK_FORMAT blockFormat;
+	if(!QTEXTURE_GET_BLOCK_FORMAT(pixelFormat, blockFormat))
+		return false;
+	
+	std::vector<unsigned char*>& chain = (useNormalmap) ? normalMap : pixels;
+	if(chain.empty())
+		return false;
+	
+	ETexturePixelFormat fmt = QTEXTURE_GET_DECODED_FORMAT(blockFormat);
+	unsigned char* newPix = new unsigned char[GetSizeWithMipMaps(0, nMipMaps, fmt)];
+	if(!newPix)
+		return false;
+	
+	unsigned int nImages = (depth == 0) ? 6 : 1;
+	for(unsigned int i = 0; i < nMipMaps; ++i)
 	{
-		int w = width;
-		int h = height;
-		int d = depth;
-		
-		for(int i = 1; i < nMipMaps; ++i)
-		{
-			dest = src + w * h * d * nChannels * channelSize;
-			if(channelSize == 1)
-				genMipMap(src, dest, w, h, d, nChannels);
-			else if(channelSize == 2)
-				genMipMap((unsigned short*)src, (unsigned short*)dest, w, h, d, nChannels);
-			else
-				genMipMap((float*)src, (float*)dest, w, h, d, nChannels);
-			
-			src = dest;
-			if(w > 1) w >>= 1;
-			if(h > 1) h >>= 1;
-			if(d > 1) d >>= 1;
-		}
+		unsigned char* src = (useNormalmap) ? GetNormalmapData(i) : GetData(i);
+		unsigned char* dst = newPix + GetSizeWithMipMaps(0, i, fmt);
+		QIMAGE_DECOMPRESS(src, dst, GetWidth(i), GetHeight(i), GetDepth(i) * nImages, blockFormat);
 	}
 	
-	pixels.push_back(newPix);
+	chain.push_back(newPix);
+	pixelFormat = fmt;
+	bpp = QTEXTURE_GET_BYTES_PER_PIXEL(fmt) * 8;
+	
 	return true;
 }
 
 
+// Slices are numbered face by face for cubemaps (depth * 6 per level) //
+bool CQuadrionTextureFile::DecompressRegion(const unsigned int& level, const unsigned int& x, const unsigned int& y, const unsigned int& w, const unsigned int& h,
+											unsigned char* out, const unsigned int& slice)
+{
+	QIMAGE_BLOCK_FORMAT blockFormat;
+	if(!out || level >= (unsigned int)nMipMaps || pixels.empty() || !QTEXTURE_GET_BLOCK_FORMAT(pixelFormat, blockFormat))
+		return false;
+	
+	unsigned int nImages = (depth == 0) ? 6 : 1;
+	if(slice >= GetDepth(level) * nImages)
+		return false;
+	
+	unsigned int levelW = GetWidth(level);
+	unsigned int levelH = GetHeight(level);
+	size_t sliceBytes = (size_t)((levelW + 3) >> 2) * ((levelH + 3) >> 2) * QTEXTURE_GET_BYTES_PER_BLOCK(pixelFormat);
+	
+	return QIMAGE_DECOMPRESS_REGION(GetData(level) + slice * sliceBytes, out, levelW, levelH, x, y, w, h, blockFormat);
+}
+
+
 std::string CQuadrionTextureFile::GetFileName()
 {
 	return fileName;
@@ -1265,8 +1547,49 @@ int CQuadrionTextureFile::GetMipMapCount()
 	return nMipMaps;
 }
 
+// Compressed colour formats are weighted the same way after decoding, ATI1N is already a single channel //
+bool CQuadrionTextureFile::ConvertToGreyscaleCompressed(const float rf, const float gf, const float bf)
+{
+	QIMAGE_BLOCK_FORMAT blockFormat;
+	if(!QTEXTURE_GET_BLOCK_FORMAT(pixelFormat, blockFormat) || blockFormat == QIMAGE_BLOCK_BC5)
+		return false;
+	
+	unsigned int nImages = (depth == 0) ? 6 : 1;
+	unsigned char* newPixels = new unsigned char[GetPixelCount(0, nMipMaps) * nImages];
+	unsigned char* dest = newPixels;
+	
+	// One level at a time through a buffer the size of level 0 with all its faces //
+	unsigned char* rgba = NULL;
+	if(blockFormat != QIMAGE_BLOCK_BC4)
+		rgba = new unsigned char[GetPixelCount(0, 1) * nImages * 4];
+	
+	for(unsigned int i = 0; i < nMipMaps; ++i)
+	{
+		unsigned int nSlices = GetDepth(i) * nImages;
+		unsigned int nPixels = GetWidth(i) * GetHeight(i) * nSlices;
+		if(!rgba)
+		{
+			QIMAGE_DECOMPRESS(GetData(i), dest, GetWidth(i), GetHeight(i), nSlices, blockFormat);
+			dest += nPixels;
+			continue;
+		}
+		
+		QIMAGE_DECOMPRESS(GetData(i), rgba, GetWidth(i), GetHeight(i), nSlices, blockFormat);
+		const unsigned char* src = rgba;
+		for(unsigned int p = 0; p < nPixels; ++p, src += 4)
+			*dest++ = (unsigned char)(src[0] * rf + src[1] * gf + src[2] * bf);
+	}
+	
+	delete[] rgba;
+	greyscale = newPixels;
+	return true;
+}
+
 bool CQuadrionTextureFile::ConvertToGreyscale(const float rf, const float gf, const float bf)
 {
+	if(QTEXTURE_IS_COMPRESSED_FORMAT(pixelFormat))
+		return ConvertToGreyscaleCompressed(rf, gf, bf);
+	
 	if (pixelFormat < QTEXTURE_FORMAT_RGB8 || pixelFormat > QTEXTURE_FORMAT_RGBA8) 
 		return false;
 
@@ -1287,125 +1610,37 @@ bool CQuadrionTextureFile::ConvertToGreyscale(const float rf, const float gf, co
 	return true;
 }
 
+// Plain 8 bit heights are filtered straight from the pixel data, compressed ones go through the //
+// greyscale chain. Every face and slice is a separate height field that wraps at its edges      //
 bool CQuadrionTextureFile::HeightToNormal(const bool useRGBA, const bool keepHeight, float sz, float mipScaleZ)
 {
-	unsigned int xMask = 0, yMask = 0, zMask = 0, hMask = 0;
-	unsigned int xShift = 0, yShift = 0, zShift = 0, hShift = 0, hFlip = 0;
-//	switch (pixelFormat)
-//	{
-//		case QTEXTURE_FORMAT_RGBA8:
-			xMask = yMask = zMask = hMask = 0xFF;
-			yShift = 8;
-			zShift = 16;
-			hShift = 24;
-//			break;
-			
-//		default:
-//			return false;
-//	}
-
-	if (pixelFormat == QTEXTURE_FORMAT_RGB8 || pixelFormat == QTEXTURE_FORMAT_RGBA8) 
-	{	
+	bool fromGreyscale = QTEXTURE_IS_COMPRESSED_FORMAT(pixelFormat);
+	if(fromGreyscale)
+	{
 		if(!ConvertToGreyscale())
 			return false;
 	}
+	else if(pixelFormat < QTEXTURE_FORMAT_I8 || pixelFormat > QTEXTURE_FORMAT_RGBA8)
+		return false;
+	
+	unsigned int nChannels = (fromGreyscale) ? 1 : QTEXTURE_GET_CHANNEL_COUNT(pixelFormat);
+	unsigned int nImages = (depth == 0) ? 6 : 1;
 	
-	pixelFormat = QTEXTURE_FORMAT_RGBA8;
-
-
-	const float sobelX[5][5] = {
-		1,  2,  0,  -2, -1,
-		4,  8,  0,  -8, -4,
-		6, 12,  0, -12, -6,
-		4,  8,  0,  -8, -4,
-		1,  2,  0,  -2, -1,
-	};
-	const float sobelY[5][5] = {
-		 1,  4,   6,  4,  1,
-		 2,  8,  12,  8,  2,
-		 0,  0,   0,  0,  0,
-		-2, -8, -12, -8, -2,
-		-1, -4,  -6, -4, -1,
-	};
-
-	bool useShort = (QTEXTURE_GET_BYTES_PER_PIXEL(pixelFormat) == 2);
-
-	float xyBias = float(IsUnsignedFormat(pixelFormat));
-	float zBias  = xyBias;
-	float xFactor = 0.5f * xMask;
-	float yFactor = 0.5f * yMask;
-	float zFactor = 0.5f * zMask;
-
-
 	// Size of the z component
 	sz *= 128.0f / max(width, height);
-
-	unsigned char* newPixels = new unsigned char[GetSizeWithMipMaps(0, nMipMaps, pixelFormat)];
-
-	union 
-	{
-		unsigned int* iDest;
-		unsigned short* sDest;
-	};
 	
-	iDest = (unsigned int*) newPixels;
-
-	for(int mipMap = 0; mipMap < nMipMaps; mipMap++)
+	unsigned char* newPixels = new unsigned char[GetSizeWithMipMaps(0, nMipMaps, QTEXTURE_FORMAT_RGBA8)];
+	for(unsigned int i = 0; i < nMipMaps; ++i)
 	{
-		unsigned char* src = GetGreyscaleData(mipMap);
-
-		int w = GetWidth(mipMap);
-		int h = GetHeight(mipMap);
-
-		for(int y = 0; y < h; y++)
-		{
-			for(int x = 0; x < w; x++)
-			{
-				// Apply a 5x5 Sobel filter
-				float sX = 0;
-				float sY = 0;
-				for (int dy = 0; dy < 5; dy++)
-				{
-					int fy = (y + dy - 2 + h) % h;
-					for (int dx = 0; dx < 5; dx++)
-					{
-						int fx = (x + dx - 2 + w) % w;
-						sX += sobelX[dy][dx] * src[fy * w + fx];
-						sY += sobelY[dy][dx] * src[fy * w + fx];
-					}
-				}
-				// Construct the components
-				sX *= 1.0f / (48 * 255);
-				sY *= 1.0f / (48 * 255);
-
-				// Normalize and store
-				float invLen = 1.0f / sqrtf(sX * sX + sY * sY + sz * sz);
-				float rX = xFactor * (sX * invLen + xyBias);
-				float rY = yFactor * (sY * invLen + xyBias);
-				float rZ = zFactor * (sz * invLen +  zBias);
-
-				unsigned int result = 0;
-				result |= (int(rX) & xMask) << xShift;
-				result |= (int(rY) & yMask) << yShift;
-				result |= (int(rZ) & zMask) << zShift;
-				result |= ((src[y * w + x] ^ hFlip) & hMask) << hShift;
-
-				if (useShort)
-					*sDest++ = result;
-				else 
-					*iDest++ = result;
-			}
-		}
+		unsigned char* src = (fromGreyscale) ? GetGreyscaleData(i) : GetData(i);
+		unsigned char* dst = newPixels + GetSizeWithMipMaps(0, i, QTEXTURE_FORMAT_RGBA8);
+		QIMAGE_HEIGHT_TO_NORMAL(src, dst, GetWidth(i), GetHeight(i), GetDepth(i) * nImages, nChannels, sz);
 		sz *= mipScaleZ;
 	}
-
-//	format = destFormat;
-//	delete pixels;
-//	pixels = newPixels;
+	
+	pixelFormat = QTEXTURE_FORMAT_RGBA8;
 	normalMap.push_back(newPixels);
-
-//	if (useCompression) compress(FORMAT_ATI2N);
-
+	
 	return true;
 }
 
@@ -1416,10 +1651,18 @@ ETexturePixelFormat CQuadrionTextureFile::GetPixelFormat()
 }
 
 
+// Compressed formats that decode to 4 channels are left compressed //
 bool CQuadrionTextureFile::AddChannel(const float val)
 {
+	QIMAGE_BLOCK_FORMAT blockFormat;
+	if(QTEXTURE_GET_BLOCK_FORMAT(pixelFormat, blockFormat))
+	{
+		if(QIMAGE_GET_BLOCK_CHANNELS(blockFormat) == 4 || !Decompress())
+			return false;
+	}
+	
 	unsigned int nChannels = QTEXTURE_GET_CHANNEL_COUNT(pixelFormat);
-	if(QTEXTURE_IS_COMPRESSED_FORMAT(pixelFormat) || nChannels == 4)
+	if(nChannels == 4)
 		return false;
 	
 	unsigned int value;
@@ -1485,12 +1728,24 @@ CQuadrionTextureObject::CQuadrionTextureObject(const unsigned int handle, const
 	m_pixelFormat = D3DFMT_UNKNOWN;
 	m_textureFlags = 0;
 	
+	m_residencyClass = -1;
+	m_residentBytes = 0;
+	m_fullBytes = 0;
+	m_droppedMips = 0;
+	m_lastUseFrame = 0;
+	m_bStreaming = false;
+	m_screenExtent = 0;
+	m_pQuadrionRender = NULL;
+	
 	memset(&m_textureSampler, 0, sizeof(SQuadrionTextureSampler));
 }
 
 CQuadrionTextureObject::~CQuadrionTextureObject()
 {
 //	UnbindTexture();
+	if(m_pQuadrionRender && m_pQuadrionRender->m_textureStreamer)
+		m_pQuadrionRender->m_textureStreamer->Cancel(this);
+	
 	m_pRenderDevice = NULL;
 	
 	if(m_pTextureObject)
@@ -1524,179 +1779,85 @@ void CQuadrionTextureObject::ChangeRenderDevice(const void* pRender)
 }
 
 
-bool CQuadrionTextureObject::CreateTextureFromFile(unsigned int& flags)
+bool CQuadrionTextureObject::CreateTextureFromFile(unsigned int& flags, const std::string& source)
 {
-	// Get full path and attempt to load texture //
-	std::string fullpath = GetFilename();
-	CQuadrionTextureFile tex;
-	std::string baseFileName(fullpath);
-	int extLoc = 0;
-
-	// Search the last 5 characters for a '.', which means an extensions was already provided
-	extLoc = fullpath.substr(fullpath.size() - 5, fullpath.size()).find(".");
-
-	if(extLoc > 0)
-	{
-		if(!tex.LoadTexture(fullpath.c_str()))
-			return false;
-	}
-	else
-	{	
-		baseFileName.append(".tga");
-
-		if(!tex.LoadTexture(baseFileName.c_str()))
-		{
-			baseFileName = fullpath;
-			baseFileName.append(".jpg");
-
-			if(!tex.LoadTexture(baseFileName.c_str()))
-			{
-				baseFileName.assign("textures/noshader.tga");
-
-				if(!tex.LoadTexture(baseFileName.c_str()))
-					return false;
-			}
-		}
-	}
+	// Resolve the file, falling back to the placeholder //
+	std::string fileName;
+	if(!QTEXTURE_FIND_FILE((source.empty()) ? GetFilename() : source, fileName) && !QTEXTURE_FIND_FILE("textures/noshader.tga", fileName))
+		return false;
 	
 	m_textureFlags = flags;
+	m_sourceFile = fileName;
 	
-	// Look for mip flags and generate mip maps //
-	bool mipGenerationFailed = false;
-	if(tex.GetMipMapCount() <= 1 && HasMipMapFlags(flags))
-	{
-		if(!tex.GenerateMipMaps())
-			mipGenerationFailed = true;
-	}
-	
-	// Look for normal/heightmap generation flags //
-	if((tex.GetHeight() > 0 && tex.GetDepth() == 1) && (flags & QTEXTURE_NORMALMAP))
-	{
-		if(!tex.HeightToNormal(true, (flags & QTEXTURE_KEEPHEIGHT) != 0))
-			return false;
-	}
+	// Whatever was on its way belongs to the previous load //
+	CQuadrionTextureStreamer* streamer = m_pQuadrionRender->m_textureStreamer;
+	streamer->Cancel(this);
 	
-	// Look for cubemap flags and clamp ranges //
-	if(tex.IsCubemap())
-		flags |= (QTEXTURE_CLAMP_S | QTEXTURE_CLAMP_T);
+	// Streamed textures start out with the small levels only //
+	CQuadrionTextureFile tex;
+	bool useNormalmap, autoGenMips;
+	unsigned int maxExtent = (flags & QTEXTURE_STREAM) ? QTEXTURE_STREAM_EXTENT : 0;
+	if(!LoadChain(m_pQuadrionRender->m_textureCache, fileName, flags, maxExtent, tex, useNormalmap, autoGenMips))
+		return false;
 	
-	ETexturePixelFormat fmt = tex.GetPixelFormat();
-	if(IsPlainFormat(fmt) && GetChannelCount(fmt) == 3)
-	{
-		if(!tex.AddChannel(1))
-			return false;
-		
-		fmt = tex.GetPixelFormat();
-	}
+	if(!UploadTexture(tex, flags, useNormalmap, autoGenMips))
+		return false;
 	
-	m_pixelFormat = g_textureFormats[fmt];
-	m_textureWidth = tex.GetWidth();
-	m_textureHeight = tex.GetHeight();
+	// The driver holds its own copy now //
+	unsigned int firstLevel = tex.GetFirstLevel();
+	tex.ReleaseMapping();
 	
-	m_usage = 0;
-	if(flags & QTEXTURE_DYNAMIC)
-		m_usage |= D3DUSAGE_DYNAMIC;
-	if(mipGenerationFailed)
-		m_usage |= D3DUSAGE_AUTOGENMIPMAP;
-		
-	D3DPOOL pool = D3DPOOL_MANAGED;
-
-	LPDIRECT3DTEXTURE9 texture;
-	LPDIRECT3DCUBETEXTURE9 cubeTexture;
-	LPDIRECT3DVOLUMETEXTURE9 volumeTexture;
+	if(firstLevel > 0)
+		streamer->Request(this, fileName, m_textureFlags);
 	
-	if(tex.IsCubemap())
-	{
-		if(FAILED(m_pRenderDevice->CreateCubeTexture(m_textureWidth, tex.GetMipMapCount(), m_usage, m_pixelFormat, pool, &cubeTexture, NULL)))
-			return false;
+	return true;
+}
 
-		m_pTextureObject = cubeTexture;
-	}
-	
-	else if(tex.Is3D())
-	{
-		if(FAILED(m_pRenderDevice->CreateVolumeTexture(m_textureWidth, m_textureHeight, tex.GetDepth(), tex.GetMipMapCount(), m_usage, m_pixelFormat, pool, &volumeTexture, NULL)))
-			return false;
 
-		m_pTextureObject = volumeTexture;
-	}
-	
-	else
-	{
-		if(FAILED(m_pRenderDevice->CreateTexture(m_textureWidth, m_textureHeight, tex.GetMipMapCount(), m_usage, m_pixelFormat, pool, &texture, NULL)))
+/////////////////////////////////////////////////////////////////////////////////
+// loadChain
+// A cached entry is used as is, anything else is decoded and processed. Partial
+// loads go straight to the file, keying the cache hashes the whole source and that
+// only pays off for the full load on the streamer's thread. DDS chains need no
+// decoding, they are only cached when PrepareForUpload has work to do on them
+bool CQuadrionTextureObject::LoadChain(CQuadrionTextureCache* cache, const std::string& fileName, unsigned int& flags, const unsigned int& maxExtent,
+									   CQuadrionTextureFile& tex, bool& useNormalmap, bool& autoGenMips)
+{
+	bool useCache = cache && cache->IsEnabled() && maxExtent == 0;
+	bool mapFile = (flags & QTEXTURE_MAPFILE) != 0;
+	autoGenMips = false;
+	
+	// QTEXTURE_MAPFILE only applies to DDS, a mapped load reads the header here and //
+	// the levels are paged in on upload                                             //
+	const char* ext = strrchr(fileName.c_str(), '.');
+	if(useCache && ext && stricmp(ext, ".dds") == 0)
+	{
+		if(!tex.LoadTexture(fileName.c_str(), "", mapFile, maxExtent))
 			return false;
 		
-		m_pTextureObject = texture;
+		useCache = NeedsProcessing(tex, flags);
 	}
 	
-	if(m_pixelFormat == D3DFMT_A8R8G8B8)
-	{
-		if(!tex.SwapChannels(0, 2, flags & QTEXTURE_NORMALMAP))
-			return false;
-	}
-	
-	unsigned char* src;
-	int mipLevel = 0;
-	
-	while((src = (flags & QTEXTURE_NORMALMAP) ? tex.GetNormalmapData(mipLevel) : tex.GetData(mipLevel)) != NULL)
+	SQuadrionTextureCacheKey key;
+	useCache = useCache && cache->GetKey(fileName, GetProcessingFlags(flags), key);
+	if(useCache && cache->Load(key, tex, autoGenMips, maxExtent))
 	{
-		int size = tex.GetSizeWithMipMaps(mipLevel, 1);
-		if(tex.Is3D())
-		{
-			D3DLOCKED_BOX box;
-			if(SUCCEEDED(volumeTexture->LockBox(mipLevel, &box, NULL, 0)))
-			{
-				memcpy(box.pBits, src, size);
-				volumeTexture->UnlockBox(mipLevel);
-			}
-		}
+		if(tex.IsCubemap())
+			flags |= (QTEXTURE_CLAMP_S | QTEXTURE_CLAMP_T);
 		
-		else if(tex.IsCubemap())
-		{
-			size /= 6;
-			D3DLOCKED_RECT rect;
-			for(unsigned int i = 0; i < 6; ++i)
-			{
-				if(SUCCEEDED(cubeTexture->LockRect((D3DCUBEMAP_FACES)i, mipLevel, &rect, NULL, 0)))
-				{
-					memcpy(rect.pBits, src, size);
-					cubeTexture->UnlockRect((D3DCUBEMAP_FACES)i, mipLevel);
-				}
-				
-				src += size;
-			}
-		}
-		
-		else
-		{
-			D3DLOCKED_RECT rect;
-			if(SUCCEEDED(texture->LockRect(mipLevel, &rect, NULL, 0)))
-			{
-				memcpy(rect.pBits, src, size);
-				texture->UnlockRect(mipLevel);
-			}
-		}
-		
-		++mipLevel;
+		useNormalmap = false;
+		return true;
 	}
 	
-	int filterIndex = GetFilterIndex(flags);
-	if(filterIndex < 0) 
+	if(!tex.IsLoaded() && !tex.LoadTexture(fileName.c_str(), "", mapFile, maxExtent))
 		return false;
-		
-	m_textureSampler.minFilter = g_filters[filterIndex];
-	m_textureSampler.magFilter = (filterIndex > 0) ? D3DTEXF_LINEAR : D3DTEXF_POINT;
-	m_textureSampler.mipFilter = g_mipFilters[filterIndex];
-	m_textureSampler.wrapS = (flags & QTEXTURE_CLAMP_S) ? D3DTADDRESS_CLAMP : D3DTADDRESS_WRAP;
-	m_textureSampler.wrapT = (flags & QTEXTURE_CLAMP_T) ? D3DTADDRESS_CLAMP : D3DTADDRESS_WRAP;
-	m_textureSampler.wrapR = (flags & QTEXTURE_CLAMP_R) ? D3DTADDRESS_CLAMP : D3DTADDRESS_WRAP;
 	
-	if(m_textureSampler.minFilter == D3DTEXF_ANISOTROPIC || m_textureSampler.mipFilter == D3DTEXF_ANISOTROPIC)
-		m_anisotropy = m_pQuadrionRender->m_deviceCaps.maxAnisotropy;
-	else
-		m_anisotropy = 0;
+	if(!PrepareForUpload(tex, flags, autoGenMips))
+		return false;
 	
-	m_bIsLoaded = true;
+	useNormalmap = (flags & QTEXTURE_NORMALMAP) != 0;
+	if(useCache)
+		cache->Store(key, tex, useNormalmap, autoGenMips);
 	
 	return true;
 }
@@ -1704,18 +1865,29 @@ bool CQuadrionTextureObject::CreateTextureFromFile(unsigned int& flags)
 
 bool CQuadrionTextureObject::CreateTexture(CQuadrionTextureFile& tex, unsigned int& flags)
 {
-	// Get full path and attempt to load texture //
-	std::string fullpath = GetFilename();
-//	CQuadrionTextureFile tex;
 	if(!tex.IsLoaded())
 		return false;
 	
+	bool autoGenMips;
+	if(!PrepareForUpload(tex, flags, autoGenMips))
+		return false;
+	
+	return UploadTexture(tex, flags, (flags & QTEXTURE_NORMALMAP) != 0, autoGenMips);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// prepareForUpload
+// Everything that happens on the CPU between loading and uploading. The result
+// only depends on the source and GetProcessingFlags, which is what makes it cacheable
+bool CQuadrionTextureObject::PrepareForUpload(CQuadrionTextureFile& tex, unsigned int& flags, bool& autoGenMips)
+{
 	// Look for mip flags and generate mip maps //
-	bool mipGenerationFailed = false;
+	autoGenMips = false;
 	if(tex.GetMipMapCount() <= 1 && HasMipMapFlags(flags))
 	{
-		if(!tex.GenerateMipMaps())
-			mipGenerationFailed = true;
+		if(!tex.GenerateMipMaps(QTEXTURE_ALL_MIPMAPS, (flags & (QTEXTURE_NORMALMAP | QTEXTURE_LINEAR)) == 0))
+			autoGenMips = true;
 	}
 	
 	// Look for normal/heightmap generation flags //
@@ -1729,6 +1901,10 @@ bool CQuadrionTextureObject::CreateTexture(CQuadrionTextureFile& tex, unsigned i
 	if(tex.IsCubemap())
 		flags |= (QTEXTURE_CLAMP_S | QTEXTURE_CLAMP_T);
 	
+	// Block compress on request //
+	if(!CompressForUpload(tex, flags, autoGenMips))
+		return false;
+	
 	ETexturePixelFormat fmt = tex.GetPixelFormat();
 	if(IsPlainFormat(fmt) && GetChannelCount(fmt) == 3)
 	{
@@ -1738,6 +1914,23 @@ bool CQuadrionTextureObject::CreateTexture(CQuadrionTextureFile& tex, unsigned i
 		fmt = tex.GetPixelFormat();
 	}
 	
+	// D3D stores 8 bit RGBA as BGRA //
+	if(g_textureFormats[fmt] == D3DFMT_A8R8G8B8)
+	{
+		if(!tex.SwapChannels(0, 2, (flags & QTEXTURE_NORMALMAP) != 0))
+			return false;
+	}
+	
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// uploadTexture
+// Creates the device texture and copies every level of the processed chain
+bool CQuadrionTextureObject::UploadTexture(CQuadrionTextureFile& tex, const unsigned int& flags, const bool useNormalmap, const bool autoGenMips)
+{
+	ETexturePixelFormat fmt = tex.GetPixelFormat();
 	m_pixelFormat = g_textureFormats[fmt];
 	m_textureWidth = tex.GetWidth();
 	m_textureHeight = tex.GetHeight();
@@ -1745,7 +1938,7 @@ bool CQuadrionTextureObject::CreateTexture(CQuadrionTextureFile& tex, unsigned i
 	m_usage = 0;
 	if(flags & QTEXTURE_DYNAMIC)
 		m_usage |= D3DUSAGE_DYNAMIC;
-	if(mipGenerationFailed)
+	if(autoGenMips)
 		m_usage |= D3DUSAGE_AUTOGENMIPMAP;
 		
 	D3DPOOL pool = D3DPOOL_MANAGED;
@@ -1778,16 +1971,10 @@ bool CQuadrionTextureObject::CreateTexture(CQuadrionTextureFile& tex, unsigned i
 		m_pTextureObject = texture;
 	}
 	
-	if(m_pixelFormat == D3DFMT_A8R8G8B8)
-	{
-		if(!tex.SwapChannels(0, 2, flags & QTEXTURE_NORMALMAP))
-			return false;
-	}
-	
 	unsigned char* src;
 	int mipLevel = 0;
 	
-	while((src = (flags & QTEXTURE_NORMALMAP) ? tex.GetNormalmapData(mipLevel) : tex.GetData(mipLevel)) != NULL)
+	while((src = (useNormalmap) ? tex.GetNormalmapData(mipLevel) : tex.GetData(mipLevel)) != NULL)
 	{
 		int size = tex.GetSizeWithMipMaps(mipLevel, 1);
 		if(tex.Is3D())
@@ -1845,6 +2032,18 @@ bool CQuadrionTextureObject::CreateTexture(CQuadrionTextureFile& tex, unsigned i
 	else
 		m_anisotropy = 0;
 	
+	// Residency bookkeeping goes before m_bIsLoaded. Loads queued on the TMS run on its thread, and the //
+	// residency update on the render thread skips a texture until m_bIsLoaded is set                   //
+	if(m_residencyClass < 0)
+		m_residencyClass = ClassifyResidency(flags, tex);
+	
+	// A chain that starts below the file's top counts as dropped levels, the full chain is estimated //
+	// from its top level, each level above it holds four times as much                              //
+	m_droppedMips = tex.GetFirstLevel();
+	UpdateResidentBytes();
+	m_fullBytes = m_residentBytes << (2 * m_droppedMips);
+	m_lastUseFrame = m_pQuadrionRender->m_textureResidency->GetFrame();
+	
 	m_bIsLoaded = true;
 	
 	return true;
@@ -1861,7 +2060,7 @@ bool CQuadrionTextureObject::CreateTextureFromData(unsigned int& flags, const vo
 	bool mipGenerationFailed = false;
 	if(tex.GetMipMapCount() <= 1 && HasMipMapFlags(flags))
 	{
-		if(!tex.GenerateMipMaps())
+		if(!tex.GenerateMipMaps(QTEXTURE_ALL_MIPMAPS, (flags & (QTEXTURE_NORMALMAP | QTEXTURE_LINEAR)) == 0))
 			mipGenerationFailed = true;
 	}
 	
@@ -1876,6 +2075,10 @@ bool CQuadrionTextureObject::CreateTextureFromData(unsigned int& flags, const vo
 	if(tex.IsCubemap())
 		flags |= (QTEXTURE_CLAMP_S | QTEXTURE_CLAMP_T);
 	
+	// Block compress on request //
+	if(!CompressForUpload(tex, flags, mipGenerationFailed))
+		return false;
+	
 	ETexturePixelFormat fmt = tex.GetPixelFormat();
 	if(IsPlainFormat(fmt) && GetChannelCount(fmt) == 3)
 	{
@@ -1992,6 +2195,14 @@ bool CQuadrionTextureObject::CreateTextureFromData(unsigned int& flags, const vo
 	else
 		m_anisotropy = 0;
 	
+	// Counted against its class but never evicted, there is no file to reload it from //
+	if(m_residencyClass < 0)
+		m_residencyClass = ClassifyResidency(flags, tex);
+	
+	UpdateResidentBytes();
+	m_fullBytes = m_residentBytes;
+	m_lastUseFrame = m_pQuadrionRender->m_textureResidency->GetFrame();
+	
 	m_bIsLoaded = true;
 	
 	return true;	
@@ -2002,6 +2213,8 @@ bool CQuadrionTextureObject::BindTexture(const unsigned int& textureUnit)
 {
 	if(textureUnit > QRENDER_MAX_TEXTURE_SAMPLERS || (!IsLoaded()))
 		return false;
+	
+	m_pQuadrionRender->m_textureResidency->Touch(this);
 		
 	bool minAniso, mipAniso;
 	minAniso = mipAniso = false;
@@ -2093,6 +2306,9 @@ bool CQuadrionTextureObject::BindTexture(const std::string& paramName)
 	if(m_pQuadrionRender->m_currentEffect == QRENDER_INVALID_HANDLE)
 		return false;
 	
+	if(IsLoaded())
+		m_pQuadrionRender->m_textureResidency->Touch(this);
+	
 	CQuadrionEffect* effect = m_pQuadrionRender->GetEffect(m_pQuadrionRender->m_currentEffect);
 	effect->UploadTexture(paramName, this);
 	
@@ -2119,6 +2335,241 @@ bool CQuadrionTextureObject::UnbindTexture()
 }
 
 
+/////////////////////////////////////////////////////////////////////////////////
+// updateResidentBytes
+// Device memory of the current chain, from the level descriptions
+void CQuadrionTextureObject::UpdateResidentBytes()
+{
+	m_residentBytes = 0;
+	if(!m_pTextureObject)
+		return;
+	
+	unsigned int nLevels = m_pTextureObject->GetLevelCount();
+	for(unsigned int level = 0; level < nLevels; ++level)
+	{
+		if(m_pTextureObject->GetType() == D3DRTYPE_VOLUMETEXTURE)
+		{
+			D3DVOLUME_DESC desc;
+			if(SUCCEEDED(((LPDIRECT3DVOLUMETEXTURE9)m_pTextureObject)->GetLevelDesc(level, &desc)))
+				m_residentBytes += GetLevelBytes(desc.Format, desc.Width, desc.Height) * desc.Depth;
+		}
+		
+		else if(m_pTextureObject->GetType() == D3DRTYPE_CUBETEXTURE)
+		{
+			D3DSURFACE_DESC desc;
+			if(SUCCEEDED(((LPDIRECT3DCUBETEXTURE9)m_pTextureObject)->GetLevelDesc(level, &desc)))
+				m_residentBytes += GetLevelBytes(desc.Format, desc.Width, desc.Height) * 6;
+		}
+		
+		else
+		{
+			D3DSURFACE_DESC desc;
+			if(SUCCEEDED(((LPDIRECT3DTEXTURE9)m_pTextureObject)->GetLevelDesc(level, &desc)))
+				m_residentBytes += GetLevelBytes(desc.Format, desc.Width, desc.Height);
+		}
+	}
+	
+	// Driver generated levels are not reported, they add a third //
+	if(m_usage & D3DUSAGE_AUTOGENMIPMAP)
+		m_residentBytes += m_residentBytes / 3;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// releaseFromSamplers
+// The device holds a reference to bound textures, they have to be unbound from
+// every unit before their memory can go
+void CQuadrionTextureObject::ReleaseFromSamplers()
+{
+	for(unsigned int i = 0; i < QRENDER_MAX_TEXTURE_SAMPLERS; ++i)
+	{
+		if(m_pQuadrionRender->m_currentTextures[i] == (int)GetHandle() && m_pQuadrionRender->m_currentTextureTypes[i] == 1)
+		{
+			m_pRenderDevice->SetTexture(i, NULL);
+			m_pQuadrionRender->m_currentTextures[i] = -1;
+			m_pQuadrionRender->m_currentTextureTypes[i] = -1;
+			memset((void*)&m_pQuadrionRender->m_currentSamplers[i], 0, sizeof(SQuadrionTextureSampler));
+		}
+	}
+	
+	m_assignedTextureUnit = -1;
+	m_bIsBound = false;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// evict
+// Releases the device texture. The object stays loaded and the next bind reloads it
+void CQuadrionTextureObject::Evict()
+{
+	if(!m_pTextureObject)
+		return;
+	
+	m_pQuadrionRender->m_textureStreamer->Cancel(this);
+	
+	ReleaseFromSamplers();
+	m_pTextureObject->Release();
+	m_pTextureObject = NULL;
+	m_residentBytes = 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// dropMipMaps
+// Replaces the device texture with one that starts nLevels further down the chain,
+// copied from the levels already on the device. Managed 2D and cube textures only,
+// the top level keeps at least QTEXTURE_RESIDENCY_MIN_EXTENT texels on one side
+bool CQuadrionTextureObject::DropMipMaps(const unsigned int& nLevels)
+{
+	if(!m_pTextureObject || (m_usage & (D3DUSAGE_AUTOGENMIPMAP | D3DUSAGE_DYNAMIC)))
+		return false;
+	
+	D3DRESOURCETYPE type = m_pTextureObject->GetType();
+	unsigned int levels = m_pTextureObject->GetLevelCount();
+	if((type != D3DRTYPE_TEXTURE && type != D3DRTYPE_CUBETEXTURE) || nLevels == 0 || nLevels >= levels)
+		return false;
+	
+	// The new top level is level nLevels of the current chain, which may itself start below the file's top //
+	D3DSURFACE_DESC desc;
+	HRESULT hr = (type == D3DRTYPE_CUBETEXTURE) ? ((LPDIRECT3DCUBETEXTURE9)m_pTextureObject)->GetLevelDesc(nLevels, &desc) :
+												  ((LPDIRECT3DTEXTURE9)m_pTextureObject)->GetLevelDesc(nLevels, &desc);
+	if(FAILED(hr))
+		return false;
+	
+	unsigned int w = desc.Width;
+	unsigned int h = desc.Height;
+	if(w < QTEXTURE_RESIDENCY_MIN_EXTENT && h < QTEXTURE_RESIDENCY_MIN_EXTENT)
+		return false;
+	
+	LPDIRECT3DBASETEXTURE9 dropped;
+	unsigned int nFaces;
+	if(type == D3DRTYPE_CUBETEXTURE)
+	{
+		LPDIRECT3DCUBETEXTURE9 cubeTexture;
+		if(FAILED(m_pRenderDevice->CreateCubeTexture(w, levels - nLevels, m_usage, m_pixelFormat, D3DPOOL_MANAGED, &cubeTexture, NULL)))
+			return false;
+		
+		dropped = cubeTexture;
+		nFaces = 6;
+	}
+	
+	else
+	{
+		LPDIRECT3DTEXTURE9 texture;
+		if(FAILED(m_pRenderDevice->CreateTexture(w, h, levels - nLevels, m_usage, m_pixelFormat, D3DPOOL_MANAGED, &texture, NULL)))
+			return false;
+		
+		dropped = texture;
+		nFaces = 1;
+	}
+	
+	// Block compressed levels are copied a row of blocks at a time //
+	bool blocks = GetBlockBytes(m_pixelFormat) != 0;
+	for(unsigned int level = 0; level < levels - nLevels; ++level)
+	{
+		unsigned int rows = QIMAGE_GET_MIP_DIMENSION(h, level);
+		if(blocks)
+			rows = (rows + 3) / 4;
+		
+		for(unsigned int face = 0; face < nFaces; ++face)
+		{
+			D3DLOCKED_RECT src, dst;
+			if(!LockTextureLevel(m_pTextureObject, face, level + nLevels, src, D3DLOCK_READONLY))
+			{
+				dropped->Release();
+				return false;
+			}
+			
+			if(!LockTextureLevel(dropped, face, level, dst, 0))
+			{
+				UnlockTextureLevel(m_pTextureObject, face, level + nLevels);
+				dropped->Release();
+				return false;
+			}
+			
+			unsigned int rowBytes = min(src.Pitch, dst.Pitch);
+			for(unsigned int y = 0; y < rows; ++y)
+				memcpy((unsigned char*)dst.pBits + y * dst.Pitch, (const unsigned char*)src.pBits + y * src.Pitch, rowBytes);
+			
+			UnlockTextureLevel(dropped, face, level);
+			UnlockTextureLevel(m_pTextureObject, face, level + nLevels);
+		}
+	}
+	
+	ReleaseFromSamplers();
+	m_pTextureObject->Release();
+	m_pTextureObject = dropped;
+	m_droppedMips += nLevels;
+	UpdateResidentBytes();
+	
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// reload
+// Recreates the full chain from the source file, normally a texture cache hit.
+// A texture whose source has gone away stays released and is no longer evictable
+bool CQuadrionTextureObject::Reload()
+{
+	if(m_sourceFile.empty())
+		return false;
+	
+	std::string source = m_sourceFile;
+	unsigned int flags = m_textureFlags;
+	Evict();
+	
+	if(!CreateTextureFromFile(flags, source))
+	{
+		m_sourceFile.clear();
+		return false;
+	}
+	
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// finishStreaming
+// The small chain stays bound and drawable until the full one is on the device, a
+// failed upload leaves it in place
+bool CQuadrionTextureObject::FinishStreaming(CQuadrionTextureFile& tex, const unsigned int& flags, const bool useNormalmap, const bool autoGenMips)
+{
+	m_bStreaming = false;
+	if(!m_pTextureObject)
+		return false;
+	
+	LPDIRECT3DBASETEXTURE9 partial = m_pTextureObject;
+	unsigned int width = m_textureWidth;
+	unsigned int height = m_textureHeight;
+	unsigned int lastUse = m_lastUseFrame;
+	D3DFORMAT format = m_pixelFormat;
+	unsigned long usage = m_usage;
+	
+	m_pTextureObject = NULL;
+	if(!UploadTexture(tex, flags, useNormalmap, autoGenMips))
+	{
+		if(m_pTextureObject)
+			m_pTextureObject->Release();
+		
+		m_pTextureObject = partial;
+		m_textureWidth = width;
+		m_textureHeight = height;
+		m_pixelFormat = format;
+		m_usage = usage;
+		UpdateResidentBytes();
+		return false;
+	}
+	
+	// The samplers still point at the small chain //
+	ReleaseFromSamplers();
+	partial->Release();
+	
+	m_lastUseFrame = lastUse;
+	return true;
+}
+
+
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
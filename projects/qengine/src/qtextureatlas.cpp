@@ -0,0 +1,470 @@
+#include "stdafx.h"
+#include "qtextureatlas.h"
+#include "qimage.h"
+
+#include <algorithm>
+
+
+// Layout a decoded top level is read as, QIMAGE_LAYOUT_RGBA8 + 1 for unsupported formats //
+static QIMAGE_PIXEL_LAYOUT qatlasGetLayout(const ETexturePixelFormat& fmt)
+{
+	switch(fmt)
+	{
+		case QTEXTURE_FORMAT_I8:
+		case QTEXTURE_FORMAT_ATI1N:
+			return QIMAGE_LAYOUT_I8;
+
+		case QTEXTURE_FORMAT_IA8:
+		case QTEXTURE_FORMAT_ATI2N:
+			return QIMAGE_LAYOUT_IA8;
+
+		case QTEXTURE_FORMAT_RGB8:
+			return QIMAGE_LAYOUT_RGB8;
+
+		case QTEXTURE_FORMAT_RGBA8:
+		case QTEXTURE_FORMAT_DXT1:
+		case QTEXTURE_FORMAT_DXT3:
+		case QTEXTURE_FORMAT_DXT5:
+			return QIMAGE_LAYOUT_RGBA8;
+
+		default:
+			return (QIMAGE_PIXEL_LAYOUT)(QIMAGE_LAYOUT_RGBA8 + 1);
+	}
+}
+
+static unsigned int qatlasFloorPow2(unsigned int x)
+{
+	unsigned int p = 1;
+	while(p <= x / 2)
+		p <<= 1;
+
+	return p;
+}
+
+static unsigned int qatlasCeilPow2(const unsigned int& x)
+{
+	unsigned int p = 1;
+	while(p < x)
+		p <<= 1;
+
+	return p;
+}
+
+
+// Writes level "level" of one image into its cell. Texels outside the image repeat the nearest //
+// edge texel, the cell and the image origin are multiples of 2^level so both stay exact         //
+static void qatlasBlitCell(const unsigned char* src, const unsigned int& iw, const unsigned int& ih, unsigned char* page, const unsigned int& pw,
+						   const unsigned int& cx, const unsigned int& cy, const unsigned int& cw, const unsigned int& ch, const unsigned int& ox, const unsigned int& oy)
+{
+	for(unsigned int r = 0; r < ch; ++r)
+	{
+		int sy = (int)(cy + r) - (int)oy;
+		sy = (sy < 0) ? 0 : ((sy >= (int)ih) ? ih - 1 : sy);
+
+		const unsigned char* row = src + sy * iw * 4;
+		unsigned char* dst = page + ((cy + r) * pw + cx) * 4;
+
+		unsigned int left = ox - cx;
+		unsigned int right = cw - left - iw;
+		for(unsigned int i = 0; i < left; ++i, dst += 4)
+			memcpy(dst, row, 4);
+
+		memcpy(dst, row, iw * 4);
+		dst += iw * 4;
+
+		for(unsigned int i = 0; i < right; ++i, dst += 4)
+			memcpy(dst, row + (iw - 1) * 4, 4);
+	}
+}
+
+
+
+CQuadrionTextureAtlas::CQuadrionTextureAtlas(const unsigned int& pageSize, const unsigned int& pad)
+{
+	maxPageSize = qatlasFloorPow2(max(pageSize, 1U));
+	padding = (pad > 0) ? qatlasFloorPow2(pad) : 0;
+
+	nMips = 1;
+	while((2U << (nMips - 1)) <= padding)
+		++nMips;
+}
+
+CQuadrionTextureAtlas::~CQuadrionTextureAtlas()
+{
+	for(unsigned int i = 0; i < images.size(); ++i)
+	{
+		if(images[i].pixels)
+		{
+			delete[] images[i].pixels;
+			images[i].pixels = NULL;
+		}
+	}
+
+	// Pages are owned by the renderer's resource manager //
+	images.clear();
+	pages.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// addImage
+// Compressed images are decoded through DecompressRegion so tex is left untouched
+int CQuadrionTextureAtlas::AddImage(CQuadrionTextureFile& tex)
+{
+	if(!tex.IsLoaded() || tex.GetDepth() != 1)
+		return -1;
+
+	ETexturePixelFormat fmt = tex.GetPixelFormat();
+	QIMAGE_PIXEL_LAYOUT layout = qatlasGetLayout(fmt);
+	if(layout > QIMAGE_LAYOUT_RGBA8)
+		return -1;
+
+	unsigned int w = tex.GetWidth();
+	unsigned int h = tex.GetHeight();
+	if(w == 0 || h == 0)
+		return -1;
+
+	unsigned char* pixels = new unsigned char[w * h * 4];
+	if(fmt >= QTEXTURE_FORMAT_DXT1)
+	{
+		unsigned char* decoded = new unsigned char[w * h * QIMAGE_GET_LAYOUT_BYTES(layout)];
+		bool ok = tex.DecompressRegion(0, 0, 0, w, h, decoded) && QIMAGE_CONVERT(decoded, pixels, w, h, layout, QIMAGE_LAYOUT_RGBA8);
+		delete[] decoded;
+
+		if(!ok)
+		{
+			delete[] pixels;
+			return -1;
+		}
+	}
+	else if(!QIMAGE_CONVERT(tex.GetData(), pixels, w, h, layout, QIMAGE_LAYOUT_RGBA8))
+	{
+		delete[] pixels;
+		return -1;
+	}
+
+	SAtlasImage image;
+	image.pixels = pixels;
+	image.width = w;
+	image.height = h;
+	image.page = -1;
+	image.x = image.y = 0;
+	image.rect.leftU = image.rect.topV = 0.0F;
+	image.rect.rightU = image.rect.bottomV = 1.0F;
+
+	images.push_back(image);
+	return images.size() - 1;
+}
+
+int CQuadrionTextureAtlas::AddImage(const std::string& name, const std::string& path)
+{
+	std::string fileName;
+	if(!QTEXTURE_FIND_FILE(path + name, fileName))
+		return -1;
+
+	CQuadrionTextureFile tex;
+	if(!tex.LoadTexture(fileName.c_str(), ""))
+		return -1;
+
+	return AddImage(tex);
+}
+
+
+// Image extent plus the gutter on both sides, aligned so every mip level starts on a whole texel //
+unsigned int CQuadrionTextureAtlas::GetCellSize(const unsigned int& extent)
+{
+	unsigned int align = 1 << (nMips - 1);
+	return ((extent + align - 1) & ~(align - 1)) + 2 * padding;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// findPosition
+// Bottom-left rule, the lowest top edge wins and ties go to the leftmost node
+bool CQuadrionTextureAtlas::FindPosition(const SAtlasPage& page, const int& w, const int& h, int& node, int& x, int& y)
+{
+	const int size = (int)maxPageSize;
+	int bestY = size + 1;
+
+	for(unsigned int i = 0; i < page.skyline.size(); ++i)
+	{
+		int nx = page.skyline[i].x;
+		if(nx + w > size)
+			break;
+
+		// Rest on the highest node under the span //
+		int ny = 0;
+		int widthLeft = w;
+		for(unsigned int j = i; widthLeft > 0; ++j)
+		{
+			ny = max(ny, page.skyline[j].y);
+			widthLeft -= page.skyline[j].width;
+		}
+
+		if(ny + h <= size && ny < bestY)
+		{
+			bestY = ny;
+			node = i;
+			x = nx;
+		}
+	}
+
+	y = bestY;
+	return bestY <= size;
+}
+
+
+void CQuadrionTextureAtlas::AddSkylineLevel(SAtlasPage& page, const int& node, const int& x, const int& y, const int& w, const int& h)
+{
+	std::vector<SAtlasNode>& skyline = page.skyline;
+
+	SAtlasNode level;
+	level.x = x;
+	level.y = y + h;
+	level.width = w;
+	skyline.insert(skyline.begin() + node, level);
+
+	// Cut the nodes now covered by the new level //
+	for(unsigned int i = node + 1; i < skyline.size();)
+	{
+		int overlap = skyline[i - 1].x + skyline[i - 1].width - skyline[i].x;
+		if(overlap <= 0)
+			break;
+
+		skyline[i].x += overlap;
+		skyline[i].width -= overlap;
+		if(skyline[i].width > 0)
+			break;
+
+		skyline.erase(skyline.begin() + i);
+	}
+
+	// Merge neighbours at the same height //
+	for(unsigned int i = 0; i + 1 < skyline.size();)
+	{
+		if(skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+			++i;
+	}
+
+	page.usedWidth = max(page.usedWidth, (unsigned int)(x + w));
+	page.usedHeight = max(page.usedHeight, (unsigned int)(y + h));
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// build
+// Pages from earlier builds are already on the device and are not touched again
+bool CQuadrionTextureAtlas::Build(unsigned int flags)
+{
+	// Only whole images are mipmapped here, normal maps need the page wide source. Blocks //
+	// only line up with the cells while the gutter holds whole blocks, so no compression  //
+	flags &= ~(QTEXTURE_NORMALMAP | QTEXTURE_KEEPHEIGHT | QTEXTURE_CUBEMAP | QTEXTURE_MAPFILE | QTEXTURE_COMPRESS);
+
+	const unsigned int mipFilters = QTEXTURE_FILTER_BILINEAR | QTEXTURE_FILTER_TRILINEAR | QTEXTURE_FILTER_BILINEAR_ANISO | QTEXTURE_FILTER_TRILINEAR_ANISO;
+	unsigned int nLevels = (flags & mipFilters) ? nMips : 1;
+	if((flags & mipFilters) && nMips == 1)
+		flags = (flags & ~mipFilters) | QTEXTURE_FILTER_LINEAR;
+
+	// Tallest first, the skyline stays flat that way //
+	std::vector<std::pair<unsigned int, unsigned int> > order;
+	for(unsigned int i = 0; i < images.size(); ++i)
+	{
+		if(images[i].page < 0 && images[i].pixels)
+			order.push_back(std::make_pair(~images[i].height, i));
+	}
+
+	std::stable_sort(order.begin(), order.end());
+
+	unsigned int firstPage = pages.size();
+	bool result = true;
+	for(unsigned int i = 0; i < order.size(); ++i)
+	{
+		SAtlasImage& image = images[order[i].second];
+		int cw = (int)GetCellSize(image.width);
+		int ch = (int)GetCellSize(image.height);
+		if(cw > (int)maxPageSize || ch > (int)maxPageSize)
+		{
+			result = false;
+			continue;
+		}
+
+		int node = 0, x = 0, y = 0;
+		unsigned int p = firstPage;
+		for(; p < pages.size(); ++p)
+		{
+			if(FindPosition(pages[p], cw, ch, node, x, y))
+				break;
+		}
+
+		if(p == pages.size())
+		{
+			SAtlasNode root;
+			root.x = root.y = 0;
+			root.width = maxPageSize;
+
+			SAtlasPage page;
+			page.skyline.push_back(root);
+			page.usedWidth = page.usedHeight = 0;
+			page.width = page.height = 0;
+			page.handle = QRENDER_INVALID_HANDLE;
+			pages.push_back(page);
+
+			node = x = y = 0;
+		}
+
+		AddSkylineLevel(pages[p], node, x, y, cw, ch);
+		image.page = p;
+		image.x = x;
+		image.y = y;
+	}
+
+	for(unsigned int p = firstPage; p < pages.size(); ++p)
+	{
+		if(!UploadPage(p, flags, nLevels))
+			result = false;
+	}
+
+	return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// uploadPage
+// Every image is mipmapped on its own and each level is copied into its cell, the page
+// chain is then handed to the renderer like any other texture file
+bool CQuadrionTextureAtlas::UploadPage(const unsigned int& p, const unsigned int& flags, const unsigned int& nLevels)
+{
+	SAtlasPage& page = pages[p];
+	page.width = qatlasCeilPow2(page.usedWidth);
+	page.height = qatlasCeilPow2(page.usedHeight);
+
+	unsigned int chainSize = 0;
+	for(unsigned int level = 0; level < nLevels; ++level)
+		chainSize += QIMAGE_GET_MIP_DIMENSION(page.width, level) * QIMAGE_GET_MIP_DIMENSION(page.height, level) * 4;
+
+	unsigned char* chain = new unsigned char[chainSize];
+	memset(chain, 0, chainSize);
+
+	unsigned int srgbMask = (flags & QTEXTURE_LINEAR) ? 0 : 0x7;
+	for(unsigned int i = 0; i < images.size(); ++i)
+	{
+		SAtlasImage& image = images[i];
+		if(image.page != (int)p || !image.pixels)
+			continue;
+
+		// The image's own chain //
+		unsigned int imageSize = 0;
+		for(unsigned int level = 0; level < nLevels; ++level)
+			imageSize += QIMAGE_GET_MIP_DIMENSION(image.width, level) * QIMAGE_GET_MIP_DIMENSION(image.height, level) * 4;
+
+		unsigned char* mips = new unsigned char[imageSize];
+		memcpy(mips, image.pixels, image.width * image.height * 4);
+		unsigned int generated = QIMAGE_GENERATE_MIP_CHAIN(mips, image.width, image.height, 1, 1, nLevels, 4, QIMAGE_CHANNEL_UNORM8, srgbMask);
+		
+		// Images smaller than the page alignment run out of levels first, they stay at 1x1 //
+		for(unsigned int level = max(generated, 1U); level < nLevels; ++level)
+			memcpy(mips + imageSize - (nLevels - level) * 4, mips + imageSize - (nLevels - level + 1) * 4, 4);
+
+		unsigned int cw = GetCellSize(image.width);
+		unsigned int ch = GetCellSize(image.height);
+
+		unsigned char* src = mips;
+		unsigned char* dst = chain;
+		for(unsigned int level = 0; level < nLevels; ++level)
+		{
+			unsigned int iw = QIMAGE_GET_MIP_DIMENSION(image.width, level);
+			unsigned int ih = QIMAGE_GET_MIP_DIMENSION(image.height, level);
+			unsigned int pw = QIMAGE_GET_MIP_DIMENSION(page.width, level);
+			unsigned int ph = QIMAGE_GET_MIP_DIMENSION(page.height, level);
+
+			qatlasBlitCell(src, iw, ih, dst, pw, image.x >> level, image.y >> level, cw >> level, ch >> level,
+						   (image.x + padding) >> level, (image.y + padding) >> level);
+
+			src += iw * ih * 4;
+			dst += pw * ph * 4;
+		}
+
+		delete[] mips;
+		delete[] image.pixels;
+		image.pixels = NULL;
+
+		image.rect.leftU = (float)(image.x + padding) / (float)page.width;
+		image.rect.rightU = (float)(image.x + padding + image.width) / (float)page.width;
+		image.rect.topV = (float)(image.y + padding) / (float)page.height;
+		image.rect.bottomV = (float)(image.y + padding + image.height) / (float)page.height;
+	}
+
+	// Hand the chain over to a texture file, which frees it //
+	CQuadrionTextureFile file;
+	file.pixels.push_back(chain);
+	file.pixelFormat = QTEXTURE_FORMAT_RGBA8;
+	file.width = page.width;
+	file.height = page.height;
+	file.depth = 1;
+	file.bpp = 32;
+	file.nMipMaps = nLevels;
+	file.m_bIsLoaded = true;
+
+	char ref[16];
+	itoa(g_pRender->GetIncrementalTextureRefference(), ref, 10);
+	file.SetFileName(std::string("atlas") + ref);
+
+	unsigned int pageFlags = flags;
+	page.handle = g_pRender->AddTextureObject(file, pageFlags);
+
+	return page.handle >= 0;
+}
+
+
+int CQuadrionTextureAtlas::GetPageHandle(const unsigned int& page)
+{
+	return (page < pages.size()) ? pages[page].handle : QRENDER_INVALID_HANDLE;
+}
+
+int CQuadrionTextureAtlas::GetTextureHandle(const unsigned int& image)
+{
+	if(image >= images.size() || images[image].page < 0)
+		return QRENDER_INVALID_HANDLE;
+
+	return pages[images[image].page].handle;
+}
+
+unsigned int CQuadrionTextureAtlas::GetImageWidth(const unsigned int& image)
+{
+	return (image < images.size()) ? images[image].width : 0;
+}
+
+unsigned int CQuadrionTextureAtlas::GetImageHeight(const unsigned int& image)
+{
+	return (image < images.size()) ? images[image].height : 0;
+}
+
+const cTextureRect& CQuadrionTextureAtlas::GetTextureRect(const unsigned int& image)
+{
+	return images[image].rect;
+}
+
+
+cTextureRect CQuadrionTextureAtlas::MapRect(const unsigned int& image, const cTextureRect& local)
+{
+	const cTextureRect& r = images[image].rect;
+
+	cTextureRect mapped;
+	mapped.leftU = r.leftU + local.leftU * (r.rightU - r.leftU);
+	mapped.rightU = r.leftU + local.rightU * (r.rightU - r.leftU);
+	mapped.topV = r.topV + local.topV * (r.bottomV - r.topV);
+	mapped.bottomV = r.topV + local.bottomV * (r.bottomV - r.topV);
+
+	return mapped;
+}
+
+vec2f CQuadrionTextureAtlas::MapUV(const unsigned int& image, const vec2f& uv)
+{
+	const cTextureRect& r = images[image].rect;
+	return vec2f(r.leftU + uv.x * (r.rightU - r.leftU), r.topV + uv.y * (r.bottomV - r.topV));
+}
@@ -0,0 +1,315 @@
+#include "stdafx.h"
+#include "qtexture.h"
+#include "qfile.h"
+
+
+// Entries are <hash>_<flags>.qtc, a 64 byte header followed by the chain exactly as GetData returns //
+// it. Keeping the header a multiple of 16 bytes leaves the mapped chain aligned for SIMD readers.    //
+
+const unsigned int QTEXTURECACHE_MAGIC   = 0x43585451;		// 'QTXC'
+const unsigned int QTEXTURECACHE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct SQuadrionTextureCacheHeader
+{
+	unsigned int		magic;
+	unsigned int		version;
+	unsigned long long	sourceHash;
+	unsigned long long	sourceSize;
+	unsigned int		flags;
+	unsigned int		pixelFormat;
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		depth;				// 0 for cubemaps, as in CQuadrionTextureFile
+	unsigned int		bpp;
+	unsigned int		nMipMaps;
+	unsigned int		autoGenMips;
+	unsigned int		dataSize;
+	unsigned int		reserved;
+};
+#pragma pack(pop)
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// SOURCE HASH
+// xxHash64, four independent lanes of 8 bytes so hashing keeps up with reading the file
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+static const unsigned long long QTEXTURECACHE_PRIME1 = 11400714785074694791ULL;
+static const unsigned long long QTEXTURECACHE_PRIME2 = 14029467366897019727ULL;
+static const unsigned long long QTEXTURECACHE_PRIME3 = 1609587929392839161ULL;
+static const unsigned long long QTEXTURECACHE_PRIME4 = 9650029242287828579ULL;
+static const unsigned long long QTEXTURECACHE_PRIME5 = 2870177450012600261ULL;
+
+static inline unsigned long long qtextureRotl64(const unsigned long long& x, const int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline unsigned long long qtextureRead64(const unsigned char* p)
+{
+	unsigned long long v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline unsigned long long qtextureHashRound(unsigned long long acc, const unsigned long long& input)
+{
+	acc += input * QTEXTURECACHE_PRIME2;
+	acc = qtextureRotl64(acc, 31);
+	return acc * QTEXTURECACHE_PRIME1;
+}
+
+static inline unsigned long long qtextureHashMerge(unsigned long long acc, const unsigned long long& lane)
+{
+	acc ^= qtextureHashRound(0, lane);
+	return acc * QTEXTURECACHE_PRIME1 + QTEXTURECACHE_PRIME4;
+}
+
+static unsigned long long qtextureHash64(const unsigned char* p, const size_t& len)
+{
+	const unsigned char* end = p + len;
+	unsigned long long h;
+
+	if(len >= 32)
+	{
+		unsigned long long v1 = QTEXTURECACHE_PRIME1 + QTEXTURECACHE_PRIME2;
+		unsigned long long v2 = QTEXTURECACHE_PRIME2;
+		unsigned long long v3 = 0;
+		unsigned long long v4 = 0 - QTEXTURECACHE_PRIME1;
+
+		const unsigned char* limit = end - 32;
+		do
+		{
+			v1 = qtextureHashRound(v1, qtextureRead64(p));
+			v2 = qtextureHashRound(v2, qtextureRead64(p + 8));
+			v3 = qtextureHashRound(v3, qtextureRead64(p + 16));
+			v4 = qtextureHashRound(v4, qtextureRead64(p + 24));
+			p += 32;
+		}while(p <= limit);
+
+		h = qtextureRotl64(v1, 1) + qtextureRotl64(v2, 7) + qtextureRotl64(v3, 12) + qtextureRotl64(v4, 18);
+		h = qtextureHashMerge(h, v1);
+		h = qtextureHashMerge(h, v2);
+		h = qtextureHashMerge(h, v3);
+		h = qtextureHashMerge(h, v4);
+	}
+	else
+		h = QTEXTURECACHE_PRIME5;
+
+	h += len;
+
+	for(; p + 8 <= end; p += 8)
+	{
+		h ^= qtextureHashRound(0, qtextureRead64(p));
+		h = qtextureRotl64(h, 27) * QTEXTURECACHE_PRIME1 + QTEXTURECACHE_PRIME4;
+	}
+
+	if(p + 4 <= end)
+	{
+		unsigned int k;
+		memcpy(&k, p, 4);
+		h ^= k * QTEXTURECACHE_PRIME1;
+		h = qtextureRotl64(h, 23) * QTEXTURECACHE_PRIME2 + QTEXTURECACHE_PRIME3;
+		p += 4;
+	}
+
+	for(; p < end; ++p)
+	{
+		h ^= *p * QTEXTURECACHE_PRIME5;
+		h = qtextureRotl64(h, 11) * QTEXTURECACHE_PRIME1;
+	}
+
+	h ^= h >> 33;
+	h *= QTEXTURECACHE_PRIME2;
+	h ^= h >> 29;
+	h *= QTEXTURECACHE_PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+
+// CreateDirectoryA only makes the last component, walk the path and make each one //
+static void qtextureCreateDirectory(const std::string& dir)
+{
+	for(size_t i = 1; i <= dir.size(); ++i)
+	{
+		if(i == dir.size() || dir[i] == '/' || dir[i] == '\\')
+		{
+			std::string part = dir.substr(0, i);
+			if(part != "." && part != ".." && part[part.size() - 1] != ':')
+				CreateDirectoryA(part.c_str(), NULL);
+		}
+	}
+}
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// CQUADRIONTEXTURECACHE
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+CQuadrionTextureCache::CQuadrionTextureCache(const std::string& dir)
+{
+	hits = 0;
+	misses = 0;
+	SetDirectory(dir);
+}
+
+CQuadrionTextureCache::~CQuadrionTextureCache()
+{
+
+}
+
+
+void CQuadrionTextureCache::SetDirectory(const std::string& dir)
+{
+	directory = dir;
+	if(!directory.empty() && directory[directory.size() - 1] != '/' && directory[directory.size() - 1] != '\\')
+		directory.append("/");
+}
+
+
+std::string CQuadrionTextureCache::GetEntryName(const SQuadrionTextureCacheKey& key)
+{
+	char name[64];
+	sprintf(name, "%016llx_%08x.qtc", key.sourceHash, key.flags);
+	return directory + name;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// getKey
+// The source is mapped rather than read, only its pages pass through the hash
+bool CQuadrionTextureCache::GetKey(const std::string& source, const unsigned int& flags, SQuadrionTextureCacheKey& key)
+{
+	CMappedFile file;
+	if(!file.Open(source))
+		return false;
+
+	key.sourceHash = qtextureHash64(file.GetData(), file.GetSize());
+	key.sourceSize = file.GetSize();
+	key.flags = flags;
+
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// load
+// Stale or damaged entries count as misses and are overwritten by the next store
+bool CQuadrionTextureCache::Load(const SQuadrionTextureCacheKey& key, CQuadrionTextureFile& tex, bool& autoGenMips, const unsigned int& maxExtent)
+{
+	if(directory.empty())
+		return false;
+
+	CMappedFile* file = new CMappedFile;
+	if(!file->Open(GetEntryName(key)) || file->GetSize() < sizeof(SQuadrionTextureCacheHeader))
+	{
+		delete file;
+		InterlockedIncrement(&misses);
+		return false;
+	}
+
+	const SQuadrionTextureCacheHeader* header = (const SQuadrionTextureCacheHeader*)file->GetData();
+	if(header->magic != QTEXTURECACHE_MAGIC || header->version != QTEXTURECACHE_VERSION || header->sourceHash != key.sourceHash ||
+	   header->sourceSize != key.sourceSize || header->flags != key.flags || header->pixelFormat == QTEXTURE_FORMAT_NONE ||
+	   header->pixelFormat > QTEXTURE_FORMAT_RE8 || header->nMipMaps == 0 ||
+	   (unsigned long long)header->dataSize + sizeof(SQuadrionTextureCacheHeader) > file->GetSize())
+	{
+		delete file;
+		InterlockedIncrement(&misses);
+		return false;
+	}
+
+	tex.FreePixels();
+	tex.pixelFormat = (ETexturePixelFormat)header->pixelFormat;
+	tex.width = header->width;
+	tex.height = header->height;
+	tex.depth = header->depth;
+	tex.bpp = header->bpp;
+	tex.nMipMaps = header->nMipMaps;
+
+	// The header has to describe exactly the chain that follows it //
+	if(tex.GetSizeWithMipMaps() != (int)header->dataSize)
+	{
+		tex.nMipMaps = 0;
+		tex.m_bIsLoaded = false;
+		delete file;
+		InterlockedIncrement(&misses);
+		return false;
+	}
+
+	// Skipped top levels are never touched, their pages are not read in //
+	unsigned int first = tex.GetLevelWithin(maxExtent);
+	int skipSize = tex.GetSizeWithMipMaps(0, first);
+	tex.SetFirstLevel(first);
+	
+	tex.pixels.push_back(file->GetData() + sizeof(SQuadrionTextureCacheHeader) + skipSize);
+	tex.mappedFile = file;
+	tex.m_bIsLoaded = true;
+	autoGenMips = (header->autoGenMips != 0);
+
+	InterlockedIncrement(&hits);
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// store
+// Written under a temporary name and renamed, readers never see a partial entry
+bool CQuadrionTextureCache::Store(const SQuadrionTextureCacheKey& key, CQuadrionTextureFile& tex, const bool useNormalmap, const bool autoGenMips)
+{
+	if(directory.empty() || !tex.IsLoaded())
+		return false;
+
+	if((useNormalmap) ? tex.normalMap.empty() : tex.pixels.empty())
+		return false;
+
+	const unsigned char* data = (useNormalmap) ? tex.GetNormalmapData(0) : tex.GetData(0);
+	int dataSize = tex.GetSizeWithMipMaps();
+	if(!data || dataSize <= 0)
+		return false;
+
+	SQuadrionTextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = QTEXTURECACHE_MAGIC;
+	header.version = QTEXTURECACHE_VERSION;
+	header.sourceHash = key.sourceHash;
+	header.sourceSize = key.sourceSize;
+	header.flags = key.flags;
+	header.pixelFormat = tex.pixelFormat;
+	header.width = tex.width;
+	header.height = tex.height;
+	header.depth = tex.depth;
+	header.bpp = tex.bpp;
+	header.nMipMaps = tex.nMipMaps;
+	header.autoGenMips = (autoGenMips) ? 1 : 0;
+	header.dataSize = (unsigned int)dataSize;
+
+	qtextureCreateDirectory(directory.substr(0, directory.size() - 1));
+
+	std::string entry = GetEntryName(key);
+	char suffix[32];
+	sprintf(suffix, ".%u.tmp", (unsigned int)GetCurrentThreadId());
+	std::string temp = entry + suffix;
+
+	FILE* file;
+	if((file = fopen(temp.c_str(), "wb")) == NULL)
+		return false;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, dataSize, 1, file) == 1;
+	if(fclose(file) != 0)
+		written = false;
+
+	// Another loader may have mapped the entry in the meantime, theirs is as good as ours //
+	if(!written || !MoveFileExA(temp.c_str(), entry.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,181 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "qtexture.h"
+
+
+// Least recently used first //
+static bool qtextureResidencyOlder(CQuadrionTextureObject* a, CQuadrionTextureObject* b)
+{
+	return a->GetLastUseFrame() < b->GetLastUseFrame();
+}
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// CQUADRIONTEXTURERESIDENCY
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+CQuadrionTextureResidency::CQuadrionTextureResidency()
+{
+	memset(budget, 0, sizeof(budget));
+	memset(&stats, 0, sizeof(SQuadrionTextureResidencyStats));
+	memset(&lastStats, 0, sizeof(SQuadrionTextureResidencyStats));
+
+	evictionAge = 300;
+	frame = 0;
+}
+
+CQuadrionTextureResidency::~CQuadrionTextureResidency()
+{
+
+}
+
+
+void CQuadrionTextureResidency::SetBudget(const ETextureResidencyClass& cls, const unsigned long long& bytes)
+{
+	if(cls < QTEXTURE_RESIDENCY_CLASSES)
+		budget[cls] = bytes;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// update
+// Only loaded textures with a source file take part, textures still being loaded
+// on the TMS thread are left alone
+void CQuadrionTextureResidency::Update(const std::vector<CQuadrionTextureObject*>* textures)
+{
+	lastStats = stats;
+	memset(&stats, 0, sizeof(SQuadrionTextureResidencyStats));
+	++frame;
+
+	if(!textures)
+		return;
+
+	std::vector<CQuadrionTextureObject*> lru[QTEXTURE_RESIDENCY_CLASSES];
+	for(std::vector<CQuadrionTextureObject*>::const_iterator i = textures->begin(); i != textures->end(); ++i)
+	{
+		CQuadrionTextureObject* tex = *i;
+		if(!tex || !tex->m_bIsLoaded || tex->m_residencyClass < 0)
+			continue;
+
+		stats.residentBytes[tex->m_residencyClass] += tex->m_residentBytes;
+		if(!tex->m_pTextureObject)
+			continue;
+
+		++stats.residentTextures;
+		if(!tex->m_sourceFile.empty())
+			lru[tex->m_residencyClass].push_back(tex);
+	}
+
+	for(unsigned int cls = 0; cls < QTEXTURE_RESIDENCY_CLASSES; ++cls)
+	{
+		if(lru[cls].empty())
+			continue;
+
+		std::sort(lru[cls].begin(), lru[cls].end(), qtextureResidencyOlder);
+		Enforce(lru[cls], cls);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// enforce
+// lru holds the class's resident, evictable textures in least recently used order.
+// Memory is taken back strictly by age, textures drawn last frame are only
+// touched once everything older is gone
+void CQuadrionTextureResidency::Enforce(std::vector<CQuadrionTextureObject*>& lru, const unsigned int& cls)
+{
+	unsigned long long& resident = stats.residentBytes[cls];
+	const unsigned long long limit = budget[cls];
+
+	// Everything not drawn last frame can be released to make room //
+	unsigned int nOld = 0;
+	unsigned long long reclaimable = 0;
+	while(nOld < lru.size() && lru[nOld]->m_lastUseFrame + 1 < frame)
+		reclaimable += lru[nOld++]->m_residentBytes;
+
+	// Textures drawn last frame get their top levels back, as long as older ones can pay for them. //
+	// Streamed textures get theirs from the streamer                                              //
+	unsigned int restores = 0;
+	for(unsigned int i = nOld; i < lru.size() && restores < QTEXTURE_RESIDENCY_RESTORES_PER_FRAME; ++i)
+	{
+		CQuadrionTextureObject* tex = lru[i];
+		if(tex->m_droppedMips == 0 || tex->m_bStreaming || (limit && resident - tex->m_residentBytes + tex->m_fullBytes > limit + reclaimable))
+			continue;
+
+		resident -= tex->m_residentBytes;
+		if(tex->Reload())
+			++stats.reloads;
+
+		resident += tex->m_residentBytes;
+		++restores;
+	}
+
+	if(!limit || resident <= limit)
+		return;
+
+	// Textures nobody has drawn for a while go first, whole //
+	unsigned int first = 0;
+	for(; first < nOld && resident > limit && frame - lru[first]->m_lastUseFrame > evictionAge; ++first)
+	{
+		resident -= lru[first]->m_residentBytes;
+		lru[first]->Evict();
+		++stats.evictions;
+	}
+
+	// Then the other old ones give up a top level each per round, then whatever they still hold //
+	DropLevels(lru, first, nOld, cls);
+	for(; first < nOld && resident > limit; ++first)
+	{
+		resident -= lru[first]->m_residentBytes;
+		lru[first]->Evict();
+		++stats.evictions;
+	}
+
+	// Last resort, textures in use lose top levels but stay drawable //
+	DropLevels(lru, nOld, lru.size(), cls);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// dropLevels
+// One top level per texture and round, oldest first, until the class fits or
+// textures begin to end have nothing left to drop. Textures still streaming in are
+// left alone, the streamer would put the levels right back
+void CQuadrionTextureResidency::DropLevels(std::vector<CQuadrionTextureObject*>& lru, const unsigned int& begin, const unsigned int& end, const unsigned int& cls)
+{
+	unsigned long long& resident = stats.residentBytes[cls];
+	bool dropped = true;
+	while(resident > budget[cls] && dropped)
+	{
+		dropped = false;
+		for(unsigned int i = begin; i < end && resident > budget[cls]; ++i)
+		{
+			unsigned int bytes = lru[i]->m_residentBytes;
+			if(!lru[i]->m_bStreaming && lru[i]->DropMipMaps(1))
+			{
+				resident -= bytes - lru[i]->m_residentBytes;
+				++stats.mipDrops;
+				dropped = true;
+			}
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// touch
+void CQuadrionTextureResidency::Touch(CQuadrionTextureObject* tex)
+{
+	tex->m_lastUseFrame = frame;
+	if(tex->m_pTextureObject || tex->m_sourceFile.empty())
+		return;
+
+	// Released, bring it back before the bind goes through //
+	if(tex->Reload())
+	{
+		++stats.reloads;
+		++stats.residentTextures;
+		stats.residentBytes[tex->m_residencyClass] += tex->m_residentBytes;
+	}
+}
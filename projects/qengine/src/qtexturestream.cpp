@@ -0,0 +1,244 @@
+#include "stdafx.h"
+#include "qtexture.h"
+
+
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// CQUADRIONTEXTURESTREAMER
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+CQuadrionTextureStreamer::CQuadrionTextureStreamer(CQuadrionTextureCache* cache)
+{
+	this->cache = cache;
+	uploadBudget = 8 << 20;
+
+	thread = NULL;
+	wake = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	InitializeCriticalSection(&lock);
+	quit = false;
+	active = NULL;
+}
+
+CQuadrionTextureStreamer::~CQuadrionTextureStreamer()
+{
+	// A load in progress is finished and thrown away //
+	if(thread)
+	{
+		quit = true;
+		ReleaseSemaphore(wake, 1, NULL);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+		thread = NULL;
+	}
+
+	for(unsigned int i = 0; i < pending.size(); ++i)
+		delete pending[i];
+
+	for(unsigned int i = 0; i < finished.size(); ++i)
+	{
+		delete finished[i]->file;
+		delete finished[i];
+	}
+
+	pending.clear();
+	finished.clear();
+
+	DeleteCriticalSection(&lock);
+	CloseHandle(wake);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// request
+// The worker is started by the first request
+void CQuadrionTextureStreamer::Request(CQuadrionTextureObject* tex, const std::string& source, const unsigned int& flags)
+{
+	EnterCriticalSection(&lock);
+	Cancel(tex);
+
+	if(!thread)
+		thread = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+
+	// Without a worker the texture keeps its small chain //
+	if(!thread)
+	{
+		LeaveCriticalSection(&lock);
+		return;
+	}
+
+	SStreamRequest* req = new SStreamRequest;
+	req->tex = tex;
+	req->source = source;
+	req->flags = flags;
+	req->file = NULL;
+	req->useNormalmap = false;
+	req->autoGenMips = false;
+	req->priority = 1.0F;
+	req->canceled = false;
+
+	pending.push_back(req);
+	tex->m_bStreaming = true;
+	LeaveCriticalSection(&lock);
+
+	ReleaseSemaphore(wake, 1, NULL);
+}
+
+
+void CQuadrionTextureStreamer::Cancel(CQuadrionTextureObject* tex)
+{
+	EnterCriticalSection(&lock);
+
+	for(unsigned int i = 0; i < pending.size(); )
+	{
+		if(pending[i]->tex == tex)
+		{
+			delete pending[i];
+			pending.erase(pending.begin() + i);
+		}
+		else
+			++i;
+	}
+
+	for(unsigned int i = 0; i < finished.size(); )
+	{
+		if(finished[i]->tex == tex)
+		{
+			delete finished[i]->file;
+			delete finished[i];
+			finished.erase(finished.begin() + i);
+		}
+		else
+			++i;
+	}
+
+	if(active && active->tex == tex)
+		active->canceled = true;
+
+	tex->m_bStreaming = false;
+	LeaveCriticalSection(&lock);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// update
+// Priority is the ratio of the extent a texture wants to the extent of the chain it
+// has, so a texture covering the screen with a 64 texel chain goes before one that
+// is merely missing its top level
+void CQuadrionTextureStreamer::Update(const unsigned int& frame)
+{
+	if(!thread)
+		return;
+
+	std::vector<SStreamRequest*> ready;
+
+	EnterCriticalSection(&lock);
+	for(unsigned int i = 0; i < pending.size(); ++i)
+	{
+		CQuadrionTextureObject* tex = pending[i]->tex;
+		unsigned int current = max(tex->m_textureWidth, tex->m_textureHeight);
+		if(tex->m_lastUseFrame + 1 < frame || current == 0)
+		{
+			pending[i]->priority = 0.0F;
+			continue;
+		}
+
+		unsigned int wanted = (tex->m_screenExtent > 0) ? tex->m_screenExtent : current << tex->m_droppedMips;
+		pending[i]->priority = (float)wanted / (float)current;
+	}
+
+	unsigned int bytes = 0;
+	while(!finished.empty())
+	{
+		unsigned int size = (finished.front()->file) ? finished.front()->file->GetSizeWithMipMaps() : 0;
+		if(!ready.empty() && bytes + size > uploadBudget)
+			break;
+
+		bytes += size;
+		ready.push_back(finished.front());
+		finished.erase(finished.begin());
+	}
+
+	LeaveCriticalSection(&lock);
+
+	// Device work stays on this thread //
+	for(unsigned int i = 0; i < ready.size(); ++i)
+	{
+		if(ready[i]->file)
+			ready[i]->tex->FinishStreaming(*ready[i]->file, ready[i]->flags, ready[i]->useNormalmap, ready[i]->autoGenMips);
+		else
+			ready[i]->tex->m_bStreaming = false;
+
+		delete ready[i]->file;
+		delete ready[i];
+	}
+}
+
+
+DWORD WINAPI CQuadrionTextureStreamer::WorkerThread(LPVOID param)
+{
+	((CQuadrionTextureStreamer*)param)->Work();
+	return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// work
+// Highest priority first, oldest first among equals. Only the file and the cache
+// are touched here, the request's texture is left to the render thread
+void CQuadrionTextureStreamer::Work()
+{
+	while(true)
+	{
+		WaitForSingleObject(wake, INFINITE);
+		if(quit)
+			break;
+
+		EnterCriticalSection(&lock);
+		int best = -1;
+		for(unsigned int i = 0; i < pending.size(); ++i)
+		{
+			if(best < 0 || pending[i]->priority > pending[best]->priority)
+				best = i;
+		}
+
+		// Canceled requests leave their wake up behind //
+		if(best < 0)
+		{
+			LeaveCriticalSection(&lock);
+			continue;
+		}
+
+		SStreamRequest* req = pending[best];
+		pending.erase(pending.begin() + best);
+		active = req;
+		LeaveCriticalSection(&lock);
+
+		CQuadrionTextureFile* file = new CQuadrionTextureFile;
+		unsigned int flags = req->flags;
+		bool loaded = CQuadrionTextureObject::LoadChain(cache, req->source, flags, 0, *file, req->useNormalmap, req->autoGenMips);
+
+		EnterCriticalSection(&lock);
+		active = NULL;
+		if(req->canceled)
+		{
+			delete file;
+			delete req;
+		}
+
+		// A failed load still goes back, the render thread ends the texture's streaming //
+		else
+		{
+			if(!loaded)
+			{
+				delete file;
+				file = NULL;
+			}
+
+			req->file = file;
+			req->flags = flags;
+			finished.push_back(req);
+		}
+
+		LeaveCriticalSection(&lock);
+	}
+}
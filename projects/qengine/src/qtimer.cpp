@@ -45,10 +45,13 @@ void CTimer::Stop()
 
 void CTimer::Reset()
 {
-	StartCount.LowPart = 0;
-	StartCount.HighPart = 0;
-	EndCount.LowPart = 0;
-	EndCount.HighPart = 0;
+#ifdef WIN32
+	StartCount.QuadPart = 0;
+	EndCount.QuadPart = 0;
+#else
+	StartCount.tv_sec = StartCount.tv_usec = 0;
+	EndCount.tv_sec = EndCount.tv_usec = 0;
+#endif
 	IsRunning = false;
 }
 
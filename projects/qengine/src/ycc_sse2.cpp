@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "jpegdecoder.h"
+#include "qmath.h"
+#include "qcpu.h"
+
+#include <emmintrin.h>
+
+//
+// SSE2 version of jpeg_decoder::convert_mcus(), 8 pixels at a time.
+//
+// The decoder's tables hold round(FIX(x/2) * (2c - 256)) style products, here
+// they're formed with pmaddwd on k = 2c - 256 and the same 16.16 constants.
+// Constants that don't fit 16 bits are split across both halves of the pair,
+// so the sums, the rounding and the final shifts match the tables exactly and
+// the results are bit exact with the scalar conversion. packuswb does the
+// clamping.
+//
+/*----------------------------------------------------------------------------*/
+#define SCALEBITS 16
+#define ONE_HALF ((long) 1 << (SCALEBITS-1))
+#define FIX(x) ((long) ((x) * (1L<<SCALEBITS) + 0.5))
+/*----------------------------------------------------------------------------*/
+#define PAIR(a, b)  _mm_set_epi16((short)(b), (short)(a), (short)(b), (short)(a), \
+                                  (short)(b), (short)(a), (short)(b), (short)(a))
+#define SPLIT(c)    PAIR((c) / 2, (c) - (c) / 2)
+/*----------------------------------------------------------------------------*/
+// Rounded 16.16 products of both halves, back to 16 bits.
+static inline __m128i descale(__m128i lo, __m128i hi, __m128i k)
+{
+  const __m128i half = _mm_set1_epi32(ONE_HALF);
+
+  lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, k), half), SCALEBITS);
+  hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, k), half), SCALEBITS);
+
+  return (_mm_packs_epi32(lo, hi));
+}
+/*----------------------------------------------------------------------------*/
+// 8 bytes widened to 16 bits.
+static inline __m128i load8(const uchar *p)
+{
+  return (_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128()));
+}
+/*----------------------------------------------------------------------------*/
+// 8 pixels, the low halves of r, g and b, out as RGB or RGBA.
+static inline void store8(uchar *Pdst, __m128i r, __m128i g, __m128i b, int dst_bpp)
+{
+  __m128i rg = _mm_unpacklo_epi8(r, g);
+  __m128i ba = _mm_unpacklo_epi8(b, _mm_set1_epi8((char)0xFF));
+
+  __m128i p0 = _mm_unpacklo_epi16(rg, ba);
+  __m128i p1 = _mm_unpackhi_epi16(rg, ba);
+
+  if (dst_bpp == 4)
+  {
+    _mm_storeu_si128((__m128i *)Pdst, p0);
+    _mm_storeu_si128((__m128i *)(Pdst + 16), p1);
+    return;
+  }
+
+  // RGB has no cheap SSE2 shuffle, the pixels are squeezed out of a copy
+  uint temp[8];
+
+  _mm_storeu_si128((__m128i *)temp, p0);
+  _mm_storeu_si128((__m128i *)(temp + 4), p1);
+
+  for (int i = 0; i < 8; i++)
+  {
+    Pdst[0] = (uchar)temp[i];
+    Pdst[1] = (uchar)(temp[i] >> 8);
+    Pdst[2] = (uchar)(temp[i] >> 16);
+    Pdst += 3;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void gray_convert_sse2(const uchar *Py, int stride, int num_mcus, uchar *Pdst, int dst_bpp)
+{
+  for (int i = num_mcus; i > 0; i--)
+  {
+    __m128i y = _mm_loadl_epi64((const __m128i *)Py);
+
+    if (dst_bpp == 1)
+    {
+      _mm_storel_epi64((__m128i *)Pdst, y);
+      Pdst += 8;
+    }
+    else
+    {
+      store8(Pdst, y, y, y, dst_bpp);
+      Pdst += 8 * dst_bpp;
+    }
+
+    Py += stride;
+  }
+}
+/*----------------------------------------------------------------------------*/
+void ycc_convert_sse2(
+  const uchar *Py, const uchar *Pc, int stride, bool h2,
+  int num_mcus, uchar *Pdst, int dst_bpp)
+{
+  if (!Pc)
+  {
+    gray_convert_sse2(Py, stride, num_mcus, Pdst, dst_bpp);
+    return;
+  }
+
+  const __m128i crr_k = SPLIT(FIX(1.40200/2));
+  const __m128i cbb_k = SPLIT(FIX(1.77200/2));
+  const __m128i g_k = PAIR(-FIX(0.71414/2), -FIX(0.34414/2));
+  const __m128i bias = _mm_set1_epi16(256);
+
+  for (int i = num_mcus; i > 0; i--)
+  {
+    __m128i kb = _mm_sub_epi16(_mm_slli_epi16(load8(Pc), 1), bias);
+    __m128i kr = _mm_sub_epi16(_mm_slli_epi16(load8(Pc + 64), 1), bias);
+
+    // Per chroma sample: crr[cr], (crg[cr] + cbg[cb]) >> 16, cbb[cb]
+    __m128i rc = descale(_mm_unpacklo_epi16(kr, kr), _mm_unpackhi_epi16(kr, kr), crr_k);
+    __m128i gc = descale(_mm_unpacklo_epi16(kr, kb), _mm_unpackhi_epi16(kr, kb), g_k);
+    __m128i bc = descale(_mm_unpacklo_epi16(kb, kb), _mm_unpackhi_epi16(kb, kb), cbb_k);
+
+    if (!h2)
+    {
+      __m128i y = load8(Py);
+
+      store8(Pdst,
+        _mm_packus_epi16(_mm_add_epi16(y, rc), rc),
+        _mm_packus_epi16(_mm_add_epi16(y, gc), gc),
+        _mm_packus_epi16(_mm_add_epi16(y, bc), bc), dst_bpp);
+
+      Pdst += 8 * dst_bpp;
+    }
+    else
+    {
+      // Chroma samples 0-3 cover the first luma block, 4-7 the second
+      for (int l = 0; l < 2; l++)
+      {
+        __m128i y = load8(Py + l * 64);
+        __m128i r = (l == 0) ? _mm_unpacklo_epi16(rc, rc) : _mm_unpackhi_epi16(rc, rc);
+        __m128i g = (l == 0) ? _mm_unpacklo_epi16(gc, gc) : _mm_unpackhi_epi16(gc, gc);
+        __m128i b = (l == 0) ? _mm_unpacklo_epi16(bc, bc) : _mm_unpackhi_epi16(bc, bc);
+
+        store8(Pdst,
+          _mm_packus_epi16(_mm_add_epi16(y, r), r),
+          _mm_packus_epi16(_mm_add_epi16(y, g), g),
+          _mm_packus_epi16(_mm_add_epi16(y, b), b), dst_bpp);
+
+        Pdst += 8 * dst_bpp;
+      }
+    }
+
+    Py += stride;
+    Pc += stride;
+  }
+}
+/*----------------------------------------------------------------------------*/
+bool ycc_sse2_avail(void)
+{
+  return ((QMATH_GET_SIMD_LEVEL() != QMATH_SIMD_SCALAR) && (QCPU_HAS_FEATURE(QCPU_FEATURE_SSE2)));
+}
+/*----------------------------------------------------------------------------*/